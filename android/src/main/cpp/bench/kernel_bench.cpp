@@ -0,0 +1,301 @@
+// Microbenchmarks for the vectorized LAME kernels.
+//
+// Each kernel is run against a scalar reference that mirrors LAME's C code
+// on identical random input; the benchmark prints ns/call for both, the
+// speedup and the largest deviation from the reference. The quantizer
+// kernels produce integers, so any mismatch reports an infinite error.
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int kIterations = 20000;
+
+// LAME 3.100 fft.c fht(), kept verbatim apart from types.
+const float kCostab[8] = {
+    9.238795325112867e-01, 3.826834323650898e-01,
+    9.951847266721969e-01, 9.801714032956060e-02,
+    9.996988186962042e-01, 2.454122852291229e-02,
+    9.999811752826011e-01, 6.135884649154475e-03
+};
+
+void scalarFht(float* fz, int n) {
+    const double sqrt2 = 1.41421356237309504880;
+    const float* tri = kCostab;
+    int k4;
+    float *fi, *gi;
+    const float* fn;
+
+    n <<= 1;
+    fn = fz + n;
+    k4 = 4;
+    do {
+        float s1, c1;
+        int i, k1, k2, k3, kx;
+        kx = k4 >> 1;
+        k1 = k4;
+        k2 = k4 << 1;
+        k3 = k2 + k1;
+        k4 = k2 << 1;
+        fi = fz;
+        gi = fi + kx;
+        do {
+            float f0, f1, f2, f3;
+            f1 = fi[0] - fi[k1];
+            f0 = fi[0] + fi[k1];
+            f3 = fi[k2] - fi[k3];
+            f2 = fi[k2] + fi[k3];
+            fi[k2] = f0 - f2;
+            fi[0] = f0 + f2;
+            fi[k3] = f1 - f3;
+            fi[k1] = f1 + f3;
+            f1 = gi[0] - gi[k1];
+            f0 = gi[0] + gi[k1];
+            f3 = sqrt2 * gi[k3];
+            f2 = sqrt2 * gi[k2];
+            gi[k2] = f0 - f2;
+            gi[0] = f0 + f2;
+            gi[k3] = f1 - f3;
+            gi[k1] = f1 + f3;
+            gi += k4;
+            fi += k4;
+        } while (fi < fn);
+        c1 = tri[0];
+        s1 = tri[1];
+        for (i = 1; i < kx; i++) {
+            float c2, s2;
+            c2 = 1 - (2 * s1) * s1;
+            s2 = (2 * s1) * c1;
+            fi = fz + i;
+            gi = fz + k1 - i;
+            do {
+                float a, b, g0, f0, f1, g1, f2, g2, f3, g3;
+                b = s2 * fi[k1] - c2 * gi[k1];
+                a = c2 * fi[k1] + s2 * gi[k1];
+                f1 = fi[0] - a;
+                f0 = fi[0] + a;
+                g1 = gi[0] - b;
+                g0 = gi[0] + b;
+                b = s2 * fi[k3] - c2 * gi[k3];
+                a = c2 * fi[k3] + s2 * gi[k3];
+                f3 = fi[k2] - a;
+                f2 = fi[k2] + a;
+                g3 = gi[k2] - b;
+                g2 = gi[k2] + b;
+                b = s1 * f2 - c1 * g3;
+                a = c1 * f2 + s1 * g3;
+                fi[k2] = f0 - a;
+                fi[0] = f0 + a;
+                gi[k3] = g1 - b;
+                gi[k1] = g1 + b;
+                b = c1 * g2 - s1 * f3;
+                a = s1 * g2 + c1 * f3;
+                gi[k2] = g0 - a;
+                gi[0] = g0 + a;
+                fi[k3] = f1 - b;
+                fi[k1] = f1 + b;
+                gi += k4;
+                fi += k4;
+            } while (fi < fn);
+            c2 = c1;
+            c1 = c2 * tri[0] - s1 * tri[1];
+            s1 = c2 * tri[1] + s1 * tri[0];
+        }
+        tri += 2;
+    } while (k4 < n);
+}
+
+// LAME 3.100 quantize.c init_xrpow_core_c()
+void scalarXrpow(const float* xr, float* xrpow, int count, float* sum, float* max) {
+    *sum = 0;
+    *max = 0;
+    for (int i = 0; i < count; ++i) {
+        float tmp = std::fabs(xr[i]);
+        *sum += tmp;
+        xrpow[i] = std::sqrt(tmp * std::sqrt((double)tmp));
+        if (xrpow[i] > *max) {
+            *max = xrpow[i];
+        }
+    }
+}
+
+// LAME 3.100 takehiro.c quantize_lines_xrpow(), the version without
+// TAKEHIRO_IEEE754_HACK
+void scalarQuantize(unsigned int l, float istep, const float* xr, int* ix, const float* adj43) {
+    unsigned int remaining;
+    l = l >> 1;
+    remaining = l % 2;
+    l = l >> 1;
+    while (l--) {
+        float x0, x1, x2, x3;
+        int rx0, rx1, rx2, rx3;
+        x0 = *xr++ * istep;
+        x1 = *xr++ * istep;
+        rx0 = (int)x0;
+        x2 = *xr++ * istep;
+        rx1 = (int)x1;
+        x3 = *xr++ * istep;
+        rx2 = (int)x2;
+        x0 += adj43[rx0];
+        rx3 = (int)x3;
+        x1 += adj43[rx1];
+        *ix++ = (int)x0;
+        x2 += adj43[rx2];
+        *ix++ = (int)x1;
+        x3 += adj43[rx3];
+        *ix++ = (int)x2;
+        *ix++ = (int)x3;
+    }
+    if (remaining) {
+        float x0, x1;
+        int rx0, rx1;
+        x0 = *xr++ * istep;
+        x1 = *xr++ * istep;
+        rx0 = (int)x0;
+        rx1 = (int)x1;
+        x0 += adj43[rx0];
+        x1 += adj43[rx1];
+        *ix++ = (int)x0;
+        *ix++ = (int)x1;
+    }
+}
+
+// adj43[] as LAME 3.100 quantize_pvt.c iteration_init() builds it
+std::vector<float> makeAdj43() {
+    const int size = 8208;  // PRECALC_SIZE
+    std::vector<double> pow43(size);
+    std::vector<float> adj43(size);
+    for (int i = 0; i < size; i++) {
+        pow43[i] = std::pow((double)(float)i, 4.0 / 3.0);
+    }
+    adj43[0] = 0.0f;
+    for (int i = 1; i < size; i++) {
+        adj43[i] = (float)((i - 0.5) - std::pow(0.5 * ((float)pow43[i - 1] + (float)pow43[i]), 0.75));
+    }
+    return adj43;
+}
+
+std::vector<float> randomSignal(size_t count, uint32_t seed) {
+    std::vector<float> out(count);
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        out[i] = ((int32_t)seed >> 8) / 8388608.0f;
+    }
+    return out;
+}
+
+template <typename Fn>
+double nsPerCall(Fn fn) {
+    fn();  // warm up caches
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / kIterations;
+}
+
+double maxRelativeError(const std::vector<float>& reference, const std::vector<float>& actual) {
+    double worst = 0.0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        double scale = std::max(1e-6, (double)std::fabs(reference[i]));
+        worst = std::max(worst, std::fabs((double)reference[i] - actual[i]) / scale);
+    }
+    return worst;
+}
+
+void report(const char* name, double scalarNs, double simdNs, double error, bool exact) {
+    printf("%-12s scalar %8.1f ns  simd %8.1f ns  speedup %.2fx  max rel err %.2e%s\n",
+           name, scalarNs, simdNs, scalarNs / simdNs, error, exact ? "  (bit-exact)" : "");
+}
+
+void benchFht(int n, const char* name) {
+    // fht() transforms 2 * n values in place
+    const std::vector<float> input = randomSignal(2 * n, 0xfeedu + n);
+    std::vector<float> reference = input;
+    std::vector<float> actual = input;
+    scalarFht(reference.data(), n);
+    simd_fht(actual.data(), n);
+    bool exact = memcmp(reference.data(), actual.data(), reference.size() * sizeof(float)) == 0;
+    double error = maxRelativeError(reference, actual);
+
+    std::vector<float> work = input;
+    double scalarNs = nsPerCall([&] {
+        memcpy(work.data(), input.data(), input.size() * sizeof(float));
+        scalarFht(work.data(), n);
+    });
+    double simdNs = nsPerCall([&] {
+        memcpy(work.data(), input.data(), input.size() * sizeof(float));
+        simd_fht(work.data(), n);
+    });
+    report(name, scalarNs, simdNs, error, exact);
+}
+
+void benchXrpow() {
+    const int count = 576;
+    const std::vector<float> xr = randomSignal(count, 0xabcdu);
+    std::vector<float> reference(count), actual(count);
+    float refSum, refMax, sum, max;
+    scalarXrpow(xr.data(), reference.data(), count, &refSum, &refMax);
+    simd_xrpow(xr.data(), actual.data(), count, &sum, &max);
+    double error = std::max(maxRelativeError(reference, actual),
+                            std::fabs((double)refSum - sum) / std::max(1e-6, (double)refSum));
+    bool exact = memcmp(reference.data(), actual.data(), count * sizeof(float)) == 0 &&
+                 refSum == sum && refMax == max;
+
+    double scalarNs = nsPerCall([&] {
+        scalarXrpow(xr.data(), reference.data(), count, &refSum, &refMax);
+    });
+    double simdNs = nsPerCall([&] {
+        simd_xrpow(xr.data(), actual.data(), count, &sum, &max);
+    });
+    report("xrpow 576", scalarNs, simdNs, error, exact);
+}
+
+// xrpow values of one granule: mostly small, with a few large lines, scaled
+// so the largest one quantizes to about 1000
+std::vector<float> granuleXrpow(float istep) {
+    std::vector<float> xrpow = randomSignal(576, 0x5eedu);
+    for (size_t i = 0; i < xrpow.size(); i++) {
+        const float a = std::fabs(xrpow[i]);
+        xrpow[i] = a * a * a * a * 1000.0f / istep;
+    }
+    return xrpow;
+}
+
+void benchQuantize(const std::vector<float>& adj43) {
+    const int count = 576;
+    const float istep = 0.8408964f;  // 2^(-0.25)
+    const std::vector<float> xrpow = granuleXrpow(istep);
+    std::vector<int> reference(count), actual(count);
+    scalarQuantize(count, istep, xrpow.data(), reference.data(), adj43.data());
+    simd_quantize_xrpow(xrpow.data(), actual.data(), count, istep, adj43.data());
+    bool exact = reference == actual;
+
+    double scalarNs = nsPerCall([&] {
+        scalarQuantize(count, istep, xrpow.data(), reference.data(), adj43.data());
+    });
+    double simdNs = nsPerCall([&] {
+        simd_quantize_xrpow(xrpow.data(), actual.data(), count, istep, adj43.data());
+    });
+    char name[32];
+    snprintf(name, sizeof(name), "quant %s", simd_quantize_isa());
+    report(name, scalarNs, simdNs, exact ? 0.0 : INFINITY, exact);
+}
+
+}  // namespace
+
+int main() {
+    benchFht(512, "fht 1024");   // long-block psychoacoustic FFT
+    benchFht(128, "fht 256");    // short-block psychoacoustic FFT
+    benchXrpow();
+    benchQuantize(makeAdj43());
+    return 0;
+}
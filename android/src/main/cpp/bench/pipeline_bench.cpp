@@ -0,0 +1,189 @@
+// Fused vs. stage-by-stage PCM pipeline.
+//
+// Runs the same raw PCM through PcmPipeline twice per case, once with the
+// stages fused into one tiled pass and once with each stage streaming the
+// whole block, and prints the time for both, the memory traffic each one
+// implies and the largest difference between their outputs:
+//
+//   pipeline_bench
+//   pipeline_bench --seconds 600 --block 16384
+#include "pcm_pipeline.h"
+#include "sample_convert.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using wavtomp3::PcmPipeline;
+using wavtomp3::PipelineConfig;
+using wavtomp3::SampleFormat;
+
+struct BenchCase {
+    const char* name;
+    SampleFormat format;
+    float gain;
+    bool downmix;
+    int outputRate;
+};
+
+const int kInputRate = 44100;
+
+// A two-tone stereo signal in `format`. Deterministic across runs.
+static std::vector<unsigned char> makeRaw(SampleFormat format, size_t frames) {
+    const int bytes = wavtomp3::bytesPerSample(format);
+    std::vector<unsigned char> raw(frames * 2 * bytes);
+    const double twoPi = 6.283185307179586;
+    for (size_t i = 0; i < frames * 2; i++) {
+        const double t = (double)(i / 2) / kInputRate;
+        const double value = 0.4 * std::sin(twoPi * ((i & 1) ? 330.0 : 220.0) * t) +
+                             0.2 * std::sin(twoPi * 3100.0 * t);
+        unsigned char* out = &raw[i * bytes];
+        switch (format) {
+            case SampleFormat::U8:
+                *out = (unsigned char)(128 + (int)(value * 127.0));
+                break;
+            case SampleFormat::S16: {
+                int16_t s = (int16_t)(value * 32767.0);
+                memcpy(out, &s, 2);
+                break;
+            }
+            case SampleFormat::S24: {
+                int32_t s = (int32_t)(value * 8388607.0);
+                out[0] = (unsigned char)s;
+                out[1] = (unsigned char)(s >> 8);
+                out[2] = (unsigned char)(s >> 16);
+                break;
+            }
+            case SampleFormat::S32: {
+                int32_t s = (int32_t)(value * 2147483647.0);
+                memcpy(out, &s, 4);
+                break;
+            }
+            case SampleFormat::F32: {
+                float s = (float)value;
+                memcpy(out, &s, 4);
+                break;
+            }
+        }
+    }
+    return raw;
+}
+
+static double run(const PipelineConfig& config, bool fused, const std::vector<unsigned char>& raw,
+                  long blockFrames, std::vector<float>* out) {
+    PcmPipeline pipeline(config, fused);
+    const int frameBytes = wavtomp3::bytesPerSample(config.input.sampleFormat) * config.input.channels;
+    const long frames = (long)(raw.size() / frameBytes);
+    out->clear();
+    out->reserve((size_t)((double)frames * pipeline.outputChannels() *
+                          (config.outputRate > 0 ? (double)config.outputRate / kInputRate : 1.0)) +
+                 4096);
+    auto start = std::chrono::steady_clock::now();
+    for (long offset = 0; offset < frames; offset += blockFrames) {
+        pipeline.process(&raw[(size_t)offset * frameBytes], std::min(blockFrames, frames - offset), out);
+    }
+    pipeline.flush(out);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Bytes each variant moves per input frame: the fused pass reads the raw
+// frame and writes the encoder input once; run separately, every stage
+// reads and writes a whole block of floats.
+static void trafficPerFrame(const PipelineConfig& config, double* fused, double* unfused) {
+    const int channels = config.input.channels;
+    const int outChannels = config.downmix ? 1 : channels;
+    const double rateRatio =
+        config.outputRate > 0 ? (double)config.outputRate / config.input.sampleRate : 1.0;
+    const double raw = wavtomp3::bytesPerSample(config.input.sampleFormat) * channels;
+    const double floats = sizeof(float) * channels;
+    const double out = sizeof(float) * outChannels * rateRatio;
+    *fused = raw + out;
+    *unfused = raw + floats;                  // convert
+    if (config.gain != 1.0f) {
+        *unfused += 2 * floats;               // gain in place
+    }
+    if (config.downmix) {
+        *unfused += floats + sizeof(float);   // downmix
+    }
+    *unfused += sizeof(float) * outChannels + out;  // resample or copy out
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--seconds N] [--block FRAMES] [--repeat N]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    int seconds = 120;
+    long blockFrames = 4096;
+    int repeat = 3;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--seconds") == 0) seconds = value;
+        else if (strcmp(argv[i], "--block") == 0) blockFrames = value;
+        else if (strcmp(argv[i], "--repeat") == 0) repeat = value;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (seconds <= 0 || blockFrames <= 0 || repeat <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const BenchCase cases[] = {
+        {"s16 stereo", SampleFormat::S16, 1.0f, false, 0},
+        {"s16 -6dB", SampleFormat::S16, 0.5f, false, 0},
+        {"s24 -3dB", SampleFormat::S24, 0.7079f, false, 0},
+        {"s16 mono 16k", SampleFormat::S16, 1.0f, true, 16000},
+        {"s16 -3dB mono", SampleFormat::S16, 0.7079f, true, 0},
+        {"s16 48k", SampleFormat::S16, 1.0f, false, 48000},
+        {"f32 stereo", SampleFormat::F32, 1.0f, false, 0},
+    };
+    const size_t frames = (size_t)seconds * kInputRate;
+    printf("%d s of 44100 Hz stereo in %ld-frame blocks, %ld-frame tiles\n", seconds, blockFrames,
+           wavtomp3::kPipelineTileFrames);
+
+    std::vector<float> fusedOut, unfusedOut;
+    for (const BenchCase& c : cases) {
+        PipelineConfig config;
+        config.input.sampleRate = kInputRate;
+        config.input.channels = 2;
+        config.input.sampleFormat = c.format;
+        config.gain = c.gain;
+        config.downmix = c.downmix;
+        config.outputRate = c.outputRate;
+        const std::vector<unsigned char> raw = makeRaw(c.format, frames);
+
+        double fusedMs = 0.0, unfusedMs = 0.0;
+        for (int r = 0; r < repeat; r++) {
+            double ms = run(config, false, raw, blockFrames, &unfusedOut);
+            unfusedMs = r == 0 ? ms : std::min(unfusedMs, ms);
+            ms = run(config, true, raw, blockFrames, &fusedOut);
+            fusedMs = r == 0 ? ms : std::min(fusedMs, ms);
+        }
+
+        double maxDiff = fusedOut.size() == unfusedOut.size() ? 0.0 : INFINITY;
+        for (size_t i = 0; i < std::min(fusedOut.size(), unfusedOut.size()); i++) {
+            maxDiff = std::max(maxDiff, (double)std::fabs(fusedOut[i] - unfusedOut[i]));
+        }
+        double fusedBytes, unfusedBytes;
+        trafficPerFrame(config, &fusedBytes, &unfusedBytes);
+        printf("%-13s %-42s fused %7.1f ms  unfused %7.1f ms  %.2fx  traffic %5.1f vs %5.1f B/frame"
+               "  max diff %.1e\n",
+               c.name, PcmPipeline(config).plan().c_str(), fusedMs, unfusedMs, unfusedMs / fusedMs,
+               fusedBytes, unfusedBytes, maxDiff);
+    }
+    return 0;
+}
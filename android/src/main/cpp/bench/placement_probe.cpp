@@ -0,0 +1,73 @@
+// Shows how encode workers are placed on this machine's cores.
+//
+// Prints the CPU topology read from sysfs and the cores each job priority
+// is pinned to. `--sysfs` reads a copied or hand-made tree instead, e.g. a
+// phone's /sys/devices/system/cpu fetched with `adb pull`, so placement
+// decisions for any SoC can be checked on a Linux host:
+//
+//   placement_probe
+//   placement_probe --sysfs ./pixel7-cpu
+//
+// Without --sysfs a short busy job is also run per priority on the shared
+// worker pool, reporting the core it actually finished on.
+#include "cpu_topology.h"
+#include "worker_pool.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using wavtomp3::CpuTopology;
+using wavtomp3::JobPriority;
+using wavtomp3::Placement;
+
+static void printPlacement(const char* label, const Placement& placement) {
+    printf("%-12s %-12s cpus %-10s", label, placement.policy.c_str(),
+           placement.cpus.empty() ? "(any)" : wavtomp3::formatCpuList(placement.cpus).c_str());
+    if (placement.cpu >= 0) {
+        printf(" ran on cpu %d", placement.cpu);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    std::string root = wavtomp3::kDefaultSysfsCpuRoot;
+    bool fake = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sysfs") == 0 && i + 1 < argc) {
+            root = argv[++i];
+            fake = true;
+        } else {
+            fprintf(stderr, "usage: %s [--sysfs DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    CpuTopology topology;
+    if (wavtomp3::readCpuTopology(root, &topology) != 0) {
+        printf("%s: no rankable cores, jobs are left to the scheduler\n", root.c_str());
+    }
+    for (const wavtomp3::CpuCore& core : topology.cores) {
+        printf("cpu%-3d capacity %5d  max %7d kHz\n", core.id, core.capacity, core.maxFreqKhz);
+    }
+    printf("%s\n", topology.isHeterogeneous() ? "heterogeneous" : "homogeneous");
+
+    for (JobPriority priority : {JobPriority::Interactive, JobPriority::Background}) {
+        const char* name = wavtomp3::priorityName(priority);
+        if (fake) {
+            printPlacement(name, wavtomp3::planPlacement(topology, priority));
+            continue;
+        }
+        Placement placement;
+        wavtomp3::runOnWorker(priority, [](const std::function<void(float)>&) {
+            volatile double sink = 0.0;
+            for (int i = 0; i < 20000000; i++) {
+                sink = sink + std::sqrt((double)i);
+            }
+            return 0;
+        }, nullptr, &placement);
+        printPlacement(name, placement);
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "job_protocol.h"
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace wavtomp3 {
+
+namespace {
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = read(fd, data, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // MSG_NOSIGNAL: a client hanging up must not kill the daemon
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool readFrame(int fd, std::string* payload) {
+    unsigned char header[4];
+    if (!readAll(fd, (char*)header, sizeof(header))) {
+        return false;
+    }
+    size_t size = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+                  ((size_t)header[2] << 8) | header[3];
+    if (size > kMaxFrameBytes) {
+        return false;
+    }
+    payload->resize(size);
+    return size == 0 || readAll(fd, &(*payload)[0], size);
+}
+
+bool writeFrame(int fd, const std::string& payload) {
+    size_t size = payload.size();
+    unsigned char header[4] = {(unsigned char)(size >> 24), (unsigned char)(size >> 16),
+                               (unsigned char)(size >> 8), (unsigned char)size};
+    std::string frame((const char*)header, sizeof(header));
+    frame += payload;
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+Fields parseFields(const std::string& payload) {
+    Fields fields;
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        size_t end = payload.find('\n', pos);
+        if (end == std::string::npos) {
+            end = payload.size();
+        }
+        size_t equals = payload.find('=', pos);
+        if (equals != std::string::npos && equals > pos && equals < end) {
+            fields.emplace_back(payload.substr(pos, equals - pos),
+                                payload.substr(equals + 1, end - equals - 1));
+        }
+        pos = end + 1;
+    }
+    return fields;
+}
+
+std::string fieldValue(const Fields& fields, const std::string& key, const std::string& fallback) {
+    for (const auto& field : fields) {
+        if (field.first == key) {
+            return field.second;
+        }
+    }
+    return fallback;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,34 @@
+// Framing for the wav2mp3d socket protocol.
+//
+// Every message is a 4-byte big-endian payload length followed by the
+// payload: "key=value" lines, the same format formatResult() produces.
+// Requests carry a `type` (convert, stats, health); see README.md.
+#ifndef WAV_TO_MP3_JOB_PROTOCOL_H
+#define WAV_TO_MP3_JOB_PROTOCOL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wavtomp3 {
+
+// Ordered, so options are applied in the order the client sent them
+typedef std::vector<std::pair<std::string, std::string>> Fields;
+
+const size_t kMaxFrameBytes = 64 * 1024;
+
+// Reads one frame. Returns false on EOF, error or an oversized frame.
+bool readFrame(int fd, std::string* payload);
+
+// Writes one frame. Returns false if the peer went away.
+bool writeFrame(int fd, const std::string& payload);
+
+Fields parseFields(const std::string& payload);
+
+// Value of `key`, or `fallback` if absent.
+std::string fieldValue(const Fields& fields, const std::string& key,
+                       const std::string& fallback = "");
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_JOB_PROTOCOL_H
@@ -0,0 +1,517 @@
+// wav2mp3: converts WAV files or whole directory trees with the same core
+// the mobile modules use.
+//
+//   wav2mp3 --bitrate 64 input.wav output.mp3
+//   wav2mp3 -j 8 --format opus --bitrate 24 recordings/ encoded/
+//
+// Options are the WavToMp3Options keys, passed to the core unchanged, so
+// anything the JS API accepts works here too. Directory inputs are searched
+// recursively for .wav files and mirrored below the output directory;
+// outputs newer than their input are skipped unless --force is given.
+#include "calibration.h"
+#include "converter.h"
+#include "cpu_topology.h"
+#include "estimate.h"
+#include "mp3_edit.h"
+#include "options.h"
+#include "probe.h"
+#include "wav_file.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+using wavtomp3::ConversionOptions;
+using wavtomp3::ConversionResult;
+
+namespace {
+
+struct Job {
+    std::string input;
+    std::string output;
+};
+
+struct Totals {
+    std::mutex mutex;
+    int converted = 0;
+    int skipped = 0;
+    int failed = 0;
+    double audioSeconds = 0.0;
+    long long inputBytes = 0;
+    long long outputBytes = 0;
+    std::set<std::string> encoders;
+};
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [options] INPUT OUTPUT\n"
+            "\n"
+            "INPUT is a WAV file or a directory searched recursively for .wav files,\n"
+            "which are written below the OUTPUT directory with the same layout.\n"
+            "\n"
+            "  -j N           parallel conversions (default: number of CPUs)\n"
+            "  -f, --force    convert even if the output is newer than the input\n"
+            "  -q, --quiet    only print failures and the summary\n"
+            "  --estimate     print predicted output size and time instead of converting\n"
+            "  --preview      write a quick preview (see --preview.seconds, --preview.bitrate)\n"
+            "                 before each full encode\n"
+            "  --KEY VALUE    conversion option as in WavToMp3Options, e.g. --bitrate 64,\n"
+            "  --KEY=VALUE    --format opus, --encoder fixed, --priority background\n"
+            "\n"
+            "       %s --calibrate FILE\n"
+            "\n"
+            "Measures encode speed per quality level into FILE, for\n"
+            "--deadlineMs MS --calibrationFile FILE.\n"
+            "\n"
+            "       %s [-j N] --probe FILE...\n"
+            "\n"
+            "Prints format and duration of WAV, MP4, AAC, MP3 and Ogg files from\n"
+            "their headers.\n"
+            "\n"
+            "       %s --trim START_MS[:END_MS] INPUT OUTPUT\n"
+            "       %s --join OUTPUT INPUT...\n"
+            "\n"
+            "Cuts or joins MP3 files at frame boundaries without re-encoding.\n",
+            argv0, argv0, argv0, argv0, argv0);
+}
+
+bool isDirectory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool hasWavExtension(const std::string& name) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string extension = name.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == "wav" || extension == "wave";
+}
+
+std::string replaceExtension(const std::string& path, const char* extension) {
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + extension;
+    }
+    return path.substr(0, dot) + extension;
+}
+
+// Appends the paths of all WAV files below `root`, relative to it.
+void collectWavFiles(const std::string& root, const std::string& relative,
+                     std::vector<std::string>* files) {
+    std::string dirPath = relative.empty() ? root : root + "/" + relative;
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir) {
+        fprintf(stderr, "Cannot read %s: %s\n", dirPath.c_str(), strerror(errno));
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string child = relative.empty() ? name : relative + "/" + name;
+        if (isDirectory(root + "/" + child)) {
+            collectWavFiles(root, child, files);
+        } else if (hasWavExtension(name)) {
+            files->push_back(child);
+        }
+    }
+    closedir(dir);
+}
+
+int makeDirectories(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos == path.size() || path[pos] == '/') {
+            std::string prefix = path.substr(0, pos);
+            if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// The core treats headerless input as raw PCM; here a .wav must be one.
+bool hasWavHeader(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool wav = wavtomp3::isWavFile(file);
+    fclose(file);
+    return wav;
+}
+
+bool isUpToDate(const Job& job) {
+    struct stat in, out;
+    return stat(job.input.c_str(), &in) == 0 && stat(job.output.c_str(), &out) == 0 &&
+           out.st_mtime >= in.st_mtime;
+}
+
+// Dates `path` a second before `input`, so isUpToDate() does not take it
+// for a finished conversion.
+void markOutdated(const std::string& path, const std::string& input) {
+    struct stat in;
+    if (stat(input.c_str(), &in) != 0) {
+        return;
+    }
+    struct timespec times[2] = {{in.st_mtime - 1, 0}, {in.st_mtime - 1, 0}};
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+}
+
+// Encodes into OUTPUT.part and renames it, so an interrupted run never
+// leaves a truncated file that would later count as up to date. With
+// `preview` a quick preview is written to OUTPUT first, as
+// convertFilePreview() does for the apps, and dated before the input until
+// the full-quality file replaces it.
+void convert(const Job& job, const ConversionOptions& options, bool preview, bool quiet, Totals* totals) {
+    auto start = std::chrono::steady_clock::now();
+    size_t slash = job.output.find_last_of('/');
+    if (slash != std::string::npos && slash > 0 && makeDirectories(job.output.substr(0, slash)) != 0) {
+        fprintf(stderr, "FAIL %s: cannot create directory for %s\n", job.input.c_str(), job.output.c_str());
+        std::lock_guard<std::mutex> lock(totals->mutex);
+        totals->failed++;
+        return;
+    }
+
+    ConversionResult result;
+    if (preview) {
+        if (wavtomp3::convertFilePreview(job.input, job.output, options, nullptr, &result) == 0) {
+            markOutdated(job.output, job.input);
+            if (!quiet) {
+                double ms =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                printf("%s -> %s  preview %s %d kbps in %.0f ms\n", job.input.c_str(), job.output.c_str(),
+                       result.encoder.c_str(), result.bitrate, ms);
+            }
+        }
+        result = ConversionResult();
+    }
+    std::string error;
+    std::string partPath = job.output + ".part";
+    std::unique_ptr<wavtomp3::AudioSource> source;
+    if (!hasWavHeader(job.input)) {
+        error = "Not a valid WAV file";
+    } else {
+        source = wavtomp3::openAudioSource(job.input, options.rawFormat, &error);
+    }
+    if (!source) {
+        result.errorCode = wavtomp3::kErrorWav;
+        result.errorMessage = error;
+    } else if (wavtomp3::convertSource(source.get(), partPath, options, nullptr, &result) == 0 &&
+               rename(partPath.c_str(), job.output.c_str()) != 0) {
+        result.errorCode = wavtomp3::kErrorWrite;
+        result.errorMessage = std::string("Failed to rename output: ") + strerror(errno);
+        remove(partPath.c_str());
+    }
+
+    struct stat st;
+    long long inputBytes = stat(job.input.c_str(), &st) == 0 ? (long long)st.st_size : 0;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(totals->mutex);
+    if (!result.errorCode.empty()) {
+        fprintf(stderr, "FAIL %s: %s %s\n", job.input.c_str(), result.errorCode.c_str(),
+                result.errorMessage.c_str());
+        totals->failed++;
+        return;
+    }
+    double audioSeconds = (double)result.inputFrames / source->format().sampleRate;
+    if (!quiet) {
+        printf("%s -> %s  %s  %.1f s audio in %.2f s (%.0fx)\n", job.input.c_str(), job.output.c_str(),
+               result.encoder.c_str(), audioSeconds, seconds, seconds > 0 ? audioSeconds / seconds : 0.0);
+    }
+    totals->converted++;
+    totals->audioSeconds += audioSeconds;
+    totals->inputBytes += inputBytes;
+    totals->outputBytes += result.outputBytes;
+    totals->encoders.insert(result.encoder);
+}
+
+int calibrate(const std::string& path) {
+    wavtomp3::Calibration calibration;
+    std::string error;
+    if (wavtomp3::runCalibration(&calibration, &error) != 0 ||
+        wavtomp3::saveCalibration(path, calibration, &error) != 0) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (int quality = 0; quality < wavtomp3::kQualityLevels; quality++) {
+        printf("quality %d: %.1fx realtime\n", quality, calibration.realtime[quality]);
+    }
+    return 0;
+}
+
+int estimate(const std::vector<Job>& jobs, const ConversionOptions& options) {
+    int failed = 0;
+    long long outputBytes = 0;
+    double elapsedMs = 0.0;
+    bool timed = true;
+    for (const Job& job : jobs) {
+        wavtomp3::ConversionEstimate result;
+        std::string errorCode, error;
+        if (wavtomp3::estimateConversion(job.input, job.output, options, &result, &errorCode, &error) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", job.input.c_str(), errorCode.c_str(), error.c_str());
+            failed++;
+            continue;
+        }
+        char time[64] = "time unknown";
+        if (result.elapsedMs >= 0) {
+            snprintf(time, sizeof(time), "~%.2f s (%s)", result.elapsedMs / 1000.0, result.timeModel.c_str());
+        }
+        printf("%s -> %s  %s %d kbps, %d Hz, %d ch  ~%.2f MB  %s\n", job.input.c_str(), job.output.c_str(),
+               result.encoder.c_str(), result.bitrate, result.sampleRate, result.channels,
+               result.outputBytes / 1e6, time);
+        outputBytes += result.outputBytes;
+        elapsedMs += std::max(result.elapsedMs, 0.0);
+        timed = timed && result.elapsedMs >= 0;
+    }
+    printf("%zu estimated, %d failed: ~%.2f MB", jobs.size(), failed, outputBytes / 1e6);
+    if (timed && failed < (int)jobs.size()) {
+        printf(", ~%.2f s on one thread", elapsedMs / 1000.0);
+    }
+    printf("\n");
+    return failed > 0 ? 1 : 0;
+}
+
+int probe(const std::vector<std::string>& paths, int parallel) {
+    std::vector<wavtomp3::ProbeResult> results;
+    auto start = std::chrono::steady_clock::now();
+    wavtomp3::probeFiles(paths, parallel, &results);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    int failed = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        const wavtomp3::ProbeResult& result = results[i];
+        if (!result.error.empty()) {
+            fprintf(stderr, "%s: %s\n", paths[i].c_str(), result.error.c_str());
+            failed++;
+            continue;
+        }
+        const wavtomp3::MediaInfo& info = result.info;
+        printf("%s: %s/%s, %d Hz, %d ch, %d kbps, %.3f s%s\n", paths[i].c_str(), info.container.c_str(),
+               info.codec.c_str(), info.sampleRate, info.channels, info.bitrate, info.durationMs / 1000.0,
+               info.estimated ? " (estimated)" : "");
+    }
+    if (!paths.empty()) {
+        printf("%zu probed, %d failed in %.1f ms (%.0f us per file, -j %d)\n", paths.size(), failed, elapsedMs,
+               elapsedMs * 1000.0 / paths.size(), parallel);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+void printEdit(const std::string& output, const wavtomp3::Mp3EditResult& result) {
+    printf("%s  %lld frames, %.3f s, %.2f MB in %.1f ms", output.c_str(), result.frames,
+           result.durationMs / 1000.0, result.outputBytes / 1e6, result.elapsedMs);
+    if (result.resizedFrames > 0) {
+        printf(", %d frames resized", result.resizedFrames);
+    }
+    if (result.gapMs > 0) {
+        printf(", %.1f ms at the seams", result.gapMs);
+    }
+    printf("\n");
+}
+
+int trim(const std::string& range, const std::string& input, const std::string& output) {
+    char* end = nullptr;
+    const double startMs = strtod(range.c_str(), &end);
+    double endMs = -1.0;
+    if (*end == ':') {
+        const char* rest = end + 1;
+        endMs = strtod(rest, &end);
+        if (end == rest) {
+            endMs = -1.0;
+        }
+    }
+    if (*end != '\0' || startMs < 0) {
+        fprintf(stderr, "Invalid range %s, expected START_MS[:END_MS]\n", range.c_str());
+        return 2;
+    }
+    wavtomp3::Mp3EditResult result;
+    std::string errorCode, error;
+    if (wavtomp3::trimMp3(input, output, startMs, endMs, &result, &errorCode, &error) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", input.c_str(), errorCode.c_str(), error.c_str());
+        return 1;
+    }
+    printEdit(output, result);
+    return 0;
+}
+
+int join(const std::string& output, const std::vector<std::string>& inputs) {
+    wavtomp3::Mp3EditResult result;
+    std::string errorCode, error;
+    if (wavtomp3::joinMp3(inputs, output, &result, &errorCode, &error) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", output.c_str(), errorCode.c_str(), error.c_str());
+        return 1;
+    }
+    printEdit(output, result);
+    return 0;
+}
+
+double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ConversionOptions options;
+    int parallel = (int)std::thread::hardware_concurrency();
+    bool force = false;
+    bool quiet = false;
+    bool estimateOnly = false;
+    bool preview = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg == "--calibrate" && i + 1 < argc) {
+            return calibrate(argv[i + 1]);
+        } else if (arg == "--probe") {
+            return probe(std::vector<std::string>(argv + i + 1, argv + argc), std::max(1, parallel));
+        } else if (arg == "--trim" || arg == "--join") {
+            if (arg == "--trim" ? i + 4 != argc : i + 3 > argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            return arg == "--trim" ? trim(argv[i + 1], argv[i + 2], argv[i + 3])
+                                   : join(argv[i + 1], std::vector<std::string>(argv + i + 2, argv + argc));
+        } else if (arg == "-f" || arg == "--force") {
+            force = true;
+        } else if (arg == "-q" || arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--estimate") {
+            estimateOnly = true;
+        } else if (arg == "--preview") {
+            preview = true;
+        } else if (arg == "-j" && i + 1 < argc) {
+            parallel = atoi(argv[++i]);
+        } else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+            parallel = atoi(arg.c_str() + 2);
+        } else if (arg.compare(0, 2, "--") == 0 && arg.size() > 2) {
+            std::string key = arg.substr(2);
+            std::string value;
+            size_t equals = key.find('=');
+            if (equals != std::string::npos) {
+                value = key.substr(equals + 1);
+                key = key.substr(0, equals);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+            std::string error;
+            if (wavtomp3::setOption(&options, key, value, &error) != 0) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 2;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    parallel = std::max(1, parallel);
+
+    const char* extension = options.format == wavtomp3::OutputFormat::Opus ? ".opus" : ".mp3";
+    std::vector<Job> jobs;
+    if (isDirectory(paths[0])) {
+        std::vector<std::string> files;
+        collectWavFiles(paths[0], "", &files);
+        std::sort(files.begin(), files.end());
+        for (const std::string& file : files) {
+            jobs.push_back({paths[0] + "/" + file, replaceExtension(paths[1] + "/" + file, extension)});
+        }
+    } else if (isDirectory(paths[1])) {
+        std::string name = paths[0].substr(paths[0].find_last_of('/') + 1);
+        jobs.push_back({paths[0], replaceExtension(paths[1] + "/" + name, extension)});
+    } else {
+        jobs.push_back({paths[0], paths[1]});
+    }
+
+    Totals totals;
+    std::vector<Job> pending;
+    for (const Job& job : jobs) {
+        if (!force && isUpToDate(job)) {
+            totals.skipped++;
+        } else {
+            pending.push_back(job);
+        }
+    }
+
+    if (estimateOnly) {
+        return estimate(pending, options);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    double startCpu = cpuSeconds();
+    std::atomic<size_t> next(0);
+    auto worker = [&](wavtomp3::Placement* placement) {
+        *placement = wavtomp3::planPlacement(wavtomp3::cpuTopology(), options.priority);
+        wavtomp3::applyPlacement(placement, options.priority);
+        for (size_t index = next++; index < pending.size(); index = next++) {
+            convert(pending[index], options, preview, quiet, &totals);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(parallel, (int)pending.size()); i++) {
+        threads.emplace_back([&] {
+            wavtomp3::Placement placement;
+            worker(&placement);
+        });
+    }
+    wavtomp3::Placement placement;
+    worker(&placement);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double busySeconds = cpuSeconds() - startCpu;
+
+    std::string encoders;
+    for (const std::string& encoder : totals.encoders) {
+        encoders += (encoders.empty() ? "" : ",") + encoder;
+    }
+    printf("%d converted, %d up to date, %d failed in %.2f s (-j %d%s%s)\n", totals.converted,
+           totals.skipped, totals.failed, wallSeconds, parallel, encoders.empty() ? "" : ", ",
+           encoders.c_str());
+    if (totals.converted > 0 && wallSeconds > 0) {
+        printf("audio %.1f s, %.1fx realtime; input %.1f MB at %.1f MB/s; output %.1f MB\n",
+               totals.audioSeconds, totals.audioSeconds / wallSeconds, totals.inputBytes / 1e6,
+               totals.inputBytes / 1e6 / wallSeconds, totals.outputBytes / 1e6);
+        printf("cpu %.1f s (%.1f cores busy), %s priority on %s cores%s%s\n", busySeconds,
+               busySeconds / wallSeconds, wavtomp3::priorityName(options.priority),
+               placement.policy.c_str(), placement.cpus.empty() ? "" : " ",
+               wavtomp3::formatCpuList(placement.cpus).c_str());
+    }
+    return totals.failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+// wav2mp3-segment: encodes one long file as independent segments that can
+// run as separate processes or on separate machines, then stitches them.
+//
+//   N=$(wav2mp3-segment plan --segment-seconds 60 --bitrate 128 talk.wav talk.manifest)
+//   seq 0 $((N - 1)) | xargs -P 8 -I{} wav2mp3-segment encode talk.manifest {} talk.{}.seg
+//   wav2mp3-segment stitch talk.manifest talk.mp3 $(seq -f 'talk.%g.seg' 0 $((N - 1)))
+//
+// `plan` prints the number of segments; blobs are stitched in the order
+// given. Workers on other machines can read
+// the input from a different path with `encode --input PATH`; it must be the
+// same audio. The stitched file is a single CBR MP3 with a LAME tag whose
+// delay and padding trim it to exactly the input length.
+#include "segment.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using wavtomp3::SegmentManifest;
+
+namespace {
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s plan [--segment-seconds S] [--prime-frames N] [--KEY VALUE ...] INPUT MANIFEST\n"
+            "       %s encode [--input PATH] MANIFEST INDEX BLOB\n"
+            "       %s stitch MANIFEST OUTPUT BLOB...\n"
+            "\n"
+            "  --segment-seconds S  audio per segment (default 30)\n"
+            "  --prime-frames N     frames encoded and dropped before each segment (default 2)\n"
+            "  --KEY VALUE          conversion option as in WavToMp3Options; MP3 only\n"
+            "  --input PATH         read the input from PATH instead of the manifest's path\n",
+            argv0, argv0, argv0);
+}
+
+int fail(const std::string& error) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+}
+
+int plan(int argc, char** argv) {
+    std::vector<std::pair<std::string, std::string>> options;
+    std::vector<std::string> paths;
+    double segmentSeconds = 30.0;
+    int primeFrames = 2;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+        } else if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        } else if (arg == "--segment-seconds") {
+            segmentSeconds = atof(argv[++i]);
+        } else if (arg == "--prime-frames") {
+            primeFrames = atoi(argv[++i]);
+        } else {
+            options.emplace_back(arg.substr(2), argv[++i]);
+        }
+    }
+    if (paths.size() != 2 || segmentSeconds <= 0 || primeFrames < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    SegmentManifest manifest;
+    std::string error;
+    if (wavtomp3::planSegments(paths[0], options, segmentSeconds, &manifest, &error) != 0) {
+        return fail(error);
+    }
+    manifest.primeFrames = primeFrames;
+    if (wavtomp3::writeManifest(paths[1], manifest, &error) != 0) {
+        return fail(error);
+    }
+    printf("%zu\n", manifest.segments.size());
+    return 0;
+}
+
+int encode(int argc, char** argv) {
+    std::string input;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc) {
+            input = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() != 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    SegmentManifest manifest;
+    std::string error;
+    if (wavtomp3::readManifest(args[0], &manifest, &error) != 0) {
+        return fail(error);
+    }
+    if (!input.empty()) {
+        manifest.input = input;
+    }
+    if (wavtomp3::encodeSegment(manifest, atoi(args[1].c_str()), args[2], &error) != 0) {
+        return fail(error);
+    }
+    return 0;
+}
+
+int stitch(int argc, char** argv) {
+    if (argc < 5) {
+        usage(argv[0]);
+        return 2;
+    }
+    SegmentManifest manifest;
+    std::string error;
+    if (wavtomp3::readManifest(argv[2], &manifest, &error) != 0) {
+        return fail(error);
+    }
+    std::vector<std::string> blobs(argv + 4, argv + argc);
+    if (wavtomp3::stitchSegments(manifest, blobs, argv[3], &error) != 0) {
+        return fail(error);
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "plan") {
+        return plan(argc, argv);
+    } else if (command == "encode") {
+        return encode(argc, argv);
+    } else if (command == "stitch") {
+        return stitch(argc, argv);
+    }
+    usage(argv[0]);
+    return command == "-h" || command == "--help" ? 0 : 2;
+}
@@ -0,0 +1,439 @@
+// wav2mp3d: long-running conversion daemon on a Unix domain socket.
+//
+// Saves ingestion servers the process start and encoder setup of one
+// wav2mp3 run per file. Jobs are queued to a fixed set of workers, each of
+// which keeps its last Opus encoder open for the next job with the same
+// settings; LAME and shine cannot be reset, so MP3 jobs open a new one.
+// Workers are placed once, by the default priority.
+//
+//   wav2mp3d --socket /run/wav2mp3.sock -j 4 --queue 64 --bitrate 64
+//
+// Options given on the command line are defaults for every job; a job's own
+// fields override them. A job with "outputs.N.path" fields instead of
+// "output" encodes its input into every output in one pass. The protocol is
+// described in job_protocol.h and README.md.
+#include "converter.h"
+#include "cpu_topology.h"
+#include "fingerprint.h"
+#include "job_protocol.h"
+#include "options.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using wavtomp3::ConversionOptions;
+using wavtomp3::ConversionResult;
+using wavtomp3::Fields;
+
+namespace {
+
+// Rejection when the queue is full; clients should retry later
+const char* const kErrorBusy = "BUSY_ERROR";
+const char* const kErrorOptions = "OPTIONS_ERROR";
+
+std::atomic<bool> gStopping(false);
+
+void onSignal(int) {
+    gStopping = true;
+}
+
+struct Job {
+    int fd = -1;  // connection to stream progress to
+    std::string id;
+    std::string input;
+    std::string output;
+    ConversionOptions options;
+    std::vector<wavtomp3::OutputSpec> outputs;  // fan-out job; `output` is unused
+    std::chrono::steady_clock::time_point queuedAt;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    double queueMs = 0.0;
+    ConversionResult result;
+    std::vector<ConversionResult> results;
+};
+
+class Daemon {
+public:
+    Daemon(const ConversionOptions& defaults, int workers, size_t queueCapacity)
+        : defaults_(defaults), queueCapacity_(queueCapacity), started_(std::chrono::steady_clock::now()) {
+        for (int i = 0; i < workers; i++) {
+            workers_.emplace_back(&Daemon::runWorker, this);
+        }
+    }
+
+    // Lets queued jobs finish, then stops the workers.
+    void drain() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void serve(int fd) {
+        std::string payload;
+        while (wavtomp3::readFrame(fd, &payload)) {
+            Fields fields = wavtomp3::parseFields(payload);
+            std::string type = wavtomp3::fieldValue(fields, "type");
+            std::string reply;
+            if (type == "convert") {
+                reply = convert(fd, fields);
+            } else if (type == "stats") {
+                reply = stats();
+            } else if (type == "compare") {
+                reply = compare(fields);
+            } else if (type == "health") {
+                reply = std::string("type=health\nstatus=") + (gStopping ? "draining" : "ok") + "\n";
+            } else {
+                reply = "type=error\nerrorMessage=Unknown request type: " + type + "\n";
+            }
+            if (!wavtomp3::writeFrame(fd, reply)) {
+                break;
+            }
+        }
+        close(fd);
+        connections_--;
+    }
+
+    std::atomic<int> connections_{0};
+
+private:
+    std::string convert(int fd, const Fields& fields) {
+        auto job = std::make_shared<Job>();
+        job->fd = fd;
+        job->id = wavtomp3::fieldValue(fields, "id");
+        job->input = wavtomp3::fieldValue(fields, "input");
+        job->output = wavtomp3::fieldValue(fields, "output");
+        job->options = defaults_;
+
+        std::string header = "type=result\nid=" + job->id + "\n";
+        std::string error;
+        Fields options;
+        bool fanOut = false;
+        for (const auto& field : fields) {
+            const std::string& key = field.first;
+            if (key == "type" || key == "id" || key == "input" || key == "output") {
+                continue;
+            }
+            options.push_back(field);
+            fanOut = fanOut || key.compare(0, 8, "outputs.") == 0;
+        }
+        int status = fanOut ? wavtomp3::setOutputOptions(options, &job->options, &job->outputs, &error)
+                            : applyOptions(options, &job->options, &error);
+        if (status != 0) {
+            rejected_++;
+            return header + "errorCode=" + kErrorOptions + "\nerrorMessage=" + error + "\n";
+        }
+        // Workers are placed once, so a job cannot pick its own cores
+        bool otherPriority = job->options.priority != defaults_.priority;
+        for (const wavtomp3::OutputSpec& output : job->outputs) {
+            otherPriority = otherPriority || output.options.priority != defaults_.priority;
+        }
+        if (otherPriority) {
+            rejected_++;
+            return header + "errorCode=" + kErrorOptions +
+                   "\nerrorMessage=priority is set for the daemon, not per job\n";
+        }
+        if (job->input.empty() || (job->output.empty() && job->outputs.empty())) {
+            rejected_++;
+            return header + "errorCode=" + kErrorOptions + "\nerrorMessage=input and output are required\n";
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || queue_.size() >= queueCapacity_) {
+                rejected_++;
+                return header + "errorCode=" + kErrorBusy + "\nerrorMessage=Job queue is full\n";
+            }
+            job->queuedAt = std::chrono::steady_clock::now();
+            queue_.push_back(job);
+            accepted_++;
+        }
+        wake_.notify_one();
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&] { return job->done; });
+        char timing[64];
+        snprintf(timing, sizeof(timing), "queueMs=%.1f\n", job->queueMs);
+        if (!job->outputs.empty()) {
+            return header + wavtomp3::formatResults(job->results) + timing;
+        }
+        return header + wavtomp3::formatResult(job->result) + timing;
+    }
+
+    static int applyOptions(const Fields& fields, ConversionOptions* options, std::string* error) {
+        for (const auto& field : fields) {
+            if (wavtomp3::setOption(options, field.first, field.second, error) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void runWorker() {
+        wavtomp3::Placement placement = wavtomp3::planPlacement(wavtomp3::cpuTopology(), defaults_.priority);
+        wavtomp3::applyPlacement(&placement, defaults_.priority);
+        wavtomp3::EncoderCache cache;
+
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                job = queue_.front();
+                queue_.pop_front();
+                running_++;
+            }
+            double queueMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - job->queuedAt).count();
+
+            // The connection thread is blocked on this job, so the worker
+            // owns the socket until it signals completion.
+            std::string progressHeader = "type=progress\nid=" + job->id + "\nprogress=";
+            auto progress = [&](float value) {
+                char text[16];
+                snprintf(text, sizeof(text), "%.2f\n", value);
+                wavtomp3::writeFrame(job->fd, progressHeader + text);
+            };
+            ConversionResult result;
+            std::vector<ConversionResult> results;
+            if (job->outputs.empty()) {
+                wavtomp3::convertFile(job->input, job->output, job->options, progress, &result, &cache);
+                results.push_back(result);
+            } else {
+                // Fan-out encoders run on threads of their own, without the cache
+                wavtomp3::convertFileMulti(job->input, job->options, job->outputs, progress, &results);
+            }
+            const int cpu = wavtomp3::currentCpu();
+            bool ok = true;
+            long long outputBytes = 0;
+            for (ConversionResult& output : results) {
+                output.placement = placement;
+                output.placement.cpu = cpu;
+                ok = ok && output.errorCode.empty();
+                outputBytes += output.outputBytes;
+            }
+            result = results[0];
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_--;
+                if (ok) {
+                    completed_++;
+                    warmJobs_ += result.warmEncoder ? 1 : 0;
+                    inputFrames_ += result.inputFrames;
+                    outputBytes_ += outputBytes;
+                    encodeMs_ += result.elapsedMs;
+                } else {
+                    failed_++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->result = result;
+            job->results = results;
+            job->queueMs = queueMs;
+            job->done = true;
+            job->finished.notify_one();
+        }
+    }
+
+    // Compares fingerprints "a" and "b"; quick enough to run on the connection thread.
+    static std::string compare(const Fields& fields) {
+        double similarity = 0.0;
+        std::string error;
+        if (wavtomp3::compareFingerprints(wavtomp3::fieldValue(fields, "a"), wavtomp3::fieldValue(fields, "b"),
+                                          &similarity, &error) != 0) {
+            return "type=compare\nerrorCode=FINGERPRINT_ERROR\nerrorMessage=" + error + "\n";
+        }
+        char reply[64];
+        snprintf(reply, sizeof(reply), "type=compare\nsimilarity=%.4f\n", similarity);
+        return reply;
+    }
+
+    std::string stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+        char text[512];
+        snprintf(text, sizeof(text),
+                 "type=stats\nuptimeS=%.1f\nworkers=%zu\nqueueCapacity=%zu\nqueued=%zu\nrunning=%d\n"
+                 "connections=%d\naccepted=%lld\nrejected=%lld\ncompleted=%lld\nfailed=%lld\n"
+                 "warmEncoderJobs=%lld\ninputFrames=%lld\noutputBytes=%lld\nencodeMs=%.1f\n",
+                 uptime, workers_.size(), queueCapacity_, queue_.size(), running_, connections_.load(),
+                 accepted_, rejected_.load(), completed_, failed_, warmJobs_, inputFrames_,
+                 outputBytes_, encodeMs_);
+        return text;
+    }
+
+    const ConversionOptions defaults_;
+    const size_t queueCapacity_;
+    const std::chrono::steady_clock::time_point started_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::shared_ptr<Job>> queue_;
+    bool stopping_ = false;
+    int running_ = 0;
+    long long accepted_ = 0;
+    std::atomic<long long> rejected_{0};
+    long long completed_ = 0;
+    long long failed_ = 0;
+    long long warmJobs_ = 0;
+    long long inputFrames_ = 0;
+    long long outputBytes_ = 0;
+    double encodeMs_ = 0.0;
+};
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s --socket PATH [-j N] [--queue N] [--KEY VALUE ...]\n"
+            "\n"
+            "  --socket PATH  Unix domain socket to listen on (created with mode 0600)\n"
+            "  -j N           worker threads (default: number of CPUs)\n"
+            "  --queue N      jobs that may wait for a worker before new ones are\n"
+            "                 rejected with BUSY_ERROR (default: 4 per worker)\n"
+            "  --KEY VALUE    default conversion option, as in WavToMp3Options; --priority\n"
+            "                 places every worker, and jobs cannot override it\n"
+            "\n"
+            "Workers reuse their last Opus encoder for a job with the same settings; MP3\n"
+            "jobs open a new encoder every time.\n",
+            argv0);
+}
+
+int listenOn(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    // Refuse to steal the socket of a daemon that is still running
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "Another daemon is listening on %s\n", path.c_str());
+        close(fd);
+        return -1;
+    }
+    unlink(path.c_str());
+
+    mode_t oldMask = umask(0077);
+    int status = bind(fd, (sockaddr*)&address, sizeof(address));
+    umask(oldMask);
+    if (status != 0 || listen(fd, 64) != 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", path.c_str(), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ConversionOptions defaults;
+    std::string socketPath;
+    int workers = (int)std::thread::hardware_concurrency();
+    int queueCapacity = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--socket") {
+            socketPath = value;
+        } else if (arg == "-j") {
+            workers = atoi(value.c_str());
+        } else if (arg == "--queue") {
+            queueCapacity = atoi(value.c_str());
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::string error;
+            if (wavtomp3::setOption(&defaults, arg.substr(2), value, &error) != 0) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 2;
+            }
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (socketPath.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    workers = std::max(1, workers);
+    if (queueCapacity < 0) {
+        queueCapacity = workers * 4;
+    }
+
+    int listenFd = listenOn(socketPath);
+    if (listenFd < 0) {
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // Leaked on purpose: detached connection threads may outlive main()
+    Daemon* daemon = new Daemon(defaults, workers, (size_t)queueCapacity);
+    fprintf(stderr, "wav2mp3d: listening on %s with %d workers, queue %d\n", socketPath.c_str(),
+            workers, queueCapacity);
+
+    while (!gStopping) {
+        pollfd listener = {listenFd, POLLIN, 0};
+        if (poll(&listener, 1, 250) <= 0) {
+            continue;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        daemon->connections_++;
+        std::thread(&Daemon::serve, daemon, fd).detach();
+    }
+
+    fprintf(stderr, "wav2mp3d: shutting down, finishing queued jobs\n");
+    close(listenFd);
+    unlink(socketPath.c_str());
+    daemon->drain();
+    return 0;
+}
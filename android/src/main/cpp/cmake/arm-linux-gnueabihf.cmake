@@ -0,0 +1,23 @@
+# Cross toolchain for running the benchmarks under qemu-arm on a host, as a
+# stand-in for an armeabi-v7a device:
+#
+#   cmake -S android/src/main/cpp -B build-arm \
+#       -DCMAKE_TOOLCHAIN_FILE=android/src/main/cpp/cmake/arm-linux-gnueabihf.cmake \
+#       -DWAV_TO_MP3_BUILD_BENCH=ON
+#   qemu-arm -L /usr/arm-linux-gnueabihf build-arm/bench/encode_bench --encoder fixed
+
+set(CMAKE_SYSTEM_NAME Linux)
+set(CMAKE_SYSTEM_PROCESSOR armv7-a)
+
+set(CMAKE_C_COMPILER arm-linux-gnueabihf-gcc)
+set(CMAKE_CXX_COMPILER arm-linux-gnueabihf-g++)
+
+# Match the armeabi-v7a baseline the NDK targets
+set(CMAKE_C_FLAGS_INIT "-march=armv7-a -mthumb")
+set(CMAKE_CXX_FLAGS_INIT "-march=armv7-a -mthumb")
+
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-arm -L /usr/arm-linux-gnueabihf)
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
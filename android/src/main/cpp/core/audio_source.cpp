@@ -0,0 +1,192 @@
+#include "audio_source.h"
+
+#include <algorithm>
+#include <fcntl.h>
+
+#include "log.h"
+#include "wav_file.h"
+
+namespace wavtomp3 {
+
+PcmFileSource::PcmFileSource(FILE* file, const AudioFormat& format, long long dataOffset, long long dataSize)
+    : file_(file),
+      format_(format),
+      dataOffset_(dataOffset),
+      frameBytes_(bytesPerSample(format.sampleFormat) * format.channels) {
+    totalFrames_ = dataSize / frameBytes_;
+    fseeko(file_, (off_t)dataOffset, SEEK_SET);
+}
+
+PcmFileSource::~PcmFileSource() {
+    fclose(file_);
+}
+
+long PcmFileSource::read(float* out, long maxFrames) {
+    raw_.resize((size_t)maxFrames * frameBytes_);
+    long got = readRaw(raw_.data(), maxFrames);
+    if (got > 0) {
+        convertToFloat(raw_.data(), format_.sampleFormat, (size_t)got * format_.channels, gain_, out);
+    }
+    return got;
+}
+
+long PcmFileSource::readRaw(void* out, long maxFrames) {
+    long long remaining = totalFrames_ - framesRead_;
+    if (remaining <= 0) {
+        return 0;
+    }
+    long frames = remaining < maxFrames ? (long)remaining : maxFrames;
+    size_t got = fread(out, frameBytes_, frames, file_);
+    if (got == 0) {
+        return ferror(file_) ? -1 : 0;
+    }
+    framesRead_ += got;
+    return (long)got;
+}
+
+int PcmFileSource::seek(long long frame) {
+    if (frame < 0 || frame > totalFrames_ ||
+        fseeko(file_, (off_t)(dataOffset_ + frame * frameBytes_), SEEK_SET) != 0) {
+        return -1;
+    }
+    framesRead_ = frame;
+    return 0;
+}
+
+void PcmFileSource::prefetch() {
+    const long long offset = dataOffset_ + framesRead_ * frameBytes_;
+    const long long bytes = (totalFrames_ - framesRead_) * frameBytes_;
+    if (bytes <= 0) {
+        return;
+    }
+#if defined(__APPLE__)
+    struct radvisory advice;
+    advice.ra_offset = (off_t)offset;
+    advice.ra_count = (int)std::min(bytes, 0x7FFFFFFFLL);
+    fcntl(fileno(file_), F_RDADVISE, &advice);
+#else
+    posix_fadvise(fileno(file_), (off_t)offset, (off_t)bytes, POSIX_FADV_WILLNEED);
+#endif
+}
+
+LeadingSource::LeadingSource(AudioSource* source, long long frames) : source_(source) {
+    const long long total = source->totalFrames();
+    frames_ = total >= 0 ? std::min(frames, total) : frames;
+}
+
+long LeadingSource::read(float* out, long maxFrames) {
+    const long frames = (long)std::min((long long)maxFrames, frames_ - framesRead_);
+    if (frames <= 0) {
+        return 0;
+    }
+    long got = source_->read(out, frames);
+    if (got > 0) {
+        framesRead_ += got;
+    }
+    return got;
+}
+
+long LeadingSource::readRaw(void* out, long maxFrames) {
+    const long frames = (long)std::min((long long)maxFrames, frames_ - framesRead_);
+    if (frames <= 0) {
+        return 0;
+    }
+    long got = source_->readRaw(out, frames);
+    if (got > 0) {
+        framesRead_ += got;
+    }
+    return got;
+}
+
+int LeadingSource::seek(long long frame) {
+    if (frame < 0 || frame > frames_ || source_->seek(frame) != 0) {
+        return -1;
+    }
+    framesRead_ = frame;
+    return 0;
+}
+
+namespace {
+
+bool sampleFormatFromWav(const WavInfo& info, SampleFormat* format) {
+    if (info.audioFormat == kWavFormatIeeeFloat && info.bitsPerSample == 32) {
+        *format = SampleFormat::F32;
+        return true;
+    }
+    if (info.audioFormat != kWavFormatPcm) {
+        return false;
+    }
+    switch (info.bitsPerSample) {
+        case 8: *format = SampleFormat::U8; return true;
+        case 16: *format = SampleFormat::S16; return true;
+        case 24: *format = SampleFormat::S24; return true;
+        case 32: *format = SampleFormat::S32; return true;
+    }
+    return false;
+}
+
+long long remainingBytes(FILE* file) {
+    off_t current = ftello(file);
+    fseeko(file, 0, SEEK_END);
+    long long size = ftello(file);
+    fseeko(file, current, SEEK_SET);
+    return size - current;
+}
+
+}  // namespace
+
+std::unique_ptr<AudioSource> openAudioSource(const std::string& path, const AudioFormat& rawFormat,
+                                             std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *error = "Failed to open input file: " + path;
+        return nullptr;
+    }
+    if (!isWavFile(file)) {
+        LOGI("No RIFF/WAVE header, treating input as raw PCM");
+        fclose(file);
+        return openRawPcmSource(path, rawFormat, error);
+    }
+
+    WavInfo info;
+    if (readWavHeader(file, &info, error) != 0) {
+        fclose(file);
+        return nullptr;
+    }
+    LOGI("WAV file info: channels=%d, sampleRate=%d, bitsPerSample=%d, audioFormat=%d", info.channels,
+         info.sampleRate, info.bitsPerSample, info.audioFormat);
+    LOGI("Data chunk: %lld bytes at offset %lld", info.dataSize, info.dataOffset);
+    AudioFormat format;
+    format.sampleRate = info.sampleRate;
+    format.channels = info.channels;
+    if (!sampleFormatFromWav(info, &format.sampleFormat)) {
+        fclose(file);
+        *error = "Unsupported WAV encoding (format " + std::to_string(info.audioFormat) + ", " +
+                 std::to_string(info.bitsPerSample) + " bits)";
+        return nullptr;
+    }
+    if (format.channels < 1 || format.channels > 2 || format.sampleRate <= 0) {
+        fclose(file);
+        *error = "Unsupported WAV layout (" + std::to_string(format.channels) + " channels, " +
+                 std::to_string(format.sampleRate) + " Hz)";
+        return nullptr;
+    }
+    return std::unique_ptr<AudioSource>(new PcmFileSource(file, format, info.dataOffset, info.dataSize));
+}
+
+std::unique_ptr<AudioSource> openRawPcmSource(const std::string& path, const AudioFormat& format,
+                                              std::string* error) {
+    if (format.channels < 1 || format.channels > 2 || format.sampleRate <= 0) {
+        *error = "Invalid raw PCM format";
+        return nullptr;
+    }
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *error = "Failed to open input file: " + path;
+        return nullptr;
+    }
+    long long size = remainingBytes(file);
+    return std::unique_ptr<AudioSource>(new PcmFileSource(file, format, 0, size));
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,108 @@
+// Sources of PCM audio for the conversion pipeline.
+#ifndef WAV_TO_MP3_AUDIO_SOURCE_H
+#define WAV_TO_MP3_AUDIO_SOURCE_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sample_convert.h"
+
+namespace wavtomp3 {
+
+struct AudioFormat {
+    int sampleRate = 0;
+    int channels = 0;
+    SampleFormat sampleFormat = SampleFormat::S16;
+};
+
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+
+    virtual const AudioFormat& format() const = 0;
+
+    // Total number of frames, or -1 if unknown.
+    virtual long long totalFrames() const = 0;
+
+    // Reads up to `maxFrames` interleaved frames as float. Returns the number
+    // of frames read, 0 at the end of the stream or -1 on error.
+    virtual long read(float* out, long maxFrames) = 0;
+
+    // Moves to `frame`. Returns 0, or -1 if the source cannot seek.
+    virtual int seek(long long /*frame*/) { return -1; }
+
+    // Whether readRaw() works, for the fused PcmPipeline.
+    virtual bool hasRawSamples() const { return false; }
+
+    // Reads up to `maxFrames` interleaved frames as stored, in
+    // format().sampleFormat. Returns the number of frames read, 0 at the end
+    // of the stream or -1 on error.
+    virtual long readRaw(void* /*out*/, long /*maxFrames*/) { return -1; }
+
+    // Asks the OS to read the rest of the source into its cache in the
+    // background, for a later pass over it.
+    virtual void prefetch() {}
+};
+
+// Interleaved PCM stored in a file region: the data chunk of a WAV file or a
+// headerless .pcm file.
+class PcmFileSource : public AudioSource {
+public:
+    PcmFileSource(FILE* file, const AudioFormat& format, long long dataOffset, long long dataSize);
+    ~PcmFileSource() override;
+
+    const AudioFormat& format() const override { return format_; }
+    long long totalFrames() const override { return totalFrames_; }
+    long read(float* out, long maxFrames) override;
+    int seek(long long frame) override;
+    bool hasRawSamples() const override { return gain_ == 1.0f; }
+    long readRaw(void* out, long maxFrames) override;
+    void prefetch() override;
+
+    // Gain applied while converting samples to float.
+    void setGain(float gain) { gain_ = gain; }
+
+private:
+    FILE* file_;
+    AudioFormat format_;
+    long long dataOffset_;
+    long long totalFrames_;
+    long long framesRead_ = 0;
+    int frameBytes_;
+    float gain_ = 1.0f;
+    std::vector<unsigned char> raw_;
+};
+
+// The first `frames` frames of `source`, which it does not own.
+class LeadingSource : public AudioSource {
+public:
+    LeadingSource(AudioSource* source, long long frames);
+
+    const AudioFormat& format() const override { return source_->format(); }
+    long long totalFrames() const override { return frames_; }
+    long read(float* out, long maxFrames) override;
+    int seek(long long frame) override;
+    bool hasRawSamples() const override { return source_->hasRawSamples(); }
+    long readRaw(void* out, long maxFrames) override;
+    void prefetch() override { source_->prefetch(); }
+
+private:
+    AudioSource* source_;
+    long long frames_;
+    long long framesRead_ = 0;
+};
+
+// Opens `path` as WAV if it has a RIFF/WAVE header, otherwise as headerless
+// PCM described by `rawFormat`. Returns nullptr with a message in `error`.
+std::unique_ptr<AudioSource> openAudioSource(const std::string& path, const AudioFormat& rawFormat,
+                                             std::string* error);
+
+// Opens a headerless PCM file.
+std::unique_ptr<AudioSource> openRawPcmSource(const std::string& path, const AudioFormat& format,
+                                              std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_AUDIO_SOURCE_H
@@ -0,0 +1,75 @@
+#include "base64.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int decodeChar(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return c == '+' ? 62 : c == '/' ? 63 : -1;
+}
+
+}  // namespace
+
+std::string encodeBase64(const unsigned char* data, size_t size) {
+    std::string text;
+    text.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        unsigned value = (unsigned)data[i] << 16;
+        if (i + 1 < size) {
+            value |= (unsigned)data[i + 1] << 8;
+        }
+        if (i + 2 < size) {
+            value |= data[i + 2];
+        }
+        text += kAlphabet[(value >> 18) & 63];
+        text += kAlphabet[(value >> 12) & 63];
+        text += i + 1 < size ? kAlphabet[(value >> 6) & 63] : '=';
+        text += i + 2 < size ? kAlphabet[value & 63] : '=';
+    }
+    return text;
+}
+
+bool decodeBase64(const std::string& text, std::vector<unsigned char>* out) {
+    out->clear();
+    if (text.size() % 4 != 0) {
+        return false;
+    }
+    out->reserve(text.size() / 4 * 3);
+    for (size_t i = 0; i < text.size(); i += 4) {
+        int padding = 0;
+        unsigned value = 0;
+        for (size_t j = 0; j < 4; j++) {
+            char c = text[i + j];
+            int digit = decodeChar(c);
+            // '=' only at the end, at most two
+            if (c == '=' && i + 4 == text.size() && j >= 2) {
+                padding++;
+                digit = 0;
+            } else if (digit < 0 || padding > 0) {
+                return false;
+            }
+            value = (value << 6) | (unsigned)digit;
+        }
+        out->push_back((unsigned char)(value >> 16));
+        if (padding < 2) {
+            out->push_back((unsigned char)(value >> 8));
+        }
+        if (padding < 1) {
+            out->push_back((unsigned char)value);
+        }
+    }
+    return true;
+}
+
+}  // namespace wavtomp3
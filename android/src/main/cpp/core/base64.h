@@ -0,0 +1,19 @@
+// Base64 for binary results (features, fingerprints) passed through the
+// key=value result lines.
+#ifndef WAV_TO_MP3_BASE64_H
+#define WAV_TO_MP3_BASE64_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+std::string encodeBase64(const unsigned char* data, size_t size);
+
+// Returns false if `text` is not padded standard base64.
+bool decodeBase64(const std::string& text, std::vector<unsigned char>* out);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_BASE64_H
@@ -0,0 +1,185 @@
+#include "calibration.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "encoder.h"
+#include "log.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kCalibrationVersion = 1;
+const int kReferenceRate = 44100;
+const int kReferenceChannels = 2;
+const double kCalibrationSeconds = 2.0;
+// Predictions are scaled by this before comparing with a budget, for
+// thermal throttling and competing load
+const double kSafetyFactor = 1.25;
+
+std::mutex cacheMutex;
+std::map<std::string, Calibration> cache;
+
+// Music-like test signal: a few partials over noise, so LAME's psychoacoustic
+// model works as hard as on real content
+void synthesize(std::vector<float>* pcm, long frames) {
+    pcm->resize((size_t)frames * kReferenceChannels);
+    unsigned int seed = 12345;
+    const double pi = 3.14159265358979323846;
+    for (long i = 0; i < frames; i++) {
+        double t = (double)i / kReferenceRate;
+        double tone = 0.2 * sin(2 * pi * 220 * t) + 0.1 * sin(2 * pi * 1760 * t) + 0.05 * sin(2 * pi * 7040 * t);
+        for (int c = 0; c < kReferenceChannels; c++) {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((seed >> 8) / 16777216.0 - 0.5) * 0.1;
+            (*pcm)[(size_t)i * kReferenceChannels + c] = (float)(tone * (c == 0 ? 1.0 : 0.8) + noise);
+        }
+    }
+}
+
+}  // namespace
+
+bool Calibration::valid() const {
+    for (double value : realtime) {
+        if (!(value > 0.0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int runCalibration(Calibration* calibration, std::string* error) {
+    const long frames = (long)(kCalibrationSeconds * kReferenceRate);
+    std::vector<float> pcm;
+    synthesize(&pcm, frames);
+    std::vector<unsigned char> out;
+
+    // The first pass only warms up caches and the CPU governor
+    for (int pass = 0; pass < 2; pass++) {
+        for (int quality = 0; quality < kQualityLevels; quality++) {
+            EncoderConfig config;
+            config.sampleRate = kReferenceRate;
+            config.channels = kReferenceChannels;
+            config.quality = quality;
+            std::unique_ptr<Encoder> encoder = createLameEncoder();
+            if (encoder->open(config, error) != 0) {
+                return -1;
+            }
+            auto start = std::chrono::steady_clock::now();
+            out.clear();
+            for (long offset = 0; offset < frames; offset += 4096) {
+                int block = (int)std::min(4096L, frames - offset);
+                if (encoder->encode(pcm.data() + (size_t)offset * kReferenceChannels, block, &out) != 0) {
+                    *error = "Calibration encode failed";
+                    return -1;
+                }
+            }
+            encoder->finish(&out);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            calibration->realtime[quality] = kCalibrationSeconds / std::max(seconds, 1e-6);
+            if (pass == 0) {
+                break;
+            }
+        }
+    }
+    LOGI("Calibration: %.0fx realtime at quality 0, %.0fx at quality 9", calibration->realtime[0],
+         calibration->realtime[kQualityLevels - 1]);
+    return 0;
+}
+
+std::string formatCalibration(const Calibration& calibration) {
+    std::string text = "version=" + std::to_string(kCalibrationVersion) + "\n";
+    for (int quality = 0; quality < kQualityLevels; quality++) {
+        char line[48];
+        snprintf(line, sizeof(line), "realtime.%d=%.2f\n", quality, calibration.realtime[quality]);
+        text += line;
+    }
+    return text;
+}
+
+int saveCalibration(const std::string& path, const Calibration& calibration, std::string* error) {
+    std::string partPath = path + ".part";
+    FILE* file = fopen(partPath.c_str(), "w");
+    if (!file) {
+        *error = "Failed to open " + partPath;
+        return -1;
+    }
+    std::string text = formatCalibration(calibration);
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (fclose(file) != 0 || !written || rename(partPath.c_str(), path.c_str()) != 0) {
+        remove(partPath.c_str());
+        *error = "Failed to write " + path;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache[path] = calibration;
+    return 0;
+}
+
+int loadCalibration(const std::string& path, Calibration* calibration, std::string* error) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        *error = "No calibration at " + path;
+        return -1;
+    }
+    *calibration = Calibration();
+    int version = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        int quality;
+        double value;
+        if (sscanf(line, "realtime.%d=%lf", &quality, &value) == 2 && quality >= 0 && quality < kQualityLevels) {
+            calibration->realtime[quality] = value;
+        } else {
+            sscanf(line, "version=%d", &version);
+        }
+    }
+    fclose(file);
+    if (version != kCalibrationVersion || !calibration->valid()) {
+        *error = "Invalid calibration: " + path;
+        return -1;
+    }
+    return 0;
+}
+
+bool cachedCalibration(const std::string& path, Calibration* calibration) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(path);
+    if (it == cache.end()) {
+        std::string error;
+        Calibration loaded;
+        if (loadCalibration(path, &loaded, &error) != 0) {
+            return false;
+        }
+        it = cache.emplace(path, loaded).first;
+    }
+    *calibration = it->second;
+    return true;
+}
+
+double predictEncodeMs(const Calibration& calibration, int quality, double audioSeconds,
+                       int sampleRate, int channels) {
+    // LAME's work is about linear in the number of samples
+    double scale = (double)sampleRate / kReferenceRate * channels / kReferenceChannels;
+    return audioSeconds * scale / calibration.realtime[quality] * 1000.0;
+}
+
+int qualityForBudget(const Calibration& calibration, double budgetMs, double audioSeconds,
+                     int sampleRate, int channels) {
+    for (int quality = 0; quality < kQualityLevels; quality++) {
+        if (predictEncodeMs(calibration, quality, audioSeconds, sampleRate, channels) * kSafetyFactor <= budgetMs) {
+            return quality;
+        }
+    }
+    return kQualityLevels - 1;
+}
+
+}  // namespace wavtomp3
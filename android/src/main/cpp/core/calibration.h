@@ -0,0 +1,45 @@
+// Per-device encode speed for deadlineMs. Measured once by runCalibration()
+// and stored by the app, since LAME's cost per quality level varies several
+// times between devices.
+#ifndef WAV_TO_MP3_CALIBRATION_H
+#define WAV_TO_MP3_CALIBRATION_H
+
+#include <string>
+
+namespace wavtomp3 {
+
+const int kQualityLevels = 10;
+
+struct Calibration {
+    // Seconds of 44.1 kHz stereo audio LAME encodes per second at each
+    // quality (0 = best), on the thread that ran the calibration
+    double realtime[kQualityLevels] = {};
+
+    bool valid() const;
+};
+
+// Encodes a few seconds of synthetic audio at every quality level. Takes
+// about a second on a mid-range phone.
+int runCalibration(Calibration* calibration, std::string* error);
+
+// "key=value" lines, the same text formatResult() style the glue parses.
+std::string formatCalibration(const Calibration& calibration);
+
+int saveCalibration(const std::string& path, const Calibration& calibration, std::string* error);
+int loadCalibration(const std::string& path, Calibration* calibration, std::string* error);
+
+// loadCalibration() with a per-process cache that saveCalibration() updates.
+bool cachedCalibration(const std::string& path, Calibration* calibration);
+
+// Predicted LAME encode time of `audioSeconds` at `quality`.
+double predictEncodeMs(const Calibration& calibration, int quality, double audioSeconds,
+                       int sampleRate, int channels);
+
+// Best quality predicted to finish within `budgetMs`, or the fastest level
+// if none does.
+int qualityForBudget(const Calibration& calibration, double budgetMs, double audioSeconds,
+                     int sampleRate, int channels);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_CALIBRATION_H
@@ -0,0 +1,62 @@
+#include "channel_similarity.h"
+
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const double kSideRatio = 1e-6;     // -60 dB
+const double kSideFloor = 1e-8;     // -80 dBFS mean square per channel
+const double kSignalFloor = 1e-6;   // -60 dBFS mean square per channel
+
+}  // namespace
+
+void ChannelSimilarity::add(const float* stereo, long frames) {
+    // Two frames per vector: L0 R0 L1 R1 against R0 L0 R1 L1. Every
+    // difference appears twice, which the sum below halves.
+    const long samples = frames * 2;
+    simd_f32x4 side = simd_zero();
+    simd_f32x4 total = simd_zero();
+    long i = 0;
+    for (; i + SIMD_WIDTH <= samples; i += SIMD_WIDTH) {
+        simd_f32x4 v = simd_load(stereo + i);
+        simd_f32x4 d = simd_sub(v, simd_swap_pairs(v));
+        side = simd_madd(d, d, side);
+        total = simd_madd(v, v, total);
+    }
+    double sideSum = simd_hsum(side) * 0.5;
+    double totalSum = simd_hsum(total);
+    for (; i < samples; i += 2) {
+        double d = stereo[i] - stereo[i + 1];
+        sideSum += d * d;
+        totalSum += (double)stereo[i] * stereo[i] + (double)stereo[i + 1] * stereo[i + 1];
+    }
+    sideEnergy_ += sideSum;
+    totalEnergy_ += totalSum;
+    frames_ += frames;
+}
+
+bool ChannelSimilarity::isDualMono(bool requireSignal) const {
+    if (frames_ == 0) {
+        return !requireSignal;
+    }
+    if (requireSignal && totalEnergy_ < kSignalFloor * 2 * frames_) {
+        return false;
+    }
+    return sideEnergy_ <= kSideRatio * totalEnergy_ || sideEnergy_ <= kSideFloor * frames_;
+}
+
+void ChannelSimilarity::clear() {
+    sideEnergy_ = 0.0;
+    totalEnergy_ = 0.0;
+    frames_ = 0;
+}
+
+void downmixStereo(const float* stereo, long frames, float* mono) {
+    for (long i = 0; i < frames; i++) {
+        mono[i] = 0.5f * (stereo[2 * i] + stereo[2 * i + 1]);
+    }
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,31 @@
+// Detection of dual-mono stereo: the same signal on both channels, as phone
+// recorders produce when they duplicate a mono mic.
+#ifndef WAV_TO_MP3_CHANNEL_SIMILARITY_H
+#define WAV_TO_MP3_CHANNEL_SIMILARITY_H
+
+namespace wavtomp3 {
+
+class ChannelSimilarity {
+public:
+    // Accumulates `frames` interleaved stereo frames.
+    void add(const float* stereo, long frames);
+
+    // True when L - R stays below -60 dB of the signal, or below -80 dBFS
+    // (dither, rounding). With `requireSignal`, near-silence is not enough
+    // to call the channels identical.
+    bool isDualMono(bool requireSignal) const;
+
+    void clear();
+
+private:
+    double sideEnergy_ = 0.0;   // sum of (L - R)^2
+    double totalEnergy_ = 0.0;  // sum of L^2 + R^2
+    long long frames_ = 0;
+};
+
+// Writes (L + R) / 2 of `frames` interleaved stereo frames to `mono`.
+void downmixStereo(const float* stereo, long frames, float* mono);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_CHANNEL_SIMILARITY_H
@@ -0,0 +1,212 @@
+#include "content_analysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "channel_similarity.h"
+#include "fft.h"
+#include "mp3_frame.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const double kSilenceDb = -60.0;
+const double kQuietDb = -40.0;
+// Speech alternates syllables and pauses, so many of its ~20 ms frames sit
+// well below the mean level; sustained music has few such frames.
+const double kSpeechLowEnergyRatio = 0.4;
+const double kNarrowbandSpeechLowEnergyRatio = 0.25;
+// Content resampled from 8 kHz telephony or voice-memo rates
+const int kNarrowbandHz = 5000;
+// Wideband speech band; little intelligibility lives above it
+const int kSpeechBandHz = 7000;
+// Spectrum bins this far below the strongest bin count as empty
+const double kBandwidthFloor = 1e-6;  // -60 dB
+
+const int kMp3Rates[] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
+
+double toDb(double value) {
+    return value > 1e-12 ? 20.0 * log10(value) : -120.0;
+}
+
+// Smallest MP3 rate that carries `bandwidthHz`, at most `sourceRate`.
+int rateForBandwidth(int bandwidthHz, int sourceRate, int minRate) {
+    for (int rate : kMp3Rates) {
+        if (rate >= minRate && rate >= sourceRate) {
+            return sourceRate;
+        }
+        // Leave room for the encoder's lowpass transition band
+        if (rate >= minRate && rate * 0.45 >= bandwidthHz) {
+            return rate;
+        }
+    }
+    return sourceRate;
+}
+
+}  // namespace
+
+int analyzeContent(AudioSource* source, double seconds, ContentAnalysis* analysis) {
+    *analysis = ContentAnalysis();
+    const AudioFormat& format = source->format();
+    const int fftSize = format.sampleRate > 24000 ? 1024 : 512;
+    Fft fft(fftSize);
+
+    std::vector<float> block((size_t)fftSize * format.channels);
+    std::vector<float> mono((size_t)fftSize);
+    std::vector<float> power((size_t)fftSize / 2 + 1);
+    std::vector<double> spectrum((size_t)fftSize / 2 + 1, 0.0);
+    std::vector<double> frameRms;
+    ChannelSimilarity similarity;
+    double sumSquares = 0.0;
+    double peak = 0.0;
+    long long samples = 0;
+
+    long long remaining = (long long)(seconds * format.sampleRate);
+    while (remaining >= fftSize) {
+        long frames = source->read(block.data(), fftSize);
+        if (frames < fftSize) {
+            break;
+        }
+        remaining -= frames;
+        if (format.channels == 2) {
+            similarity.add(block.data(), frames);
+            downmixStereo(block.data(), frames, mono.data());
+        } else {
+            for (long i = 0; i < frames; i++) {
+                mono[i] = block[(size_t)i * format.channels];
+            }
+        }
+        double frameSquares = 0.0;
+        for (long i = 0; i < frames; i++) {
+            frameSquares += (double)mono[i] * mono[i];
+            peak = std::max(peak, (double)fabsf(mono[i]));
+        }
+        sumSquares += frameSquares;
+        samples += frames;
+        frameRms.push_back(sqrt(frameSquares / frames));
+
+        fft.powerSpectrum(mono.data(), power.data());
+        for (size_t i = 0; i < power.size(); i++) {
+            spectrum[i] += power[i];
+        }
+    }
+    if (source->seek(0) != 0) {
+        return -1;
+    }
+    if (samples == 0) {
+        analysis->type = ContentType::Silence;
+        return 0;
+    }
+
+    analysis->rmsDb = toDb(sqrt(sumSquares / samples));
+    analysis->peakDb = toDb(peak);
+    analysis->dualMono = format.channels == 2 && similarity.isDualMono(true);
+
+    double strongest = *std::max_element(spectrum.begin() + 1, spectrum.end());
+    size_t top = 0;
+    for (size_t i = 1; i < spectrum.size(); i++) {
+        if (spectrum[i] > strongest * kBandwidthFloor) {
+            top = i;
+        }
+    }
+    analysis->bandwidthHz = (int)((top + 1) * (double)format.sampleRate / fftSize);
+
+    double meanRms = 0.0;
+    for (double rms : frameRms) {
+        meanRms += rms;
+    }
+    meanRms /= frameRms.size();
+    size_t low = 0;
+    for (double rms : frameRms) {
+        low += rms < 0.5 * meanRms ? 1 : 0;
+    }
+    analysis->lowEnergyRatio = (double)low / frameRms.size();
+
+    if (analysis->rmsDb < kSilenceDb) {
+        analysis->type = ContentType::Silence;
+    } else if (analysis->lowEnergyRatio >= kSpeechLowEnergyRatio ||
+               (analysis->bandwidthHz <= kNarrowbandHz &&
+                analysis->lowEnergyRatio >= kNarrowbandSpeechLowEnergyRatio)) {
+        analysis->type = ContentType::Speech;
+    } else {
+        analysis->type = ContentType::Music;
+    }
+    return 0;
+}
+
+PresetChoice choosePreset(const ContentAnalysis& analysis, const AudioFormat& format,
+                          OutputFormat output) {
+    PresetChoice choice;
+    choice.sampleRate = format.sampleRate;
+    const bool quiet = analysis.rmsDb < kQuietDb;
+
+    if (output == OutputFormat::Opus) {
+        // Opus picks its own bandwidth for the bitrate; rate and lowpass stay
+        switch (analysis.type) {
+        case ContentType::Silence:
+            choice.bitrate = 6;
+            choice.mono = true;
+            break;
+        case ContentType::Speech:
+            choice.bitrate = quiet ? 12 : 16;
+            choice.mono = true;
+            break;
+        case ContentType::Music:
+            choice.bitrate = format.channels == 1 || analysis.dualMono ? 32 : 64;
+            break;
+        }
+        return choice;
+    }
+
+    switch (analysis.type) {
+    case ContentType::Silence:
+        choice.mono = true;
+        choice.sampleRate = rateForBandwidth(0, format.sampleRate, 16000);
+        choice.bitrate = 32;
+        break;
+    case ContentType::Speech: {
+        choice.mono = true;
+        int band = std::min(analysis.bandwidthHz, kSpeechBandHz);
+        choice.sampleRate = rateForBandwidth(band, format.sampleRate, 8000);
+        choice.lowpassHz = band < choice.sampleRate / 2 ? band : -1;
+        choice.bitrate = choice.sampleRate <= 12000 ? 24 : choice.sampleRate <= 24000 ? 32 : 48;
+        break;
+    }
+    case ContentType::Music: {
+        // Dual-mono is left to detectMono, which confirms it while encoding
+        const bool mono = format.channels == 1 || analysis.dualMono;
+        choice.sampleRate = rateForBandwidth(analysis.bandwidthHz, format.sampleRate, 22050);
+        choice.lowpassHz = analysis.bandwidthHz < choice.sampleRate * 0.45 ? analysis.bandwidthHz : -1;
+        if (choice.sampleRate >= 44100) {
+            choice.bitrate = mono ? 64 : 128;
+        } else if (choice.sampleRate >= 32000) {
+            choice.bitrate = mono ? 56 : 96;
+        } else {
+            choice.bitrate = mono ? 48 : 64;
+        }
+        if (quiet) {
+            // Much of a quiet signal sits below the threshold of hearing.
+            // A quarter less, down to a bitrate MP3 has at this rate.
+            choice.bitrate = mp3Bitrates(choice.sampleRate, choice.bitrate * 3 / 4).back();
+        }
+        break;
+    }
+    }
+    return choice;
+}
+
+const char* contentTypeName(ContentType type) {
+    switch (type) {
+    case ContentType::Silence:
+        return "silence";
+    case ContentType::Speech:
+        return "speech";
+    case ContentType::Music:
+        return "music";
+    }
+    return "music";
+}
+
+}  // namespace wavtomp3
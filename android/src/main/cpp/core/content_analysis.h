@@ -0,0 +1,45 @@
+// Cheap analysis of the start of a recording for preset: 'auto'.
+#ifndef WAV_TO_MP3_CONTENT_ANALYSIS_H
+#define WAV_TO_MP3_CONTENT_ANALYSIS_H
+
+#include "audio_source.h"
+#include "encoder.h"
+
+namespace wavtomp3 {
+
+enum class ContentType {
+    Silence,
+    Speech,
+    Music,
+};
+
+struct ContentAnalysis {
+    ContentType type = ContentType::Music;
+    double rmsDb = -120.0;       // dBFS
+    double peakDb = -120.0;
+    int bandwidthHz = 0;         // highest frequency with content
+    double lowEnergyRatio = 0.0; // share of frames well below the mean level
+    bool dualMono = false;       // stereo with identical channels
+};
+
+// Analyzes up to `seconds` from the start of `source` and rewinds it.
+// Returns -1 if the source cannot be rewound.
+int analyzeContent(AudioSource* source, double seconds, ContentAnalysis* analysis);
+
+struct PresetChoice {
+    int bitrate = 128;    // kbps
+    int sampleRate = 0;   // rate to encode at
+    int lowpassHz = -1;   // -1: encoder default
+    bool mono = false;    // downmix stereo input even if the channels differ
+};
+
+// Settings that fit the analyzed content without spending bits or CPU on
+// bandwidth and channels it does not have.
+PresetChoice choosePreset(const ContentAnalysis& analysis, const AudioFormat& format,
+                          OutputFormat output);
+
+const char* contentTypeName(ContentType type);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_CONTENT_ANALYSIS_H
@@ -0,0 +1,1146 @@
+#include "converter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "calibration.h"
+#include "channel_similarity.h"
+#include "content_analysis.h"
+#include "encoder.h"
+#include "estimate.h"
+#include "filter_graph.h"
+#include "fingerprint.h"
+#include "base64.h"
+#include "log.h"
+#include "log_mel.h"
+#include "loudness.h"
+#include "mp3_frame.h"
+#include "pcm_pipeline.h"
+#include "pcm_sink.h"
+#include "pcm_writer.h"
+#include "peak_pyramid.h"
+#include "resampler.h"
+#include "size_limit.h"
+
+namespace wavtomp3 {
+
+const char* const kErrorFile = "FILE_ERROR";
+const char* const kErrorWav = "WAV_ERROR";
+const char* const kErrorEncoder = "ENCODER_ERROR";
+const char* const kErrorEncode = "ENCODE_ERROR";
+const char* const kErrorWrite = "WRITE_ERROR";
+const char* const kErrorSpace = "SPACE_ERROR";
+const char* const kErrorMp3 = "MP3_ERROR";
+const char* const kErrorSize = "SIZE_ERROR";
+
+namespace {
+
+const long kBlockFrames = 4096;
+
+// Audio checked for dual-mono before choosing the channel count
+const double kMonoLookaheadSeconds = 3.0;
+
+// Audio analyzed for preset: 'auto'
+const double kPresetAnalysisSeconds = 5.0;
+
+// encodeSource(): a job encoded as mono turned out to be real stereo
+const int kNotDualMono = 1;
+
+enum class Downmix {
+    Off,
+    IfDualMono,  // while every block confirms the channels are the same
+    Always,
+};
+
+int fail(ConversionResult* result, const char* code, const std::string& message) {
+    LOGE("%s: %s", code, message.c_str());
+    result->errorCode = code;
+    result->errorMessage = message;
+    return -1;
+}
+
+// Input errors of a fan-out job fail every output.
+int failAll(std::vector<ConversionResult>* results, const char* code, const std::string& message) {
+    for (ConversionResult& result : *results) {
+        fail(&result, code, message);
+    }
+    return -1;
+}
+
+bool writeAll(FILE* file, const std::vector<unsigned char>& data) {
+    return data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size();
+}
+
+// Reads the start of a stereo `source` and rewinds it.
+bool startsDualMono(AudioSource* source) {
+    const AudioFormat& format = source->format();
+    std::vector<float> pcm((size_t)kBlockFrames * 2);
+    long long remaining = (long long)(kMonoLookaheadSeconds * format.sampleRate);
+    ChannelSimilarity similarity;
+    while (remaining > 0) {
+        long frames = source->read(pcm.data(), (long)std::min<long long>(kBlockFrames, remaining));
+        if (frames <= 0) {
+            break;
+        }
+        similarity.add(pcm.data(), frames);
+        remaining -= frames;
+    }
+    return source->seek(0) == 0 && similarity.isDualMono(true);
+}
+
+}  // namespace
+
+std::unique_ptr<Encoder> EncoderCache::acquire(EncoderBackend backend, const EncoderConfig& config,
+                                               bool* reused, std::string* error) {
+    *reused = encoder_ && backend == backend_ && config == config_;
+    if (*reused) {
+        return std::move(encoder_);
+    }
+    encoder_.reset();
+    return openEncoder(backend, config, error);
+}
+
+void EncoderCache::release(EncoderBackend backend, const EncoderConfig& config,
+                           std::unique_ptr<Encoder> encoder) {
+    if (encoder->reset() == 0) {
+        backend_ = backend;
+        config_ = config;
+        encoder_ = std::move(encoder);
+    }
+}
+
+namespace {
+
+EncoderConfig encoderConfig(const ConversionOptions& options, int sourceRate, int channels,
+                            int sampleRate) {
+    EncoderConfig config;
+    config.format = options.format;
+    config.sampleRate = encoderSampleRate(options.format, sampleRate > 0 ? sampleRate : sourceRate);
+    config.sourceSampleRate = sourceRate;
+    config.channels = channels;
+    config.bitrate = options.bitrate > 0 ? options.bitrate : defaultBitrate(options.format);
+    config.quality = options.quality;
+    config.lowpassHz = options.lowpassHz;
+    config.highpassHz = options.highpassHz;
+    if (options.sizeLimit.enabled()) {
+        config.sampleRate = sizeLimitSampleRate(options.format, config.sampleRate);
+        config.bitrate = sizeLimitCeiling(options.sizeLimit, options.bitrate, options.format);
+    }
+    return config;
+}
+
+// The encoder and file of one output. The file is removed unless finish()
+// succeeds.
+class OutputWriter {
+public:
+    OutputWriter(const std::string& path, ConversionResult* result) : path_(path), result_(result) {}
+    ~OutputWriter() { discard(); }
+
+    // Keeps the output within `limit` for `frames` frames at the config's
+    // rate; call before open().
+    void limitSize(const SizeLimitOptions& limit, long long frames) {
+        limit_ = limit;
+        limitFrames_ = frames;
+    }
+
+    int open(EncoderBackend backend, const EncoderConfig& config, EncoderCache* cache) {
+        std::string error;
+        if (limit_.enabled()) {
+            std::string errorCode;
+            encoder_ = openSizeLimitedEncoder(backend, config, limit_, limitFrames_, &errorCode, &error);
+            if (!encoder_) {
+                return fail(result_, errorCode.c_str(), error);
+            }
+        } else if (cache) {
+            encoder_ = cache->acquire(backend, config, &result_->warmEncoder, &error);
+        } else {
+            encoder_ = openEncoder(backend, config, &error);
+        }
+        if (!encoder_) {
+            return fail(result_, kErrorEncoder, error);
+        }
+        backend_ = backend;
+        config_ = config;
+        result_->encoder = encoder_->name();
+        file_ = fopen(path_.c_str(), "wb");
+        if (!file_) {
+            return fail(result_, kErrorFile, "Failed to open output file: " + path_);
+        }
+        return 0;
+    }
+
+    const EncoderConfig& config() const { return config_; }
+
+    // Encodes interleaved PCM at the config's rate and channels.
+    int write(const float* pcm, long frames) {
+        encoded_.clear();
+        if (encoder_->encode(pcm, (int)frames, &encoded_) != 0) {
+            return fail(result_, kErrorEncode, "Failed to encode buffer");
+        }
+        if (!writeAll(file_, encoded_)) {
+            return fail(result_, kErrorWrite, "Failed to write output");
+        }
+        result_->outputBytes += encoded_.size();
+        frames_ += frames;
+        return 0;
+    }
+
+    // Flushes the encoder and closes the file; with a `cache` the encoder
+    // goes back to it.
+    int finish(EncoderCache* cache) {
+        encoded_.clear();
+        if (encoder_->finish(&encoded_) != 0) {
+            return fail(result_, kErrorEncode, "Failed to flush encoder");
+        }
+        if (!writeAll(file_, encoded_)) {
+            return fail(result_, kErrorWrite, "Failed to write output");
+        }
+        result_->outputBytes += encoded_.size();
+
+        // Overwrite the placeholder first frame with the final Info tag
+        std::vector<unsigned char> header;
+        const bool hasHeader = encoder_->finalHeader(&header);
+        if (replayGain_ && !(hasHeader && wavtomp3::setReplayGain(&header, replayGainDb_, replayPeak_))) {
+            LOGW("No LAME tag to hold the ReplayGain");
+        }
+        if (hasHeader && (fseek(file_, 0, SEEK_SET) != 0 || !writeAll(file_, header))) {
+            return fail(result_, kErrorWrite, "Failed to write file header");
+        }
+        FILE* file = file_;
+        file_ = nullptr;
+        if (fclose(file) != 0) {
+            remove(path_.c_str());
+            return fail(result_, kErrorWrite, "Failed to write output");
+        }
+
+        if (cache) {
+            cache->release(backend_, config_, std::move(encoder_));
+        }
+        // A size-limited stream reports the bitrate it averaged
+        result_->bitrate = limit_.enabled() && frames_ > 0
+                               ? (int)std::lround(result_->outputBytes * 8.0 * config_.sampleRate / frames_ / 1000.0)
+                               : config_.bitrate;
+        result_->sampleRate = config_.sampleRate;
+        result_->channels = config_.channels;
+        result_->quality = config_.quality;
+        return 0;
+    }
+
+    // ReplayGain for finish() to put in the Info tag; MP3 only.
+    void setReplayGain(double gainDb, float peak) {
+        replayGain_ = true;
+        replayGainDb_ = gainDb;
+        replayPeak_ = peak;
+    }
+
+    // Closes and removes the output of an unfinished encode.
+    void discard() {
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+            remove(path_.c_str());
+        }
+    }
+
+private:
+    const std::string path_;
+    ConversionResult* result_;
+    EncoderBackend backend_ = EncoderBackend::Auto;
+    EncoderConfig config_;
+    std::unique_ptr<Encoder> encoder_;
+    FILE* file_ = nullptr;
+    std::vector<unsigned char> encoded_;
+    bool replayGain_ = false;
+    double replayGainDb_ = 0.0;
+    float replayPeak_ = 0.0f;
+    SizeLimitOptions limit_;
+    long long limitFrames_ = 0;
+    long long frames_ = 0;
+};
+
+// How one output encodes the source, after preset 'auto', dual-mono
+// detection and deadlineMs.
+struct EncodePlan {
+    ConversionOptions options;
+    Downmix downmix = Downmix::Off;
+    int sampleRate = 0;  // 0: the source rate
+};
+
+// Starts a plan from `options`, applying preset 'auto' from `analysis`
+// (nullptr if the input could not be analyzed).
+EncodePlan planPreset(const AudioFormat& format, const ConversionOptions& options,
+                      const ContentAnalysis* analysis, ConversionResult* result) {
+    EncodePlan plan;
+    plan.options = options;
+    if (options.preset != Preset::Auto) {
+        return plan;
+    }
+    if (!analysis) {
+        LOGW("Cannot analyze the input; preset auto uses the default settings");
+        return plan;
+    }
+    PresetChoice choice = choosePreset(*analysis, format, options.format);
+    // Settings the job gives explicitly win over the preset
+    if (plan.options.bitrate <= 0) {
+        plan.options.bitrate = choice.bitrate;
+    }
+    if (plan.options.lowpassHz < 0) {
+        plan.options.lowpassHz = choice.lowpassHz;
+    }
+    plan.sampleRate = choice.sampleRate;
+    if (choice.mono && format.channels == 2) {
+        plan.downmix = Downmix::Always;
+    }
+    result->content = contentTypeName(analysis->type);
+    LOGI("Preset auto: %s, %.1f dBFS, %d Hz bandwidth -> %d kbps, %d Hz%s",
+         result->content.c_str(), analysis->rmsDb, analysis->bandwidthHz, plan.options.bitrate,
+         plan.sampleRate, plan.downmix == Downmix::Always ? ", mono" : "");
+    return plan;
+}
+
+// Sets the plan's quality for what is left of its deadlineMs since `start`.
+void planDeadline(AudioSource* source, std::chrono::steady_clock::time_point start,
+                  EncodePlan* plan) {
+    const ConversionOptions& options = plan->options;
+    if (options.deadlineMs <= 0) {
+        return;
+    }
+    const AudioFormat& format = source->format();
+    Calibration calibration;
+    const long long totalFrames = source->totalFrames();
+    if (totalFrames <= 0 || options.calibrationFile.empty() ||
+        !cachedCalibration(options.calibrationFile, &calibration)) {
+        LOGW("No device calibration; deadlineMs keeps quality %d", options.quality);
+        return;
+    }
+    double audioSeconds = (double)totalFrames / format.sampleRate;
+    double budgetMs = options.deadlineMs - std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    plan->options.quality = qualityForBudget(
+        calibration, budgetMs, audioSeconds, plan->sampleRate > 0 ? plan->sampleRate : format.sampleRate,
+        plan->downmix != Downmix::Off ? 1 : format.channels);
+    LOGI("Deadline %d ms for %.1f s of audio: quality %d", options.deadlineMs, audioSeconds,
+         plan->options.quality);
+}
+
+// Side outputs and analyses of one job. The mono sinks are owned by its
+// MonoTaps; the peaks see every channel of the input.
+struct Sinks {
+    PcmWriter* speech = nullptr;
+    LogMelSink* logMel = nullptr;
+    FingerprintSink* fingerprint = nullptr;
+    std::unique_ptr<PeakPyramid> peaks;
+    bool returnPeaks = false;
+};
+
+int openSinks(const ConversionOptions& options, const AudioFormat& format, MonoTaps* taps, Sinks* sinks,
+              ConversionResult* result) {
+    std::string error;
+    const SpeechOutputOptions& speech = options.speechOutput;
+    if (!speech.path.empty()) {
+        std::unique_ptr<PcmWriter> writer(new PcmWriter(speech.path, speech.wav, speech.sampleRate));
+        sinks->speech = writer.get();
+        taps->add(std::move(writer));
+        if (sinks->speech->open(&error) != 0) {
+            return fail(result, kErrorFile, error);
+        }
+        LOGI("Writing %d Hz mono PCM to %s", speech.sampleRate, speech.path.c_str());
+    }
+    const LogMelOptions& logMel = options.logMel;
+    if (logMel.enabled()) {
+        std::unique_ptr<LogMelSink> sink(new LogMelSink(logMel.path, logMel.returnData, logMel.bands));
+        sinks->logMel = sink.get();
+        taps->add(std::move(sink));
+        if (sinks->logMel->open(&error) != 0) {
+            return fail(result, kErrorFile, error);
+        }
+        LOGI("Computing %d log-mel bands", logMel.bands);
+    }
+    if (options.fingerprint) {
+        std::unique_ptr<FingerprintSink> sink(new FingerprintSink());
+        sinks->fingerprint = sink.get();
+        taps->add(std::move(sink));
+    }
+    const PeakOptions& peaks = options.peaks;
+    if (peaks.enabled()) {
+        sinks->peaks.reset(new PeakPyramid(peaks.path, format.sampleRate, format.channels,
+                                           peaks.samplesPerBin, peaks.levels));
+        sinks->returnPeaks = peaks.returnData;
+    }
+    return 0;
+}
+
+void reportSinks(const Sinks& sinks, ConversionResult* result) {
+    result->speechOutputBytes = sinks.speech ? sinks.speech->bytes() : 0;
+    result->logMelFrames = sinks.logMel ? sinks.logMel->frames() : 0;
+    if (sinks.logMel && !sinks.logMel->data().empty()) {
+        const std::vector<unsigned char>& data = sinks.logMel->data();
+        result->logMel = encodeBase64(data.data(), data.size());
+    }
+    if (sinks.fingerprint) {
+        const std::vector<unsigned char>& data = sinks.fingerprint->data();
+        result->fingerprint = encodeBase64(data.data(), data.size());
+    }
+    result->clippedSamples = sinks.peaks ? sinks.peaks->clippedSamples() : 0;
+    if (sinks.peaks && sinks.returnPeaks) {
+        const std::vector<unsigned char>& data = sinks.peaks->data();
+        result->peaks = encodeBase64(data.data(), data.size());
+    }
+}
+
+// Whether anything besides the encoder takes the decoded source blocks.
+bool needsSourceBlocks(const ConversionOptions& options) {
+    return !options.speechOutput.path.empty() || options.logMel.enabled() || options.peaks.enabled() ||
+           options.fingerprint || options.loudness.enabled();
+}
+
+bool gainOnly(FilterOptions filters) {
+    filters.gainDb = 0.0;
+    return !filters.enabled();
+}
+
+// Encodes `source` from its current position. With Downmix::IfDualMono,
+// returns kNotDualMono, with the output removed, at the first block whose
+// channels differ.
+int encodeSource(AudioSource* input, const std::string& outputPath, const EncodePlan& plan,
+                 const ProgressCallback& progress, ConversionResult* result, EncoderCache* cache) {
+    // When nothing but the encoder needs the decoded blocks, raw samples may
+    // go through the fused PcmPipeline instead, with a gain-only filter chain
+    // folded into it
+    FilterOptions filterOptions = plan.options.filters;
+    const bool fusable = input->hasRawSamples() && plan.downmix != Downmix::IfDualMono &&
+                       !needsSourceBlocks(plan.options) && (!filterOptions.enabled() || gainOnly(filterOptions));
+    float fusedGain = 1.0f;
+    if (fusable && filterOptions.gainDb != 0.0) {
+        fusedGain = (float)pow(10.0, filterOptions.gainDb / 20.0);
+        filterOptions.gainDb = 0.0;
+    }
+
+    // Filters run, and loudness is measured and normalized, on the way in
+    // so every output below sees the same PCM
+    FilteredSource filtered(input, filterOptions);
+    AudioSource* source = filtered.graph().empty() ? input : &filtered;
+    const LoudnessOptions& loudnessOptions = plan.options.loudness;
+    LoudnessSource loudness(source, loudnessOptions);
+    source = loudnessOptions.enabled() ? &loudness : source;
+    AudioFormat format = source->format();
+    const int sourceChannels = format.channels;
+    if (plan.downmix != Downmix::Off) {
+        format.channels = 1;
+    }
+
+    OutputWriter writer(outputPath, result);
+    EncoderConfig config = encoderConfig(plan.options, format.sampleRate, format.channels, plan.sampleRate);
+    const long long totalFrames = source->totalFrames();
+    const long long encoderFrames =
+        totalFrames > 0 ? (long long)((double)totalFrames * config.sampleRate / format.sampleRate) : -1;
+    writer.limitSize(plan.options.sizeLimit, encoderFrames);
+    if (writer.open(plan.options.encoder, config, cache) != 0) {
+        return -1;
+    }
+    LOGI("Encoding %d Hz, %d ch with %s", format.sampleRate, format.channels, result->encoder.c_str());
+
+    std::unique_ptr<PcmPipeline> pipeline;
+    std::vector<unsigned char> raw;
+    std::unique_ptr<Resampler> resampler;
+    std::vector<float> resampled;
+    // Fusing pays only when there is a stage to fuse with the format
+    // conversion; on its own that is as quick through the source's read()
+    const bool fused = fusable && (fusedGain != 1.0f || (plan.downmix == Downmix::Always && sourceChannels == 2) ||
+                                   config.sampleRate != format.sampleRate);
+    if (fused) {
+        PipelineConfig pipelineConfig;
+        pipelineConfig.input = source->format();
+        pipelineConfig.gain = fusedGain;
+        pipelineConfig.downmix = plan.downmix == Downmix::Always && sourceChannels == 2;
+        pipelineConfig.outputRate = config.sampleRate;
+        pipeline.reset(new PcmPipeline(pipelineConfig));
+        raw.resize((size_t)kBlockFrames * bytesPerSample(pipelineConfig.input.sampleFormat) * sourceChannels);
+        LOGI("Fused pipeline: %s", pipeline->plan().c_str());
+    } else if (config.sampleRate != format.sampleRate) {
+        LOGI("Resampling %d Hz to %d Hz", format.sampleRate, config.sampleRate);
+        resampler.reset(new Resampler(format.sampleRate, config.sampleRate, format.channels));
+    }
+
+    // Side outputs and analyses take mono from the same blocks, or the
+    // encoder's own PCM when that is already mono at their rate
+    MonoTaps taps(format.sampleRate);
+    Sinks sinks;
+    if (openSinks(plan.options, source->format(), &taps, &sinks, result) != 0) {
+        return -1;
+    }
+    if (format.channels == 1) {
+        taps.share(config.sampleRate);
+    }
+    std::string error;
+
+    std::vector<float> pcm((size_t)kBlockFrames * sourceChannels);
+    std::vector<float> mono;
+    ChannelSimilarity similarity;
+    long long framesDone = 0;
+    int lastPercent = -1;
+
+    for (;;) {
+        long frames = pipeline ? source->readRaw(raw.data(), kBlockFrames) : source->read(pcm.data(), kBlockFrames);
+        if (frames < 0) {
+            return fail(result, kErrorFile, "Failed to read input");
+        }
+        if (frames == 0) {
+            break;
+        }
+        const float* block = pcm.data();
+        long blockFrames = frames;
+        if (pipeline) {
+            resampled.clear();
+            pipeline->process(raw.data(), frames, &resampled);
+            block = resampled.data();
+            blockFrames = (long)(resampled.size() / format.channels);
+        } else if (plan.downmix == Downmix::IfDualMono) {
+            similarity.clear();
+            similarity.add(pcm.data(), frames);
+            if (!similarity.isDualMono(false)) {
+                LOGI("Channels differ at frame %lld; not dual-mono", framesDone);
+                return kNotDualMono;
+            }
+        }
+        if (sinks.peaks) {
+            sinks.peaks->add(pcm.data(), frames);
+        }
+        if (!pipeline && (plan.downmix != Downmix::Off || (!taps.empty() && sourceChannels == 2))) {
+            mono.resize((size_t)frames);
+            downmixStereo(pcm.data(), frames, mono.data());
+        }
+        if (!pipeline && plan.downmix != Downmix::Off) {
+            block = mono.data();
+        }
+        if (!taps.empty() && taps.write(sourceChannels == 2 ? mono.data() : pcm.data(), frames, &error) != 0) {
+            return fail(result, kErrorWrite, error);
+        }
+        if (resampler) {
+            resampled.clear();
+            resampler->process(block, frames, &resampled);
+            block = resampled.data();
+            blockFrames = (long)(resampled.size() / format.channels);
+        }
+        if (taps.shares() && taps.writeShared(block, blockFrames, &error) != 0) {
+            return fail(result, kErrorWrite, error);
+        }
+        if (writer.write(block, blockFrames) != 0) {
+            return -1;
+        }
+        framesDone += frames;
+
+        if (progress && totalFrames > 0) {
+            int percent = (int)(framesDone * 100 / totalFrames);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                progress((float)framesDone / (float)totalFrames);
+            }
+        }
+    }
+
+    if (pipeline || resampler) {
+        resampled.clear();
+        if (pipeline) {
+            pipeline->flush(&resampled);
+        } else {
+            resampler->flush(&resampled);
+        }
+        const long flushed = (long)(resampled.size() / format.channels);
+        if (taps.shares() && taps.writeShared(resampled.data(), flushed, &error) != 0) {
+            return fail(result, kErrorWrite, error);
+        }
+        if (writer.write(resampled.data(), flushed) != 0) {
+            return -1;
+        }
+    }
+    if (taps.finish(&error) != 0) {
+        return fail(result, kErrorWrite, error);
+    }
+    if (sinks.peaks && sinks.peaks->finish(&error) != 0) {
+        return fail(result, kErrorWrite, error);
+    }
+    const double outputLoudness = loudness.outputLoudness();
+    if (loudnessOptions.replayGain) {
+        if (config.format == OutputFormat::Mp3) {
+            // ReplayGain 2.0 plays back at -18 LUFS
+            writer.setReplayGain(-18.0 - outputLoudness, loudness.outputPeak());
+        } else {
+            LOGW("loudness.replayGain is only written to MP3 output");
+        }
+    }
+    if (writer.finish(cache) != 0) {
+        taps.discard();
+        if (sinks.peaks) {
+            sinks.peaks->discard();
+        }
+        return -1;
+    }
+    reportSinks(sinks, result);
+    result->filterMs = filtered.graph().stats();
+    if (loudnessOptions.enabled()) {
+        result->loudnessMeasured = true;
+        result->loudness = loudness.inputLoudness();
+        result->outputLoudness = outputLoudness;
+        LOGI("Loudness %.1f LUFS in, %.1f LUFS out", result->loudness, outputLoudness);
+    }
+    result->inputFrames = framesDone;
+    result->monoDownmix = plan.downmix == Downmix::IfDualMono;
+    return 0;
+}
+
+// Fan-out (convertSourceMulti): PCM blocks go from the reading thread to
+// the encoder threads through one bounded queue per output.
+typedef std::shared_ptr<const std::vector<float>> PcmBlock;
+
+// Blocks each output may have queued before the reader waits
+const size_t kQueueBlocks = 8;
+
+class BlockQueues {
+public:
+    explicit BlockQueues(size_t outputs) : queues_(outputs) {}
+
+    // Waits for room in queue `output`. Returns false once stopped.
+    bool push(size_t output, const PcmBlock& block) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return stopped_ || queues_[output].size() < kQueueBlocks; });
+        if (stopped_) {
+            return false;
+        }
+        queues_[output].push_back(block);
+        changed_.notify_all();
+        return true;
+    }
+
+    // Waits for the next block of `output`; nullptr at the end of the
+    // input or once stopped.
+    PcmBlock pop(size_t output) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return stopped_ || closed_ || !queues_[output].empty(); });
+        if (stopped_ || queues_[output].empty()) {
+            return nullptr;
+        }
+        PcmBlock block = queues_[output].front();
+        queues_[output].pop_front();
+        changed_.notify_all();
+        return block;
+    }
+
+    // End of the input: outputs finish once their queue is empty.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        changed_.notify_all();
+    }
+
+    // Abandons the job: every output is discarded.
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        changed_.notify_all();
+    }
+
+    bool stopped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopped_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::deque<PcmBlock>> queues_;
+    bool closed_ = false;
+    bool stopped_ = false;
+};
+
+// Outputs that take the same PCM: one downmix and one resampler serve
+// them all.
+struct PcmGroup {
+    bool mono = false;
+    int sampleRate = 0;
+    std::unique_ptr<Resampler> resampler;
+    std::vector<size_t> outputs;
+};
+
+// One pass of a fan-out job from the current position of `source`. Returns
+// kNotDualMono, with every output removed, when an output planned with
+// Downmix::IfDualMono meets a block whose channels differ.
+int encodeFanOut(AudioSource* source, const std::vector<OutputSpec>& outputs,
+                 const std::vector<EncodePlan>& plans, const ProgressCallback& progress,
+                 std::vector<ConversionResult>* results) {
+    const AudioFormat& format = source->format();
+    const long long totalFrames = source->totalFrames();
+    std::vector<std::unique_ptr<OutputWriter>> writers;
+    std::vector<PcmGroup> groups;
+    bool checkDualMono = false;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const EncodePlan& plan = plans[i];
+        const bool mono = plan.downmix != Downmix::Off;
+        ConversionResult* result = &(*results)[i];
+        EncoderConfig config = encoderConfig(plan.options, format.sampleRate,
+                                             mono ? 1 : format.channels, plan.sampleRate);
+        writers.emplace_back(new OutputWriter(outputs[i].path, result));
+        const long long encoderFrames =
+            totalFrames > 0 ? (long long)((double)totalFrames * config.sampleRate / format.sampleRate) : -1;
+        writers.back()->limitSize(plan.options.sizeLimit, encoderFrames);
+        if (writers.back()->open(plan.options.encoder, config, nullptr) != 0) {
+            return -1;
+        }
+        LOGI("Output %zu: %d kbps, %d Hz, %d ch with %s", i, config.bitrate, config.sampleRate,
+             config.channels, result->encoder.c_str());
+        checkDualMono = checkDualMono || plan.downmix == Downmix::IfDualMono;
+
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const PcmGroup& g) {
+            return g.mono == mono && g.sampleRate == config.sampleRate;
+        });
+        if (group == groups.end()) {
+            groups.emplace_back();
+            group = groups.end() - 1;
+            group->mono = mono;
+            group->sampleRate = config.sampleRate;
+            if (config.sampleRate != format.sampleRate) {
+                group->resampler.reset(new Resampler(format.sampleRate, config.sampleRate, config.channels));
+            }
+        }
+        group->outputs.push_back(i);
+    }
+    LOGI("Fan-out to %zu outputs from %zu PCM streams", outputs.size(), groups.size());
+
+    // Encoder threads inherit the worker's priority and CPU affinity
+    BlockQueues queues(outputs.size());
+    std::vector<int> status(outputs.size(), 0);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        threads.emplace_back([&, i] {
+            const int channels = writers[i]->config().channels;
+            while (PcmBlock block = queues.pop(i)) {
+                if (writers[i]->write(block->data(), (long)(block->size() / channels)) != 0) {
+                    status[i] = -1;
+                    queues.stop();
+                    return;
+                }
+            }
+            if (!queues.stopped()) {
+                status[i] = writers[i]->finish(nullptr);
+            }
+        });
+    }
+
+    // Hands `pcm` (source rate, group channels) to every output of `group`
+    auto publish = [&](PcmGroup& group, const float* pcm, long frames, bool flush) {
+        auto block = std::make_shared<std::vector<float>>();
+        if (group.resampler) {
+            if (frames > 0) {
+                group.resampler->process(pcm, frames, block.get());
+            }
+            if (flush) {
+                group.resampler->flush(block.get());
+            }
+        } else {
+            block->assign(pcm, pcm + (size_t)frames * (group.mono ? 1 : format.channels));
+        }
+        for (size_t output : group.outputs) {
+            if (!queues.push(output, block)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<float> pcm((size_t)kBlockFrames * format.channels);
+    std::vector<float> mono;
+    const bool downmix = std::any_of(groups.begin(), groups.end(),
+                                     [](const PcmGroup& group) { return group.mono; });
+    ChannelSimilarity similarity;
+    long long framesDone = 0;
+    int lastPercent = -1;
+    int readStatus = 0;
+    bool running = true;
+    while (running) {
+        long frames = source->read(pcm.data(), kBlockFrames);
+        if (frames < 0) {
+            readStatus = -1;
+            break;
+        }
+        if (frames == 0) {
+            for (PcmGroup& group : groups) {
+                if (group.resampler && !publish(group, nullptr, 0, true)) {
+                    break;
+                }
+            }
+            break;
+        }
+        if (checkDualMono) {
+            similarity.clear();
+            similarity.add(pcm.data(), frames);
+            if (!similarity.isDualMono(false)) {
+                LOGI("Channels differ at frame %lld; not dual-mono", framesDone);
+                readStatus = kNotDualMono;
+                break;
+            }
+        }
+        if (downmix) {
+            mono.resize((size_t)frames);
+            downmixStereo(pcm.data(), frames, mono.data());
+        }
+        for (PcmGroup& group : groups) {
+            if (!publish(group, group.mono ? mono.data() : pcm.data(), frames, false)) {
+                running = false;
+                break;
+            }
+        }
+        framesDone += frames;
+
+        if (progress && totalFrames > 0) {
+            int percent = (int)(framesDone * 100 / totalFrames);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                progress((float)framesDone / (float)totalFrames);
+            }
+        }
+    }
+
+    if (readStatus != 0) {
+        queues.stop();
+    } else {
+        queues.close();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (readStatus == -1) {
+        failAll(results, kErrorFile, "Failed to read input");
+    }
+    bool failed = readStatus != 0;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        failed = failed || status[i] != 0;
+    }
+    if (failed) {
+        // All outputs or none: remove the ones that did finish
+        writers.clear();
+        for (const OutputSpec& output : outputs) {
+            remove(output.path.c_str());
+        }
+        return readStatus == kNotDualMono ? kNotDualMono : -1;
+    }
+    for (size_t i = 0; i < outputs.size(); i++) {
+        (*results)[i].inputFrames = framesDone;
+        (*results)[i].monoDownmix = plans[i].downmix == Downmix::IfDualMono;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int convertSource(AudioSource* source, const std::string& outputPath,
+                  const ConversionOptions& options, const ProgressCallback& progress,
+                  ConversionResult* result, EncoderCache* cache) {
+    auto start = std::chrono::steady_clock::now();
+    const AudioFormat& format = source->format();
+
+    // Both analyses need to rewind, which every file source can
+    const bool seekable = source->seek(0) == 0;
+    ContentAnalysis analysis;
+    const bool analyzed = options.preset == Preset::Auto && seekable &&
+                          analyzeContent(source, kPresetAnalysisSeconds, &analysis) == 0;
+    EncodePlan plan = planPreset(format, options, analyzed ? &analysis : nullptr, result);
+    if (plan.downmix == Downmix::Off && options.detectMono && format.channels == 2 && seekable &&
+        startsDualMono(source)) {
+        LOGI("Stereo input is dual-mono; encoding as mono");
+        plan.downmix = Downmix::IfDualMono;
+    }
+    planDeadline(source, start, &plan);
+
+    int status = encodeSource(source, outputPath, plan, progress, result, cache);
+    if (status == kNotDualMono) {
+        result->outputBytes = 0;
+        if (source->seek(0) != 0) {
+            return fail(result, kErrorFile, "Failed to rewind input");
+        }
+        plan.downmix = Downmix::Off;
+        status = encodeSource(source, outputPath, plan, progress, result, cache);
+    }
+    if (status != 0) {
+        return status;
+    }
+    result->elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    result->deadlineMs = options.deadlineMs;
+    result->deadlineMet = options.deadlineMs > 0 && result->elapsedMs <= options.deadlineMs;
+    LOGI("Encoded %lld frames into %lld bytes in %.1f ms", result->inputFrames,
+         result->outputBytes, result->elapsedMs);
+    recordConversion(options, *result, (double)result->inputFrames / format.sampleRate);
+    return 0;
+}
+
+int convertSourceMulti(AudioSource* source, const std::vector<OutputSpec>& outputs,
+                       const ProgressCallback& progress,
+                       std::vector<ConversionResult>* results) {
+    auto start = std::chrono::steady_clock::now();
+    const AudioFormat& format = source->format();
+    results->assign(outputs.size(), ConversionResult());
+
+    // The input is analyzed once for every output that needs it
+    const bool seekable = source->seek(0) == 0;
+    bool wantsAnalysis = false;
+    for (const OutputSpec& output : outputs) {
+        wantsAnalysis = wantsAnalysis || output.options.preset == Preset::Auto;
+    }
+    ContentAnalysis analysis;
+    const bool analyzed = wantsAnalysis && seekable &&
+                          analyzeContent(source, kPresetAnalysisSeconds, &analysis) == 0;
+    std::vector<EncodePlan> plans;
+    bool wantsDualMono = false;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        plans.push_back(planPreset(format, outputs[i].options, analyzed ? &analysis : nullptr,
+                                   &(*results)[i]));
+        wantsDualMono = wantsDualMono ||
+                        (plans[i].downmix == Downmix::Off && plans[i].options.detectMono);
+    }
+    if (wantsDualMono && format.channels == 2 && seekable && startsDualMono(source)) {
+        LOGI("Stereo input is dual-mono; encoding as mono");
+        for (EncodePlan& plan : plans) {
+            if (plan.downmix == Downmix::Off && plan.options.detectMono) {
+                plan.downmix = Downmix::IfDualMono;
+            }
+        }
+    }
+    for (EncodePlan& plan : plans) {
+        planDeadline(source, start, &plan);
+        if (!plan.options.speechOutput.path.empty()) {
+            LOGW("speechOutput is not written by fan-out jobs");
+        }
+        if (plan.options.logMel.enabled()) {
+            LOGW("logMel is not computed by fan-out jobs");
+        }
+        if (plan.options.peaks.enabled()) {
+            LOGW("peaks are not computed by fan-out jobs");
+        }
+        if (plan.options.fingerprint) {
+            LOGW("fingerprint is not computed by fan-out jobs");
+        }
+        if (plan.options.loudness.enabled()) {
+            LOGW("loudness is not measured or normalized by fan-out jobs");
+        }
+        if (plan.options.filters.enabled()) {
+            LOGW("filters are not applied by fan-out jobs");
+        }
+    }
+
+    // Every output is encoded on its own thread for the whole pass, so each
+    // took the pass's wall time
+    auto pass = std::chrono::steady_clock::now();
+    int status = encodeFanOut(source, outputs, plans, progress, results);
+    if (status == kNotDualMono) {
+        if (source->seek(0) != 0) {
+            return failAll(results, kErrorFile, "Failed to rewind input");
+        }
+        for (size_t i = 0; i < outputs.size(); i++) {
+            (*results)[i].outputBytes = 0;
+            if (plans[i].downmix == Downmix::IfDualMono) {
+                plans[i].downmix = Downmix::Off;
+            }
+        }
+        pass = std::chrono::steady_clock::now();
+        status = encodeFanOut(source, outputs, plans, progress, results);
+    }
+    if (status != 0) {
+        return -1;
+    }
+    const double passMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - pass).count();
+    double elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    long long outputBytes = 0;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        ConversionResult& result = (*results)[i];
+        result.elapsedMs = elapsedMs;
+        result.deadlineMs = plans[i].options.deadlineMs;
+        result.deadlineMet = result.deadlineMs > 0 && elapsedMs <= result.deadlineMs;
+        outputBytes += result.outputBytes;
+    }
+    LOGI("Encoded %lld frames into %zu outputs, %lld bytes, in %.1f ms", (*results)[0].inputFrames,
+         outputs.size(), outputBytes, elapsedMs);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        ConversionResult encoded = (*results)[i];
+        encoded.elapsedMs = passMs;
+        recordConversion(outputs[i].options, encoded, (double)encoded.inputFrames / format.sampleRate);
+    }
+    return 0;
+}
+
+int convertFile(const std::string& inputPath, const std::string& outputPath,
+                const ConversionOptions& options, const ProgressCallback& progress,
+                ConversionResult* result, EncoderCache* cache) {
+    if (access(inputPath.c_str(), R_OK) != 0) {
+        return fail(result, kErrorFile, "Failed to open input file: " + inputPath);
+    }
+    std::string error;
+    std::unique_ptr<AudioSource> source = openAudioSource(inputPath, options.rawFormat, &error);
+    if (!source) {
+        return fail(result, kErrorWav, error);
+    }
+    return convertSource(source.get(), outputPath, options, progress, result, cache);
+}
+
+int convertFilePreview(const std::string& inputPath, const std::string& outputPath,
+                       const ConversionOptions& options, const ProgressCallback& progress,
+                       ConversionResult* result) {
+    if (access(inputPath.c_str(), R_OK) != 0) {
+        return fail(result, kErrorFile, "Failed to open input file: " + inputPath);
+    }
+    std::string error;
+    std::unique_ptr<AudioSource> source = openAudioSource(inputPath, options.rawFormat, &error);
+    if (!source) {
+        return fail(result, kErrorWav, error);
+    }
+    source->prefetch();
+
+    // 6 and 7 kbps are Opus bitrates only; LAME would quietly pick another
+    if (options.format == OutputFormat::Mp3 && options.preview.bitrate > 0 && options.preview.bitrate < 8) {
+        return fail(result, kErrorEncoder, "preview.bitrate must be at least 8 kbps for MP3");
+    }
+    ConversionOptions preview;
+    preview.format = options.format;
+    const int bitrate = options.bitrate > 0 ? options.bitrate : defaultBitrate(options.format);
+    preview.bitrate = options.preview.bitrate > 0 ? options.preview.bitrate
+                                                  : std::min(kPreviewBitrate, bitrate);
+    preview.quality = kQualityLevels - 1;
+    preview.lowpassHz = options.lowpassHz;
+    preview.highpassHz = options.highpassHz;
+    preview.encoder = options.encoder;
+    preview.priority = options.priority;
+    preview.detectMono = options.detectMono;
+    preview.throughputFile = options.throughputFile;
+    preview.filters = options.filters;
+    preview.rawFormat = options.rawFormat;
+    if (options.preview.seconds <= 0.0) {
+        return convertSource(source.get(), outputPath, preview, progress, result);
+    }
+    LeadingSource leading(source.get(), (long long)(options.preview.seconds * source->format().sampleRate));
+    return convertSource(&leading, outputPath, preview, progress, result);
+}
+
+int convertFileReplacing(const std::string& inputPath, const std::string& outputPath,
+                         const ConversionOptions& options, const ProgressCallback& progress,
+                         ConversionResult* result) {
+    const std::string partPath = outputPath + ".part";
+    if (convertFile(inputPath, partPath, options, progress, result) != 0) {
+        return -1;
+    }
+    if (rename(partPath.c_str(), outputPath.c_str()) != 0) {
+        remove(partPath.c_str());
+        return fail(result, kErrorWrite, "Failed to replace " + outputPath);
+    }
+    return 0;
+}
+
+int convertFileMulti(const std::string& inputPath, const ConversionOptions& options,
+                     const std::vector<OutputSpec>& outputs, const ProgressCallback& progress,
+                     std::vector<ConversionResult>* results) {
+    results->assign(outputs.size(), ConversionResult());
+    if (access(inputPath.c_str(), R_OK) != 0) {
+        return failAll(results, kErrorFile, "Failed to open input file: " + inputPath);
+    }
+    std::string error;
+    std::unique_ptr<AudioSource> source = openAudioSource(inputPath, options.rawFormat, &error);
+    if (!source) {
+        return failAll(results, kErrorWav, error);
+    }
+    return convertSourceMulti(source.get(), outputs, progress, results);
+}
+
+std::string formatResult(const ConversionResult& result) {
+    char numbers[192];
+    snprintf(numbers, sizeof(numbers),
+             "inputFrames=%lld\noutputBytes=%lld\nelapsedMs=%.1f\ncpu=%d\nwarmEncoder=%d\nmonoDownmix=%d\n",
+             result.inputFrames, result.outputBytes, result.elapsedMs, result.placement.cpu,
+             result.warmEncoder ? 1 : 0, result.monoDownmix ? 1 : 0);
+    std::string text;
+    if (!result.errorCode.empty()) {
+        text += "errorCode=" + result.errorCode + "\n";
+        text += "errorMessage=" + result.errorMessage + "\n";
+    }
+    text += "encoder=" + result.encoder + "\n";
+    text += numbers;
+    text += std::string("priority=") + priorityName(result.placement.priority) + "\n";
+    text += "placement=" + result.placement.policy + "\n";
+    text += "cpus=" + formatCpuList(result.placement.cpus) + "\n";
+    char stream[96];
+    snprintf(stream, sizeof(stream), "bitrate=%d\nsampleRate=%d\nchannels=%d\nquality=%d\n", result.bitrate,
+             result.sampleRate, result.channels, result.quality);
+    text += stream;
+    if (result.deadlineMs > 0) {
+        text += std::string("deadlineMet=") + (result.deadlineMet ? "1" : "0") + "\n";
+    }
+    if (!result.content.empty()) {
+        text += "content=" + result.content + "\n";
+    }
+    if (result.speechOutputBytes > 0) {
+        text += "speechOutputBytes=" + std::to_string(result.speechOutputBytes) + "\n";
+    }
+    if (result.logMelFrames > 0) {
+        text += "logMelFrames=" + std::to_string(result.logMelFrames) + "\n";
+    }
+    if (!result.logMel.empty()) {
+        text += "logMel=" + result.logMel + "\n";
+    }
+    if (result.clippedSamples > 0) {
+        text += "clippedSamples=" + std::to_string(result.clippedSamples) + "\n";
+    }
+    if (!result.peaks.empty()) {
+        text += "peaks=" + result.peaks + "\n";
+    }
+    if (!result.fingerprint.empty()) {
+        text += "fingerprint=" + result.fingerprint + "\n";
+    }
+    if (!result.filterMs.empty()) {
+        text += "filterMs=";
+        for (size_t i = 0; i < result.filterMs.size(); i++) {
+            char stage[64];
+            snprintf(stage, sizeof(stage), "%s%s:%.2f", i > 0 ? "," : "", result.filterMs[i].first.c_str(),
+                     result.filterMs[i].second);
+            text += stage;
+        }
+        text += "\n";
+    }
+    if (result.loudnessMeasured) {
+        char loudness[64];
+        snprintf(loudness, sizeof(loudness), "loudness=%.2f\noutputLoudness=%.2f\n", result.loudness,
+                 result.outputLoudness);
+        text += loudness;
+    }
+    return text;
+}
+
+std::string formatResults(const std::vector<ConversionResult>& results) {
+    std::string text;
+    for (const ConversionResult& result : results) {
+        if (!result.errorCode.empty()) {
+            text += "errorCode=" + result.errorCode + "\n";
+            text += "errorMessage=" + result.errorMessage + "\n";
+            break;
+        }
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        std::string prefix = "outputs." + std::to_string(i) + ".";
+        std::string lines = formatResult(results[i]);
+        for (size_t begin = 0; begin < lines.size();) {
+            size_t end = lines.find('\n', begin) + 1;
+            text += prefix + lines.substr(begin, end - begin);
+            begin = end;
+        }
+    }
+    return text;
+}
+
+}  // namespace wavtomp3
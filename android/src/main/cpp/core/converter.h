@@ -0,0 +1,139 @@
+// Drives an AudioSource through an Encoder into an output file.
+#ifndef WAV_TO_MP3_CONVERTER_H
+#define WAV_TO_MP3_CONVERTER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio_source.h"
+#include "options.h"
+#include "worker_pool.h"
+
+namespace wavtomp3 {
+
+// Error codes, shared with the JS promise rejections
+extern const char* const kErrorFile;     // FILE_ERROR
+extern const char* const kErrorWav;      // WAV_ERROR
+extern const char* const kErrorEncoder;  // ENCODER_ERROR: encoder failed to initialize
+extern const char* const kErrorEncode;   // ENCODE_ERROR: encoder failed mid-stream
+extern const char* const kErrorWrite;    // WRITE_ERROR
+extern const char* const kErrorSpace;    // SPACE_ERROR: not enough free space for the output
+extern const char* const kErrorMp3;      // MP3_ERROR: input is not an MP3 stream that can be cut
+extern const char* const kErrorSize;     // SIZE_ERROR: maxBytes cannot hold the input
+
+// Preview bitrate of a two-phase job when options.preview sets none
+const int kPreviewBitrate = 32;
+
+struct ConversionResult {
+    std::string errorCode;  // empty on success
+    std::string errorMessage;
+    std::string encoder;    // backend that produced the output
+    long long inputFrames = 0;
+    long long outputBytes = 0;
+    double elapsedMs = 0.0;
+    Placement placement;    // worker the job ran on, see runOnWorker()
+    bool warmEncoder = false;  // encoder reused from an EncoderCache
+    bool monoDownmix = false;  // dual-mono stereo input encoded as mono
+    // Encoded stream
+    int bitrate = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    std::string content;       // preset 'auto': "speech", "music" or "silence"
+    int quality = 0;
+    int deadlineMs = 0;        // from the options; 0 if none
+    bool deadlineMet = false;
+    long long speechOutputBytes = 0;  // options.speechOutput, 0 if none
+    long long logMelFrames = 0;       // options.logMel
+    std::string logMel;               // base64 features if logMel.returnData, see log_mel.h
+    long long clippedSamples = 0;     // options.peaks
+    std::string peaks;                // base64 pyramid if peaks.returnData, see peak_pyramid.h
+    std::string fingerprint;          // base64 if options.fingerprint, see fingerprint.h
+    // options.loudness: integrated LUFS of the input and of the output
+    // after normalization, see loudness.h
+    bool loudnessMeasured = false;
+    double loudness = 0.0;
+    double outputLoudness = 0.0;
+    // Time spent in each stage of options.filters, see filter_graph.h
+    std::vector<std::pair<std::string, double>> filterMs;
+};
+
+// Keeps the encoder of the last successful job open so a long-running
+// process (wav2mp3d) can reuse it for the next job with the same settings.
+// Not thread-safe: use one cache per worker thread.
+class EncoderCache {
+public:
+    // Returns the cached encoder if it matches, otherwise opens a new one.
+    std::unique_ptr<Encoder> acquire(EncoderBackend backend, const EncoderConfig& config,
+                                     bool* reused, std::string* error);
+
+    // Takes back a finished encoder; dropped if the backend cannot reset.
+    void release(EncoderBackend backend, const EncoderConfig& config,
+                 std::unique_ptr<Encoder> encoder);
+
+private:
+    EncoderBackend backend_ = EncoderBackend::Auto;
+    EncoderConfig config_;
+    std::unique_ptr<Encoder> encoder_;
+};
+
+// Called with the fraction of input consumed, at most once per percent.
+typedef std::function<void(float)> ProgressCallback;
+
+// Returns 0 on success, -1 with `result->errorCode` set otherwise. A partial
+// output file is removed on failure. With a `cache` the encoder is taken
+// from and returned to it.
+int convertSource(AudioSource* source, const std::string& outputPath,
+                  const ConversionOptions& options, const ProgressCallback& progress,
+                  ConversionResult* result, EncoderCache* cache = nullptr);
+
+// Opens `inputPath` (WAV, or raw PCM described by options.rawFormat) and
+// converts it.
+int convertFile(const std::string& inputPath, const std::string& outputPath,
+                const ConversionOptions& options, const ProgressCallback& progress,
+                ConversionResult* result, EncoderCache* cache = nullptr);
+
+// Two-phase jobs, for playback right after recording: a quick preview
+// first, then the full encode replacing it.
+//
+// Encodes the first options.preview.seconds of `inputPath` (all of it if 0)
+// into `outputPath` at the preview bitrate and the fastest quality, without
+// side outputs or loudness normalization. The rest of the input is read
+// ahead into the OS cache meanwhile, so the second phase finds it there.
+int convertFilePreview(const std::string& inputPath, const std::string& outputPath,
+                       const ConversionOptions& options, const ProgressCallback& progress,
+                       ConversionResult* result);
+
+// Converts `inputPath` into a temporary file next to `outputPath` and
+// renames it over `outputPath` once complete, so a player never sees a
+// partial file. On failure whatever was at `outputPath` is kept.
+int convertFileReplacing(const std::string& inputPath, const std::string& outputPath,
+                         const ConversionOptions& options, const ProgressCallback& progress,
+                         ConversionResult* result);
+
+// Reads, converts and resamples `source` once and encodes it into every
+// output in parallel, each on its own thread with its own encoder. Fills one
+// result per output and returns 0, or -1 with the failed outputs'
+// errorCode set, in which case no output is kept.
+int convertSourceMulti(AudioSource* source, const std::vector<OutputSpec>& outputs,
+                       const ProgressCallback& progress, std::vector<ConversionResult>* results);
+
+// Opens `inputPath` (WAV, or raw PCM described by options.rawFormat) and
+// fans it out to `outputs`.
+int convertFileMulti(const std::string& inputPath, const ConversionOptions& options,
+                     const std::vector<OutputSpec>& outputs, const ProgressCallback& progress,
+                     std::vector<ConversionResult>* results);
+
+// Serializes `result` as "key=value" lines for the platform glue.
+std::string formatResult(const ConversionResult& result);
+
+// Serializes fan-out results: formatResult() of output N with its keys
+// prefixed "outputs.N.", after the errorCode and errorMessage of the first
+// failed output, if any.
+std::string formatResults(const std::vector<ConversionResult>& results);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_CONVERTER_H
@@ -0,0 +1,162 @@
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace wavtomp3 {
+
+namespace {
+
+bool readFile(const std::string& path, std::string* text) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    char buffer[256];
+    size_t size = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[size] = '\0';
+    *text = buffer;
+    while (!text->empty() && (text->back() == '\n' || text->back() == ' ')) {
+        text->pop_back();
+    }
+    return true;
+}
+
+int readInt(const std::string& path) {
+    std::string text;
+    return readFile(path, &text) ? atoi(text.c_str()) : 0;
+}
+
+}  // namespace
+
+int CpuTopology::score(const CpuCore& core) const {
+    bool haveCapacity = std::all_of(cores.begin(), cores.end(),
+                                    [](const CpuCore& c) { return c.capacity > 0; });
+    return haveCapacity ? core.capacity : core.maxFreqKhz;
+}
+
+bool CpuTopology::isHeterogeneous() const {
+    for (const CpuCore& core : cores) {
+        if (score(core) != score(cores.front())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<int> CpuTopology::performanceCores() const {
+    std::vector<int> ids;
+    if (cores.empty()) {
+        return ids;
+    }
+    int slowest = score(cores.front());
+    for (const CpuCore& core : cores) {
+        slowest = std::min(slowest, score(core));
+    }
+    for (const CpuCore& core : cores) {
+        if (!isHeterogeneous() || score(core) > slowest) {
+            ids.push_back(core.id);
+        }
+    }
+    return ids;
+}
+
+std::vector<int> CpuTopology::efficiencyCores() const {
+    std::vector<int> ids;
+    if (cores.empty()) {
+        return ids;
+    }
+    int slowest = score(cores.front());
+    for (const CpuCore& core : cores) {
+        slowest = std::min(slowest, score(core));
+    }
+    for (const CpuCore& core : cores) {
+        if (score(core) == slowest) {
+            ids.push_back(core.id);
+        }
+    }
+    return ids;
+}
+
+bool parseCpuList(const std::string& text, std::vector<int>* cpus) {
+    cpus->clear();
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string range = text.substr(pos, end - pos);
+        int first, last;
+        char extra;
+        if (sscanf(range.c_str(), "%d-%d%c", &first, &last, &extra) == 2) {
+            if (first < 0 || last < first) {
+                return false;
+            }
+        } else if (sscanf(range.c_str(), "%d%c", &first, &extra) == 1 && first >= 0) {
+            last = first;
+        } else {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus->push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        if (!text.empty()) {
+            text += ",";
+        }
+        text += std::to_string(cpus[i]);
+        if (j > i) {
+            text += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text;
+}
+
+int readCpuTopology(const std::string& root, CpuTopology* topology) {
+    topology->cores.clear();
+    // "possible" rather than "online": big cores are often hotplugged out
+    // while idle and come back once there is work.
+    std::string possible;
+    std::vector<int> ids;
+    if (!readFile(root + "/possible", &possible) || !parseCpuList(possible, &ids)) {
+        return -1;
+    }
+    for (int id : ids) {
+        std::string dir = root + "/cpu" + std::to_string(id);
+        CpuCore core;
+        core.id = id;
+        core.capacity = readInt(dir + "/cpu_capacity");
+        core.maxFreqKhz = readInt(dir + "/cpufreq/cpuinfo_max_freq");
+        // Cores that report nothing (no cpufreq, not present) cannot be ranked
+        if (core.capacity > 0 || core.maxFreqKhz > 0) {
+            topology->cores.push_back(core);
+        }
+    }
+    return topology->cores.empty() ? -1 : 0;
+}
+
+const CpuTopology& cpuTopology() {
+    static const CpuTopology topology = [] {
+        CpuTopology t;
+        readCpuTopology(kDefaultSysfsCpuRoot, &t);
+        return t;
+    }();
+    return topology;
+}
+
+}  // namespace wavtomp3
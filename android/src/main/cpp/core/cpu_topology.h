@@ -0,0 +1,52 @@
+// CPU core capacities read from sysfs, for placing encode threads on
+// heterogeneous (big.LITTLE) SoCs.
+#ifndef WAV_TO_MP3_CPU_TOPOLOGY_H
+#define WAV_TO_MP3_CPU_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+struct CpuCore {
+    int id = 0;
+    int capacity = 0;      // cpu_capacity (0-1024), 0 if the kernel does not expose it
+    int maxFreqKhz = 0;    // cpufreq/cpuinfo_max_freq, 0 if unknown
+};
+
+struct CpuTopology {
+    std::vector<CpuCore> cores;  // cores reporting a capacity or frequency, by id
+
+    // Relative performance used for classification: capacity when the
+    // kernel reports it, otherwise the maximum frequency.
+    int score(const CpuCore& core) const;
+
+    // True if cores differ in score.
+    bool isHeterogeneous() const;
+
+    // Every core except those of the slowest cluster; all cores on
+    // homogeneous systems.
+    std::vector<int> performanceCores() const;
+
+    // Cores of the slowest cluster; all cores on homogeneous systems.
+    std::vector<int> efficiencyCores() const;
+};
+
+const char* const kDefaultSysfsCpuRoot = "/sys/devices/system/cpu";
+
+// Reads the topology below `root` (normally kDefaultSysfsCpuRoot; tests can
+// point it at a fake tree). Returns 0, or -1 if no core could be ranked.
+int readCpuTopology(const std::string& root, CpuTopology* topology);
+
+// Topology of this machine, read once on first use.
+const CpuTopology& cpuTopology();
+
+// Parses a sysfs CPU list such as "0-3,6". Returns false on malformed input.
+bool parseCpuList(const std::string& text, std::vector<int>* cpus);
+
+// Formats ids as a CPU list, e.g. {0, 1, 2, 3, 6} -> "0-3,6".
+std::string formatCpuList(const std::vector<int>& cpus);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_CPU_TOPOLOGY_H
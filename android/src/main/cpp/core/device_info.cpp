@@ -0,0 +1,39 @@
+#include "device_info.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+#include "cpu_topology.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+DeviceInfo probeDevice() {
+    DeviceInfo info;
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    info.cpuCount = cpus > 0 ? (int)cpus : 1;
+    for (const CpuCore& core : cpuTopology().cores) {
+        info.maxCpuFreqKhz = std::max(info.maxCpuFreqKhz, core.maxFreqKhz);
+    }
+#if defined(__arm__)
+    info.is32BitArm = true;
+#endif
+    return info;
+}
+
+}  // namespace
+
+const DeviceInfo& deviceInfo() {
+    static const DeviceInfo info = probeDevice();
+    return info;
+}
+
+bool isLowEndDevice(const DeviceInfo& info) {
+    if (info.is32BitArm) {
+        return true;
+    }
+    return info.cpuCount <= 4 && info.maxCpuFreqKhz > 0 && info.maxCpuFreqKhz < 1500000;
+}
+
+}  // namespace wavtomp3
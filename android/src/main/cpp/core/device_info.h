@@ -0,0 +1,22 @@
+// Coarse description of the CPU the conversion runs on.
+#ifndef WAV_TO_MP3_DEVICE_INFO_H
+#define WAV_TO_MP3_DEVICE_INFO_H
+
+namespace wavtomp3 {
+
+struct DeviceInfo {
+    int cpuCount = 1;
+    int maxCpuFreqKhz = 0;  // fastest core, 0 if unknown
+    bool is32BitArm = false;
+};
+
+// Probed once, on first use.
+const DeviceInfo& deviceInfo();
+
+// True on devices where LAME runs close to real time: 32-bit ARM builds and
+// few, slow cores.
+bool isLowEndDevice(const DeviceInfo& info);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_DEVICE_INFO_H
@@ -0,0 +1,119 @@
+#include "encoder.h"
+
+#include "device_info.h"
+#include "log.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Bitrates at or below this are speech presets, where shine's quality is
+// close enough to LAME's to trade for its speed.
+const int kSpeechMaxBitrate = 64;
+
+// Rates libopus accepts natively
+const int kOpusRates[] = {8000, 12000, 16000, 24000, 48000};
+
+}  // namespace
+
+int encoderSampleRate(OutputFormat format, int sampleRate) {
+    if (format != OutputFormat::Opus) {
+        return sampleRate;  // LAME and shine resample internally when needed
+    }
+    // Smallest Opus rate that keeps the full input bandwidth
+    for (int rate : kOpusRates) {
+        if (rate >= sampleRate) {
+            return rate;
+        }
+    }
+    return 48000;
+}
+
+int defaultBitrate(OutputFormat format) {
+    return format == OutputFormat::Opus ? 24 : 128;
+}
+
+EncoderBackend selectBackend(EncoderBackend requested, const EncoderConfig& config) {
+    if (requested != EncoderBackend::Auto) {
+        return requested;
+    }
+    if (config.bitrate <= kSpeechMaxBitrate && isLowEndDevice(deviceInfo())) {
+        return EncoderBackend::Fixed;
+    }
+    return EncoderBackend::Lame;
+}
+
+std::unique_ptr<Encoder> openEncoder(EncoderBackend requested, const EncoderConfig& config,
+                                     std::string* error) {
+    if (config.format == OutputFormat::Opus) {
+        std::unique_ptr<Encoder> encoder = createOpusEncoder();
+        if (!encoder) {
+            *error = "Opus encoding is not available in this build";
+            return nullptr;
+        }
+        if (encoder->open(config, error) != 0) {
+            return nullptr;
+        }
+        return encoder;
+    }
+
+    EncoderBackend backend = selectBackend(requested, config);
+    if (backend == EncoderBackend::Fixed) {
+        std::unique_ptr<Encoder> encoder = createFixedPointEncoder();
+        if (!encoder) {
+            *error = "Fixed-point encoder is not available in this build";
+        } else if (encoder->open(config, error) == 0) {
+            return encoder;
+        }
+        if (requested == EncoderBackend::Fixed) {
+            return nullptr;
+        }
+        LOGI("%s, falling back to LAME", error->c_str());
+        error->clear();
+    }
+
+    std::unique_ptr<Encoder> encoder = createLameEncoder();
+    if (encoder->open(config, error) != 0) {
+        return nullptr;
+    }
+    return encoder;
+}
+
+const char* backendName(EncoderBackend backend) {
+    switch (backend) {
+        case EncoderBackend::Auto: return "auto";
+        case EncoderBackend::Lame: return "lame";
+        case EncoderBackend::Fixed: return "fixed";
+    }
+    return "auto";
+}
+
+bool parseBackend(const std::string& name, EncoderBackend* backend) {
+    if (name == "auto") {
+        *backend = EncoderBackend::Auto;
+    } else if (name == "lame") {
+        *backend = EncoderBackend::Lame;
+    } else if (name == "fixed") {
+        *backend = EncoderBackend::Fixed;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* formatName(OutputFormat format) {
+    return format == OutputFormat::Opus ? "opus" : "mp3";
+}
+
+bool parseFormat(const std::string& name, OutputFormat* format) {
+    if (name == "mp3") {
+        *format = OutputFormat::Mp3;
+    } else if (name == "opus") {
+        *format = OutputFormat::Opus;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace wavtomp3
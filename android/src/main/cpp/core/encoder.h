@@ -0,0 +1,112 @@
+// Pluggable audio encoders behind the conversion pipeline.
+#ifndef WAV_TO_MP3_ENCODER_H
+#define WAV_TO_MP3_ENCODER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+enum class OutputFormat {
+    Mp3,
+    Opus,  // Ogg/Opus
+};
+
+// MP3 encoder implementation; Opus has a single backend.
+enum class EncoderBackend {
+    Auto,   // pick per job from the preset and the device
+    Lame,   // LAME, floating point
+    Fixed,  // shine, fixed point; CBR only, ignores quality
+};
+
+struct EncoderConfig {
+    OutputFormat format = OutputFormat::Mp3;
+    int sampleRate = 44100;    // rate of the PCM passed to encode()
+    int sourceSampleRate = 0;  // rate before resampling, for metadata; 0 = sampleRate
+    int channels = 2;          // input channels, 1 or 2
+    int bitrate = 128;         // kbps
+    int quality = 5;           // 0 = best, 9 = fastest
+    int lowpassHz = -1;        // -1 = encoder default
+    int highpassHz = -1;
+    // For segment encoding (segment.h): frames that decode on their own (no
+    // bit reservoir), no Info tag, and no resampling inside the encoder, so
+    // frames line up with a whole-file encode. MP3 via LAME only.
+    bool independentFrames = false;
+    // Opus: hard CBR, every packet exactly the bitrate's size (size_limit.h)
+    bool constantBitrate = false;
+};
+
+inline bool operator==(const EncoderConfig& a, const EncoderConfig& b) {
+    return a.format == b.format && a.sampleRate == b.sampleRate &&
+           a.sourceSampleRate == b.sourceSampleRate && a.channels == b.channels &&
+           a.bitrate == b.bitrate && a.quality == b.quality && a.lowpassHz == b.lowpassHz &&
+           a.highpassHz == b.highpassHz && a.independentFrames == b.independentFrames &&
+           a.constantBitrate == b.constantBitrate;
+}
+
+class Encoder {
+public:
+    virtual ~Encoder() = default;
+
+    virtual const char* name() const = 0;
+
+    // Returns 0 on success, -1 with a message in `error` otherwise.
+    virtual int open(const EncoderConfig& config, std::string* error) = 0;
+
+    // Encodes interleaved float frames in [-1, 1] and appends the bitstream
+    // to `out`. Returns 0 on success, -1 on error.
+    virtual int encode(const float* pcm, int frames, std::vector<unsigned char>* out) = 0;
+
+    // Flushes buffered audio into `out`. Returns 0 on success, -1 on error.
+    virtual int finish(std::vector<unsigned char>* out) = 0;
+
+    // Bytes to write over the start of the output once encoding finished
+    // (e.g. LAME's Info tag frame). Returns false if there is none.
+    virtual bool finalHeader(std::vector<unsigned char>* /*header*/) { return false; }
+
+    // Prepares a finished encoder for another stream with the same config,
+    // skipping open(). Returns -1 if the backend cannot be reused.
+    virtual int reset() { return -1; }
+
+    // Samples per frame and encoder delay, in input samples. Returns false
+    // if the backend does not expose them.
+    virtual bool framing(int* /*frameSamples*/, int* /*delaySamples*/) const { return false; }
+
+    // Changes the bitrate, in kbps, of the audio encoded from now on.
+    // Returns -1 if the backend cannot change it mid-stream.
+    virtual int setBitrate(int /*bitrate*/) { return -1; }
+};
+
+std::unique_ptr<Encoder> createLameEncoder();
+
+// Returns nullptr when libopus was not compiled in.
+std::unique_ptr<Encoder> createOpusEncoder();
+
+// Rate the PCM has to be resampled to before `format` can encode it.
+int encoderSampleRate(OutputFormat format, int sampleRate);
+
+// Default bitrate in kbps when the job does not set one.
+int defaultBitrate(OutputFormat format);
+
+// Returns nullptr when the fixed-point backend was not compiled in.
+std::unique_ptr<Encoder> createFixedPointEncoder();
+
+// Resolves EncoderBackend::Auto for `config` on this device.
+EncoderBackend selectBackend(EncoderBackend requested, const EncoderConfig& config);
+
+// Creates and opens the encoder for `config.format` and, for MP3, `requested`.
+// Auto falls back to LAME if the preferred backend cannot handle the
+// configuration.
+std::unique_ptr<Encoder> openEncoder(EncoderBackend requested, const EncoderConfig& config,
+                                     std::string* error);
+
+const char* backendName(EncoderBackend backend);
+bool parseBackend(const std::string& name, EncoderBackend* backend);
+
+const char* formatName(OutputFormat format);
+bool parseFormat(const std::string& name, OutputFormat* format);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_ENCODER_H
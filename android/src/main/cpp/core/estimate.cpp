@@ -0,0 +1,348 @@
+#include "estimate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include "audio_source.h"
+#include "calibration.h"
+#include "encoder.h"
+#include "log.h"
+#include "size_limit.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kModelVersion = 1;
+// Weight of the newest job in the moving average
+const double kModelAlpha = 0.25;
+// Jobs shorter than this are dominated by setup and left out of the model
+const double kMinModelAudioSeconds = 1.0;
+const double kMinModelElapsedMs = 20.0;
+// Speeds are in seconds of 44.1 kHz stereo per second, as in Calibration
+const int kReferenceRate = 44100;
+const int kReferenceChannels = 2;
+// Model key of the platform's decode of compressed input, whose speed is in
+// seconds of audio per second
+const char* const kDecodeKey = "decode";
+// LAME's encoder delay, and the Ogg Opus overhead: one lacing byte per 20 ms
+// packet, a 27-byte header per page of about 4 KB, and the OpusHead and
+// OpusTags pages
+const int kLameDelaySamples = 576;
+const double kOpusLacingBytesPerSecond = 50.0;
+const double kOggPageBytes = 4096.0;
+const int kOggPageHeaderBytes = 27;
+const int kOpusHeaderBytes = 128;
+
+struct Throughput {
+    double speed = 0.0;
+    int jobs = 0;
+};
+
+typedef std::map<std::string, Throughput> ThroughputModel;
+
+std::mutex modelMutex;
+std::map<std::string, ThroughputModel> models;
+
+ThroughputModel loadModel(const std::string& path) {
+    ThroughputModel model;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return model;
+    }
+    int version = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        char key[64];
+        Throughput entry;
+        if (sscanf(line, "version=%d", &version) == 1) {
+            continue;
+        }
+        if (sscanf(line, "%63[^=]=%lf %d", key, &entry.speed, &entry.jobs) == 3 && entry.speed > 0.0 &&
+            entry.jobs > 0) {
+            model[key] = entry;
+        }
+    }
+    fclose(file);
+    if (version != kModelVersion) {
+        LOGW("Ignoring encode speed model %s of version %d", path.c_str(), version);
+        model.clear();
+    }
+    return model;
+}
+
+int saveModel(const std::string& path, const ThroughputModel& model) {
+    std::string text = "version=" + std::to_string(kModelVersion) + "\n";
+    for (const auto& entry : model) {
+        char line[128];
+        snprintf(line, sizeof(line), "%s=%.3f %d\n", entry.first.c_str(), entry.second.speed,
+                 entry.second.jobs);
+        text += line;
+    }
+    std::string partPath = path + ".part";
+    FILE* file = fopen(partPath.c_str(), "w");
+    if (!file) {
+        return -1;
+    }
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (fclose(file) != 0 || !written || rename(partPath.c_str(), path.c_str()) != 0) {
+        remove(partPath.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// Call with modelMutex held
+ThroughputModel& cachedModel(const std::string& path) {
+    auto it = models.find(path);
+    if (it == models.end()) {
+        it = models.emplace(path, loadModel(path)).first;
+    }
+    return it->second;
+}
+
+// Folds `speed` into the model's entry for `key` and saves the model
+void recordSpeed(const std::string& path, const std::string& key, double speed) {
+    std::lock_guard<std::mutex> lock(modelMutex);
+    ThroughputModel& model = cachedModel(path);
+    Throughput& entry = model[key];
+    entry.speed = entry.jobs == 0 ? speed : entry.speed + kModelAlpha * (speed - entry.speed);
+    entry.jobs++;
+    if (saveModel(path, model) != 0) {
+        LOGW("Failed to write encode speed model %s", path.c_str());
+    }
+}
+
+// Backends differ several times in speed, and LAME by quality level
+std::string modelKey(const std::string& encoder, int quality) {
+    return encoder == "lame" ? encoder + "." + std::to_string(quality) : encoder;
+}
+
+// Encode work of `audioSeconds` at the encoded rate and channels, in
+// seconds of 44.1 kHz stereo
+double referenceSeconds(double audioSeconds, int sampleRate, int channels) {
+    return audioSeconds * sampleRate / kReferenceRate * channels / kReferenceChannels;
+}
+
+// Size of `frames` input frames as LAME or shine CBR frames, including the
+// encoder delay, the flushed last frame and LAME's Info frame
+long long mp3Bytes(long long frames, int sampleRate, int bitrate, bool infoFrame) {
+    // MPEG-2 and 2.5 frames below 32 kHz hold half the samples
+    const int frameSamples = sampleRate >= 32000 ? 1152 : 576;
+    long long count = (frames + kLameDelaySamples + frameSamples - 1) / frameSamples + 1;
+    if (infoFrame) {
+        count++;
+    }
+    return (long long)std::llround((double)count * frameSamples * bitrate * 1000.0 / 8.0 / sampleRate);
+}
+
+long long opusBytes(double audioSeconds, int bitrate) {
+    const double packets = audioSeconds * (bitrate * 1000.0 / 8.0 + kOpusLacingBytesPerSecond);
+    return (long long)std::llround(packets + packets / kOggPageBytes * kOggPageHeaderBytes) +
+           kOpusHeaderBytes;
+}
+
+// Free bytes on the file system `path` would be created on; -1 if unknown.
+// Walks up to the nearest existing directory, as the glue creates missing
+// output directories.
+long long freeSpace(const std::string& path) {
+    std::string dir = path;
+    while (true) {
+        size_t slash = dir.find_last_of('/');
+        if (slash == std::string::npos) {
+            dir = ".";
+        } else {
+            dir = slash == 0 ? "/" : dir.substr(0, slash);
+        }
+        struct statvfs stats;
+        if (statvfs(dir.c_str(), &stats) == 0) {
+            return (long long)stats.f_bavail * (long long)stats.f_frsize;
+        }
+        if (dir == "/" || dir == ".") {
+            return -1;
+        }
+    }
+}
+
+// Probes `path`, or describes it as raw PCM in options.rawFormat as
+// convertFile() would read it.
+int probeInput(const std::string& path, const ConversionOptions& options, MediaInfo* info,
+               std::string* errorCode, std::string* error) {
+    if (probeFile(path, info, error) == 0) {
+        return 0;
+    }
+    std::string rawError;
+    std::unique_ptr<AudioSource> source = openAudioSource(path, options.rawFormat, &rawError);
+    if (!source || source->totalFrames() < 0) {
+        *errorCode = kErrorWav;
+        return -1;
+    }
+    const AudioFormat& format = source->format();
+    *info = MediaInfo();
+    info->container = "raw";
+    info->codec = "pcm";
+    info->sampleRate = format.sampleRate;
+    info->channels = format.channels;
+    info->bitsPerSample = bytesPerSample(format.sampleFormat) * 8;
+    info->bitrate = (int)std::lround((double)format.sampleRate * format.channels * info->bitsPerSample / 1000.0);
+    info->frames = source->totalFrames();
+    info->durationMs = info->frames * 1000.0 / format.sampleRate;
+    error->clear();
+    return 0;
+}
+
+}  // namespace
+
+int estimateConversion(const std::string& inputPath, const std::string& outputPath,
+                       const ConversionOptions& options, ConversionEstimate* estimate,
+                       std::string* errorCode, std::string* error) {
+    *estimate = ConversionEstimate();
+    if (access(inputPath.c_str(), R_OK) != 0) {
+        *errorCode = kErrorFile;
+        *error = "Failed to open input file: " + inputPath;
+        return -1;
+    }
+    if (probeInput(inputPath, options, &estimate->input, errorCode, error) != 0) {
+        return -1;
+    }
+    const MediaInfo& input = estimate->input;
+    if (input.sampleRate <= 0 || input.channels < 1) {
+        *errorCode = kErrorWav;
+        *error = "Unknown stream parameters: " + inputPath;
+        return -1;
+    }
+    const double audioSeconds = input.durationMs / 1000.0;
+    const long long frames =
+        input.frames >= 0 ? input.frames : (long long)std::llround(audioSeconds * input.sampleRate);
+
+    EncoderConfig config;
+    config.format = options.format;
+    config.sampleRate = encoderSampleRate(options.format, input.sampleRate);
+    config.channels = std::min(input.channels, 2);
+    config.bitrate = options.bitrate > 0 ? options.bitrate : defaultBitrate(options.format);
+    config.quality = options.quality;
+    const SizeLimitOptions& limit = options.sizeLimit;
+    if (limit.enabled()) {
+        config.sampleRate = sizeLimitSampleRate(options.format, config.sampleRate);
+        config.bitrate = sizeLimitCeiling(limit, options.bitrate, options.format);
+    }
+    estimate->encoder = options.format == OutputFormat::Opus
+                            ? "opus"
+                            : backendName(selectBackend(options.encoder, config));
+    estimate->bitrate = config.bitrate;
+    estimate->sampleRate = config.sampleRate;
+    estimate->channels = config.channels;
+
+    Calibration calibration;
+    const bool calibrated = !options.calibrationFile.empty() &&
+                            cachedCalibration(options.calibrationFile, &calibration);
+    estimate->quality = options.quality;
+    if (options.deadlineMs > 0 && calibrated) {
+        estimate->quality = qualityForBudget(calibration, options.deadlineMs, audioSeconds,
+                                             config.sampleRate, config.channels);
+    }
+
+    if (options.format == OutputFormat::Opus) {
+        estimate->outputBytes = opusBytes(audioSeconds, config.bitrate);
+    } else {
+        const long long encodedFrames =
+            (long long)std::llround((double)frames * config.sampleRate / input.sampleRate);
+        estimate->outputBytes = mp3Bytes(encodedFrames, config.sampleRate, config.bitrate,
+                                         estimate->encoder == std::string("lame"));
+    }
+    // A size limit lowers the bitrate until the output fits
+    const long long limitBytes = limit.targetBytes > 0 && (limit.maxBytes == 0 || limit.targetBytes < limit.maxBytes)
+                                     ? limit.targetBytes
+                                     : limit.maxBytes;
+    if (limitBytes > 0 && estimate->outputBytes > limitBytes && audioSeconds > 0.0) {
+        estimate->outputBytes = limitBytes;
+        estimate->bitrate = (int)(limitBytes * 8.0 / audioSeconds / 1000.0);
+    }
+    if (input.container != "wav" && input.container != "rf64" && input.container != "raw") {
+        estimate->decodedBytes = frames * input.channels * 2;
+    }
+
+    const double work = referenceSeconds(audioSeconds, config.sampleRate, config.channels);
+    double decodeMs = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        if (!options.throughputFile.empty()) {
+            const ThroughputModel& model = cachedModel(options.throughputFile);
+            auto it = model.find(modelKey(estimate->encoder, estimate->quality));
+            if (it != model.end()) {
+                estimate->elapsedMs = work / it->second.speed * 1000.0;
+                estimate->timeModel = "jobs";
+                estimate->modelJobs = it->second.jobs;
+            }
+            auto decode = model.find(kDecodeKey);
+            if (estimate->decodedBytes > 0 && decode != model.end()) {
+                decodeMs = audioSeconds / decode->second.speed * 1000.0;
+            }
+        }
+    }
+    if (estimate->timeModel.empty() && calibrated && estimate->encoder == std::string("lame")) {
+        estimate->elapsedMs = predictEncodeMs(calibration, estimate->quality, audioSeconds,
+                                              config.sampleRate, config.channels);
+        estimate->timeModel = "calibration";
+    }
+    if (estimate->elapsedMs >= 0.0) {
+        estimate->elapsedMs += decodeMs;
+    }
+
+    estimate->freeBytes = freeSpace(outputPath);
+    const long long needed = estimate->outputBytes + estimate->decodedBytes + kSpaceMarginBytes;
+    if (estimate->freeBytes >= 0 && estimate->freeBytes < needed) {
+        char message[160];
+        snprintf(message, sizeof(message), "Not enough free space: about %.1f MB needed, %.1f MB free",
+                 needed / 1e6, estimate->freeBytes / 1e6);
+        *errorCode = kErrorSpace;
+        *error = message;
+        return -1;
+    }
+    return 0;
+}
+
+void recordConversion(const ConversionOptions& options, const ConversionResult& result,
+                      double audioSeconds) {
+    if (options.throughputFile.empty() || audioSeconds < kMinModelAudioSeconds ||
+        result.elapsedMs < kMinModelElapsedMs || result.sampleRate <= 0) {
+        return;
+    }
+    const double speed = referenceSeconds(audioSeconds, result.sampleRate, result.channels) /
+                         (result.elapsedMs / 1000.0);
+    recordSpeed(options.throughputFile, modelKey(result.encoder, result.quality), speed);
+}
+
+void recordDecode(const ConversionOptions& options, double decodeMs, double audioSeconds) {
+    if (options.throughputFile.empty() || audioSeconds < kMinModelAudioSeconds ||
+        decodeMs < kMinModelElapsedMs) {
+        return;
+    }
+    recordSpeed(options.throughputFile, kDecodeKey, audioSeconds / (decodeMs / 1000.0));
+}
+
+std::string formatEstimate(const ConversionEstimate& estimate) {
+    std::string text;
+    const std::string input = formatMediaInfo(estimate.input);
+    for (size_t begin = 0; begin < input.size();) {
+        size_t end = input.find('\n', begin) + 1;
+        text += "input." + input.substr(begin, end - begin);
+        begin = end;
+    }
+    char numbers[320];
+    snprintf(numbers, sizeof(numbers),
+             "bitrate=%d\nsampleRate=%d\nchannels=%d\nquality=%d\noutputBytes=%lld\ndecodedBytes=%lld\n"
+             "freeBytes=%lld\nelapsedMs=%.1f\nmodelJobs=%d\n",
+             estimate.bitrate, estimate.sampleRate, estimate.channels, estimate.quality,
+             estimate.outputBytes, estimate.decodedBytes, estimate.freeBytes, estimate.elapsedMs,
+             estimate.modelJobs);
+    return text + "encoder=" + estimate.encoder + "\ntimeModel=" + estimate.timeModel + "\n" + numbers;
+}
+
+}  // namespace wavtomp3
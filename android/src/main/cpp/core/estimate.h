@@ -0,0 +1,69 @@
+// Output size and wall time of a conversion, predicted before it starts so
+// the app can warn about large files and long waits.
+//
+// The size follows from the probed duration and the bitrate and rate the job
+// would encode at. The time comes from a per-device model of encode speed,
+// kept per backend (and LAME quality) in options.throughputFile: every
+// finished job folds its measured speed into a moving average there (each
+// output of convertSourceMulti() the time of its whole pass), and a
+// backend no job has used yet is predicted from the device calibration
+// (LAME) or not at all. Compressed input the platform decodes first (AAC on
+// Android) adds the decode speed the model keeps under "decode", per second
+// of audio; a decode the PCM cache saves still counts, so such an estimate
+// is an upper bound too. Preset 'auto' is estimated with the settings it
+// starts from, so its estimate is an upper bound.
+#ifndef WAV_TO_MP3_ESTIMATE_H
+#define WAV_TO_MP3_ESTIMATE_H
+
+#include <string>
+
+#include "converter.h"
+#include "options.h"
+#include "probe.h"
+
+namespace wavtomp3 {
+
+// Free space a job needs beyond its predicted output
+const long long kSpaceMarginBytes = 1024 * 1024;
+
+struct ConversionEstimate {
+    MediaInfo input;
+    // Encoded stream
+    std::string encoder;
+    int bitrate = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    int quality = 0;
+    long long outputBytes = 0;
+    // 16-bit PCM a compressed input is decoded to next to the output first
+    long long decodedBytes = 0;
+    long long freeBytes = -1;  // on the output's file system; -1 if unknown
+    double elapsedMs = -1.0;   // -1: neither a finished job nor a calibration to go by
+    std::string timeModel;     // "jobs", "calibration" or empty
+    int modelJobs = 0;         // finished jobs behind a "jobs" prediction
+};
+
+// Predicts the conversion of `inputPath` into `outputPath`. Returns 0, or
+// -1 with `errorCode` set: kErrorFile or kErrorWav when the input cannot be
+// read, kErrorSpace when the output's file system has less free space than
+// the job needs.
+int estimateConversion(const std::string& inputPath, const std::string& outputPath,
+                       const ConversionOptions& options, ConversionEstimate* estimate,
+                       std::string* errorCode, std::string* error);
+
+// Folds a finished job of `audioSeconds` into the model at
+// options.throughputFile, if set. Jobs too short to time reliably are left
+// out.
+void recordConversion(const ConversionOptions& options, const ConversionResult& result,
+                      double audioSeconds);
+
+// Folds a platform decode of `audioSeconds` that took `decodeMs` into the
+// model at options.throughputFile, if set, as recordConversion() does.
+void recordDecode(const ConversionOptions& options, double decodeMs, double audioSeconds);
+
+// "key=value" lines, the input's prefixed "input." as in formatMediaInfo().
+std::string formatEstimate(const ConversionEstimate& estimate);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_ESTIMATE_H
@@ -0,0 +1,110 @@
+#include "fft.h"
+
+#include <cmath>
+#include <utility>
+
+#include "simd.h"
+
+namespace wavtomp3 {
+
+Fft::Fft(int size, int windowLength)
+    : size_(size), half_(size / 2), bitReverse_((size_t)half_), splitRe_((size_t)half_ + 1),
+      splitIm_((size_t)half_ + 1), window_((size_t)size), re_((size_t)half_), im_((size_t)half_) {
+    const double pi = 3.14159265358979323846;
+    int bits = 0;
+    while ((1 << bits) < half_) {
+        bits++;
+    }
+    for (int i = 0; i < half_; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse_[i] = reversed;
+    }
+    for (int span = 1; span < half_; span *= 2) {
+        for (int k = 0; k < span; k++) {
+            stageRe_.push_back((float)cos(-pi * k / span));
+            stageIm_.push_back((float)sin(-pi * k / span));
+        }
+    }
+    for (int k = 0; k <= half_; k++) {
+        splitRe_[k] = (float)cos(-2.0 * pi * k / size);
+        splitIm_[k] = (float)sin(-2.0 * pi * k / size);
+    }
+    if (windowLength <= 0 || windowLength > size) {
+        windowLength = size;
+    }
+    for (int i = 0; i < windowLength; i++) {
+        window_[i] = (float)(0.5 - 0.5 * cos(2.0 * pi * i / windowLength));
+    }
+}
+
+void Fft::transform(float* re, float* im) const {
+    for (int i = 0; i < half_; i++) {
+        int j = bitReverse_[i];
+        if (j > i) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    const float* twiddleRe = stageRe_.data();
+    const float* twiddleIm = stageIm_.data();
+    for (int span = 1; span < half_; twiddleRe += span, twiddleIm += span, span *= 2) {
+        for (int start = 0; start < half_; start += 2 * span) {
+            float* aRe = re + start;
+            float* aIm = im + start;
+            float* bRe = aRe + span;
+            float* bIm = aIm + span;
+            int k = 0;
+            for (; k + SIMD_WIDTH <= span; k += SIMD_WIDTH) {
+                simd_f32x4 wr = simd_load(twiddleRe + k);
+                simd_f32x4 wi = simd_load(twiddleIm + k);
+                simd_f32x4 br = simd_load(bRe + k);
+                simd_f32x4 bi = simd_load(bIm + k);
+                simd_f32x4 tr = simd_sub(simd_mul(br, wr), simd_mul(bi, wi));
+                simd_f32x4 ti = simd_add(simd_mul(br, wi), simd_mul(bi, wr));
+                simd_f32x4 ar = simd_load(aRe + k);
+                simd_f32x4 ai = simd_load(aIm + k);
+                simd_store(bRe + k, simd_sub(ar, tr));
+                simd_store(bIm + k, simd_sub(ai, ti));
+                simd_store(aRe + k, simd_add(ar, tr));
+                simd_store(aIm + k, simd_add(ai, ti));
+            }
+            // The first two stages are narrower than a vector
+            for (; k < span; k++) {
+                float tr = bRe[k] * twiddleRe[k] - bIm[k] * twiddleIm[k];
+                float ti = bRe[k] * twiddleIm[k] + bIm[k] * twiddleRe[k];
+                bRe[k] = aRe[k] - tr;
+                bIm[k] = aIm[k] - ti;
+                aRe[k] += tr;
+                aIm[k] += ti;
+            }
+        }
+    }
+}
+
+void Fft::powerSpectrum(const float* samples, float* power) {
+    // Even samples go to the real parts, odd ones to the imaginary parts
+    for (int i = 0; i < half_; i++) {
+        re_[i] = samples[2 * i] * window_[2 * i];
+        im_[i] = samples[2 * i + 1] * window_[2 * i + 1];
+    }
+    transform(re_.data(), im_.data());
+
+    // Untangle the spectra of the even and odd samples:
+    // X[k] = (Z[k] + conj(Z[n-k])) / 2 + W^k (Z[k] - conj(Z[n-k])) / 2i
+    for (int k = 0; k <= half_; k++) {
+        int j = (half_ - k) & (half_ - 1);
+        int m = k & (half_ - 1);
+        float evenRe = 0.5f * (re_[m] + re_[j]);
+        float evenIm = 0.5f * (im_[m] - im_[j]);
+        float oddRe = 0.5f * (im_[m] + im_[j]);
+        float oddIm = -0.5f * (re_[m] - re_[j]);
+        float xRe = evenRe + splitRe_[k] * oddRe - splitIm_[k] * oddIm;
+        float xIm = evenIm + splitRe_[k] * oddIm + splitIm_[k] * oddRe;
+        power[k] = xRe * xRe + xIm * xIm;
+    }
+}
+
+}  // namespace wavtomp3
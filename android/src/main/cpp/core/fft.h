@@ -0,0 +1,41 @@
+// Real-input FFT for the analysis passes (content classification, log-mel
+// features, fingerprints).
+#ifndef WAV_TO_MP3_FFT_H
+#define WAV_TO_MP3_FFT_H
+
+#include <vector>
+
+namespace wavtomp3 {
+
+// Transforms `size` real samples as a complex FFT of size / 2 points in split
+// (planar) form, whose butterflies run four at a time on the SIMD layer.
+class Fft {
+public:
+    // `size` must be a power of two, at least 8. The Hann window spans the
+    // first `windowLength` samples (0: all of them); the rest is zero padding.
+    explicit Fft(int size, int windowLength = 0);
+
+    int size() const { return size_; }
+
+    // Windowed power spectrum of `size` real samples: size / 2 + 1 bins.
+    void powerSpectrum(const float* samples, float* power);
+
+private:
+    // In-place complex FFT of size / 2 points.
+    void transform(float* re, float* im) const;
+
+    int size_;
+    int half_;
+    std::vector<int> bitReverse_;   // half_ entries
+    std::vector<float> stageRe_;    // twiddles of every stage, concatenated
+    std::vector<float> stageIm_;
+    std::vector<float> splitRe_;    // exp(-2 pi i k / size), k = 0 .. half_
+    std::vector<float> splitIm_;
+    std::vector<float> window_;
+    std::vector<float> re_;
+    std::vector<float> im_;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_FFT_H
@@ -0,0 +1,402 @@
+#include "filter_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "log.h"
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+// Frames per gain decision of the gate and compressor
+const int kControlFrames = 32;
+const double kDcCutoffHz = 10.0;
+// Butterworth sections of a 4th-order filter
+const double kButterworthQ[2] = {0.5411961001461971, 1.3065629648763766};
+const double kGateFloorDb = -80.0;
+const int kGateAttackMs = 1;
+const int kGateHoldMs = 50;
+const int kGateReleaseMs = 100;
+
+float dbToGain(double db) {
+    return (float)pow(10.0, db / 20.0);
+}
+
+// Per-control-block smoothing factor for a time constant of `ms`
+float smoothing(int ms, int sampleRate) {
+    if (ms <= 0) {
+        return 1.0f;
+    }
+    return (float)(1.0 - exp(-(double)kControlFrames * 1000.0 / ((double)ms * sampleRate)));
+}
+
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+};
+
+// RBJ cookbook high- or low-pass
+Biquad passBiquad(bool highpass, double hz, double q, int sampleRate) {
+    const double w0 = 2.0 * kPi * hz / sampleRate;
+    const double cosw = cos(w0);
+    const double alpha = sin(w0) / (2.0 * q);
+    const double a0 = 1.0 + alpha;
+    Biquad f;
+    f.b0 = (highpass ? (1.0 + cosw) : (1.0 - cosw)) / 2.0 / a0;
+    f.b1 = (highpass ? -(1.0 + cosw) : (1.0 - cosw)) / a0;
+    f.b2 = f.b0;
+    f.a1 = -2.0 * cosw / a0;
+    f.a2 = (1.0 - alpha) / a0;
+    return f;
+}
+
+// Biquads in series, each run over the whole block before the next so the
+// block stays in L1.
+class BiquadCascade : public FilterStage {
+public:
+    BiquadCascade(const char* name, const std::vector<Biquad>& biquads, int channels)
+        : name_(name), channels_(channels) {
+        for (const Biquad& biquad : biquads) {
+            sections_.push_back(makeSection(biquad));
+        }
+        reset();
+    }
+
+    const char* name() const override { return name_; }
+
+    void process(float* const* channels, long frames) override {
+        for (int c = 0; c < channels_; c++) {
+            for (size_t s = 0; s < sections_.size(); s++) {
+                run(sections_[s], channels[c], frames, &state_[(c * sections_.size() + s) * 2]);
+            }
+        }
+    }
+
+    void reset() override { state_.assign(sections_.size() * channels_ * 2, 0.0f); }
+
+private:
+    struct Section {
+        float b0, b1, b2, a1, a2;
+        float input[4][4];  // input[j][k]: weight of x[n+j] in y[n+k]
+        float state[2][4];  // state[i][k]: weight of state i in y[n+k]
+    };
+
+    // Transposed direct form II: y = b0 x + s1, s1' = b1 x - a1 y + s2,
+    // s2' = b2 x - a2 y. The 4-sample weights come from running it on unit
+    // inputs and states.
+    static Section makeSection(const Biquad& f) {
+        Section s;
+        s.b0 = (float)f.b0;
+        s.b1 = (float)f.b1;
+        s.b2 = (float)f.b2;
+        s.a1 = (float)f.a1;
+        s.a2 = (float)f.a2;
+        double impulse[4];
+        double s1 = 0.0, s2 = 0.0;
+        for (int k = 0; k < 4; k++) {
+            const double x = k == 0 ? 1.0 : 0.0;
+            const double y = f.b0 * x + s1;
+            s1 = f.b1 * x - f.a1 * y + s2;
+            s2 = f.b2 * x - f.a2 * y;
+            impulse[k] = y;
+        }
+        for (int j = 0; j < 4; j++) {
+            for (int k = 0; k < 4; k++) {
+                s.input[j][k] = k >= j ? (float)impulse[k - j] : 0.0f;
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            s1 = i == 0 ? 1.0 : 0.0;
+            s2 = i == 1 ? 1.0 : 0.0;
+            for (int k = 0; k < 4; k++) {
+                const double y = s1;
+                s1 = -f.a1 * y + s2;
+                s2 = -f.a2 * y;
+                s.state[i][k] = (float)y;
+            }
+        }
+        return s;
+    }
+
+    static void run(const Section& s, float* x, long frames, float* z) {
+        const simd_f32x4 in0 = simd_load(s.input[0]);
+        const simd_f32x4 in1 = simd_load(s.input[1]);
+        const simd_f32x4 in2 = simd_load(s.input[2]);
+        const simd_f32x4 in3 = simd_load(s.input[3]);
+        const simd_f32x4 st1 = simd_load(s.state[0]);
+        const simd_f32x4 st2 = simd_load(s.state[1]);
+        float s1 = z[0];
+        float s2 = z[1];
+        long i = 0;
+        for (; i + 4 <= frames; i += 4) {
+            const float x2 = x[i + 2];
+            const float x3 = x[i + 3];
+            simd_f32x4 y = simd_mul(simd_set1(x[i]), in0);
+            y = simd_madd(simd_set1(x[i + 1]), in1, y);
+            y = simd_madd(simd_set1(x2), in2, y);
+            y = simd_madd(simd_set1(x3), in3, y);
+            y = simd_madd(simd_set1(s1), st1, y);
+            y = simd_madd(simd_set1(s2), st2, y);
+            simd_store(x + i, y);
+            const float y2 = x[i + 2];
+            const float y3 = x[i + 3];
+            s1 = s.b1 * x3 - s.a1 * y3 + (s.b2 * x2 - s.a2 * y2);
+            s2 = s.b2 * x3 - s.a2 * y3;
+        }
+        for (; i < frames; i++) {
+            const float in = x[i];
+            const float y = s.b0 * in + s1;
+            s1 = s.b1 * in - s.a1 * y + s2;
+            s2 = s.b2 * in - s.a2 * y;
+            x[i] = y;
+        }
+        // Decaying states would otherwise end up denormal in silence
+        z[0] = std::fabs(s1) < 1e-20f ? 0.0f : s1;
+        z[1] = std::fabs(s2) < 1e-20f ? 0.0f : s2;
+    }
+
+    const char* name_;
+    const int channels_;
+    std::vector<Section> sections_;
+    std::vector<float> state_;  // s1, s2 per section per channel
+};
+
+// Gain decided every kControlFrames from the block's peak over all
+// channels, ramped to from the previous decision.
+class DynamicsStage : public FilterStage {
+public:
+    explicit DynamicsStage(int channels) : channels_(channels) {}
+
+    void process(float* const* channels, long frames) override {
+        for (long start = 0; start < frames; start += kControlFrames) {
+            const long count = std::min((long)kControlFrames, frames - start);
+            float peak = 0.0f;
+            for (int c = 0; c < channels_; c++) {
+                peak = std::max(peak, blockPeak(channels[c] + start, count));
+            }
+            const float gain = nextGain(peak);
+            for (int c = 0; c < channels_; c++) {
+                applyGainRamp(channels[c] + start, (size_t)count, 1, gain_, gain);
+            }
+            gain_ = gain;
+        }
+    }
+
+    void reset() override { gain_ = 1.0f; }
+
+protected:
+    virtual float nextGain(float peak) = 0;
+
+    float gain_ = 1.0f;
+
+private:
+    static float blockPeak(const float* x, long count) {
+        simd_f32x4 peak = simd_zero();
+        long i = 0;
+        for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+            peak = simd_max(peak, simd_abs(simd_load(x + i)));
+        }
+        float result = simd_hmax(peak);
+        for (; i < count; i++) {
+            result = std::max(result, std::fabs(x[i]));
+        }
+        return result;
+    }
+
+    const int channels_;
+};
+
+class NoiseGate : public DynamicsStage {
+public:
+    NoiseGate(double thresholdDb, int sampleRate, int channels)
+        : DynamicsStage(channels), threshold_(dbToGain(thresholdDb)), floor_(dbToGain(kGateFloorDb)),
+          attack_(smoothing(kGateAttackMs, sampleRate)), release_(smoothing(kGateReleaseMs, sampleRate)),
+          holdBlocks_(kGateHoldMs * sampleRate / 1000 / kControlFrames) {}
+
+    const char* name() const override { return "gate"; }
+
+    void reset() override {
+        DynamicsStage::reset();
+        hold_ = 0;
+    }
+
+protected:
+    float nextGain(float peak) override {
+        if (peak >= threshold_) {
+            hold_ = holdBlocks_;
+        } else if (hold_ > 0) {
+            hold_--;
+        }
+        const bool open = peak >= threshold_ || hold_ > 0;
+        const float target = open ? 1.0f : floor_;
+        return gain_ + (target - gain_) * (open ? attack_ : release_);
+    }
+
+private:
+    const float threshold_;
+    const float floor_;
+    const float attack_;
+    const float release_;
+    const int holdBlocks_;
+    int hold_ = 0;
+};
+
+class Compressor : public DynamicsStage {
+public:
+    Compressor(const CompressorOptions& options, int sampleRate, int channels)
+        : DynamicsStage(channels), thresholdDb_((float)options.thresholdDb),
+          slope_((float)(1.0 - 1.0 / options.ratio)), makeupDb_((float)options.makeupDb),
+          attack_(smoothing(options.attackMs, sampleRate)), release_(smoothing(options.releaseMs, sampleRate)) {
+        reset();
+    }
+
+    const char* name() const override { return "compressor"; }
+
+    void reset() override {
+        DynamicsStage::reset();
+        envelope_ = 0.0f;
+        gain_ = dbToGain(makeupDb_);
+    }
+
+protected:
+    float nextGain(float peak) override {
+        envelope_ += (peak - envelope_) * (peak > envelope_ ? attack_ : release_);
+        const float levelDb = 20.0f * log10f(std::max(envelope_, 1e-9f));
+        const float over = levelDb - thresholdDb_;
+        return dbToGain((over > 0.0f ? -over * slope_ : 0.0f) + makeupDb_);
+    }
+
+private:
+    const float thresholdDb_;
+    const float slope_;
+    const float makeupDb_;
+    const float attack_;
+    const float release_;
+    float envelope_ = 0.0f;
+};
+
+class Gain : public FilterStage {
+public:
+    Gain(double gainDb, int channels) : gain_(dbToGain(gainDb)), channels_(channels) {}
+
+    const char* name() const override { return "gain"; }
+
+    void process(float* const* channels, long frames) override {
+        for (int c = 0; c < channels_; c++) {
+            applyGainRamp(channels[c], (size_t)frames, 1, gain_, gain_);
+        }
+    }
+
+    void reset() override {}
+
+private:
+    const float gain_;
+    const int channels_;
+};
+
+}  // namespace
+
+FilterGraph::FilterGraph(const FilterOptions& options, int sampleRate, int channels)
+    : channels_(channels), planes_((size_t)channels) {
+    const double nyquist = sampleRate / 2.0;
+    if (options.dcRemoval) {
+        // One pole at 10 Hz and a zero at DC
+        const double pole = exp(-2.0 * kPi * kDcCutoffHz / sampleRate);
+        stages_.emplace_back(new BiquadCascade("dcRemoval", {{1.0, -1.0, 0.0, -pole, 0.0}}, channels));
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        const bool highpass = pass == 0;
+        const int hz = highpass ? options.highpassHz : options.lowpassHz;
+        if (hz <= 0) {
+            continue;
+        }
+        if (hz >= nyquist) {
+            LOGW("Ignoring filters.%s %d Hz at %d Hz", highpass ? "highpassHz" : "lowpassHz", hz, sampleRate);
+            continue;
+        }
+        std::vector<Biquad> biquads;
+        for (double q : kButterworthQ) {
+            biquads.push_back(passBiquad(highpass, hz, q, sampleRate));
+        }
+        stages_.emplace_back(new BiquadCascade(highpass ? "highpass" : "lowpass", biquads, channels));
+    }
+    if (options.gateDb < 0.0) {
+        stages_.emplace_back(new NoiseGate(options.gateDb, sampleRate, channels));
+    }
+    if (options.compressor.enabled()) {
+        stages_.emplace_back(new Compressor(options.compressor, sampleRate, channels));
+    }
+    if (options.gainDb != 0.0) {
+        stages_.emplace_back(new Gain(options.gainDb, channels));
+    }
+    stageMs_.assign(stages_.size(), 0.0);
+}
+
+void FilterGraph::process(float* pcm, long frames) {
+    if (stages_.empty() || frames <= 0) {
+        return;
+    }
+    // Mono is filtered in place; other layouts through one buffer per channel
+    if (channels_ == 1) {
+        planes_[0] = pcm;
+    } else {
+        planar_.resize((size_t)frames * channels_);
+        for (int c = 0; c < channels_; c++) {
+            planes_[c] = planar_.data() + (size_t)c * frames;
+            for (long i = 0; i < frames; i++) {
+                planes_[c][i] = pcm[i * channels_ + c];
+            }
+        }
+    }
+    for (size_t s = 0; s < stages_.size(); s++) {
+        auto start = std::chrono::steady_clock::now();
+        stages_[s]->process(planes_.data(), frames);
+        stageMs_[s] += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    if (channels_ != 1) {
+        for (int c = 0; c < channels_; c++) {
+            for (long i = 0; i < frames; i++) {
+                pcm[i * channels_ + c] = planes_[c][i];
+            }
+        }
+    }
+}
+
+void FilterGraph::reset() {
+    for (auto& stage : stages_) {
+        stage->reset();
+    }
+}
+
+std::vector<std::pair<std::string, double>> FilterGraph::stats() const {
+    std::vector<std::pair<std::string, double>> stats;
+    for (size_t s = 0; s < stages_.size(); s++) {
+        stats.emplace_back(stages_[s]->name(), stageMs_[s]);
+    }
+    return stats;
+}
+
+FilteredSource::FilteredSource(AudioSource* source, const FilterOptions& options)
+    : source_(source), graph_(options, source->format().sampleRate, source->format().channels) {}
+
+long FilteredSource::read(float* out, long maxFrames) {
+    long frames = source_->read(out, maxFrames);
+    if (frames > 0) {
+        graph_.process(out, frames);
+    }
+    return frames;
+}
+
+int FilteredSource::seek(long long frame) {
+    if (source_->seek(frame) != 0) {
+        return -1;
+    }
+    graph_.reset();
+    return 0;
+}
+
+}  // namespace wavtomp3
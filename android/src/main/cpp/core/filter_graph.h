@@ -0,0 +1,99 @@
+// Preprocessing between decoding and encoding: DC removal, high/low-pass,
+// noise gate, compressor and gain, in that order. The same code runs on
+// every platform, so a job sounds the same whichever encoder it ends up on.
+//
+// Blocks are split into one buffer per channel. Biquads run four samples at
+// a time: each output of a 4-sample step is a fixed combination of the four
+// inputs and the two filter states, so a step costs six vector
+// multiply-adds plus a scalar state update. The gate and compressor decide
+// their gain every 32 frames and ramp to it, with the detector linked
+// across channels.
+#ifndef WAV_TO_MP3_FILTER_GRAPH_H
+#define WAV_TO_MP3_FILTER_GRAPH_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio_source.h"
+
+namespace wavtomp3 {
+
+struct CompressorOptions {
+    double thresholdDb = 0.0;  // 0: off
+    double ratio = 4.0;
+    int attackMs = 10;
+    int releaseMs = 100;
+    double makeupDb = 0.0;
+
+    bool enabled() const { return thresholdDb < 0.0; }
+};
+
+struct FilterOptions {
+    bool dcRemoval = false;
+    int highpassHz = 0;   // 4th-order Butterworth; 0: off
+    int lowpassHz = 0;    // 4th-order Butterworth; 0: off
+    double gateDb = 0.0;  // gate threshold; 0: off
+    CompressorOptions compressor;
+    double gainDb = 0.0;
+
+    bool enabled() const {
+        return dcRemoval || highpassHz > 0 || lowpassHz > 0 || gateDb < 0.0 || compressor.enabled() ||
+               gainDb != 0.0;
+    }
+};
+
+// One step of the graph, working in place on one buffer per channel.
+class FilterStage {
+public:
+    virtual ~FilterStage() = default;
+
+    virtual const char* name() const = 0;
+    virtual void process(float* const* channels, long frames) = 0;
+    virtual void reset() = 0;
+};
+
+class FilterGraph {
+public:
+    FilterGraph(const FilterOptions& options, int sampleRate, int channels);
+
+    bool empty() const { return stages_.empty(); }
+
+    // Filters `frames` interleaved frames in place.
+    void process(float* pcm, long frames);
+
+    // Clears the filter states, e.g. after a seek.
+    void reset();
+
+    // Time spent in each stage so far, in milliseconds.
+    std::vector<std::pair<std::string, double>> stats() const;
+
+private:
+    const int channels_;
+    std::vector<std::unique_ptr<FilterStage>> stages_;
+    std::vector<double> stageMs_;
+    std::vector<float> planar_;
+    std::vector<float*> planes_;
+};
+
+// `source` read through a FilterGraph.
+class FilteredSource : public AudioSource {
+public:
+    FilteredSource(AudioSource* source, const FilterOptions& options);
+
+    const AudioFormat& format() const override { return source_->format(); }
+    long long totalFrames() const override { return source_->totalFrames(); }
+    long read(float* out, long maxFrames) override;
+    int seek(long long frame) override;
+
+    const FilterGraph& graph() const { return graph_; }
+
+private:
+    AudioSource* source_;
+    FilterGraph graph_;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_FILTER_GRAPH_H
@@ -0,0 +1,184 @@
+#include "fingerprint.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "base64.h"
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kFftSize = 4096;
+const int kHop = 128;
+const int kVersion = 1;
+const int kHeaderBytes = 12;
+const int kBands = 21;
+const double kMinBandHz = 300.0;
+const double kMaxBandHz = 2000.0;
+const double kMinChromaHz = 100.0;
+const double kMaxChromaHz = 3500.0;
+const float kFloor = 1e-10f;
+// Alignment searched by compareFingerprints(), in frames (10 s)
+const int kMaxShift = 10 * kFingerprintSampleRate / kHop;
+// Shortest overlap compared, in frames (about 1 s)
+const int kMinOverlap = 20;
+
+float sumRange(const float* x, int count) {
+    simd_f32x4 sum = simd_zero();
+    int i = 0;
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        sum = simd_add(sum, simd_load(x + i));
+    }
+    float total = simd_hsum(sum);
+    for (; i < count; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+unsigned readLe32(const unsigned char* p) {
+    return (unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+int parseFingerprint(const std::string& text, std::vector<uint32_t>* codes, std::string* error) {
+    std::vector<unsigned char> bytes;
+    if (!decodeBase64(text, &bytes) || bytes.size() < kHeaderBytes || memcmp(bytes.data(), "AFPR", 4) != 0) {
+        *error = "Not a fingerprint";
+        return -1;
+    }
+    if ((bytes[4] | (bytes[5] << 8)) != kVersion) {
+        *error = "Unsupported fingerprint version";
+        return -1;
+    }
+    const size_t count = readLe32(bytes.data() + 8);
+    if (bytes.size() < kHeaderBytes + count * 4) {
+        *error = "Truncated fingerprint";
+        return -1;
+    }
+    codes->resize(count);
+    for (size_t i = 0; i < count; i++) {
+        (*codes)[i] = readLe32(bytes.data() + kHeaderBytes + i * 4);
+    }
+    return 0;
+}
+
+}  // namespace
+
+FingerprintSink::FingerprintSink()
+    : fft_(kFftSize), chromaClass_(kFftSize / 2 + 1, -1), power_(kFftSize / 2 + 1),
+      energies_(kBands + 12), previous_(kBands + 12) {
+    const double binHz = (double)kFingerprintSampleRate / kFftSize;
+    for (int i = 0; i <= kBands; i++) {
+        const double hz = kMinBandHz * pow(kMaxBandHz / kMinBandHz, (double)i / kBands);
+        bandBins_.push_back((int)lround(hz / binHz));
+    }
+    for (int k = 1; k <= kFftSize / 2; k++) {
+        const double hz = k * binHz;
+        if (hz >= kMinChromaHz && hz <= kMaxChromaHz) {
+            // Semitones from A4, folded to 0-11
+            const long semitone = lround(12.0 * log2(hz / 440.0));
+            chromaClass_[(size_t)k] = (int)(((semitone % 12) + 12) % 12);
+        }
+    }
+}
+
+void FingerprintSink::computeFrame(const float* samples) {
+    fft_.powerSpectrum(samples, power_.data());
+    for (int band = 0; band < kBands; band++) {
+        const int first = bandBins_[(size_t)band];
+        const float energy = sumRange(power_.data() + first, bandBins_[(size_t)band + 1] - first);
+        energies_[(size_t)band] = logf(energy > kFloor ? energy : kFloor);
+    }
+    float chroma[12] = {};
+    for (size_t k = 0; k < power_.size(); k++) {
+        if (chromaClass_[k] >= 0) {
+            chroma[chromaClass_[k]] += power_[k];
+        }
+    }
+    for (int c = 0; c < 12; c++) {
+        energies_[(size_t)kBands + c] = logf(chroma[c] > kFloor ? chroma[c] : kFloor);
+    }
+
+    if (hasPrevious_) {
+        const float* e = energies_.data();
+        const float* p = previous_.data();
+        uint32_t code = 0;
+        for (int band = 0; band + 1 < kBands; band++) {
+            if ((e[band] - e[band + 1]) - (p[band] - p[band + 1]) > 0.0f) {
+                code |= 1u << band;
+            }
+        }
+        e += kBands;
+        p += kBands;
+        for (int c = 0; c < 12; c++) {
+            const int next = (c + 1) % 12;
+            if ((e[c] - e[next]) - (p[c] - p[next]) > 0.0f) {
+                code |= 1u << (kBands - 1 + c);
+            }
+        }
+        codes_.push_back(code);
+    }
+    previous_.swap(energies_);
+    hasPrevious_ = true;
+}
+
+int FingerprintSink::write(const float* mono, long frames, std::string* /*error*/) {
+    pending_.insert(pending_.end(), mono, mono + frames);
+    size_t offset = 0;
+    for (; offset + kFftSize <= pending_.size(); offset += kHop) {
+        computeFrame(pending_.data() + offset);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + (long)offset);
+    return 0;
+}
+
+int FingerprintSink::finish(std::string* /*error*/) {
+    data_.assign(kHeaderBytes + codes_.size() * 4, 0);
+    unsigned char* p = data_.data();
+    memcpy(p, "AFPR", 4);
+    p[4] = kVersion;
+    const uint32_t count = (uint32_t)codes_.size();
+    memcpy(p + 8, &count, 4);
+    // Host order; every supported target is little-endian
+    memcpy(p + kHeaderBytes, codes_.data(), codes_.size() * 4);
+    return 0;
+}
+
+int compareFingerprints(const std::string& a, const std::string& b, double* similarity, std::string* error) {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> second;
+    if (parseFingerprint(a, &first, error) != 0 || parseFingerprint(b, &second, error) != 0) {
+        return -1;
+    }
+    const long na = (long)first.size();
+    const long nb = (long)second.size();
+    long minOverlap = (na < nb ? na : nb) / 2;
+    minOverlap = minOverlap > kMinOverlap ? minOverlap : kMinOverlap;
+    if (na < minOverlap || nb < minOverlap) {
+        *error = "Fingerprint too short to compare";
+        return -1;
+    }
+
+    // Lowest bit error rate over the shifts of `second` against `first`
+    double best = 1.0;
+    for (long shift = -kMaxShift; shift <= kMaxShift; shift++) {
+        const long begin = shift < 0 ? -shift : 0;
+        const long end = na < nb - shift ? na : nb - shift;
+        if (end - begin < minOverlap) {
+            continue;
+        }
+        long long errors = 0;
+        for (long i = begin; i < end; i++) {
+            errors += __builtin_popcount(first[(size_t)i] ^ second[(size_t)(i + shift)]);
+        }
+        const double rate = (double)errors / (32.0 * (double)(end - begin));
+        best = rate < best ? rate : best;
+    }
+    const double score = 1.0 - 2.0 * best;
+    *similarity = score > 0.0 ? score : 0.0;
+    return 0;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,61 @@
+// Perceptual fingerprint computed from the encode loop's mono PCM, so the
+// same recording imported in other containers or bitrates can be found
+// without decoding it again.
+//
+// Every 128 samples of 11025 Hz mono (11.6 ms) yield a 32-bit sub-fingerprint
+// from a 4096-point spectrum: bits 0-19 are the signs of the band-to-band
+// log-energy differences of 21 bands from 300 to 2000 Hz, compared with the
+// previous frame, and bits 20-31 the same for the 12 chroma (pitch class)
+// bins. Re-encoding flips few bits while unrelated audio flips about half.
+//
+// Serialized little-endian: "AFPR", u16 version (1), u16 reserved (0),
+// u32 count, then the sub-fingerprints as u32.
+#ifndef WAV_TO_MP3_FINGERPRINT_H
+#define WAV_TO_MP3_FINGERPRINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fft.h"
+#include "pcm_sink.h"
+
+namespace wavtomp3 {
+
+const int kFingerprintSampleRate = 11025;
+
+class FingerprintSink : public PcmSink {
+public:
+    FingerprintSink();
+
+    int sampleRate() const override { return kFingerprintSampleRate; }
+    int write(const float* mono, long frames, std::string* error) override;
+    int finish(std::string* error) override;
+
+    // Serialized fingerprint; valid after finish().
+    const std::vector<unsigned char>& data() const { return data_; }
+
+private:
+    void computeFrame(const float* samples);
+
+    Fft fft_;
+    std::vector<int> bandBins_;     // first bin of each band, and the end
+    std::vector<int> chromaClass_;  // pitch class of each bin, -1 if unused
+    std::vector<float> pending_;
+    std::vector<float> power_;
+    std::vector<float> energies_;   // log band energies, then chroma
+    std::vector<float> previous_;
+    bool hasPrevious_ = false;
+    std::vector<uint32_t> codes_;
+    std::vector<unsigned char> data_;
+};
+
+// Similarity of two base64 fingerprints (ConversionResult::fingerprint) at
+// their best alignment within 10 s: 1 for the same audio, about 0 for
+// unrelated audio. Returns 0, or -1 with a message in `error` if either is
+// not a fingerprint or they are too short to compare.
+int compareFingerprints(const std::string& a, const std::string& b, double* similarity, std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_FINGERPRINT_H
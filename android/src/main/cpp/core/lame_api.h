@@ -0,0 +1,11 @@
+// LAME comes from the LAME-xcframework pod on iOS and from source elsewhere.
+#ifndef WAV_TO_MP3_LAME_API_H
+#define WAV_TO_MP3_LAME_API_H
+
+#if __has_include(<LAME/lame.h>)
+#include <LAME/lame.h>
+#else
+#include <lame.h>
+#endif
+
+#endif  // WAV_TO_MP3_LAME_API_H
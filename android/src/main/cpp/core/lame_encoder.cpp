@@ -0,0 +1,110 @@
+#include "encoder.h"
+#include "lame_api.h"
+#include "log.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+class LameMp3Encoder : public Encoder {
+public:
+    ~LameMp3Encoder() override {
+        if (gfp_) {
+            lame_close(gfp_);
+        }
+    }
+
+    const char* name() const override { return "lame"; }
+
+    int open(const EncoderConfig& config, std::string* error) override {
+        gfp_ = lame_init();
+        if (!gfp_) {
+            *error = "Failed to initialize LAME";
+            return -1;
+        }
+        channels_ = config.channels;
+
+        lame_set_num_channels(gfp_, config.channels);
+        lame_set_in_samplerate(gfp_, config.sampleRate);
+        lame_set_brate(gfp_, config.bitrate);
+        lame_set_quality(gfp_, config.quality);
+        lame_set_VBR(gfp_, vbr_off);
+        if (config.lowpassHz >= 0) {
+            lame_set_lowpassfreq(gfp_, config.lowpassHz);
+        }
+        if (config.highpassHz >= 0) {
+            lame_set_highpassfreq(gfp_, config.highpassHz);
+        }
+        if (config.independentFrames) {
+            lame_set_disable_reservoir(gfp_, 1);
+            lame_set_bWriteVbrTag(gfp_, 0);
+            lame_set_out_samplerate(gfp_, config.sampleRate);
+        }
+        LOGI("LAME: %d Hz, %d ch, %d kbps, quality %d", config.sampleRate, config.channels,
+             config.bitrate, config.quality);
+
+        if (lame_init_params(gfp_) < 0) {
+            *error = "Failed to initialize LAME parameters";
+            return -1;
+        }
+        return 0;
+    }
+
+    int encode(const float* pcm, int frames, std::vector<unsigned char>* out) override {
+        // Worst case according to lame.h: 1.25 * samples + 7200
+        buffer_.resize((size_t)frames * 5 / 4 + 7200);
+        int written;
+        if (channels_ == 1) {
+            written = lame_encode_buffer_ieee_float(gfp_, pcm, nullptr, frames,
+                                                    buffer_.data(), (int)buffer_.size());
+        } else {
+            written = lame_encode_buffer_interleaved_ieee_float(gfp_, pcm, frames,
+                                                                buffer_.data(), (int)buffer_.size());
+        }
+        if (written < 0) {
+            LOGE("lame_encode_buffer failed: %d", written);
+            return -1;
+        }
+        out->insert(out->end(), buffer_.begin(), buffer_.begin() + written);
+        return 0;
+    }
+
+    int finish(std::vector<unsigned char>* out) override {
+        buffer_.resize(7200);
+        int written = lame_encode_flush(gfp_, buffer_.data(), (int)buffer_.size());
+        if (written < 0) {
+            LOGE("lame_encode_flush failed: %d", written);
+            return -1;
+        }
+        out->insert(out->end(), buffer_.begin(), buffer_.begin() + written);
+        return 0;
+    }
+
+    bool finalHeader(std::vector<unsigned char>* header) override {
+        // LAME reserves the first frame for the Xing/Info tag; fill it in so
+        // players get the frame count, seek table and gapless delay/padding.
+        header->resize(2880);
+        size_t size = lame_get_lametag_frame(gfp_, header->data(), header->size());
+        header->resize(size);
+        return size > 0;
+    }
+
+    bool framing(int* frameSamples, int* delaySamples) const override {
+        *frameSamples = lame_get_framesize(gfp_);
+        *delaySamples = lame_get_encoder_delay(gfp_);
+        return true;
+    }
+
+private:
+    lame_global_flags* gfp_ = nullptr;
+    int channels_ = 0;
+    std::vector<unsigned char> buffer_;
+};
+
+}  // namespace
+
+std::unique_ptr<Encoder> createLameEncoder() {
+    return std::unique_ptr<Encoder>(new LameMp3Encoder());
+}
+
+}  // namespace wavtomp3
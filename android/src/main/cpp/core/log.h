@@ -0,0 +1,24 @@
+// Logging macros shared by the native core and the platform glue.
+#ifndef WAV_TO_MP3_LOG_H
+#define WAV_TO_MP3_LOG_H
+
+#define LOG_TAG "WavToMp3"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+// Info logging is compiled out of host tools unless explicitly requested.
+#ifdef WAV_TO_MP3_VERBOSE
+#define LOGI(...) (fprintf(stderr, LOG_TAG " I: " __VA_ARGS__), fputc('\n', stderr))
+#else
+#define LOGI(...) ((void)0)
+#endif
+#define LOGW(...) (fprintf(stderr, LOG_TAG " W: " __VA_ARGS__), fputc('\n', stderr))
+#define LOGE(...) (fprintf(stderr, LOG_TAG " E: " __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+#endif  // WAV_TO_MP3_LOG_H
@@ -0,0 +1,218 @@
+#include "log_mel.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kFftSize = 512;
+const int kWindow = 400;  // 25 ms
+const int kHop = 160;     // 10 ms
+const int kVersion = 1;
+const double kMinHz = 20.0;
+const double kMaxHz = 8000.0;
+const float kFloor = 1e-10f;
+
+double hzToMel(double hz) { return 2595.0 * log10(1.0 + hz / 700.0); }
+double melToHz(double mel) { return 700.0 * (pow(10.0, mel / 2595.0) - 1.0); }
+
+void putLe16(unsigned char* p, unsigned value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+void putLe32(unsigned char* p, unsigned value) {
+    putLe16(p, value & 0xffff);
+    putLe16(p + 2, value >> 16);
+}
+
+void buildHeader(int bands, long long frames, unsigned char* header) {
+    memcpy(header, "LMEL", 4);
+    putLe16(header + 4, kVersion);
+    putLe16(header + 6, (unsigned)bands);
+    putLe32(header + 8, kLogMelSampleRate);
+    putLe16(header + 12, kHop);
+    putLe16(header + 14, kWindow);
+    putLe32(header + 16, (unsigned)frames);
+}
+
+// IEEE binary16, rounded to nearest even. Log energies are finite and far
+// from the half range, so infinities and NaNs are not special-cased.
+unsigned toHalf(float value) {
+    unsigned bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const unsigned sign = (bits >> 16) & 0x8000;
+    const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned mantissa = bits & 0x7fffff;
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    int shift = 13;
+    unsigned half;
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+        // Subnormal
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    } else {
+        half = ((unsigned)exponent << 10) | (mantissa >> shift);
+    }
+    const unsigned rest = mantissa & ((1u << shift) - 1);
+    const unsigned halfway = 1u << (shift - 1);
+    // A carry out of the mantissa correctly bumps the exponent
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+}  // namespace
+
+LogMelSink::LogMelSink(const std::string& path, bool keepData, int bands)
+    : path_(path), keepData_(keepData), bands_(bands), fft_(kFftSize, kWindow),
+      frame_(kFftSize, 0.0f), power_(kFftSize / 2 + 1 + SIMD_WIDTH, 0.0f) {
+    // Band b rises from edge b to b + 1 and falls to b + 2
+    std::vector<double> edges((size_t)bands + 2);
+    const double minMel = hzToMel(kMinHz);
+    const double maxMel = hzToMel(kMaxHz);
+    for (size_t i = 0; i < edges.size(); i++) {
+        edges[i] = melToHz(minMel + (maxMel - minMel) * (double)i / (double)(bands + 1));
+    }
+    const double binHz = (double)kLogMelSampleRate / kFftSize;
+    filters_.resize((size_t)bands);
+    for (int b = 0; b < bands; b++) {
+        Filter& filter = filters_[(size_t)b];
+        filter.firstBin = 0;
+        for (int k = 0; k <= kFftSize / 2; k++) {
+            const double hz = k * binHz;
+            const double rise = (hz - edges[(size_t)b]) / (edges[(size_t)b + 1] - edges[(size_t)b]);
+            const double fall = (edges[(size_t)b + 2] - hz) / (edges[(size_t)b + 2] - edges[(size_t)b + 1]);
+            const double weight = rise < fall ? rise : fall;
+            if (weight <= 0.0) {
+                continue;
+            }
+            if (filter.weights.empty()) {
+                filter.firstBin = k;
+            }
+            filter.weights.resize((size_t)(k - filter.firstBin), 0.0f);
+            filter.weights.push_back((float)weight);
+        }
+        // Narrow low bands may fall between bins and stay empty
+        filter.weights.resize((filter.weights.size() + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH, 0.0f);
+    }
+}
+
+LogMelSink::~LogMelSink() {
+    if (file_) {
+        discard();
+    }
+}
+
+int LogMelSink::open(std::string* error) {
+    unsigned char header[kLogMelHeaderBytes];
+    buildHeader(bands_, 0, header);
+    if (keepData_) {
+        data_.assign(header, header + sizeof(header));
+    }
+    if (path_.empty()) {
+        return 0;
+    }
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        *error = "Failed to open output file: " + path_;
+        return -1;
+    }
+    written_ = true;
+    // Frame count patched by finish()
+    if (fwrite(header, 1, sizeof(header), file_) != sizeof(header)) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    return 0;
+}
+
+void LogMelSink::computeFrame(const float* samples) {
+    memcpy(frame_.data(), samples, kWindow * sizeof(float));
+    fft_.powerSpectrum(frame_.data(), power_.data());
+    for (const Filter& filter : filters_) {
+        const float* power = power_.data() + filter.firstBin;
+        const float* weights = filter.weights.data();
+        simd_f32x4 sum = simd_set1(0.0f);
+        for (size_t i = 0; i < filter.weights.size(); i += SIMD_WIDTH) {
+            sum = simd_add(sum, simd_mul(simd_load(power + i), simd_load(weights + i)));
+        }
+        const float energy = simd_hsum(sum);
+        const unsigned half = toHalf(logf(energy > kFloor ? energy : kFloor));
+        out_.push_back((unsigned char)half);
+        out_.push_back((unsigned char)(half >> 8));
+    }
+    frames_++;
+}
+
+int LogMelSink::write(const float* mono, long frames, std::string* error) {
+    pending_.insert(pending_.end(), mono, mono + frames);
+    size_t offset = 0;
+    for (; offset + kWindow <= pending_.size(); offset += kHop) {
+        computeFrame(pending_.data() + offset);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + (long)offset);
+    return flush(error);
+}
+
+int LogMelSink::flush(std::string* error) {
+    if (out_.empty()) {
+        return 0;
+    }
+    if (file_ && fwrite(out_.data(), 1, out_.size(), file_) != out_.size()) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    if (keepData_) {
+        data_.insert(data_.end(), out_.begin(), out_.end());
+    }
+    out_.clear();
+    return 0;
+}
+
+int LogMelSink::finish(std::string* error) {
+    unsigned char header[kLogMelHeaderBytes];
+    buildHeader(bands_, frames_, header);
+    if (keepData_) {
+        memcpy(data_.data(), header, sizeof(header));
+    }
+    if (!file_) {
+        return 0;
+    }
+    if (fseek(file_, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), file_) != sizeof(header)) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    FILE* file = file_;
+    file_ = nullptr;
+    if (fclose(file) != 0) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    return 0;
+}
+
+void LogMelSink::discard() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    if (written_) {
+        remove(path_.c_str());
+        written_ = false;
+    }
+    data_.clear();
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,79 @@
+// Log-mel spectrogram computed from the encode loop's mono PCM, for keyword
+// spotting and audio embeddings without decoding the output again.
+//
+// Features are 25 ms frames every 10 ms of 16 kHz mono: the power spectrum of
+// a 512-point FFT, HTK mel filters from 20 Hz to 8 kHz, then ln(max(e, 1e-10)).
+// Frame i covers samples [i * hop, i * hop + window); a partial last frame is
+// dropped.
+// The file, and the bytes returned in the result, are little-endian:
+//
+//   0   "LMEL"
+//   4   u16 version (1)
+//   6   u16 bands
+//   8   u32 sample rate (16000)
+//   12  u16 hop, in samples (160)
+//   14  u16 window, in samples (400)
+//   16  u32 frames
+//   20  frames * bands IEEE half floats, frame by frame
+#ifndef WAV_TO_MP3_LOG_MEL_H
+#define WAV_TO_MP3_LOG_MEL_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "fft.h"
+#include "pcm_sink.h"
+
+namespace wavtomp3 {
+
+const int kLogMelSampleRate = 16000;
+const int kLogMelHeaderBytes = 20;
+const int kMaxLogMelBands = 128;
+
+class LogMelSink : public PcmSink {
+public:
+    // Writes the features to `path` unless it is empty, and keeps them in
+    // memory for data() when `keepData` is set.
+    LogMelSink(const std::string& path, bool keepData, int bands);
+    ~LogMelSink() override;
+
+    int open(std::string* error);
+
+    int sampleRate() const override { return kLogMelSampleRate; }
+    int write(const float* mono, long frames, std::string* error) override;
+    int finish(std::string* error) override;
+    void discard() override;
+
+    long long frames() const { return frames_; }
+
+    // Header and features in the file layout; empty unless `keepData`.
+    const std::vector<unsigned char>& data() const { return data_; }
+
+private:
+    void computeFrame(const float* samples);
+    int flush(std::string* error);
+
+    struct Filter {
+        int firstBin;
+        std::vector<float> weights;  // padded to the SIMD width
+    };
+
+    const std::string path_;
+    const bool keepData_;
+    const int bands_;
+    Fft fft_;
+    std::vector<Filter> filters_;
+    std::vector<float> pending_;  // input not yet consumed by a full frame
+    std::vector<float> frame_;    // one window, zero padded to the FFT size
+    std::vector<float> power_;    // padded so filters can read whole vectors
+    std::vector<unsigned char> out_;  // features of the current write()
+    std::vector<unsigned char> data_;
+    FILE* file_ = nullptr;
+    bool written_ = false;
+    long long frames_ = 0;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_LOG_MEL_H
@@ -0,0 +1,261 @@
+#include "loudness.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wavtomp3 {
+
+namespace {
+
+const double kAbsoluteGate = -70.0;
+const double kRelativeGate = -10.0;
+const double kBinWidth = 0.1;  // LU
+const int kBins = 800;         // -70 to +10 LUFS
+// How fast the normalizing gain follows the measurement. Cuts are faster so
+// they finish within the lookahead, before the louder part is played.
+const double kRiseDbPerSecond = 2.0;
+const double kFallDbPerSecond = 10.0;
+// Highest sample peak normalization may produce
+const double kCeilingDb = -1.0;
+
+double toLufs(double power) {
+    return -0.691 + 10.0 * log10(power);
+}
+
+float dbToGain(double db) {
+    return (float)pow(10.0, db / 20.0);
+}
+
+}  // namespace
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+    : channels_(channels), stepFrames_(std::max(1, sampleRate / 10)), binPower_(kBins),
+      binBlocks_(kBins) {
+    // BS.1770 K-weighting, derived for any rate from the analog prototypes
+    const double pi = 3.14159265358979323846;
+    double k = tan(pi * 1681.974450955533 / sampleRate);
+    const double vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    double q = 0.7071752369554196;
+    double a0 = 1.0 + k / q + k * k;
+    shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf_.b1 = 2.0 * (k * k - vh) / a0;
+    shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf_.a2 = (1.0 - k / q + k * k) / a0;
+
+    k = tan(pi * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    highpass_.b0 = 1.0;
+    highpass_.b1 = -2.0;
+    highpass_.b2 = 1.0;
+    highpass_.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass_.a2 = (1.0 - k / q + k * k) / a0;
+    reset();
+}
+
+void LoudnessMeter::reset() {
+    state_.assign((size_t)channels_ * 4, 0.0);
+    stepDone_ = 0;
+    stepSum_ = 0.0;
+    stepCount_ = 0;
+    std::fill(binPower_.begin(), binPower_.end(), 0.0);
+    std::fill(binBlocks_.begin(), binBlocks_.end(), 0);
+    peak_ = 0.0f;
+}
+
+void LoudnessMeter::add(const float* pcm, long frames) {
+    const Biquad& s = shelf_;
+    const Biquad& h = highpass_;
+    for (long i = 0; i < frames; i++) {
+        for (int c = 0; c < channels_; c++) {
+            const float sample = pcm[i * channels_ + c];
+            peak_ = std::max(peak_, std::fabs(sample));
+            // Two transposed direct form II stages
+            double* z = &state_[(size_t)c * 4];
+            double x = sample;
+            double y = s.b0 * x + z[0];
+            z[0] = s.b1 * x - s.a1 * y + z[1];
+            z[1] = s.b2 * x - s.a2 * y;
+            x = y;
+            y = h.b0 * x + z[2];
+            z[2] = h.b1 * x - h.a1 * y + z[3];
+            z[3] = h.b2 * x - h.a2 * y;
+            stepSum_ += y * y;
+        }
+        if (++stepDone_ < stepFrames_) {
+            continue;
+        }
+        steps_[stepCount_ % 4] = stepSum_ / stepFrames_;
+        stepCount_++;
+        stepDone_ = 0;
+        stepSum_ = 0.0;
+        if (stepCount_ >= 4) {
+            addBlock((steps_[0] + steps_[1] + steps_[2] + steps_[3]) / 4.0);
+        }
+    }
+}
+
+void LoudnessMeter::addBlock(double power) {
+    if (power <= 0.0) {
+        return;
+    }
+    const double lufs = toLufs(power);
+    if (lufs < kAbsoluteGate) {
+        return;
+    }
+    const int bin = std::min(kBins - 1, (int)((lufs - kAbsoluteGate) / kBinWidth));
+    binPower_[bin] += power;
+    binBlocks_[bin]++;
+}
+
+double LoudnessMeter::integrated() const {
+    double power = 0.0;
+    long blocks = 0;
+    for (int i = 0; i < kBins; i++) {
+        power += binPower_[i];
+        blocks += binBlocks_[i];
+    }
+    if (blocks == 0) {
+        return kSilenceLufs;
+    }
+    // The relative gate falls inside a bin; that whole bin counts
+    const double gate = toLufs(power / blocks) + kRelativeGate;
+    const int first = std::max(0, (int)((gate - kAbsoluteGate) / kBinWidth));
+    power = 0.0;
+    blocks = 0;
+    for (int i = first; i < kBins; i++) {
+        power += binPower_[i];
+        blocks += binBlocks_[i];
+    }
+    return blocks > 0 ? toLufs(power / blocks) : kSilenceLufs;
+}
+
+LoudnessSource::LoudnessSource(AudioSource* source, const LoudnessOptions& options)
+    : source_(source), options_(options), channels_(source->format().channels),
+      lookaheadFrames_(options.normalize()
+                           ? (long)((long long)source->format().sampleRate * options.lookaheadMs / 1000)
+                           : 0),
+      input_(source->format().sampleRate, channels_),
+      output_(source->format().sampleRate, channels_) {}
+
+long LoudnessSource::read(float* out, long maxFrames) {
+    if (!options_.normalize()) {
+        long frames = source_->read(out, maxFrames);
+        if (frames > 0) {
+            input_.add(out, frames);
+        }
+        return frames;
+    }
+    if (fill(maxFrames) != 0) {
+        return -1;
+    }
+    const long frames = std::min(maxFrames, (long)((pending_.size() - pendingStart_) / channels_));
+    if (frames == 0) {
+        return 0;
+    }
+    const size_t samples = (size_t)frames * channels_;
+    std::copy(pending_.begin() + pendingStart_, pending_.begin() + pendingStart_ + samples, out);
+    pendingStart_ += samples;
+    if (pendingStart_ * 2 >= pending_.size()) {
+        pending_.erase(pending_.begin(), pending_.begin() + pendingStart_);
+        pendingStart_ = 0;
+    }
+
+    // No sample from here to the end of the lookahead may pass the ceiling
+    while (!blockPeaks_.empty() && blockPeaks_.front().first <= framesReturned_) {
+        blockPeaks_.pop_front();
+    }
+    float peak = 0.0f;
+    for (const auto& block : blockPeaks_) {
+        peak = std::max(peak, block.second);
+    }
+    double gainDb = loudnessGainDb(frames);
+    if (peak > 0.0f) {
+        gainDb = std::min(gainDb, kCeilingDb - 20.0 * log10(peak));
+    }
+    // Ramp up from the last block's gain, but step straight down so the ramp
+    // never exceeds either limit
+    const double fromDb = framesReturned_ == 0 ? gainDb : std::min(appliedDb_, gainDb);
+    applyGainRamp(out, (size_t)frames, channels_, dbToGain(fromDb), dbToGain(gainDb));
+    appliedDb_ = gainDb;
+
+    output_.add(out, frames);
+    framesReturned_ += frames;
+    return frames;
+}
+
+int LoudnessSource::fill(long maxFrames) {
+    while (!ended_ && framesRead_ - framesReturned_ < lookaheadFrames_ + maxFrames) {
+        const size_t start = pending_.size();
+        pending_.resize(start + (size_t)maxFrames * channels_);
+        long frames = source_->read(&pending_[start], maxFrames);
+        if (frames < 0) {
+            pending_.resize(start);
+            return -1;
+        }
+        pending_.resize(start + (size_t)frames * channels_);
+        if (frames == 0) {
+            ended_ = true;
+            break;
+        }
+        const float* block = &pending_[start];
+        input_.add(block, frames);
+        float peak = 0.0f;
+        for (size_t i = 0; i < (size_t)frames * channels_; i++) {
+            peak = std::max(peak, std::fabs(block[i]));
+        }
+        framesRead_ += frames;
+        blockPeaks_.emplace_back(framesRead_, peak);
+    }
+    return 0;
+}
+
+double LoudnessSource::loudnessGainDb(long frames) {
+    const double loudness = input_.integrated();
+    if (loudness <= kSilenceLufs) {
+        // Nothing measured yet: leave the gain where it is
+        return loudnessGainDb_;
+    }
+    const double wanted = std::min(options_.maxGainDb, options_.target - loudness);
+    if (!settled_) {
+        // The first measurement already covers the lookahead
+        loudnessGainDb_ = wanted;
+        settled_ = true;
+    } else {
+        const double seconds = (double)frames / format().sampleRate;
+        loudnessGainDb_ += std::max(-kFallDbPerSecond * seconds,
+                                    std::min(kRiseDbPerSecond * seconds, wanted - loudnessGainDb_));
+    }
+    return loudnessGainDb_;
+}
+
+int LoudnessSource::seek(long long frame) {
+    if (source_->seek(frame) != 0) {
+        return -1;
+    }
+    // Measurement starts over from the new position
+    input_.reset();
+    output_.reset();
+    pending_.clear();
+    pendingStart_ = 0;
+    blockPeaks_.clear();
+    framesRead_ = 0;
+    framesReturned_ = 0;
+    ended_ = false;
+    settled_ = false;
+    loudnessGainDb_ = 0.0;
+    appliedDb_ = 0.0;
+    return 0;
+}
+
+double LoudnessSource::outputLoudness() const {
+    return options_.normalize() ? output_.integrated() : input_.integrated();
+}
+
+float LoudnessSource::outputPeak() const {
+    return options_.normalize() ? output_.peak() : input_.peak();
+}
+
+}  // namespace wavtomp3
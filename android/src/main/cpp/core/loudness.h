@@ -0,0 +1,121 @@
+// EBU R128 loudness (ITU-R BS.1770-4) measured in the encode loop, and
+// loudness normalization in the same pass.
+//
+// Normalizing usually needs the integrated loudness of the whole file before
+// the first sample is written. LoudnessSource instead holds a few seconds of
+// PCM back: the gain for each block comes from the loudness of everything
+// read so far, including the lookahead, and moves slowly enough not to be
+// heard. The lookahead also bounds the gain so no sample in it goes above
+// the ceiling. Material whose loudness is steady lands on the target; for
+// the rest the result is within a few LU and the actual figure is reported.
+#ifndef WAV_TO_MP3_LOUDNESS_H
+#define WAV_TO_MP3_LOUDNESS_H
+
+#include <deque>
+#include <vector>
+
+#include "audio_source.h"
+
+namespace wavtomp3 {
+
+// Reported for input that never rises above the absolute gate
+const double kSilenceLufs = -70.0;
+
+// Integrated loudness and sample peak of interleaved float PCM: K-weighting,
+// 400 ms blocks every 100 ms, gated at -70 LUFS and 10 LU below the
+// ungated loudness.
+class LoudnessMeter {
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    void add(const float* pcm, long frames);
+
+    // LUFS of everything added so far; kSilenceLufs if nothing passes the
+    // absolute gate.
+    double integrated() const;
+
+    // Largest absolute sample so far.
+    float peak() const { return peak_; }
+
+    void reset();
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void addBlock(double power);
+
+    const int channels_;
+    Biquad shelf_;     // stage 1: head-related high shelf
+    Biquad highpass_;  // stage 2: RLB high-pass
+    std::vector<double> state_;  // 2 per stage per channel
+    long stepFrames_;            // 100 ms
+    long stepDone_ = 0;
+    double stepSum_ = 0.0;
+    double steps_[4] = {0.0, 0.0, 0.0, 0.0};  // last four 100 ms sums
+    int stepCount_ = 0;
+    // Gated blocks in 0.1 LU bins from -70 LUFS, so integrated() costs the
+    // same however long the input is
+    std::vector<double> binPower_;
+    std::vector<long> binBlocks_;
+    float peak_ = 0.0f;
+};
+
+struct LoudnessOptions {
+    bool measure = false;     // report the loudness only
+    double target = 0.0;      // normalize to this many LUFS; 0: off
+    int lookaheadMs = 3000;
+    double maxGainDb = 20.0;  // largest boost; cuts are not limited
+    bool replayGain = false;  // ReplayGain in the MP3's LAME tag
+
+    bool normalize() const { return target < 0.0; }
+    bool enabled() const { return measure || normalize() || replayGain; }
+};
+
+// Measures `source` as it is read and, with options.normalize(), returns it
+// with the normalizing gain applied.
+class LoudnessSource : public AudioSource {
+public:
+    LoudnessSource(AudioSource* source, const LoudnessOptions& options);
+
+    const AudioFormat& format() const override { return source_->format(); }
+    long long totalFrames() const override { return source_->totalFrames(); }
+    long read(float* out, long maxFrames) override;
+    int seek(long long frame) override;
+
+    // Integrated loudness of the input and of what was returned.
+    double inputLoudness() const { return input_.integrated(); }
+    double outputLoudness() const;
+
+    // Largest absolute sample returned.
+    float outputPeak() const;
+
+private:
+    // Reads until the lookahead is full or the input ends. Returns -1 on a
+    // read error.
+    int fill(long maxFrames);
+    // Gain the loudness calls for over the next `frames` frames.
+    double loudnessGainDb(long frames);
+
+    AudioSource* source_;
+    const LoudnessOptions options_;
+    const int channels_;
+    const long lookaheadFrames_;
+    LoudnessMeter input_;
+    LoudnessMeter output_;
+    std::vector<float> pending_;  // lookahead, interleaved
+    size_t pendingStart_ = 0;     // first unread sample
+    // Peak of each block in the lookahead, by its last frame
+    std::deque<std::pair<long long, float>> blockPeaks_;
+    long long framesRead_ = 0;
+    long long framesReturned_ = 0;
+    bool ended_ = false;
+    bool settled_ = false;  // gain follows a measurement, not the 0 dB start
+    double loudnessGainDb_ = 0.0;
+    double appliedDb_ = 0.0;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_LOUDNESS_H
@@ -0,0 +1,459 @@
+#include "mp3_edit.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#include "log.h"
+#include "mp3_frame.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Samples a layer III decoder outputs before the first encoded one; the
+// LAME tag's delay does not include them
+const int kDecoderDelay = 529;
+const int kMaxTagSamples = 4095;
+
+struct Mp3Input {
+    std::string path;
+    std::vector<unsigned char> data;
+    size_t id3Bytes = 0;        // ID3v2 tag in front, kept by the output
+    std::vector<size_t> frames; // offsets of the audio frames
+    Mp3FrameHeader first;       // header of the first audio frame
+    InfoTag tag;                // delay and padding stay 0 without a LAME tag
+    long long samples = 0;      // playing length per channel
+};
+
+// Where the fields of a layer III side info sit, in bits: main_data_begin,
+// then after the private bits (and MPEG-1 scfsi) one entry per granule and
+// channel starting with part2_3_length (12 bits) and big_values (9 bits)
+struct SideInfoLayout {
+    int beginBits;
+    int firstEntry;
+    int entryBits;
+    int entries;
+};
+
+SideInfoLayout sideInfoLayout(const Mp3FrameHeader& header) {
+    if (header.version == 1) {
+        return {9, 9 + (header.channels == 1 ? 5 : 3) + 4 * header.channels, 59, 2 * header.channels};
+    }
+    return {8, 8 + (header.channels == 1 ? 1 : 2), 63, header.channels};
+}
+
+unsigned getBits(const unsigned char* data, int offset, int count) {
+    unsigned value = 0;
+    for (int i = offset; i < offset + count; i++) {
+        value = (value << 1) | ((data[i >> 3] >> (7 - (i & 7))) & 1);
+    }
+    return value;
+}
+
+void putBits(unsigned char* data, int offset, int count, unsigned value) {
+    for (int i = offset + count - 1; i >= offset; i--, value >>= 1) {
+        const unsigned char mask = (unsigned char)(0x80 >> (i & 7));
+        data[i >> 3] = (unsigned char)((value & 1) ? data[i >> 3] | mask : data[i >> 3] & ~mask);
+    }
+}
+
+int readFile(const std::string& path, std::vector<unsigned char>* data) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return -1;
+    }
+    data->clear();
+    unsigned char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    return failed ? -1 : 0;
+}
+
+bool sameStream(const Mp3FrameHeader& a, const Mp3FrameHeader& b) {
+    return a.version == b.version && a.sampleRate == b.sampleRate && a.channels == b.channels;
+}
+
+int openMp3Input(const std::string& path, Mp3Input* input, std::string* errorCode, std::string* error) {
+    input->path = path;
+    if (readFile(path, &input->data) != 0) {
+        *errorCode = kErrorFile;
+        *error = "Failed to read input file: " + path;
+        return -1;
+    }
+    const std::vector<unsigned char>& data = input->data;
+    size_t end = data.size();
+    if (end >= 10 && memcmp(data.data(), "ID3", 3) == 0) {
+        // Sizes are "syncsafe": 7 bits per byte
+        const size_t size = ((size_t)(data[6] & 0x7F) << 21) | ((size_t)(data[7] & 0x7F) << 14) |
+                            ((size_t)(data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+        input->id3Bytes = std::min(end, 10 + size + ((data[5] & 0x10) ? 10 : 0));
+    }
+    if (end >= input->id3Bytes + 128 && memcmp(&data[end - 128], "TAG", 3) == 0) {
+        end -= 128;
+    }
+
+    // The first frame that a matching frame follows, then every frame up to
+    // the first one that does not belong to the stream
+    size_t pos = input->id3Bytes;
+    Mp3FrameHeader header;
+    for (; pos + 4 <= end; pos++) {
+        if (!parseMp3FrameHeader(&data[pos], end - pos, &header)) {
+            continue;
+        }
+        const size_t next = pos + header.frameBytes;
+        Mp3FrameHeader following;
+        if (next == end || (next + 4 <= end && parseMp3FrameHeader(&data[next], end - next, &following) &&
+                            sameStream(following, header))) {
+            break;
+        }
+    }
+    input->first = header;
+    while (pos + 4 <= end && parseMp3FrameHeader(&data[pos], end - pos, &header) &&
+           sameStream(header, input->first) && pos + header.frameBytes <= end) {
+        input->frames.push_back(pos);
+        pos += header.frameBytes;
+    }
+    bool hasLameTag = false;
+    if (!input->frames.empty() &&
+        parseInfoFrame(&data[input->frames[0]], end - input->frames[0], &input->tag, &hasLameTag)) {
+        input->frames.erase(input->frames.begin());
+    }
+    if (input->frames.empty() || !parseMp3FrameHeader(&data[input->frames[0]], 4, &input->first)) {
+        *errorCode = kErrorMp3;
+        *error = "No MP3 frames in " + path;
+        return -1;
+    }
+    if (!hasLameTag) {
+        input->tag.encoderDelay = 0;
+        input->tag.padding = 0;
+    }
+    input->samples = std::max(0LL, (long long)input->frames.size() * input->first.frameSamples -
+                                       input->tag.encoderDelay - input->tag.padding);
+    return 0;
+}
+
+// Collects the main data of frame `index` of `input`: the bits its side info
+// counts, starting main_data_begin bytes before its own main data. Returns
+// false if they reach back past the first frame.
+bool frameMainData(const Mp3Input& input, size_t index, std::vector<unsigned char>* mainData) {
+    const unsigned char* data = input.data.data();
+    auto mainArea = [&](size_t frame, size_t* begin, size_t* end) {
+        Mp3FrameHeader header;
+        parseMp3FrameHeader(data + input.frames[frame], 4, &header);
+        const size_t crc = (data[input.frames[frame] + 1] & 1) ? 0 : 2;
+        *begin = input.frames[frame] + 4 + crc + sideInfoBytes(header);
+        *end = input.frames[frame] + header.frameBytes;
+    };
+    Mp3FrameHeader header;
+    parseMp3FrameHeader(data + input.frames[index], 4, &header);
+    const SideInfoLayout layout = sideInfoLayout(header);
+    size_t begin, end;
+    mainArea(index, &begin, &end);
+    const unsigned char* side = data + begin - sideInfoBytes(header);
+    size_t back = getBits(side, 0, layout.beginBits);
+    long long bits = 0;
+    for (int i = 0; i < layout.entries; i++) {
+        bits += getBits(side, layout.firstEntry + i * layout.entryBits, 12);
+    }
+    size_t bytes = (size_t)((bits + 7) / 8);
+
+    // Main data areas of this frame and as many before it as main_data_begin
+    // reaches into, oldest first
+    std::deque<std::pair<size_t, size_t>> areas(1, std::make_pair(begin, end));
+    size_t before = 0;
+    for (size_t frame = index; before < back; ) {
+        if (frame == 0) {
+            return false;
+        }
+        mainArea(--frame, &begin, &end);
+        areas.emplace_front(begin, end);
+        before += end - begin;
+    }
+    mainData->clear();
+    size_t skip = before - back;
+    for (const auto& area : areas) {
+        const size_t from = area.first + std::min(skip, area.second - area.first);
+        skip -= from - area.first;
+        const size_t count = std::min(area.second - from, bytes - mainData->size());
+        mainData->insert(mainData->end(), data + from, data + from + count);
+    }
+    return mainData->size() == bytes;
+}
+
+// Lays out frames again with main_data_begin pointing into the output's
+// own reservoir
+class FrameWriter {
+public:
+    std::vector<unsigned char> out;
+    std::vector<size_t> offsets;
+    int resized = 0;
+    bool mixedBitrates = false;
+
+    // Appends frame `index` of `input`. Frames whose data reaches back past
+    // the start of the input are written silent.
+    int add(const Mp3Input& input, size_t index, std::string* error) {
+        const unsigned char* frame = input.data.data() + input.frames[index];
+        Mp3FrameHeader header;
+        parseMp3FrameHeader(frame, 4, &header);
+        const SideInfoLayout layout = sideInfoLayout(header);
+        const int sideBytes = sideInfoBytes(header);
+        std::vector<unsigned char> side(frame + 4 + ((frame[1] & 1) ? 0 : 2),
+                                        frame + 4 + ((frame[1] & 1) ? 0 : 2) + sideBytes);
+        if (!frameMainData(input, index, &mainData_)) {
+            for (int i = 0; i < layout.entries; i++) {
+                putBits(side.data(), layout.firstEntry + i * layout.entryBits, 12 + 9, 0);
+            }
+            mainData_.clear();
+        }
+
+        // Older free bytes stay unused, as ancillary data
+        const size_t maxBack = ((size_t)1 << layout.beginBits) - 1;
+        if (reserved_ > maxBack) {
+            take(reserved_ - maxBack, nullptr);
+        }
+        // No CRC: it would cover the rewritten side info
+        unsigned char raw[4] = {frame[0], (unsigned char)(frame[1] | 1), frame[2], frame[3]};
+        while (reserved_ + header.frameBytes - 4 - sideBytes < mainData_.size()) {
+            if (header.bitrateIndex == 14) {
+                *error = "MP3 frame " + std::to_string(index) + " does not fit at any bitrate";
+                return -1;
+            }
+            raw[2] = (unsigned char)(((header.bitrateIndex + 1) << 4) | (raw[2] & 0x0F));
+            parseMp3FrameHeader(raw, 4, &header);
+        }
+        if (raw[2] != frame[2]) {
+            resized++;
+        }
+        if (!offsets.empty() && header.bitrate != bitrate_) {
+            mixedBitrates = true;
+        }
+        bitrate_ = header.bitrate;
+        putBits(side.data(), 0, layout.beginBits, (unsigned)reserved_);
+
+        offsets.push_back(out.size());
+        out.insert(out.end(), raw, raw + 4);
+        out.insert(out.end(), side.begin(), side.end());
+        const size_t mainStart = out.size();
+        out.resize(offsets.back() + header.frameBytes, 0);
+        reservoir_.emplace_back(mainStart, out.size() - mainStart);
+        reserved_ += out.size() - mainStart;
+        take(mainData_.size(), mainData_.data());
+        return 0;
+    }
+
+private:
+    // Main data bytes of the output no frame has used yet, as (offset,
+    // length) spans in stream order
+    std::deque<std::pair<size_t, size_t>> reservoir_;
+    size_t reserved_ = 0;
+    std::vector<unsigned char> mainData_;
+    int bitrate_ = 0;
+
+    // Fills the oldest `count` free bytes with `bytes`, or skips them
+    void take(size_t count, const unsigned char* bytes) {
+        reserved_ -= count;
+        while (count > 0) {
+            std::pair<size_t, size_t>& span = reservoir_.front();
+            const size_t n = std::min(count, span.second);
+            if (bytes) {
+                memcpy(&out[span.first], bytes, n);
+                bytes += n;
+            }
+            span.first += n;
+            span.second -= n;
+            count -= n;
+            if (span.second == 0) {
+                reservoir_.pop_front();
+            }
+        }
+    }
+};
+
+// Writes the ID3v2 tag of `input`, an Info/Xing tag and the frames of
+// `writer` to `outputPath` through a temporary file.
+int writeOutput(const Mp3Input& input, const FrameWriter& writer, int delay, int padding,
+                const std::string& outputPath, Mp3EditResult* result, std::string* errorCode,
+                std::string* error) {
+    InfoTag tag;
+    tag.frames = (long long)writer.offsets.size();
+    tag.audioBytes = (long long)writer.out.size();
+    tag.encoderDelay = delay;
+    tag.padding = padding;
+    tag.quality = input.tag.quality;
+    tag.lowpassHz = input.tag.lowpassHz;
+    tag.sourceSampleRate = input.first.sampleRate;
+    tag.musicCrc = crc16(writer.out.data(), writer.out.size());
+    Mp3FrameHeader first;
+    parseMp3FrameHeader(writer.out.data(), 4, &first);
+    std::vector<unsigned char> infoFrame;
+    if (buildInfoFrame(first, tag, &infoFrame, error) != 0) {
+        *errorCode = kErrorMp3;
+        return -1;
+    }
+    if (writer.mixedBitrates) {
+        // Seek points need the tag frame's size, which the table does not change
+        const double total = (double)(infoFrame.size() + writer.out.size());
+        for (int i = 0; i < 100; i++) {
+            const size_t frame = (size_t)((double)i * writer.offsets.size() / 100);
+            tag.toc.push_back((unsigned char)std::min(255.0, (infoFrame.size() + writer.offsets[frame]) * 256 / total));
+        }
+        buildInfoFrame(first, tag, &infoFrame, error);
+    }
+
+    const std::string partPath = outputPath + ".part";
+    FILE* file = fopen(partPath.c_str(), "wb");
+    if (!file) {
+        *errorCode = kErrorWrite;
+        *error = "Failed to open output file: " + outputPath;
+        return -1;
+    }
+    bool written = fwrite(input.data.data(), 1, input.id3Bytes, file) == input.id3Bytes &&
+                   fwrite(infoFrame.data(), 1, infoFrame.size(), file) == infoFrame.size() &&
+                   fwrite(writer.out.data(), 1, writer.out.size(), file) == writer.out.size();
+    if (fclose(file) != 0 || !written || rename(partPath.c_str(), outputPath.c_str()) != 0) {
+        remove(partPath.c_str());
+        *errorCode = kErrorWrite;
+        *error = "Failed to write output";
+        return -1;
+    }
+    result->sampleRate = first.sampleRate;
+    result->channels = first.channels;
+    result->frames = tag.frames;
+    result->outputBytes = (long long)(input.id3Bytes + infoFrame.size() + writer.out.size());
+    result->durationMs = (double)(tag.frames * first.frameSamples - delay - padding) * 1000.0 / first.sampleRate;
+    result->resizedFrames = writer.resized;
+    return 0;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int trimMp3(const std::string& inputPath, const std::string& outputPath, double startMs, double endMs,
+            Mp3EditResult* result, std::string* errorCode, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    *result = Mp3EditResult();
+    Mp3Input input;
+    if (openMp3Input(inputPath, &input, errorCode, error) != 0) {
+        return -1;
+    }
+    const int rate = input.first.sampleRate;
+    const int frameSamples = input.first.frameSamples;
+    const long long delay = input.tag.encoderDelay;
+    const long long first = std::max(0LL, (long long)std::llround(startMs * rate / 1000.0));
+    const long long last = endMs < 0 ? input.samples
+                                     : std::min(input.samples, (long long)std::llround(endMs * rate / 1000.0));
+    if (first >= last) {
+        char message[160];
+        const double lengthMs = input.samples * 1000.0 / rate;
+        snprintf(message, sizeof(message), "Nothing to keep from %.0f to %.0f ms of a %.0f ms file", startMs,
+                 endMs < 0 ? lengthMs : endMs, lengthMs);
+        *errorCode = kErrorMp3;
+        *error = message;
+        return -1;
+    }
+
+    // Frame k decodes to samples [k*N, (k+1)*N) of the decoder's output,
+    // where input sample s sits at s + delay + kDecoderDelay. The frame
+    // before the first one needed is kept for its overlap.
+    const long long from = std::max(0LL, (first + delay + kDecoderDelay) / frameSamples - 1);
+    const long long to = std::min((long long)input.frames.size() - 1,
+                                  (last + delay + kDecoderDelay - 1) / frameSamples);
+    const long long newDelay = first + delay - from * frameSamples;
+    const long long newPadding = (to - from + 1) * frameSamples - newDelay - (last - first);
+    if (newDelay > kMaxTagSamples || newPadding < 0 || newPadding > kMaxTagSamples) {
+        *errorCode = kErrorMp3;
+        *error = "Encoder delay or padding of " + inputPath + " out of range";
+        return -1;
+    }
+
+    FrameWriter writer;
+    for (long long frame = from; frame <= to; frame++) {
+        if (writer.add(input, (size_t)frame, error) != 0) {
+            *errorCode = kErrorMp3;
+            return -1;
+        }
+    }
+    if (writeOutput(input, writer, (int)newDelay, (int)newPadding, outputPath, result, errorCode, error) != 0) {
+        return -1;
+    }
+    result->elapsedMs = millisecondsSince(start);
+    LOGI("Trimmed %s to frames %lld-%lld, %d resized, in %.1f ms", inputPath.c_str(), from, to,
+         result->resizedFrames, result->elapsedMs);
+    return 0;
+}
+
+int joinMp3(const std::vector<std::string>& inputPaths, const std::string& outputPath,
+            Mp3EditResult* result, std::string* errorCode, std::string* error) {
+    auto start = std::chrono::steady_clock::now();
+    *result = Mp3EditResult();
+    if (inputPaths.empty()) {
+        *errorCode = kErrorMp3;
+        *error = "No input files";
+        return -1;
+    }
+    Mp3Input first;
+    if (openMp3Input(inputPaths[0], &first, errorCode, error) != 0) {
+        return -1;
+    }
+    FrameWriter writer;
+    long long gapSamples = 0;
+    int padding = first.tag.padding;
+    for (size_t i = 0; i < inputPaths.size(); i++) {
+        Mp3Input next;
+        const Mp3Input* input = &first;
+        if (i > 0) {
+            if (openMp3Input(inputPaths[i], &next, errorCode, error) != 0) {
+                return -1;
+            }
+            if (!sameStream(next.first, first.first)) {
+                char message[160];
+                snprintf(message, sizeof(message), ": %d Hz %s, expected %d Hz %s like the first file",
+                         next.first.sampleRate, next.first.channels == 1 ? "mono" : "stereo",
+                         first.first.sampleRate, first.first.channels == 1 ? "mono" : "stereo");
+                *errorCode = kErrorMp3;
+                *error = inputPaths[i] + message;
+                return -1;
+            }
+            gapSamples += padding + next.tag.encoderDelay;
+            padding = next.tag.padding;
+            input = &next;
+        }
+        for (size_t frame = 0; frame < input->frames.size(); frame++) {
+            if (writer.add(*input, frame, error) != 0) {
+                *errorCode = kErrorMp3;
+                return -1;
+            }
+        }
+    }
+    if (writeOutput(first, writer, first.tag.encoderDelay, padding, outputPath, result, errorCode, error) != 0) {
+        return -1;
+    }
+    result->gapMs = gapSamples * 1000.0 / result->sampleRate;
+    result->elapsedMs = millisecondsSince(start);
+    LOGI("Joined %zu files into %s, %d frames resized, in %.1f ms", inputPaths.size(), outputPath.c_str(),
+         result->resizedFrames, result->elapsedMs);
+    return 0;
+}
+
+std::string formatMp3EditResult(const Mp3EditResult& result) {
+    char text[256];
+    snprintf(text, sizeof(text),
+             "sampleRate=%d\nchannels=%d\nframes=%lld\noutputBytes=%lld\ndurationMs=%.1f\nresizedFrames=%d\n"
+             "gapMs=%.1f\nelapsedMs=%.1f\n",
+             result.sampleRate, result.channels, result.frames, result.outputBytes, result.durationMs,
+             result.resizedFrames, result.gapMs, result.elapsedMs);
+    return text;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,56 @@
+// Cutting and joining MP3 files at frame boundaries without decoding, so the
+// cost follows the file size rather than the encode time.
+//
+// Layer III frames may start their audio data in earlier frames (the bit
+// reservoir, addressed by main_data_begin in the side info), so frames
+// cannot simply be copied out of a stream. Each kept frame's data is taken
+// from wherever it sits in the input and laid out again from the first
+// output frame on, with main_data_begin rewritten. A frame whose data no
+// longer fits, because the reservoir it drew on is gone, is moved to the
+// next higher bitrate.
+//
+// A cut also keeps the frame before the first wanted one, whose overlap the
+// decoder needs, and the new Info/LAME tag's encoder delay and padding trim
+// playback to the exact sample for gapless players. Joins keep each input's
+// delay and padding at the seam, some 25 to 50 ms of near-silence at
+// 44.1 kHz, since removing them would mean re-encoding.
+#ifndef WAV_TO_MP3_MP3_EDIT_H
+#define WAV_TO_MP3_MP3_EDIT_H
+
+#include <string>
+#include <vector>
+
+#include "converter.h"
+
+namespace wavtomp3 {
+
+struct Mp3EditResult {
+    int sampleRate = 0;
+    int channels = 0;
+    long long frames = 0;       // audio frames written, not counting the tag frame
+    long long outputBytes = 0;
+    double durationMs = 0.0;    // playing time, delay and padding excluded
+    int resizedFrames = 0;      // frames moved to a higher bitrate
+    double gapMs = 0.0;         // joinMp3: delay and padding kept at the seams
+    double elapsedMs = 0.0;
+};
+
+// Writes the part of `inputPath` from `startMs` to `endMs` (the end if
+// negative) to `outputPath`. Returns 0, or -1 with `errorCode` set:
+// kErrorFile, kErrorMp3, or kErrorWrite. The output replaces `outputPath`
+// only once complete, so it may be the input itself.
+int trimMp3(const std::string& inputPath, const std::string& outputPath, double startMs, double endMs,
+            Mp3EditResult* result, std::string* errorCode, std::string* error);
+
+// Writes `inputPaths` one after the other to `outputPath`. All inputs must
+// share the MPEG version, sample rate and channel count; bitrates may
+// differ. Errors as for trimMp3().
+int joinMp3(const std::vector<std::string>& inputPaths, const std::string& outputPath,
+            Mp3EditResult* result, std::string* errorCode, std::string* error);
+
+// "key=value" lines
+std::string formatMp3EditResult(const Mp3EditResult& result);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_MP3_EDIT_H
@@ -0,0 +1,257 @@
+#include "mp3_frame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kBitratesV1[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+const int kBitratesV2[15] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+const int kSampleRatesV1[3] = {44100, 48000, 32000};
+
+// "Info" tag layout after the side info: 4 id, 4 flags, 4 frames, 4 bytes,
+// 100 TOC, 4 quality, then the 36-byte LAME extension.
+const int kXingBytes = 120;
+const int kLameBytes = 36;
+
+int frameBytesFor(int version, int bitrate, int sampleRate, bool padding) {
+    int coefficient = version == 1 ? 144 : 72;
+    return coefficient * bitrate * 1000 / sampleRate + (padding ? 1 : 0);
+}
+
+int sideInfoBytes(int version, int channels) {
+    if (version == 1) {
+        return channels == 1 ? 17 : 32;
+    }
+    return channels == 1 ? 9 : 17;
+}
+
+unsigned long long getBe(const unsigned char* in, int bytes) {
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// Offset of the Xing/Info tag in `frame`, or 0 if it has none
+size_t xingOffset(const unsigned char* frame, size_t size, const Mp3FrameHeader& header) {
+    const size_t offset = 4 + (size_t)sideInfoBytes(header.version, header.channels);
+    if (size < offset + 8 || (memcmp(frame + offset, "Info", 4) != 0 && memcmp(frame + offset, "Xing", 4) != 0)) {
+        return 0;
+    }
+    return offset;
+}
+
+// Offset of the LAME tag behind the Xing tag at `xing`, or 0 if there is none
+size_t lameOffset(const unsigned char* frame, size_t size, size_t xing) {
+    // The Xing fields present decide where the LAME tag starts
+    const unsigned char flags = frame[xing + 7];
+    const size_t offset = xing + 8 + ((flags & 1) ? 4 : 0) + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0) +
+                          ((flags & 8) ? 4 : 0);
+    if (size < offset + kLameBytes || memcmp(frame + offset, "LAME", 4) != 0) {
+        return 0;
+    }
+    return offset;
+}
+
+void putBe(unsigned char* out, unsigned long long value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        out[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+}  // namespace
+
+bool parseMp3FrameHeader(const unsigned char* data, size_t size, Mp3FrameHeader* header) {
+    if (size < 4 || data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    int versionBits = (data[1] >> 3) & 3;
+    int layerBits = (data[1] >> 1) & 3;
+    int bitrateIndex = data[2] >> 4;
+    int rateIndex = (data[2] >> 2) & 3;
+    if (versionBits == 1 || layerBits != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) {
+        return false;
+    }
+    memcpy(header->raw, data, 4);
+    header->version = versionBits == 3 ? 1 : versionBits == 2 ? 2 : 25;
+    header->bitrateIndex = bitrateIndex;
+    header->bitrate = (header->version == 1 ? kBitratesV1 : kBitratesV2)[bitrateIndex];
+    header->sampleRate = kSampleRatesV1[rateIndex] / (header->version == 1 ? 1 : header->version == 2 ? 2 : 4);
+    header->channels = (data[3] >> 6) == 3 ? 1 : 2;
+    header->padding = ((data[2] >> 1) & 1) != 0;
+    header->frameBytes = frameBytesFor(header->version, header->bitrate, header->sampleRate, header->padding);
+    header->frameSamples = header->version == 1 ? 1152 : 576;
+    return true;
+}
+
+int sideInfoBytes(const Mp3FrameHeader& header) {
+    return sideInfoBytes(header.version, header.channels);
+}
+
+std::vector<int> mp3Bitrates(int sampleRate, int ceiling) {
+    const int* bitrates = sampleRate >= 32000 ? kBitratesV1 : kBitratesV2;
+    std::vector<int> steps;
+    for (int index = 1; index < 15; index++) {
+        if (steps.empty() || bitrates[index] <= ceiling) {
+            steps.push_back(bitrates[index]);
+        }
+    }
+    return steps;
+}
+
+int splitMp3Frames(const unsigned char* data, size_t size, std::vector<size_t>* offsets,
+                   std::string* error) {
+    offsets->clear();
+    Mp3FrameHeader first;
+    size_t pos = 0;
+    while (pos < size) {
+        Mp3FrameHeader header;
+        if (!parseMp3FrameHeader(data + pos, size - pos, &header) ||
+            pos + header.frameBytes > size ||
+            (!offsets->empty() && (header.version != first.version ||
+                                   header.sampleRate != first.sampleRate ||
+                                   header.channels != first.channels))) {
+            *error = "Invalid MP3 frame at offset " + std::to_string(pos);
+            return -1;
+        }
+        if (offsets->empty()) {
+            first = header;
+        }
+        offsets->push_back(pos);
+        pos += header.frameBytes;
+    }
+    return 0;
+}
+
+uint16_t crc16(const unsigned char* data, size_t size, uint16_t crc) {
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+int buildInfoFrame(const Mp3FrameHeader& first, const InfoTag& tag, std::vector<unsigned char>* frame,
+                   std::string* error) {
+    const int* bitrates = first.version == 1 ? kBitratesV1 : kBitratesV2;
+    const int tagOffset = 4 + sideInfoBytes(first.version, first.channels);
+    const int needed = tagOffset + kXingBytes + kLameBytes;
+    int index = first.bitrateIndex;
+    while (index < 14 && frameBytesFor(first.version, bitrates[index], first.sampleRate, false) < needed) {
+        index++;
+    }
+    const int size = frameBytesFor(first.version, bitrates[index], first.sampleRate, false);
+    if (size < needed) {
+        *error = "Frames too small for an Info tag";
+        return -1;
+    }
+
+    frame->assign((size_t)size, 0);
+    unsigned char* out = frame->data();
+    out[0] = 0xFF;
+    out[1] = (unsigned char)(first.raw[1] | 1);  // no CRC
+    out[2] = (unsigned char)((index << 4) | (first.raw[2] & 0x0C));
+    out[3] = first.raw[3];
+
+    unsigned char* xing = out + tagOffset;
+    const bool vbr = tag.toc.size() == 100;
+    memcpy(xing, vbr ? "Xing" : "Info", 4);
+    putBe(xing + 4, 0x0F, 4);  // frames, bytes, TOC and quality present
+    putBe(xing + 8, (unsigned long long)tag.frames, 4);
+    putBe(xing + 12, (unsigned long long)(size + tag.audioBytes), 4);
+    // CBR: byte offsets grow linearly with time
+    for (int i = 0; i < 100; i++) {
+        xing[16 + i] = vbr ? tag.toc[i] : (unsigned char)(i * 256 / 100);
+    }
+    putBe(xing + 116, (unsigned long long)std::max(0, 100 - 10 * 4 - tag.quality), 4);
+
+    unsigned char* lame = xing + kXingBytes;
+    memcpy(lame, "LAME3.100", 9);
+    lame[9] = vbr ? 0 : 1;  // tag revision 0, CBR or unknown method
+    lame[10] = (unsigned char)std::min(255, std::max(0, tag.lowpassHz / 100));
+    lame[20] = (unsigned char)std::min(255, first.bitrate);
+    int delay = std::min(4095, std::max(0, tag.encoderDelay));
+    int padding = std::min(4095, std::max(0, tag.padding));
+    lame[21] = (unsigned char)(delay >> 4);
+    lame[22] = (unsigned char)(((delay & 0x0F) << 4) | (padding >> 8));
+    lame[23] = (unsigned char)(padding & 0xFF);
+    int rate = tag.sourceSampleRate > 0 ? tag.sourceSampleRate : first.sampleRate;
+    int rateCode = rate <= 32000 ? 0 : rate == 44100 ? 1 : rate == 48000 ? 2 : 3;
+    lame[24] = (unsigned char)(rateCode << 6);
+    putBe(lame + 28, (unsigned long long)(size + tag.audioBytes), 4);
+    putBe(lame + 32, tag.musicCrc, 2);
+    putBe(lame + 34, crc16(out, (size_t)(tagOffset + kXingBytes + kLameBytes - 2)), 2);
+    return 0;
+}
+
+bool setReplayGain(std::vector<unsigned char>* frame, double gainDb, float peak) {
+    Mp3FrameHeader header;
+    if (!parseMp3FrameHeader(frame->data(), frame->size(), &header)) {
+        return false;
+    }
+    unsigned char* out = frame->data();
+    const size_t xing = xingOffset(out, frame->size(), header);
+    const size_t offset = xing > 0 ? lameOffset(out, frame->size(), xing) : 0;
+    if (offset == 0) {
+        return false;
+    }
+    unsigned char* lame = out + offset;
+    // Peak as a fixed-point fraction of full scale with 23 fraction bits
+    putBe(lame + 11, (unsigned long long)(std::min(peak, 255.0f) * 8388608.0f + 0.5f), 4);
+    // Radio (track) gain, set automatically, in 0.1 dB with a sign bit
+    const int tenths = std::min(511, (int)(std::fabs(gainDb) * 10.0 + 0.5));
+    putBe(lame + 15, (unsigned long long)(0x2000 | 0x0C00 | (gainDb < 0.0 ? 0x0200 : 0) | tenths), 2);
+    putBe(lame + 34, crc16(out, offset + kLameBytes - 2), 2);
+    return true;
+}
+
+bool parseInfoFrame(const unsigned char* frame, size_t size, InfoTag* tag, bool* hasLameTag) {
+    Mp3FrameHeader header;
+    if (!parseMp3FrameHeader(frame, size, &header) || size < (size_t)header.frameBytes) {
+        return false;
+    }
+    *tag = InfoTag();
+    *hasLameTag = false;
+    const size_t xing = xingOffset(frame, size, header);
+    if (xing > 0) {
+        const unsigned char flags = frame[xing + 7];
+        if (!(flags & 1)) {
+            return false;
+        }
+        tag->frames = (long long)getBe(frame + xing + 8, 4);
+        // The byte count includes the tag frame
+        const long long bytes = (flags & 2) ? (long long)getBe(frame + xing + 12, 4) : 0;
+        tag->audioBytes = std::max(0LL, bytes - header.frameBytes);
+        const size_t quality = xing + 12 + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0);
+        if ((flags & 8) && quality + 4 <= size) {
+            // LAME stores 100 - 10 * VBR quality - quality
+            tag->quality = (int)((100 - std::min<unsigned long long>(100, getBe(frame + quality, 4))) % 10);
+        }
+        const size_t lame = lameOffset(frame, size, xing);
+        if (lame > 0) {
+            tag->lowpassHz = frame[lame + 10] * 100;
+            tag->encoderDelay = (frame[lame + 21] << 4) | (frame[lame + 22] >> 4);
+            tag->padding = ((frame[lame + 22] & 0x0F) << 8) | frame[lame + 23];
+            *hasLameTag = true;
+        }
+        return true;
+    }
+    // Fraunhofer's VBRI tag sits 32 bytes after the header whatever the mode
+    if (size >= 4 + 32 + 18 && memcmp(frame + 36, "VBRI", 4) == 0) {
+        tag->encoderDelay = (int)getBe(frame + 42, 2);
+        tag->audioBytes = std::max(0LL, (long long)getBe(frame + 46, 4) - header.frameBytes);
+        tag->frames = (long long)getBe(frame + 50, 4);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,80 @@
+// MPEG-1/2/2.5 layer III frame headers, and the Xing "Info" + LAME tag frame
+// that carries the length and gapless information of a CBR stream.
+#ifndef WAV_TO_MP3_MP3_FRAME_H
+#define WAV_TO_MP3_MP3_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+struct Mp3FrameHeader {
+    unsigned char raw[4] = {0, 0, 0, 0};
+    int version = 0;       // 1 = MPEG-1, 2 = MPEG-2, 25 = MPEG-2.5
+    int bitrateIndex = 0;
+    int bitrate = 0;       // kbps
+    int sampleRate = 0;
+    int channels = 0;
+    bool padding = false;
+    int frameBytes = 0;
+    int frameSamples = 0;  // 1152 for MPEG-1, 576 otherwise
+};
+
+// Parses the 4-byte header at `data`. Only layer III with a fixed bitrate
+// index (no free format) is accepted.
+bool parseMp3FrameHeader(const unsigned char* data, size_t size, Mp3FrameHeader* header);
+
+// Bytes of the layer III side info behind the header (and CRC, if any).
+int sideInfoBytes(const Mp3FrameHeader& header);
+
+// Layer III bitrates at `sampleRate` up to `ceiling` kbps, ascending; the
+// lowest one even if it is above `ceiling`.
+std::vector<int> mp3Bitrates(int sampleRate, int ceiling);
+
+// Splits `data`, which must consist of whole frames of one stream, into
+// frame offsets. Returns 0, or -1 with a message in `error`.
+int splitMp3Frames(const unsigned char* data, size_t size, std::vector<size_t>* offsets,
+                   std::string* error);
+
+// CRC-16 (polynomial 0x8005, reflected) as used by the LAME tag.
+uint16_t crc16(const unsigned char* data, size_t size, uint16_t crc = 0);
+
+struct InfoTag {
+    long long frames = 0;      // audio frames, not counting the tag frame
+    long long audioBytes = 0;  // bytes of those frames
+    int encoderDelay = 0;      // samples to drop at the start
+    int padding = 0;           // samples to drop at the end
+    int quality = 5;
+    int lowpassHz = 0;
+    int sourceSampleRate = 0;
+    uint16_t musicCrc = 0;     // crc16 over the audio frames
+    // Seek table of a stream whose frames differ in size: the byte position
+    // of each percent of the playing time, in 1/256 of the file. Empty for
+    // CBR, whose table is linear.
+    std::vector<unsigned char> toc;
+};
+
+// Builds the Info tag frame to put in front of a CBR stream whose first
+// audio frame has header `first`, or a Xing tag frame when `tag.toc` is set.
+// Uses a higher bitrate for the tag frame if the audio frames are too small
+// to hold it.
+int buildInfoFrame(const Mp3FrameHeader& first, const InfoTag& tag, std::vector<unsigned char>* frame,
+                   std::string* error);
+
+// Writes a track ReplayGain of `gainDb` and a sample peak of `peak` (1.0 =
+// full scale) into the LAME tag of `frame`, an Info/Xing tag frame, and
+// updates the tag's CRC. Returns false if the frame has no LAME tag.
+bool setReplayGain(std::vector<unsigned char>* frame, double gainDb, float peak);
+
+// Reads the Xing/Info (with an optional LAME tag) or VBRI tag of `frame`,
+// the first frame of a stream: the frame and byte counts, and the encoder
+// delay and padding, plus the quality and lowpass of a LAME tag.
+// `hasLameTag` tells whether the padding is known.
+// Returns false if the frame carries no frame count.
+bool parseInfoFrame(const unsigned char* frame, size_t size, InfoTag* tag, bool* hasLameTag);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_MP3_FRAME_H
@@ -0,0 +1,87 @@
+#include "ogg_writer.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const size_t kMaxSegments = 255;
+// Soft page size limit, about 1 s of low bitrate Opus
+const size_t kTargetPageBytes = 4096;
+
+// CRC-32 with polynomial 0x04c11db7, no reflection, zero initial value
+struct CrcTable {
+    uint32_t entries[256];
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t r = i << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : r << 1;
+            }
+            entries[i] = r;
+        }
+    }
+};
+
+uint32_t oggCrc(const unsigned char* data, size_t size) {
+    static const CrcTable table;
+    uint32_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ table.entries[((crc >> 24) ^ data[i]) & 0xff];
+    }
+    return crc;
+}
+
+void putLe32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+}  // namespace
+
+void OggWriter::addPacket(const unsigned char* data, size_t size, int64_t granule,
+                          std::vector<unsigned char>* out) {
+    size_t lacing = size / 255 + 1;
+    if (segments_.size() + lacing > kMaxSegments ||
+        (!body_.empty() && body_.size() + size > kTargetPageBytes)) {
+        flushPage(out);
+    }
+    for (size_t i = 0; i + 1 < lacing; i++) {
+        segments_.push_back(255);
+    }
+    segments_.push_back((unsigned char)(size % 255));
+    body_.insert(body_.end(), data, data + size);
+    granule_ = granule;
+}
+
+void OggWriter::flushPage(std::vector<unsigned char>* out, bool endOfStream) {
+    if (segments_.empty() && !endOfStream) {
+        return;
+    }
+    size_t start = out->size();
+    out->resize(start + 27 + segments_.size());
+    unsigned char* header = out->data() + start;
+    header[0] = 'O';
+    header[1] = 'g';
+    header[2] = 'g';
+    header[3] = 'S';
+    header[4] = 0;  // version
+    header[5] = (sequence_ == 0 ? 0x02 : 0) | (endOfStream ? 0x04 : 0);
+    putLe32(header + 6, (uint32_t)granule_);
+    putLe32(header + 10, (uint32_t)((uint64_t)granule_ >> 32));
+    putLe32(header + 14, serial_);
+    putLe32(header + 18, sequence_++);
+    putLe32(header + 22, 0);
+    header[26] = (unsigned char)segments_.size();
+    for (size_t i = 0; i < segments_.size(); i++) {
+        header[27 + i] = segments_[i];
+    }
+    out->insert(out->end(), body_.begin(), body_.end());
+    putLe32(out->data() + start + 22, oggCrc(out->data() + start, out->size() - start));
+
+    segments_.clear();
+    body_.clear();
+    granule_ = -1;
+}
+
+}  // namespace wavtomp3
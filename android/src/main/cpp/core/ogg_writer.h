@@ -0,0 +1,35 @@
+// Minimal Ogg page writer for a single logical stream (RFC 3533).
+#ifndef WAV_TO_MP3_OGG_WRITER_H
+#define WAV_TO_MP3_OGG_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wavtomp3 {
+
+class OggWriter {
+public:
+    explicit OggWriter(uint32_t serial) : serial_(serial) {}
+
+    // Queues a packet that ends at `granule`. Full pages are appended to
+    // `out`; packets never span pages, which suits Opus packet sizes.
+    void addPacket(const unsigned char* data, size_t size, int64_t granule,
+                   std::vector<unsigned char>* out);
+
+    // Writes the queued packets as a page, even if it is not full. Use after
+    // header packets, which must end their page, and with `endOfStream` for
+    // the last page.
+    void flushPage(std::vector<unsigned char>* out, bool endOfStream = false);
+
+private:
+    uint32_t serial_;
+    uint32_t sequence_ = 0;
+    int64_t granule_ = -1;  // -1: no packet ends on this page
+    std::vector<unsigned char> segments_;
+    std::vector<unsigned char> body_;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_OGG_WRITER_H
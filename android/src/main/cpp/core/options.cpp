@@ -0,0 +1,264 @@
+#include "options.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+
+#include "log.h"
+#include "log_mel.h"
+#include "peak_pyramid.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+bool parseInt(const std::string& value, int* out) {
+    if (value.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    // JS numbers arrive as doubles ("128" or "128.0")
+    double parsed = strtod(value.c_str(), &end);
+    if (errno != 0 || *end != '\0' || parsed < -2147483648.0 || parsed > 2147483647.0) {
+        return false;
+    }
+    *out = (int)parsed;
+    return true;
+}
+
+bool parseIntInRange(const std::string& key, const std::string& value, int min, int max,
+                     int* out, std::string* error) {
+    int parsed;
+    if (!parseInt(value, &parsed) || parsed < min || parsed > max) {
+        *error = "Invalid " + key + ": " + value;
+        return false;
+    }
+    *out = parsed;
+    return true;
+}
+
+bool parseDoubleInRange(const std::string& key, const std::string& value, double min, double max,
+                        double* out, std::string* error) {
+    char* end = nullptr;
+    errno = 0;
+    double parsed = value.empty() ? 0.0 : strtod(value.c_str(), &end);
+    if (value.empty() || errno != 0 || *end != '\0' || !(parsed >= min && parsed <= max)) {
+        *error = "Invalid " + key + ": " + value;
+        return false;
+    }
+    *out = parsed;
+    return true;
+}
+
+bool parseBool(const std::string& value, bool* out) {
+    // "true"/"false" from Android, "1"/"0" from NSNumber on iOS
+    if (value == "true" || value == "1") {
+        *out = true;
+    } else if (value == "false" || value == "0") {
+        *out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int setOption(ConversionOptions* options, const std::string& key, const std::string& value,
+              std::string* error) {
+    bool ok = true;
+    if (key == "format") {
+        ok = parseFormat(value, &options->format);
+        if (!ok) {
+            *error = "Invalid format: " + value;
+        }
+    } else if (key == "bitrate") {
+        ok = parseIntInRange(key, value, 6, 320, &options->bitrate, error);
+    } else if (key == "quality") {
+        ok = parseIntInRange(key, value, 0, 9, &options->quality, error);
+    } else if (key == "encoder") {
+        ok = parseBackend(value, &options->encoder);
+        if (!ok) {
+            *error = "Invalid encoder: " + value;
+        }
+    } else if (key == "priority") {
+        ok = parsePriority(value, &options->priority);
+        if (!ok) {
+            *error = "Invalid priority: " + value;
+        }
+    } else if (key == "preset") {
+        ok = value == "auto" || value == "manual";
+        if (ok) {
+            options->preset = value == "auto" ? Preset::Auto : Preset::Manual;
+        } else {
+            *error = "Invalid preset: " + value;
+        }
+    } else if (key == "deadlineMs") {
+        ok = parseIntInRange(key, value, 1, 3600000, &options->deadlineMs, error);
+    } else if (key == "calibrationFile") {
+        options->calibrationFile = value;
+    } else if (key == "throughputFile") {
+        options->throughputFile = value;
+    } else if (key == "speechOutput.path") {
+        options->speechOutput.path = value;
+    } else if (key == "speechOutput.format") {
+        ok = value == "wav" || value == "raw";
+        if (ok) {
+            options->speechOutput.wav = value == "wav";
+        } else {
+            *error = "Invalid speechOutput.format: " + value;
+        }
+    } else if (key == "speechOutput.sampleRate") {
+        ok = parseIntInRange(key, value, 8000, 48000, &options->speechOutput.sampleRate, error);
+    } else if (key == "logMel.path") {
+        options->logMel.path = value;
+    } else if (key == "logMel.bands") {
+        ok = parseIntInRange(key, value, 1, kMaxLogMelBands, &options->logMel.bands, error);
+    } else if (key == "logMel.returnData") {
+        ok = parseBool(value, &options->logMel.returnData);
+        if (!ok) {
+            *error = "Invalid logMel.returnData: " + value;
+        }
+    } else if (key == "peaks.path") {
+        options->peaks.path = value;
+    } else if (key == "peaks.samplesPerBin") {
+        ok = parseIntInRange(key, value, 16, 65536, &options->peaks.samplesPerBin, error);
+    } else if (key == "peaks.levels") {
+        ok = parseIntInRange(key, value, 1, kMaxPeakLevels, &options->peaks.levels, error);
+    } else if (key == "peaks.returnData") {
+        ok = parseBool(value, &options->peaks.returnData);
+        if (!ok) {
+            *error = "Invalid peaks.returnData: " + value;
+        }
+    } else if (key == "fingerprint") {
+        ok = parseBool(value, &options->fingerprint);
+        if (!ok) {
+            *error = "Invalid fingerprint: " + value;
+        }
+    } else if (key == "loudness.measure") {
+        ok = parseBool(value, &options->loudness.measure);
+        if (!ok) {
+            *error = "Invalid loudness.measure: " + value;
+        }
+    } else if (key == "loudness.target") {
+        ok = parseDoubleInRange(key, value, -40.0, -5.0, &options->loudness.target, error);
+    } else if (key == "loudness.lookaheadMs") {
+        ok = parseIntInRange(key, value, 0, 10000, &options->loudness.lookaheadMs, error);
+    } else if (key == "loudness.maxGainDb") {
+        ok = parseDoubleInRange(key, value, 0.0, 40.0, &options->loudness.maxGainDb, error);
+    } else if (key == "loudness.replayGain") {
+        ok = parseBool(value, &options->loudness.replayGain);
+        if (!ok) {
+            *error = "Invalid loudness.replayGain: " + value;
+        }
+    } else if (key == "filters.dcRemoval") {
+        ok = parseBool(value, &options->filters.dcRemoval);
+        if (!ok) {
+            *error = "Invalid filters.dcRemoval: " + value;
+        }
+    } else if (key == "filters.highpassHz") {
+        ok = parseIntInRange(key, value, 10, 20000, &options->filters.highpassHz, error);
+    } else if (key == "filters.lowpassHz") {
+        ok = parseIntInRange(key, value, 100, 24000, &options->filters.lowpassHz, error);
+    } else if (key == "filters.gateDb") {
+        ok = parseDoubleInRange(key, value, -100.0, -1.0, &options->filters.gateDb, error);
+    } else if (key == "filters.compressor.thresholdDb") {
+        ok = parseDoubleInRange(key, value, -60.0, -1.0, &options->filters.compressor.thresholdDb, error);
+    } else if (key == "filters.compressor.ratio") {
+        ok = parseDoubleInRange(key, value, 1.0, 20.0, &options->filters.compressor.ratio, error);
+    } else if (key == "filters.compressor.attackMs") {
+        ok = parseIntInRange(key, value, 0, 1000, &options->filters.compressor.attackMs, error);
+    } else if (key == "filters.compressor.releaseMs") {
+        ok = parseIntInRange(key, value, 1, 5000, &options->filters.compressor.releaseMs, error);
+    } else if (key == "filters.compressor.makeupDb") {
+        ok = parseDoubleInRange(key, value, 0.0, 30.0, &options->filters.compressor.makeupDb, error);
+    } else if (key == "filters.gainDb") {
+        ok = parseDoubleInRange(key, value, -40.0, 40.0, &options->filters.gainDb, error);
+    } else if (key == "preview.seconds") {
+        ok = parseDoubleInRange(key, value, 0.0, 86400.0, &options->preview.seconds, error);
+    } else if (key == "preview.bitrate") {
+        ok = parseIntInRange(key, value, 6, 320, &options->preview.bitrate, error);
+    } else if (key == "pcmCache.enabled") {
+        ok = parseBool(value, &options->pcmCache.enabled);
+        if (!ok) {
+            *error = "Invalid pcmCache.enabled: " + value;
+        }
+    } else if (key == "pcmCache.maxBytes") {
+        double maxBytes = 0.0;
+        ok = parseDoubleInRange(key, value, 1e6, 1e12, &maxBytes, error);
+        if (ok) {
+            options->pcmCache.maxBytes = (long long)maxBytes;
+        }
+    } else if (key == "pcmCache.dir") {
+        options->pcmCache.dir = value;
+    } else if (key == "maxBytes" || key == "targetBytes") {
+        double bytes = 0.0;
+        ok = parseDoubleInRange(key, value, 1e3, 1e12, &bytes, error);
+        if (ok) {
+            (key == "maxBytes" ? options->sizeLimit.maxBytes : options->sizeLimit.targetBytes) = (long long)bytes;
+        }
+    } else if (key == "detectMono") {
+        ok = parseBool(value, &options->detectMono);
+        if (!ok) {
+            *error = "Invalid detectMono: " + value;
+        }
+    } else {
+        LOGW("Ignoring unknown option %s", key.c_str());
+    }
+    return ok ? 0 : -1;
+}
+
+int setOutputOptions(const std::vector<std::pair<std::string, std::string>>& fields,
+                     ConversionOptions* options, std::vector<OutputSpec>* outputs,
+                     std::string* error) {
+    static const std::string kPrefix = "outputs.";
+    std::map<int, std::vector<std::pair<std::string, std::string>>> perOutput;
+    for (const auto& field : fields) {
+        const std::string& key = field.first;
+        if (key.compare(0, kPrefix.size(), kPrefix) != 0) {
+            if (setOption(options, key, field.second, error) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        size_t dot = key.find('.', kPrefix.size());
+        int index;
+        if (dot == std::string::npos ||
+            !parseIntInRange(key, key.substr(kPrefix.size(), dot - kPrefix.size()), 0,
+                             kMaxOutputs - 1, &index, error)) {
+            *error = "Invalid output option: " + key;
+            return -1;
+        }
+        perOutput[index].emplace_back(key.substr(dot + 1), field.second);
+    }
+
+    outputs->clear();
+    for (const auto& entry : perOutput) {
+        if (entry.first != (int)outputs->size()) {
+            *error = "Missing output " + std::to_string(outputs->size());
+            return -1;
+        }
+        OutputSpec output;
+        output.options = *options;
+        for (const auto& field : entry.second) {
+            if (field.first == "path") {
+                output.path = field.second;
+            } else if (setOption(&output.options, field.first, field.second, error) != 0) {
+                return -1;
+            }
+        }
+        if (output.path.empty()) {
+            *error = "outputs." + std::to_string(entry.first) + ".path is required";
+            return -1;
+        }
+        outputs->push_back(output);
+    }
+    if (outputs->empty()) {
+        *error = "No outputs given";
+        return -1;
+    }
+    return 0;
+}
+
+}  // namespace wavtomp3
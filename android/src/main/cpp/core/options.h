@@ -0,0 +1,116 @@
+// Conversion options shared by every platform. The JS layer passes them as
+// a flat list of key/value strings so the glue code stays free of parsing.
+#ifndef WAV_TO_MP3_OPTIONS_H
+#define WAV_TO_MP3_OPTIONS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio_source.h"
+#include "encoder.h"
+#include "filter_graph.h"
+#include "loudness.h"
+#include "pcm_cache.h"
+#include "size_limit.h"
+#include "worker_pool.h"
+
+namespace wavtomp3 {
+
+enum class Preset {
+    Manual,  // the job's settings and the defaults
+    Auto,    // chosen from the content, see content_analysis.h
+};
+
+// 16-bit mono PCM written alongside the encoded output, see pcm_writer.h
+struct SpeechOutputOptions {
+    std::string path;  // empty: none
+    bool wav = true;   // false: headerless samples
+    int sampleRate = 16000;
+};
+
+// Log-mel features computed while encoding, see log_mel.h
+struct LogMelOptions {
+    std::string path;         // feature file; empty: none
+    bool returnData = false;  // also return the features in the result
+    int bands = 64;
+
+    bool enabled() const { return !path.empty() || returnData; }
+};
+
+// Waveform peaks computed while encoding, see peak_pyramid.h
+struct PeakOptions {
+    std::string path;         // sidecar file; empty: none
+    bool returnData = false;  // also return the peaks in the result
+    int samplesPerBin = 256;  // level 0, in frames
+    int levels = 3;           // each 4x coarser than the one below
+
+    bool enabled() const { return !path.empty() || returnData; }
+};
+
+// Quick first pass of a two-phase job, see convertFilePreview()
+struct PreviewOptions {
+    double seconds = 0.0;  // leading audio to encode; 0: all of it
+    int bitrate = -1;      // -1: kPreviewBitrate, or the job's if lower
+};
+
+struct ConversionOptions {
+    OutputFormat format = OutputFormat::Mp3;
+    int bitrate = -1;  // -1: defaultBitrate(format)
+    int quality = 5;
+    int lowpassHz = -1;
+    int highpassHz = -1;
+    EncoderBackend encoder = EncoderBackend::Auto;
+    JobPriority priority = JobPriority::Interactive;
+    // Encode stereo whose channels are identical as mono
+    bool detectMono = true;
+    Preset preset = Preset::Manual;
+    // Pick the best quality predicted to finish within this time; 0 = off
+    int deadlineMs = 0;
+    // Device calibration (calibration.h), supplied by the platform glue
+    std::string calibrationFile;
+    // Encode speed learned from finished jobs (estimate.h), supplied by the
+    // platform glue
+    std::string throughputFile;
+    SpeechOutputOptions speechOutput;
+    LogMelOptions logMel;
+    PeakOptions peaks;
+    // Perceptual fingerprint in the result, see fingerprint.h
+    bool fingerprint = false;
+    LoudnessOptions loudness;
+    // Preprocessing before the encoder, see filter_graph.h
+    FilterOptions filters;
+    PreviewOptions preview;
+    // Decoded AAC/M4A kept for later jobs on the same input, see pcm_cache.h
+    PcmCacheOptions pcmCache;
+    // Output size cap and target, met in one pass, see size_limit.h
+    SizeLimitOptions sizeLimit;
+    // Layout assumed for inputs without a WAV header
+    AudioFormat rawFormat = {44100, 1, SampleFormat::S16};
+};
+
+// One output of a fan-out job, see convertSourceMulti().
+struct OutputSpec {
+    std::string path;
+    ConversionOptions options;
+};
+
+// Outputs one fan-out job may write
+const int kMaxOutputs = 8;
+
+// Applies one option. Unknown keys are ignored so older native code keeps
+// working with newer JS. Returns 0, or -1 with a message in `error` when the
+// value is invalid.
+int setOption(ConversionOptions* options, const std::string& key, const std::string& value,
+              std::string* error);
+
+// Applies the flat options of a fan-out job. "outputs.N.path" names output N
+// and "outputs.N.KEY" sets KEY for that output only; the other keys go to
+// `options`, which every output starts from. Outputs are numbered from 0.
+int setOutputOptions(const std::vector<std::pair<std::string, std::string>>& fields,
+                     ConversionOptions* options, std::vector<OutputSpec>* outputs,
+                     std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_OPTIONS_H
@@ -0,0 +1,231 @@
+// Ogg/Opus encoding with libopus, framed by our own Ogg writer.
+#include "encoder.h"
+
+#ifdef WAV_TO_MP3_HAVE_OPUS
+
+#include <opus.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "log.h"
+#include "ogg_writer.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Opus timestamps are always in 48 kHz samples
+const int kGranuleRate = 48000;
+const int kFrameMs = 20;
+const int kMaxPacketBytes = 1275 * 3 + 7;
+const char* const kVendor = "react-native-wav-to-mp3";
+// Files hold a single logical stream, so any fixed serial number will do
+const uint32_t kStreamSerial = 0x57544d33;
+
+void appendLe16(std::vector<unsigned char>* out, int value) {
+    out->push_back((unsigned char)value);
+    out->push_back((unsigned char)(value >> 8));
+}
+
+void appendLe32(std::vector<unsigned char>* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((unsigned char)(value >> (8 * i)));
+    }
+}
+
+class OggOpusEncoder : public Encoder {
+public:
+    OggOpusEncoder() : ogg_(kStreamSerial) {}
+
+    ~OggOpusEncoder() override {
+        if (opus_) {
+            opus_encoder_destroy(opus_);
+        }
+    }
+
+    const char* name() const override { return "opus"; }
+
+    int open(const EncoderConfig& config, std::string* error) override {
+        int status = OPUS_OK;
+        opus_ = opus_encoder_create(config.sampleRate, config.channels, OPUS_APPLICATION_AUDIO, &status);
+        if (status != OPUS_OK) {
+            opus_ = nullptr;
+            *error = std::string("Failed to initialize Opus encoder: ") + opus_strerror(status);
+            return -1;
+        }
+        channels_ = config.channels;
+        sampleRate_ = config.sampleRate;
+        frameSize_ = config.sampleRate * kFrameMs / 1000;
+
+        opus_encoder_ctl(opus_, OPUS_SET_BITRATE(config.bitrate * 1000));
+        if (config.constantBitrate) {
+            opus_encoder_ctl(opus_, OPUS_SET_VBR(0));
+        }
+        // quality 0 (best) .. 9 (fastest) onto complexity 10 .. 1
+        opus_encoder_ctl(opus_, OPUS_SET_COMPLEXITY(std::max(1, 10 - config.quality)));
+        opus_int32 lookahead = 0;
+        opus_encoder_ctl(opus_, OPUS_GET_LOOKAHEAD(&lookahead));
+        preSkip_ = (int)((long long)lookahead * kGranuleRate / sampleRate_);
+        lookahead_ = lookahead;
+        LOGI("Opus: %d Hz, %d ch, %d kbps, complexity %d, pre-skip %d", config.sampleRate,
+             config.channels, config.bitrate, std::max(1, 10 - config.quality), preSkip_);
+
+        sourceRate_ = config.sourceSampleRate > 0 ? config.sourceSampleRate : config.sampleRate;
+        writeHeaders(sourceRate_);
+        pending_.reserve((size_t)frameSize_ * channels_);
+        packet_.resize(kMaxPacketBytes);
+        return 0;
+    }
+
+    int encode(const float* pcm, int frames, std::vector<unsigned char>* out) override {
+        flushHeaders(out);
+        inputFrames_ += frames;
+        return push(pcm, (size_t)frames * channels_, out);
+    }
+
+    int finish(std::vector<unsigned char>* out) override {
+        flushHeaders(out);
+        // Feed the encoder's lookahead as silence so the tail is coded, then
+        // pad to a whole frame; the final granule position trims the excess.
+        std::vector<float> silence((size_t)lookahead_ * channels_, 0.0f);
+        if (push(silence.data(), silence.size(), out) != 0) {
+            return -1;
+        }
+        if (!pending_.empty()) {
+            pending_.resize((size_t)frameSize_ * channels_, 0.0f);
+            if (encodeFrame(out) != 0) {
+                return -1;
+            }
+        }
+        if (lastPacket_.empty()) {
+            ogg_.flushPage(out, true);
+            return 0;
+        }
+        writeLastPacket(out);
+        return 0;
+    }
+
+    int reset() override {
+        if (opus_encoder_ctl(opus_, OPUS_RESET_STATE) != OPUS_OK) {
+            return -1;
+        }
+        ogg_ = OggWriter(kStreamSerial);
+        inputFrames_ = 0;
+        encodedFrames_ = 0;
+        lastGranule_ = 0;
+        pending_.clear();
+        lastPacket_.clear();
+        headers_.clear();
+        writeHeaders(sourceRate_);
+        return 0;
+    }
+
+    int setBitrate(int bitrate) override {
+        return opus_encoder_ctl(opus_, OPUS_SET_BITRATE(bitrate * 1000)) == OPUS_OK ? 0 : -1;
+    }
+
+private:
+    void writeHeaders(int sourceRate) {
+        std::vector<unsigned char> head = {'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1};
+        head.push_back((unsigned char)channels_);
+        appendLe16(&head, preSkip_);
+        appendLe32(&head, (uint32_t)sourceRate);
+        appendLe16(&head, 0);  // output gain
+        head.push_back(0);     // channel mapping family: mono/stereo
+        ogg_.addPacket(head.data(), head.size(), 0, &headers_);
+        ogg_.flushPage(&headers_);
+
+        std::vector<unsigned char> tags = {'O', 'p', 'u', 's', 'T', 'a', 'g', 's'};
+        size_t vendorLength = strlen(kVendor);
+        appendLe32(&tags, (uint32_t)vendorLength);
+        tags.insert(tags.end(), kVendor, kVendor + vendorLength);
+        appendLe32(&tags, 0);  // no user comments
+        ogg_.addPacket(tags.data(), tags.size(), 0, &headers_);
+        ogg_.flushPage(&headers_);
+    }
+
+    void flushHeaders(std::vector<unsigned char>* out) {
+        if (!headers_.empty()) {
+            out->insert(out->end(), headers_.begin(), headers_.end());
+            headers_.clear();
+        }
+    }
+
+    int push(const float* pcm, size_t count, std::vector<unsigned char>* out) {
+        const size_t frameSamples = (size_t)frameSize_ * channels_;
+        size_t offset = 0;
+        while (offset < count) {
+            size_t take = std::min(count - offset, frameSamples - pending_.size());
+            pending_.insert(pending_.end(), pcm + offset, pcm + offset + take);
+            offset += take;
+            if (pending_.size() == frameSamples && encodeFrame(out) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // The previous packet is held back one frame so the last one can carry
+    // the end-of-stream flag and trimmed granule position.
+    int encodeFrame(std::vector<unsigned char>* out) {
+        int bytes = opus_encode_float(opus_, pending_.data(), frameSize_, packet_.data(),
+                                      (opus_int32)packet_.size());
+        pending_.clear();
+        if (bytes < 0) {
+            LOGE("opus_encode_float failed: %s", opus_strerror(bytes));
+            return -1;
+        }
+        if (!lastPacket_.empty()) {
+            ogg_.addPacket(lastPacket_.data(), lastPacket_.size(), lastGranule_, out);
+        }
+        lastPacket_.assign(packet_.begin(), packet_.begin() + bytes);
+        encodedFrames_ += frameSize_;
+        lastGranule_ = preSkip_ + encodedFrames_ * kGranuleRate / sampleRate_;
+        return 0;
+    }
+
+    void writeLastPacket(std::vector<unsigned char>* out) {
+        // End trimming: the last granule position marks the real end of audio
+        int64_t end = preSkip_ + inputFrames_ * kGranuleRate / sampleRate_;
+        ogg_.addPacket(lastPacket_.data(), lastPacket_.size(), std::min(end, lastGranule_), out);
+        ogg_.flushPage(out, true);
+        lastPacket_.clear();
+    }
+
+    OpusEncoder* opus_ = nullptr;
+    OggWriter ogg_;
+    int channels_ = 0;
+    int sampleRate_ = 0;
+    int frameSize_ = 0;
+    int preSkip_ = 0;
+    int lookahead_ = 0;
+    int sourceRate_ = 0;
+    long long inputFrames_ = 0;
+    long long encodedFrames_ = 0;
+    int64_t lastGranule_ = 0;
+    std::vector<float> pending_;
+    std::vector<unsigned char> packet_;
+    std::vector<unsigned char> lastPacket_;
+    std::vector<unsigned char> headers_;
+};
+
+}  // namespace
+
+std::unique_ptr<Encoder> createOpusEncoder() {
+    return std::unique_ptr<Encoder>(new OggOpusEncoder());
+}
+
+}  // namespace wavtomp3
+
+#else
+
+namespace wavtomp3 {
+
+std::unique_ptr<Encoder> createOpusEncoder() {
+    return nullptr;
+}
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_HAVE_OPUS
@@ -0,0 +1,558 @@
+#include "pcm_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <vector>
+
+#include "log.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Entry layout: "WPCM", version, channels, two reserved bytes, the sample
+// rate (u32) and frame count (u64), then blocks of a u32 payload size, a
+// u32 frame count and the payload. Integers are little-endian.
+const char kMagic[4] = {'W', 'P', 'C', 'M'};
+const int kVersion = 1;
+const int kHeaderBytes = 20;
+const int kBlockHeaderBytes = 8;
+const char kEntrySuffix[] = ".wpcm";
+const char kPartInfix[] = ".wpcm.part";
+// Leftovers of a store that never finished are removed after this
+const int kStalePartSeconds = 3600;
+
+const int kBlockFrames = 4096;
+const int kPartitionSamples = 256;
+const int kMaxChannels = 8;
+const int kOrderBits = 2;       // fixed predictor order 0 to 3
+const int kRiceParameterBits = 5;
+const int kMaxRiceParameter = 20;
+// A Rice quotient this large is written as an escape and the raw value. An
+// order-3 residual of 16-bit samples is below 2^18, so its zigzag code fits
+// in 20 bits.
+const int kEscapeQuotient = 24;
+const int kRawBits = 20;
+
+const size_t kHashChunkBytes = 64 * 1024;
+
+std::mutex evictMutex;
+std::atomic<unsigned> partCount(0);
+
+void putLe32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+uint32_t getLe32(const unsigned char* in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// MSB first, as FLAC
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>* out) : out_(out) {}
+
+    // `bits` up to 32
+    void put(uint32_t value, int bits) {
+        acc_ = (acc_ << bits) | value;
+        count_ += bits;
+        while (count_ >= 8) {
+            count_ -= 8;
+            out_->push_back((unsigned char)(acc_ >> count_));
+        }
+    }
+
+    void flush() {
+        if (count_ > 0) {
+            out_->push_back((unsigned char)(acc_ << (8 - count_)));
+            count_ = 0;
+        }
+    }
+
+private:
+    std::vector<unsigned char>* out_;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size) : data_(data), size_(size) {}
+
+    // `bits` up to 32
+    uint32_t get(int bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        refill();
+        uint32_t value = (uint32_t)(acc_ >> (64 - bits));
+        acc_ <<= bits;
+        count_ -= bits;
+        return value;
+    }
+
+    // Zero bits before the next one bit, which is consumed; -1 if there are
+    // more than `limit`
+    int unary(int limit) {
+        refill();
+        if ((acc_ >> (63 - limit)) == 0) {
+            return -1;
+        }
+        int zeros = __builtin_clzll(acc_);
+        acc_ <<= zeros + 1;
+        count_ -= zeros + 1;
+        return zeros;
+    }
+
+    // Whether more bits were read than the data holds
+    bool overrun() const { return pos_ * 8 - count_ > size_ * 8; }
+
+private:
+    void refill() {
+        while (count_ <= 56) {
+            uint64_t byte = pos_ < size_ ? data_[pos_] : 0;
+            acc_ |= byte << (56 - count_);
+            pos_++;
+            count_ += 8;
+        }
+    }
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+};
+
+uint32_t zigzag(int value) {
+    return value >= 0 ? (uint32_t)value << 1 : ((uint32_t)(-(value + 1)) << 1) | 1;
+}
+
+int unzigzag(uint32_t value) {
+    return (value & 1) ? -(int)(value >> 1) - 1 : (int)(value >> 1);
+}
+
+// Residual of `x` at `i` under the fixed predictor of `order`
+int fixedResidual(const short* x, int stride, int i, int order) {
+    const int s0 = x[i * stride];
+    switch (order) {
+        case 0: return s0;
+        case 1: return s0 - x[(i - 1) * stride];
+        case 2: return s0 - 2 * x[(i - 1) * stride] + x[(i - 2) * stride];
+        default: return s0 - 3 * x[(i - 1) * stride] + 3 * x[(i - 2) * stride] - x[(i - 3) * stride];
+    }
+}
+
+// One channel of a block: the predictor order, its warm-up samples verbatim
+// and the Rice coded residual
+void encodeChannel(const short* pcm, int stride, int frames, std::vector<uint32_t>* codes, BitWriter* out) {
+    // The order whose residual is smallest over the samples all orders predict
+    long long sums[4] = {0, 0, 0, 0};
+    for (int i = 3; i < frames; i++) {
+        const int s0 = pcm[i * stride], s1 = pcm[(i - 1) * stride];
+        const int s2 = pcm[(i - 2) * stride], s3 = pcm[(i - 3) * stride];
+        sums[0] += std::abs(s0);
+        sums[1] += std::abs(s0 - s1);
+        sums[2] += std::abs(s0 - 2 * s1 + s2);
+        sums[3] += std::abs(s0 - 3 * s1 + 3 * s2 - s3);
+    }
+    int order = (int)(std::min_element(sums, sums + 4) - sums);
+    order = std::min(order, frames);
+
+    out->put((uint32_t)order, kOrderBits);
+    for (int i = 0; i < order; i++) {
+        out->put((uint16_t)pcm[i * stride], 16);
+    }
+    codes->resize(frames);
+    for (int i = order; i < frames; i++) {
+        (*codes)[i] = zigzag(fixedResidual(pcm, stride, i, order));
+    }
+    for (int start = order; start < frames; start += kPartitionSamples) {
+        const int end = std::min(start + kPartitionSamples, frames);
+        uint64_t sum = 0;
+        for (int i = start; i < end; i++) {
+            sum += (*codes)[i];
+        }
+        // The parameter near log2 of the mean, as FLAC estimates it
+        int k = 0;
+        while (k < kMaxRiceParameter && ((uint64_t)(end - start) << (k + 1)) < sum) {
+            k++;
+        }
+        out->put((uint32_t)k, kRiceParameterBits);
+        for (int i = start; i < end; i++) {
+            const uint32_t code = (*codes)[i];
+            const uint32_t quotient = code >> k;
+            if (quotient < (uint32_t)kEscapeQuotient) {
+                out->put(1, (int)quotient + 1);
+                out->put(code & ((1u << k) - 1), k);
+            } else {
+                out->put(1, kEscapeQuotient + 1);
+                out->put(code, kRawBits);
+            }
+        }
+    }
+}
+
+bool decodeChannel(BitReader* in, short* pcm, int stride, int frames) {
+    const int order = (int)in->get(kOrderBits);
+    if (order > frames) {
+        return false;
+    }
+    for (int i = 0; i < order; i++) {
+        pcm[i * stride] = (short)in->get(16);
+    }
+    for (int start = order; start < frames; start += kPartitionSamples) {
+        const int end = std::min(start + kPartitionSamples, frames);
+        const int k = (int)in->get(kRiceParameterBits);
+        if (k > kMaxRiceParameter) {
+            return false;
+        }
+        for (int i = start; i < end; i++) {
+            const int quotient = in->unary(kEscapeQuotient);
+            if (quotient < 0) {
+                return false;
+            }
+            const uint32_t code = quotient == kEscapeQuotient ? in->get(kRawBits)
+                                                             : ((uint32_t)quotient << k) | in->get(k);
+            const int residual = unzigzag(code);
+            int prediction = 0;
+            switch (order) {
+                case 1: prediction = pcm[(i - 1) * stride]; break;
+                case 2: prediction = 2 * pcm[(i - 1) * stride] - pcm[(i - 2) * stride]; break;
+                case 3:
+                    prediction = 3 * pcm[(i - 1) * stride] - 3 * pcm[(i - 2) * stride] + pcm[(i - 3) * stride];
+                    break;
+            }
+            pcm[i * stride] = (short)(prediction + residual);
+        }
+    }
+    return !in->overrun();
+}
+
+// Largest payload a valid block of `frames` can have: every sample escaped
+size_t maxPayloadBytes(int frames, int channels) {
+    const size_t channelBits = (size_t)frames * (kEscapeQuotient + 1 + kRawBits) + kOrderBits + 16 * 3 +
+                               (size_t)(frames / kPartitionSamples + 1) * kRiceParameterBits;
+    return channelBits * channels / 8 + 1;
+}
+
+class CachedPcmSource : public AudioSource {
+public:
+    CachedPcmSource(FILE* file, const AudioFormat& format, long long frames)
+        : file_(file), format_(format), totalFrames_(frames) {}
+    ~CachedPcmSource() override { fclose(file_); }
+
+    const AudioFormat& format() const override { return format_; }
+    long long totalFrames() const override { return totalFrames_; }
+
+    long read(float* out, long maxFrames) override {
+        raw_.resize((size_t)maxFrames * format_.channels);
+        long got = readRaw(raw_.data(), maxFrames);
+        if (got > 0) {
+            convertToFloat(raw_.data(), SampleFormat::S16, (size_t)got * format_.channels, 1.0f, out);
+        }
+        return got;
+    }
+
+    bool hasRawSamples() const override { return true; }
+
+    long readRaw(void* out, long maxFrames) override {
+        short* samples = (short*)out;
+        long copied = 0;
+        while (copied < maxFrames) {
+            if (blockPos_ == blockFrames_) {
+                uint32_t bytes, frames;
+                if (!readBlockHeader(&bytes, &frames)) {
+                    break;
+                }
+                if (!decodeBlock(bytes, frames)) {
+                    LOGW("Corrupt block in cached PCM at frame %lld", framesRead_);
+                    return copied > 0 ? copied : -1;
+                }
+            }
+            const long frames = std::min(maxFrames - copied, (long)(blockFrames_ - blockPos_));
+            memcpy(samples + copied * format_.channels, block_.data() + (size_t)blockPos_ * format_.channels,
+                   (size_t)frames * format_.channels * sizeof(short));
+            blockPos_ += (int)frames;
+            framesRead_ += frames;
+            copied += frames;
+        }
+        return copied;
+    }
+
+    // Skips whole blocks by their sizes and decodes the one holding `frame`
+    int seek(long long frame) override {
+        if (frame < 0 || frame > totalFrames_ || fseeko(file_, kHeaderBytes, SEEK_SET) != 0) {
+            return -1;
+        }
+        framesRead_ = 0;
+        blockFrames_ = blockPos_ = 0;
+        while (framesRead_ < frame) {
+            uint32_t bytes, frames;
+            if (!readBlockHeader(&bytes, &frames)) {
+                return -1;
+            }
+            if (framesRead_ + frames <= frame) {
+                if (fseeko(file_, (off_t)bytes, SEEK_CUR) != 0) {
+                    return -1;
+                }
+                framesRead_ += frames;
+                continue;
+            }
+            if (!decodeBlock(bytes, frames)) {
+                return -1;
+            }
+            blockPos_ = (int)(frame - framesRead_);
+            framesRead_ = frame;
+        }
+        return 0;
+    }
+
+    void prefetch() override {
+#if defined(__APPLE__)
+        struct radvisory advice;
+        advice.ra_offset = ftello(file_);
+        advice.ra_count = 0x7FFFFFFF;
+        fcntl(fileno(file_), F_RDADVISE, &advice);
+#else
+        posix_fadvise(fileno(file_), ftello(file_), 0, POSIX_FADV_WILLNEED);
+#endif
+    }
+
+private:
+    bool readBlockHeader(uint32_t* bytes, uint32_t* frames) {
+        unsigned char header[kBlockHeaderBytes];
+        if (fread(header, 1, sizeof(header), file_) != sizeof(header)) {
+            return false;
+        }
+        *bytes = getLe32(header);
+        *frames = getLe32(header + 4);
+        return *frames > 0 && *frames <= (uint32_t)kBlockFrames &&
+               *bytes <= maxPayloadBytes((int)*frames, format_.channels);
+    }
+
+    bool decodeBlock(uint32_t bytes, uint32_t frames) {
+        payload_.resize(bytes);
+        if (fread(payload_.data(), 1, bytes, file_) != bytes) {
+            return false;
+        }
+        block_.resize((size_t)frames * format_.channels);
+        BitReader in(payload_.data(), payload_.size());
+        for (int channel = 0; channel < format_.channels; channel++) {
+            if (!decodeChannel(&in, block_.data() + channel, format_.channels, (int)frames)) {
+                return false;
+            }
+        }
+        blockFrames_ = (int)frames;
+        blockPos_ = 0;
+        return true;
+    }
+
+    FILE* file_;
+    AudioFormat format_;
+    long long totalFrames_;
+    long long framesRead_ = 0;
+    std::vector<unsigned char> payload_;
+    std::vector<short> block_;
+    int blockFrames_ = 0;
+    int blockPos_ = 0;
+    std::vector<short> raw_;
+};
+
+std::string entryPath(const PcmCacheOptions& cache, const std::string& key) {
+    return cache.dir + "/" + key + kEntrySuffix;
+}
+
+bool endsWith(const std::string& text, const char* suffix) {
+    const size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+struct Entry {
+    std::string path;
+    time_t used;
+    long long bytes;
+};
+
+// Removes the least recently used entries until the directory is within
+// cache.maxBytes. `kept` goes last, and only if it alone exceeds the cap.
+void evict(const PcmCacheOptions& cache, const std::string& kept) {
+    std::lock_guard<std::mutex> lock(evictMutex);
+    DIR* dir = opendir(cache.dir.c_str());
+    if (!dir) {
+        return;
+    }
+    std::vector<Entry> entries;
+    long long total = 0;
+    const time_t now = time(nullptr);
+    while (struct dirent* item = readdir(dir)) {
+        const std::string name = item->d_name;
+        const std::string path = cache.dir + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        if (name.find(kPartInfix) != std::string::npos) {
+            if (now - info.st_mtime > kStalePartSeconds) {
+                remove(path.c_str());
+            }
+        } else if (endsWith(name, kEntrySuffix)) {
+            entries.push_back({path, path == kept ? now + 1 : info.st_mtime, (long long)info.st_size});
+            total += info.st_size;
+        }
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.used != b.used ? a.used < b.used : a.path < b.path;
+    });
+    for (const Entry& entry : entries) {
+        if (total <= cache.maxBytes) {
+            break;
+        }
+        if (remove(entry.path.c_str()) == 0) {
+            total -= entry.bytes;
+            LOGI("Evicted cached PCM %s (%lld bytes)", entry.path.c_str(), entry.bytes);
+        }
+    }
+}
+
+}  // namespace
+
+int pcmCacheKey(const std::string& path, std::string* key, std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *error = "Failed to open input file: " + path;
+        return -1;
+    }
+    std::vector<unsigned char> chunk(kHashChunkBytes);
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    long long size = 0;
+    size_t got;
+    while ((got = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+        size += (long long)got;
+        const size_t padded = (got + 7) & ~(size_t)7;
+        memset(chunk.data() + got, 0, padded - got);
+        for (size_t i = 0; i < padded; i += 8) {
+            uint64_t word;
+            memcpy(&word, chunk.data() + i, 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+        *error = "Failed to read input file: " + path;
+        return -1;
+    }
+    char text[48];
+    snprintf(text, sizeof(text), "%016llx-%lld", (unsigned long long)hash, size);
+    *key = text;
+    return 0;
+}
+
+std::unique_ptr<AudioSource> openCachedPcm(const PcmCacheOptions& cache, const std::string& key) {
+    const std::string path = entryPath(cache, key);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+    unsigned char header[kHeaderBytes];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, kMagic, 4) != 0 ||
+        header[4] != kVersion || header[5] < 1 || header[5] > kMaxChannels) {
+        LOGW("Ignoring unreadable cached PCM %s", path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    AudioFormat format;
+    format.sampleRate = (int)getLe32(header + 8);
+    format.channels = header[5];
+    format.sampleFormat = SampleFormat::S16;
+    const long long frames = (long long)((uint64_t)getLe32(header + 12) | (uint64_t)getLe32(header + 16) << 32);
+    // Marks the entry as recently used for eviction
+    utime(path.c_str(), nullptr);
+    return std::unique_ptr<AudioSource>(new CachedPcmSource(file, format, frames));
+}
+
+int storeCachedPcm(const PcmCacheOptions& cache, const std::string& key, AudioSource* source,
+                   std::string* error) {
+    const AudioFormat& format = source->format();
+    if (!source->hasRawSamples() || format.sampleFormat != SampleFormat::S16 || format.channels < 1 ||
+        format.channels > kMaxChannels) {
+        *error = "Only 16-bit PCM of up to 8 channels can be cached";
+        return -1;
+    }
+    if (source->seek(0) != 0) {
+        *error = "Cached PCM needs a source that can seek";
+        return -1;
+    }
+    mkdir(cache.dir.c_str(), 0700);
+    const std::string path = entryPath(cache, key);
+    const std::string partPath = cache.dir + "/" + key + kPartInfix + std::to_string(getpid()) + "." +
+                                 std::to_string(partCount++);
+    FILE* file = fopen(partPath.c_str(), "wb");
+    if (!file) {
+        *error = "Failed to create cache file: " + partPath;
+        return -1;
+    }
+
+    unsigned char header[kHeaderBytes] = {0};
+    memcpy(header, kMagic, 4);
+    header[4] = kVersion;
+    header[5] = (unsigned char)format.channels;
+    putLe32(header + 8, (uint32_t)format.sampleRate);
+    bool written = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    std::vector<short> block((size_t)kBlockFrames * format.channels);
+    std::vector<unsigned char> payload;
+    std::vector<uint32_t> codes;
+    long long frames = 0;
+    long long bytes = kHeaderBytes;
+    long got = 0;
+    while (written && (got = source->readRaw(block.data(), kBlockFrames)) > 0) {
+        payload.resize(kBlockHeaderBytes);
+        BitWriter out(&payload);
+        for (int channel = 0; channel < format.channels; channel++) {
+            encodeChannel(block.data() + channel, format.channels, (int)got, &codes, &out);
+        }
+        out.flush();
+        putLe32(payload.data(), (uint32_t)(payload.size() - kBlockHeaderBytes));
+        putLe32(payload.data() + 4, (uint32_t)got);
+        written = fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+        frames += got;
+        bytes += (long long)payload.size();
+    }
+    putLe32(header + 12, (uint32_t)frames);
+    putLe32(header + 16, (uint32_t)((uint64_t)frames >> 32));
+    written = written && got == 0 && fseeko(file, 0, SEEK_SET) == 0 &&
+              fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    if (fclose(file) != 0 || !written || rename(partPath.c_str(), path.c_str()) != 0) {
+        remove(partPath.c_str());
+        source->seek(0);
+        *error = got < 0 ? "Failed to read the decoded PCM" : "Failed to write cache file: " + path;
+        return -1;
+    }
+    if (source->seek(0) != 0) {
+        *error = "Failed to rewind the decoded PCM";
+        return -1;
+    }
+    LOGI("Cached %lld frames of PCM in %lld bytes (%.0f%%)", frames, bytes,
+         frames > 0 ? 100.0 * bytes / (frames * format.channels * 2) : 0.0);
+    evict(cache, path);
+    return 0;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,53 @@
+// Decoded PCM of compressed inputs, kept so that exporting the same AAC/M4A
+// file again (another bitrate, another format) skips the codec decode.
+//
+// Entries hold 16-bit PCM losslessly compressed the way FLAC does at level
+// 0: blocks of 4096 frames, each channel predicted by the fixed polynomial of
+// order 0 to 3 that fits it best, and the residual Rice coded in partitions
+// of 256 samples with a parameter each. Music typically shrinks to some 60%
+// of its size and speech further, and reading an entry back runs at several
+// hundred times real time, well beyond a MediaCodec decode.
+//
+// Entries are named by a hash of the input's contents, so a copied or
+// renamed file still hits and an edited one misses. A hit refreshes the
+// entry's modification time, and storing an entry removes the least
+// recently used ones until the directory is within its cap.
+#ifndef WAV_TO_MP3_PCM_CACHE_H
+#define WAV_TO_MP3_PCM_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include "audio_source.h"
+
+namespace wavtomp3 {
+
+const long long kDefaultPcmCacheBytes = 256LL * 1024 * 1024;
+
+struct PcmCacheOptions {
+    bool enabled = false;
+    // Directory of the entries, supplied by the platform glue; empty: off
+    std::string dir;
+    long long maxBytes = kDefaultPcmCacheBytes;
+
+    bool active() const { return enabled && !dir.empty(); }
+};
+
+// Cache key of the file at `path`: a 64-bit hash of its contents and its
+// size. Returns 0, or -1 with a message in `error`.
+int pcmCacheKey(const std::string& path, std::string* key, std::string* error);
+
+// Opens the entry for `key` as 16-bit PCM and marks it recently used.
+// Returns nullptr if there is none or it cannot be read.
+std::unique_ptr<AudioSource> openCachedPcm(const PcmCacheOptions& cache, const std::string& key);
+
+// Compresses all of `source`, which must have raw 16-bit samples, into the
+// entry for `key`, then evicts entries beyond cache.maxBytes. `source` is
+// left at its start. Returns 0, or -1 with a message in `error`; a failed
+// store leaves the cache as it was.
+int storeCachedPcm(const PcmCacheOptions& cache, const std::string& key, AudioSource* source,
+                   std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PCM_CACHE_H
@@ -0,0 +1,163 @@
+#include "pcm_pipeline.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "channel_similarity.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Raw samples as unscaled floats; convertToFloat() reads them the same way.
+struct LoadU8 {
+    static float at(const unsigned char* raw, size_t i) { return (float)((int)raw[i] - 128); }
+};
+struct LoadS16 {
+    static float at(const unsigned char* raw, size_t i) { return (float)((const int16_t*)raw)[i]; }
+};
+struct LoadS24 {
+    static float at(const unsigned char* raw, size_t i) {
+        return (float)(int32_t)(((uint32_t)raw[3 * i] << 8) | ((uint32_t)raw[3 * i + 1] << 16) |
+                                ((uint32_t)raw[3 * i + 2] << 24));
+    }
+};
+struct LoadS32 {
+    static float at(const unsigned char* raw, size_t i) { return (float)((const int32_t*)raw)[i]; }
+};
+struct LoadF32 {
+    static float at(const unsigned char* raw, size_t i) { return ((const float*)raw)[i]; }
+};
+
+// `samples` input samples to floats times `scale`, averaging stereo pairs
+// with Downmix. Branch-free so the compiler vectorizes it.
+template <typename Load, bool Downmix>
+void convertKernel(const unsigned char* raw, size_t samples, float scale, float* out) {
+    if (Downmix) {
+        for (size_t i = 0; i < samples / 2; i++) {
+            out[i] = (Load::at(raw, 2 * i) + Load::at(raw, 2 * i + 1)) * scale;
+        }
+    } else {
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = Load::at(raw, i) * scale;
+        }
+    }
+}
+
+template <typename Load>
+void selectKernel(bool downmix, void (**kernel)(const unsigned char*, size_t, float, float*)) {
+    *kernel = downmix ? convertKernel<Load, true> : convertKernel<Load, false>;
+}
+
+const char* sampleFormatName(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::U8: return "u8";
+        case SampleFormat::S16: return "s16";
+        case SampleFormat::S24: return "s24";
+        case SampleFormat::S32: return "s32";
+        case SampleFormat::F32: return "f32";
+    }
+    return "?";
+}
+
+}  // namespace
+
+PcmPipeline::PcmPipeline(const PipelineConfig& config, bool fused)
+    : config_(config),
+      fused_(fused),
+      outputChannels_(config.downmix ? 1 : config.input.channels),
+      frameBytes_(bytesPerSample(config.input.sampleFormat) * config.input.channels) {
+    float scale = 1.0f;
+    switch (config.input.sampleFormat) {
+        case SampleFormat::U8:
+            selectKernel<LoadU8>(config.downmix, &kernel_);
+            scale = 1.0f / 128.0f;
+            break;
+        case SampleFormat::S16:
+            selectKernel<LoadS16>(config.downmix, &kernel_);
+            scale = 1.0f / 32768.0f;
+            break;
+        case SampleFormat::S24:
+            selectKernel<LoadS24>(config.downmix, &kernel_);
+            scale = 1.0f / 2147483648.0f;
+            break;
+        case SampleFormat::S32:
+            selectKernel<LoadS32>(config.downmix, &kernel_);
+            scale = 1.0f / 2147483648.0f;
+            break;
+        case SampleFormat::F32:
+            selectKernel<LoadF32>(config.downmix, &kernel_);
+            break;
+    }
+    scale_ = scale * config.gain * (config.downmix ? 0.5f : 1.0f);
+
+    plan_ = sampleFormatName(config.input.sampleFormat);
+    if (config.gain != 1.0f) {
+        plan_ += "*gain";
+    }
+    if (config.downmix) {
+        plan_ += "+downmix";
+    }
+    if (config.outputRate > 0 && config.outputRate != config.input.sampleRate) {
+        resampler_.reset(new Resampler(config.input.sampleRate, config.outputRate, outputChannels_));
+        plan_ += " > resample " + std::to_string(config.input.sampleRate) + "->" +
+                 std::to_string(config.outputRate);
+    }
+    if (!fused) {
+        plan_ += " (unfused)";
+    }
+}
+
+void PcmPipeline::process(const void* raw, long frames, std::vector<float>* out) {
+    if (fused_) {
+        processFused((const unsigned char*)raw, frames, out);
+    } else {
+        processUnfused((const unsigned char*)raw, frames, out);
+    }
+}
+
+void PcmPipeline::processFused(const unsigned char* raw, long frames, std::vector<float>* out) {
+    const int channels = config_.input.channels;
+    if (!resampler_) {
+        // Nothing after the kernel: it writes the encoder input directly
+        const size_t start = out->size();
+        out->resize(start + (size_t)frames * outputChannels_);
+        kernel_(raw, (size_t)frames * channels, scale_, out->data() + start);
+        return;
+    }
+    tile_.resize((size_t)kPipelineTileFrames * outputChannels_);
+    for (long done = 0; done < frames; done += kPipelineTileFrames) {
+        const long count = std::min(kPipelineTileFrames, frames - done);
+        kernel_(raw + (size_t)done * frameBytes_, (size_t)count * channels, scale_, tile_.data());
+        resampler_->process(tile_.data(), count, out);
+    }
+}
+
+void PcmPipeline::processUnfused(const unsigned char* raw, long frames, std::vector<float>* out) {
+    const int channels = config_.input.channels;
+    block_.resize((size_t)frames * channels);
+    convertToFloat(raw, config_.input.sampleFormat, block_.size(), 1.0f, block_.data());
+    if (config_.gain != 1.0f) {
+        applyGainRamp(block_.data(), (size_t)frames, channels, config_.gain, config_.gain);
+    }
+    const float* pcm = block_.data();
+    if (config_.downmix) {
+        mono_.resize((size_t)frames);
+        downmixStereo(block_.data(), frames, mono_.data());
+        pcm = mono_.data();
+    }
+    if (resampler_) {
+        resampler_->process(pcm, frames, out);
+    } else {
+        out->insert(out->end(), pcm, pcm + (size_t)frames * outputChannels_);
+    }
+}
+
+void PcmPipeline::flush(std::vector<float>* out) {
+    if (resampler_) {
+        resampler_->flush(out);
+    }
+}
+
+}  // namespace wavtomp3
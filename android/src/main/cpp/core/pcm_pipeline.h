@@ -0,0 +1,73 @@
+// Raw PCM to encoder input in one pass.
+//
+// Run one after the other, format conversion, gain, downmix and resampling
+// each stream the whole block through memory again. PcmPipeline compiles the
+// stages a job needs into one conversion kernel, with the gain and the
+// downmix's 1/2 folded into the sample scale, and feeds the resampler from
+// tiles small enough that their floats never leave L1. With gain 1 the
+// output is bit-exact with running the stages separately; with a gain the
+// scale is rounded differently ((a + b) * g/65536 against the stages'
+// 0.5 * (a*g + b*g)/32768 for downmixed s16), so samples may differ in the
+// last bit. Format conversion alone gains nothing from fusing.
+#ifndef WAV_TO_MP3_PCM_PIPELINE_H
+#define WAV_TO_MP3_PCM_PIPELINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_source.h"
+#include "resampler.h"
+
+namespace wavtomp3 {
+
+// Frames per tile of the fused pass
+const long kPipelineTileFrames = 256;
+
+struct PipelineConfig {
+    AudioFormat input;
+    float gain = 1.0f;
+    bool downmix = false;  // stereo to mono
+    int outputRate = 0;    // 0: the input rate
+};
+
+class PcmPipeline {
+public:
+    // `fused` = false runs each stage over the whole block in turn, for
+    // benchmarks.
+    explicit PcmPipeline(const PipelineConfig& config, bool fused = true);
+
+    int outputChannels() const { return outputChannels_; }
+
+    // The compiled stages, e.g. "s16*gain+downmix > resample 44100->16000".
+    const std::string& plan() const { return plan_; }
+
+    // Converts `frames` interleaved frames in the input's sample format and
+    // appends the encoder input that became available to `out`.
+    void process(const void* raw, long frames, std::vector<float>* out);
+
+    // Drains the resampler at the end of the stream.
+    void flush(std::vector<float>* out);
+
+private:
+    typedef void (*Kernel)(const unsigned char* raw, size_t samples, float scale, float* out);
+
+    void processFused(const unsigned char* raw, long frames, std::vector<float>* out);
+    void processUnfused(const unsigned char* raw, long frames, std::vector<float>* out);
+
+    const PipelineConfig config_;
+    const bool fused_;
+    const int outputChannels_;
+    const int frameBytes_;
+    Kernel kernel_;
+    float scale_;
+    std::unique_ptr<Resampler> resampler_;
+    std::vector<float> tile_;
+    std::vector<float> block_;  // unfused: converted block
+    std::vector<float> mono_;   // unfused: downmixed block
+    std::string plan_;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PCM_PIPELINE_H
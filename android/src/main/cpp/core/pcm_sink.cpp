@@ -0,0 +1,100 @@
+#include "pcm_sink.h"
+
+namespace wavtomp3 {
+
+MonoTaps::~MonoTaps() {
+    if (!finished_) {
+        discard();
+    }
+}
+
+void MonoTaps::add(std::unique_ptr<PcmSink> sink) {
+    for (Tap& tap : taps_) {
+        if (tap.rate == sink->sampleRate()) {
+            tap.sinks.push_back(std::move(sink));
+            return;
+        }
+    }
+    Tap tap;
+    tap.rate = sink->sampleRate();
+    if (tap.rate != inRate_) {
+        tap.resampler.reset(new Resampler(inRate_, tap.rate, 1));
+    }
+    tap.sinks.push_back(std::move(sink));
+    taps_.push_back(std::move(tap));
+}
+
+void MonoTaps::share(int rate) {
+    for (const Tap& tap : taps_) {
+        if (tap.rate == rate) {
+            sharedRate_ = rate;
+        }
+    }
+}
+
+int MonoTaps::feed(Tap& tap, const float* mono, long frames, std::string* error) {
+    for (auto& sink : tap.sinks) {
+        if (sink->write(mono, frames, error) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int MonoTaps::write(const float* mono, long frames, std::string* error) {
+    for (Tap& tap : taps_) {
+        if (tap.rate == sharedRate_) {
+            continue;
+        }
+        if (!tap.resampler) {
+            if (feed(tap, mono, frames, error) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        resampled_.clear();
+        tap.resampler->process(mono, frames, &resampled_);
+        if (feed(tap, resampled_.data(), (long)resampled_.size(), error) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int MonoTaps::writeShared(const float* mono, long frames, std::string* error) {
+    for (Tap& tap : taps_) {
+        if (tap.rate == sharedRate_) {
+            return feed(tap, mono, frames, error);
+        }
+    }
+    return 0;
+}
+
+int MonoTaps::finish(std::string* error) {
+    for (Tap& tap : taps_) {
+        if (tap.resampler && tap.rate != sharedRate_) {
+            resampled_.clear();
+            tap.resampler->flush(&resampled_);
+            if (feed(tap, resampled_.data(), (long)resampled_.size(), error) != 0) {
+                return -1;
+            }
+        }
+        for (auto& sink : tap.sinks) {
+            if (sink->finish(error) != 0) {
+                return -1;
+            }
+        }
+    }
+    finished_ = true;
+    return 0;
+}
+
+void MonoTaps::discard() {
+    for (Tap& tap : taps_) {
+        for (auto& sink : tap.sinks) {
+            sink->discard();
+        }
+    }
+}
+
+}  // namespace wavtomp3
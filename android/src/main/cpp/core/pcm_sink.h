@@ -0,0 +1,80 @@
+// Consumers of mono PCM fed from the encode loop: side outputs and analyses
+// that would otherwise need another pass over the input.
+#ifndef WAV_TO_MP3_PCM_SINK_H
+#define WAV_TO_MP3_PCM_SINK_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resampler.h"
+
+namespace wavtomp3 {
+
+class PcmSink {
+public:
+    virtual ~PcmSink() = default;
+
+    // Rate the sink takes its mono PCM at.
+    virtual int sampleRate() const = 0;
+
+    // Consumes `frames` mono frames. Returns 0, or -1 with a message in `error`.
+    virtual int write(const float* mono, long frames, std::string* error) = 0;
+
+    // Called once after the last write(). Returns 0, or -1 with a message
+    // in `error`.
+    virtual int finish(std::string* error) = 0;
+
+    // Removes whatever the sink wrote, also after finish(): the job failed.
+    virtual void discard() {}
+};
+
+// Feeds mono PCM at one rate to sinks at their own rates, with one resampler
+// per distinct rate however many sinks share it.
+class MonoTaps {
+public:
+    explicit MonoTaps(int inRate) : inRate_(inRate) {}
+    ~MonoTaps();
+
+    // Takes ownership of `sink`.
+    void add(std::unique_ptr<PcmSink> sink);
+
+    bool empty() const { return taps_.empty(); }
+
+    // Sinks at `rate` are fed by writeShared() instead of write(), for a
+    // stream the caller already has at that rate (e.g. the encoder's).
+    void share(int rate);
+    bool shares() const { return sharedRate_ > 0; }
+
+    // `frames` mono frames at the input rate.
+    int write(const float* mono, long frames, std::string* error);
+
+    // `frames` mono frames at the shared rate.
+    int writeShared(const float* mono, long frames, std::string* error);
+
+    // Drains the resamplers and finishes every sink. Unless it succeeds, the
+    // sinks are discarded when the taps are destroyed.
+    int finish(std::string* error);
+
+    // Discards every sink, e.g. when the encode failed after finish().
+    void discard();
+
+private:
+    struct Tap {
+        int rate;
+        std::unique_ptr<Resampler> resampler;
+        std::vector<std::unique_ptr<PcmSink>> sinks;
+    };
+
+    int feed(Tap& tap, const float* mono, long frames, std::string* error);
+
+    const int inRate_;
+    int sharedRate_ = 0;
+    std::vector<Tap> taps_;
+    std::vector<float> resampled_;
+    bool finished_ = false;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PCM_SINK_H
@@ -0,0 +1,79 @@
+#include "pcm_writer.h"
+
+#include "sample_convert.h"
+#include "wav_file.h"
+
+namespace wavtomp3 {
+
+PcmWriter::PcmWriter(const std::string& path, bool wav, int sampleRate)
+    : path_(path), wav_(wav), sampleRate_(sampleRate) {}
+
+PcmWriter::~PcmWriter() {
+    if (file_) {
+        discard();
+    }
+}
+
+int PcmWriter::open(std::string* error) {
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        *error = "Failed to open output file: " + path_;
+        return -1;
+    }
+    written_ = true;
+    if (wav_) {
+        // Placeholder until the data size is known
+        unsigned char header[kWavHeaderBytes];
+        buildWavHeader(sampleRate_, 1, 0, header);
+        if (fwrite(header, 1, sizeof(header), file_) != sizeof(header)) {
+            *error = "Failed to write output";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int PcmWriter::write(const float* mono, long frames, std::string* error) {
+    const size_t count = (size_t)frames;
+    samples_.resize(count);
+    convertToS16(mono, count, samples_.data());
+    // The samples are written in host order; every supported target is little-endian
+    if (count > 0 && fwrite(samples_.data(), sizeof(short), count, file_) != count) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    bytes_ += (long long)(count * sizeof(short));
+    return 0;
+}
+
+int PcmWriter::finish(std::string* error) {
+    if (wav_) {
+        unsigned char header[kWavHeaderBytes];
+        buildWavHeader(sampleRate_, 1, bytes_, header);
+        if (fseek(file_, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), file_) != sizeof(header)) {
+            *error = "Failed to write " + path_;
+            return -1;
+        }
+        bytes_ += kWavHeaderBytes;
+    }
+    FILE* file = file_;
+    file_ = nullptr;
+    if (fclose(file) != 0) {
+        *error = "Failed to write " + path_;
+        return -1;
+    }
+    return 0;
+}
+
+void PcmWriter::discard() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    if (written_) {
+        remove(path_.c_str());
+        written_ = false;
+    }
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,42 @@
+// 16-bit mono PCM written next to the encoded file, e.g. 16 kHz for a speech
+// recognizer, from the same pass over the input.
+#ifndef WAV_TO_MP3_PCM_WRITER_H
+#define WAV_TO_MP3_PCM_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pcm_sink.h"
+
+namespace wavtomp3 {
+
+class PcmWriter : public PcmSink {
+public:
+    // Writes mono PCM at `sampleRate` as WAV or as headerless little-endian
+    // samples.
+    PcmWriter(const std::string& path, bool wav, int sampleRate);
+    ~PcmWriter() override;
+
+    int open(std::string* error);
+
+    int sampleRate() const override { return sampleRate_; }
+    int write(const float* mono, long frames, std::string* error) override;
+    int finish(std::string* error) override;
+    void discard() override;
+
+    long long bytes() const { return bytes_; }
+
+private:
+    const std::string path_;
+    const bool wav_;
+    const int sampleRate_;
+    FILE* file_ = nullptr;
+    bool written_ = false;  // the file exists, finished or not
+    long long bytes_ = 0;
+    std::vector<short> samples_;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PCM_WRITER_H
@@ -0,0 +1,194 @@
+#include "peak_pyramid.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kVersion = 1;
+const int kLevelFactor = 4;
+const int kBinBytes = 8;
+// Largest 16-bit sample
+const float kClipLevel = 32767.0f / 32768.0f;
+
+// Min, max, sum of squares and clipped samples of `count` samples. Clipping
+// is only counted sample by sample when the peak reaches full scale.
+void reduce(const float* x, size_t count, float* min, float* max, double* squares, long long* clipped) {
+    simd_f32x4 lo = simd_set1(x[0]);
+    simd_f32x4 hi = lo;
+    simd_f32x4 sum = simd_zero();
+    size_t i = 0;
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        simd_f32x4 v = simd_load(x + i);
+        lo = simd_min(lo, v);
+        hi = simd_max(hi, v);
+        sum = simd_madd(v, v, sum);
+    }
+    float low = simd_hmin(lo);
+    float high = simd_hmax(hi);
+    float squareSum = simd_hsum(sum);
+    for (; i < count; i++) {
+        low = x[i] < low ? x[i] : low;
+        high = x[i] > high ? x[i] : high;
+        squareSum += x[i] * x[i];
+    }
+    *min = low;
+    *max = high;
+    *squares = squareSum;
+    *clipped = 0;
+    if (high >= kClipLevel || -low >= kClipLevel) {
+        for (i = 0; i < count; i++) {
+            *clipped += fabsf(x[i]) >= kClipLevel ? 1 : 0;
+        }
+    }
+}
+
+void putLe16(unsigned char* p, unsigned value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+void putLe32(unsigned char* p, unsigned value) {
+    putLe16(p, value & 0xffff);
+    putLe16(p + 2, value >> 16);
+}
+
+unsigned toSample(double value, double low, double high) {
+    value = floor(value * 32767.0 + 0.5);
+    return (unsigned)(int)(value < low ? low : value > high ? high : value);
+}
+
+}  // namespace
+
+PeakPyramid::PeakPyramid(const std::string& path, int sampleRate, int channels, int framesPerBin, int levels)
+    : path_(path), sampleRate_(sampleRate), channels_(channels), levels_((size_t)levels) {
+    long long frames = framesPerBin;
+    for (Level& level : levels_) {
+        level.framesPerBin = frames;
+        frames *= kLevelFactor;
+    }
+}
+
+void PeakPyramid::add(const float* pcm, long frames) {
+    const long framesPerBin = (long)levels_[0].framesPerBin;
+    while (frames > 0) {
+        const long count = frames < framesPerBin - binFrames_ ? frames : framesPerBin - binFrames_;
+        Bin part;
+        reduce(pcm, (size_t)(count * channels_), &part.min, &part.max, &part.squares, &part.clipped);
+        part.samples = (long long)count * channels_;
+        if (bin_.samples == 0) {
+            bin_ = part;
+        } else {
+            bin_.min = part.min < bin_.min ? part.min : bin_.min;
+            bin_.max = part.max > bin_.max ? part.max : bin_.max;
+            bin_.squares += part.squares;
+            bin_.samples += part.samples;
+            bin_.clipped += part.clipped;
+        }
+        clipped_ += part.clipped;
+        pcm += count * channels_;
+        frames -= count;
+        frames_ += count;
+        binFrames_ += count;
+        if (binFrames_ == framesPerBin) {
+            addBin(0, bin_);
+            bin_ = Bin();
+            binFrames_ = 0;
+        }
+    }
+}
+
+void PeakPyramid::addBin(size_t level, const Bin& bin) {
+    levels_[level].bins.push_back(bin);
+    if (level + 1 == levels_.size()) {
+        return;
+    }
+    Level& up = levels_[level + 1];
+    if (up.merged == 0) {
+        up.pending = bin;
+    } else {
+        up.pending.min = bin.min < up.pending.min ? bin.min : up.pending.min;
+        up.pending.max = bin.max > up.pending.max ? bin.max : up.pending.max;
+        up.pending.squares += bin.squares;
+        up.pending.samples += bin.samples;
+        up.pending.clipped += bin.clipped;
+    }
+    if (++up.merged == kLevelFactor) {
+        up.merged = 0;
+        addBin(level + 1, up.pending);
+    }
+}
+
+int PeakPyramid::finish(std::string* error) {
+    // Partial bins, from the bottom so each reaches the level above
+    if (binFrames_ > 0) {
+        addBin(0, bin_);
+        binFrames_ = 0;
+    }
+    for (size_t i = 1; i < levels_.size(); i++) {
+        if (levels_[i].merged > 0) {
+            levels_[i].merged = 0;
+            addBin(i, levels_[i].pending);
+        }
+    }
+
+    size_t size = kPeakHeaderBytes + levels_.size() * 8;
+    for (const Level& level : levels_) {
+        size += level.bins.size() * kBinBytes;
+    }
+    data_.assign(size, 0);
+    unsigned char* p = data_.data();
+    memcpy(p, "PEAK", 4);
+    putLe16(p + 4, kVersion);
+    putLe16(p + 6, (unsigned)levels_.size());
+    putLe32(p + 8, (unsigned)sampleRate_);
+    putLe16(p + 12, (unsigned)channels_);
+    putLe32(p + 16, (unsigned)frames_);
+    p += kPeakHeaderBytes;
+    for (const Level& level : levels_) {
+        putLe32(p, (unsigned)level.framesPerBin);
+        putLe32(p + 4, (unsigned)level.bins.size());
+        p += 8;
+    }
+    for (const Level& level : levels_) {
+        for (const Bin& bin : level.bins) {
+            const double rms = bin.samples > 0 ? sqrt(bin.squares / (double)bin.samples) : 0.0;
+            putLe16(p, toSample(bin.min, -32768.0, 32767.0));
+            putLe16(p + 2, toSample(bin.max, -32768.0, 32767.0));
+            putLe16(p + 4, toSample(rms, 0.0, 65535.0));
+            putLe16(p + 6, (unsigned)(bin.clipped < 65535 ? bin.clipped : 65535));
+            p += kBinBytes;
+        }
+    }
+
+    if (path_.empty()) {
+        return 0;
+    }
+    FILE* file = fopen(path_.c_str(), "wb");
+    if (!file) {
+        *error = "Failed to open output file: " + path_;
+        return -1;
+    }
+    written_ = true;
+    const bool ok = fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+    if (fclose(file) != 0 || !ok) {
+        *error = "Failed to write " + path_;
+        discard();
+        return -1;
+    }
+    return 0;
+}
+
+void PeakPyramid::discard() {
+    if (written_) {
+        remove(path_.c_str());
+        written_ = false;
+    }
+}
+
+}  // namespace wavtomp3
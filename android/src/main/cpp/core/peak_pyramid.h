@@ -0,0 +1,84 @@
+// Multi-resolution min/max/RMS peaks of the input, built in the encode loop
+// so a waveform view can zoom without reading the audio again.
+//
+// Level 0 has one bin per `framesPerBin` frames, each further level one per
+// four bins of the level below. Every channel goes into the same bins. The
+// sidecar, and the bytes returned in the result, are little-endian:
+//
+//   0   "PEAK"
+//   4   u16 version (1)
+//   6   u16 levels
+//   8   u32 sample rate
+//   12  u16 channels
+//   14  u16 reserved (0)
+//   16  u32 frames
+//   20  per level: u32 frames per bin, u32 bins
+//   ..  per level, per bin: i16 min, i16 max, u16 RMS, u16 clipped samples
+//
+// Peaks and RMS are scaled to 32767 = full scale; clip counts saturate at
+// 65535. The last bin of a level may cover fewer frames.
+#ifndef WAV_TO_MP3_PEAK_PYRAMID_H
+#define WAV_TO_MP3_PEAK_PYRAMID_H
+
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+const int kPeakHeaderBytes = 20;
+const int kMaxPeakLevels = 8;
+
+class PeakPyramid {
+public:
+    // Writes the sidecar to `path` unless it is empty.
+    PeakPyramid(const std::string& path, int sampleRate, int channels, int framesPerBin, int levels);
+
+    // Accumulates `frames` interleaved frames.
+    void add(const float* pcm, long frames);
+
+    // Closes the partial bins and writes the sidecar. Returns 0, or -1 with
+    // a message in `error`.
+    int finish(std::string* error);
+
+    // Removes the sidecar, e.g. when the encode failed after finish().
+    void discard();
+
+    // Samples at or beyond full scale, every channel counted.
+    long long clippedSamples() const { return clipped_; }
+
+    // Header and bins in the sidecar layout; valid after finish().
+    const std::vector<unsigned char>& data() const { return data_; }
+
+private:
+    struct Bin {
+        float min = 0.0f;
+        float max = 0.0f;
+        double squares = 0.0;
+        long long samples = 0;
+        long long clipped = 0;
+    };
+
+    struct Level {
+        long long framesPerBin;
+        std::vector<Bin> bins;
+        Bin pending;
+        int merged = 0;  // bins of the level below in `pending`
+    };
+
+    void addBin(size_t level, const Bin& bin);
+
+    const std::string path_;
+    const int sampleRate_;
+    const int channels_;
+    std::vector<Level> levels_;
+    Bin bin_;            // level 0 bin being filled
+    long binFrames_ = 0;
+    long long frames_ = 0;
+    long long clipped_ = 0;
+    std::vector<unsigned char> data_;
+    bool written_ = false;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PEAK_PYRAMID_H
@@ -0,0 +1,501 @@
+#include "probe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "mp3_frame.h"
+#include "wav_file.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kAdtsSampleRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                  22050, 16000, 12000, 11025, 8000,  7350};
+// Frames read from an ADTS stream or an untagged MP3 to estimate the rest
+const int kSampleFrames = 32;
+// How far past any ID3v2 tag to look for the first MP3 frame
+const size_t kSyncSearchBytes = 64 * 1024;
+// Tail read for the last Ogg page
+const size_t kOggTailBytes = 64 * 1024;
+
+uint16_t readBe16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t readBe32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint64_t readBe64(const unsigned char* p) {
+    return ((uint64_t)readBe32(p) << 32) | readBe32(p + 4);
+}
+
+uint32_t readLe32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t readLe64(const unsigned char* p) {
+    return (uint64_t)readLe32(p) | ((uint64_t)readLe32(p + 4) << 32);
+}
+
+size_t readAt(FILE* file, long long offset, void* out, size_t size) {
+    if (offset < 0 || fseeko(file, (off_t)offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    return fread(out, 1, size, file);
+}
+
+long long fileSize(FILE* file) {
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    return (long long)ftello(file);
+}
+
+// Fills in the duration and, if not known from the header, the bitrate of
+// `audioBytes` of audio
+void finish(MediaInfo* info, long long audioBytes) {
+    if (info->frames < 0 || info->sampleRate <= 0) {
+        return;
+    }
+    info->durationMs = info->frames * 1000.0 / info->sampleRate;
+    if (info->bitrate == 0 && audioBytes > 0 && info->durationMs > 0.0) {
+        info->bitrate = (int)std::lround(audioBytes * 8.0 / info->durationMs);
+    }
+}
+
+// Bytes of the ID3v2 tag at the start of the file, 0 if there is none
+long long id3v2Bytes(FILE* file) {
+    unsigned char header[10];
+    if (readAt(file, 0, header, sizeof(header)) != sizeof(header) || memcmp(header, "ID3", 3) != 0) {
+        return 0;
+    }
+    // Sizes are "syncsafe": 7 bits per byte
+    const long long size = ((long long)(header[6] & 0x7F) << 21) | ((header[7] & 0x7F) << 14) |
+                           ((header[8] & 0x7F) << 7) | (header[9] & 0x7F);
+    return 10 + size + ((header[5] & 0x10) ? 10 : 0);
+}
+
+// Bytes of the ID3v1 tag at the end of the file, 0 if there is none
+long long id3v1Bytes(FILE* file, long long size) {
+    unsigned char tag[3];
+    return size >= 128 && readAt(file, size - 128, tag, 3) == 3 && memcmp(tag, "TAG", 3) == 0 ? 128 : 0;
+}
+
+int probeWav(FILE* file, MediaInfo* info, std::string* error) {
+    WavInfo wav;
+    if (readWavHeader(file, &wav, error) != 0) {
+        return -1;
+    }
+    unsigned char id[4];
+    info->container = readAt(file, 0, id, 4) == 4 && memcmp(id, "RIFF", 4) == 0 ? "wav" : "rf64";
+    info->codec = wav.audioFormat == kWavFormatPcm         ? "pcm"
+                  : wav.audioFormat == kWavFormatIeeeFloat ? "float"
+                                                           : "wav-" + std::to_string(wav.audioFormat);
+    info->sampleRate = wav.sampleRate;
+    info->channels = wav.channels;
+    info->bitsPerSample = wav.bitsPerSample;
+    if (wav.blockAlign > 0) {
+        info->frames = wav.dataSize / wav.blockAlign;
+        info->bitrate = (int)std::lround(wav.sampleRate * wav.blockAlign * 8.0 / 1000.0);
+    }
+    finish(info, wav.dataSize);
+    return 0;
+}
+
+// ISO BMFF boxes. Each walk reads only box headers and seeks past the rest.
+struct Box {
+    char type[5] = {0};
+    long long payload = 0;  // first byte after the header
+    long long end = 0;      // first byte after the box
+};
+
+bool readBox(FILE* file, long long pos, long long end, Box* box) {
+    unsigned char header[16];
+    if (pos + 8 > end || readAt(file, pos, header, 8) != 8) {
+        return false;
+    }
+    memcpy(box->type, header + 4, 4);
+    long long size = readBe32(header);
+    box->payload = pos + 8;
+    if (size == 1) {
+        if (readAt(file, pos + 8, header + 8, 8) != 8) {
+            return false;
+        }
+        size = (long long)readBe64(header + 8);
+        box->payload += 8;
+    } else if (size == 0) {
+        size = end - pos;  // to the end of the enclosing box
+    }
+    box->end = pos + size;
+    return size >= box->payload - pos && box->end <= end;
+}
+
+// First child of type `type` in [begin, end)
+bool findBox(FILE* file, long long begin, long long end, const char* type, Box* box) {
+    for (long long pos = begin; readBox(file, pos, end, box); pos = box->end) {
+        if (memcmp(box->type, type, 4) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// mvhd, mdhd and mehd: version, flags, [times,] then timescale and duration
+bool readTimes(FILE* file, const Box& box, bool hasTimescale, uint32_t* timescale, uint64_t* duration) {
+    unsigned char data[32];
+    const size_t size = (size_t)std::min<long long>(sizeof(data), box.end - box.payload);
+    if (size < 8 || readAt(file, box.payload, data, size) != size) {
+        return false;
+    }
+    const bool wide = data[0] == 1;
+    if (!hasTimescale) {
+        *duration = wide ? (size >= 12 ? readBe64(data + 4) : 0) : readBe32(data + 4);
+        return true;
+    }
+    const size_t at = wide ? 20 : 12;
+    if (size < at + (wide ? 12 : 8)) {
+        return false;
+    }
+    *timescale = readBe32(data + at);
+    *duration = wide ? readBe64(data + at + 4) : readBe32(data + at + 4);
+    return true;
+}
+
+const char* mp4CodecName(const char* type) {
+    static const char* const kNames[][2] = {
+        {"mp4a", "aac"},  {"alac", "alac"}, {"Opus", "opus"}, {"fLaC", "flac"},
+        {".mp3", "mp3"},  {"ac-3", "ac3"},  {"ec-3", "eac3"}, {"samr", "amr"},
+        {"sawb", "amr-wb"}, {"lpcm", "pcm"}, {"sowt", "pcm"}, {"twos", "pcm"},
+    };
+    for (const auto& name : kNames) {
+        if (memcmp(type, name[0], 4) == 0) {
+            return name[1];
+        }
+    }
+    return nullptr;
+}
+
+// Fills `info` from a trak box if it is a sound track
+bool probeTrack(FILE* file, const Box& trak, MediaInfo* info, uint32_t* timescale, uint64_t* duration) {
+    Box mdia, hdlr, mdhd, minf, stbl, stsd;
+    unsigned char handler[12];
+    if (!findBox(file, trak.payload, trak.end, "mdia", &mdia) ||
+        !findBox(file, mdia.payload, mdia.end, "hdlr", &hdlr) ||
+        readAt(file, hdlr.payload, handler, sizeof(handler)) != sizeof(handler) ||
+        memcmp(handler + 8, "soun", 4) != 0) {
+        return false;
+    }
+    if (!findBox(file, mdia.payload, mdia.end, "mdhd", &mdhd) ||
+        !readTimes(file, mdhd, true, timescale, duration) ||
+        !findBox(file, mdia.payload, mdia.end, "minf", &minf) ||
+        !findBox(file, minf.payload, minf.end, "stbl", &stbl) ||
+        !findBox(file, stbl.payload, stbl.end, "stsd", &stsd)) {
+        return false;
+    }
+    // Version, flags and entry count, then the first audio sample entry
+    unsigned char entry[8 + 36];
+    if (readAt(file, stsd.payload, entry, sizeof(entry)) != sizeof(entry)) {
+        return false;
+    }
+    const unsigned char* sample = entry + 8;
+    char type[5] = {0};
+    memcpy(type, sample + 4, 4);
+    const char* codec = mp4CodecName(type);
+    info->codec = codec ? codec : type;
+    info->channels = readBe16(sample + 24);
+    info->bitsPerSample = info->codec == "pcm" ? readBe16(sample + 26) : 0;
+    // 16.16 fixed point; rates above 65535 Hz only fit the media timescale
+    info->sampleRate = (int)(readBe32(sample + 32) >> 16);
+    if (info->sampleRate == 0) {
+        info->sampleRate = (int)*timescale;
+    }
+    return true;
+}
+
+int probeMp4(FILE* file, long long size, MediaInfo* info, std::string* error) {
+    Box moov;
+    long long mdatBytes = 0;
+    bool haveMoov = false;
+    Box box;
+    for (long long pos = 0; readBox(file, pos, size, &box); pos = box.end) {
+        if (memcmp(box.type, "moov", 4) == 0) {
+            moov = box;
+            haveMoov = true;
+        } else if (memcmp(box.type, "mdat", 4) == 0) {
+            mdatBytes += box.end - box.payload;
+        }
+    }
+    if (!haveMoov) {
+        *error = "No moov box in MP4 file";
+        return -1;
+    }
+    info->container = "mp4";
+
+    uint32_t movieTimescale = 0, timescale = 0;
+    uint64_t movieDuration = 0, duration = 0;
+    bool found = false;
+    for (long long pos = moov.payload; readBox(file, pos, moov.end, &box); pos = box.end) {
+        if (memcmp(box.type, "mvhd", 4) == 0) {
+            readTimes(file, box, true, &movieTimescale, &movieDuration);
+        } else if (memcmp(box.type, "mvex", 4) == 0 && movieDuration == 0) {
+            // Fragmented files give the whole duration in mehd
+            Box mehd;
+            if (findBox(file, box.payload, box.end, "mehd", &mehd)) {
+                readTimes(file, mehd, false, nullptr, &movieDuration);
+            }
+        } else if (!found && memcmp(box.type, "trak", 4) == 0) {
+            found = probeTrack(file, box, info, &timescale, &duration);
+        }
+    }
+    if (!found) {
+        *error = "No audio track in MP4 file";
+        return -1;
+    }
+    double seconds = timescale > 0 ? (double)duration / timescale : 0.0;
+    if (seconds <= 0.0 && movieTimescale > 0) {
+        seconds = (double)movieDuration / movieTimescale;
+    }
+    if (seconds > 0.0) {
+        info->frames = (long long)std::llround(seconds * info->sampleRate);
+    }
+    finish(info, mdatBytes);
+    return 0;
+}
+
+bool isAdtsHeader(const unsigned char* p) {
+    // Sync word, MPEG-4 or -2, layer 0
+    return p[0] == 0xFF && (p[1] & 0xF6) == 0xF0;
+}
+
+int probeAdts(FILE* file, long long start, long long end, MediaInfo* info, std::string* error) {
+    long long pos = start, samples = 0;
+    int frames = 0;
+    unsigned char header[7];
+    while (frames < kSampleFrames && pos + 7 <= end && readAt(file, pos, header, 7) == 7 &&
+           isAdtsHeader(header)) {
+        const int rateIndex = (header[2] >> 2) & 0x0F;
+        const int length = ((header[3] & 3) << 11) | (header[4] << 3) | (header[5] >> 5);
+        if (rateIndex >= 13 || length < 7) {
+            break;
+        }
+        if (frames == 0) {
+            info->sampleRate = kAdtsSampleRates[rateIndex];
+            info->channels = ((header[2] & 1) << 2) | (header[3] >> 6);
+        }
+        samples += 1024 * ((header[6] & 3) + 1);
+        pos += length;
+        frames++;
+    }
+    if (frames == 0) {
+        *error = "Invalid ADTS header";
+        return -1;
+    }
+    info->container = "adts";
+    info->codec = "aac";
+    info->frames = samples;
+    if (pos < end) {
+        // The frames read give the bytes per sample for the rest
+        info->frames = (long long)((double)samples * (end - start) / (pos - start));
+        info->estimated = true;
+    }
+    finish(info, end - start);
+    return 0;
+}
+
+// First frame at or after `start` that is followed by a matching frame
+long long findMp3Sync(FILE* file, long long start, Mp3FrameHeader* header) {
+    std::vector<unsigned char> data(kSyncSearchBytes);
+    data.resize(readAt(file, start, data.data(), data.size()));
+    for (size_t i = 0; i + 4 <= data.size(); i++) {
+        if (!parseMp3FrameHeader(&data[i], data.size() - i, header)) {
+            continue;
+        }
+        const size_t next = i + header->frameBytes;
+        Mp3FrameHeader following;
+        if (next + 4 > data.size() ||
+            (parseMp3FrameHeader(&data[next], data.size() - next, &following) &&
+             following.version == header->version && following.sampleRate == header->sampleRate)) {
+            return start + (long long)i;
+        }
+    }
+    return -1;
+}
+
+int probeMp3(FILE* file, long long start, long long end, MediaInfo* info, std::string* error) {
+    Mp3FrameHeader first;
+    const long long offset = findMp3Sync(file, start, &first);
+    if (offset < 0) {
+        *error = "Unsupported audio file (no RIFF, MP4, ADTS, MP3 or Ogg header)";
+        return -1;
+    }
+    info->container = "mp3";
+    info->codec = "mp3";
+    info->sampleRate = first.sampleRate;
+    info->channels = first.channels;
+
+    std::vector<unsigned char> frame((size_t)first.frameBytes);
+    InfoTag tag;
+    bool hasLameTag = false;
+    if (readAt(file, offset, frame.data(), frame.size()) == frame.size() &&
+        parseInfoFrame(frame.data(), frame.size(), &tag, &hasLameTag)) {
+        info->frames = tag.frames * first.frameSamples;
+        if (hasLameTag) {
+            info->frames = std::max(0LL, info->frames - tag.encoderDelay - tag.padding);
+        }
+        finish(info, tag.audioBytes > 0 ? tag.audioBytes : end - offset - first.frameBytes);
+        return 0;
+    }
+
+    // No tag: walk the first frames; one bitrate throughout is taken as CBR
+    // and the rest estimated, otherwise every frame header is read
+    long long pos = offset, frames = 0;
+    bool constant = true;
+    unsigned char bytes[4];
+    Mp3FrameHeader header;
+    while (pos + 4 <= end && readAt(file, pos, bytes, 4) == 4 && parseMp3FrameHeader(bytes, 4, &header) &&
+           header.version == first.version && header.sampleRate == first.sampleRate) {
+        constant = constant && header.bitrate == first.bitrate;
+        frames++;
+        pos += header.frameBytes;
+        if (frames == kSampleFrames && constant) {
+            break;
+        }
+    }
+    info->frames = frames * first.frameSamples;
+    if (constant && frames == kSampleFrames && pos < end) {
+        info->frames = (long long)((double)info->frames * (end - offset) / (pos - offset));
+        info->bitrate = first.bitrate;
+        info->estimated = true;
+    }
+    finish(info, std::min(pos, end) - offset);
+    return 0;
+}
+
+int probeOgg(FILE* file, long long size, MediaInfo* info, std::string* error) {
+    // The first page holds just the identification header
+    unsigned char page[27 + 255 + 30];
+    const size_t got = readAt(file, 0, page, sizeof(page));
+    const size_t packet = got > 27 ? 27 + (size_t)page[26] : got;
+    if (packet + 19 <= got && memcmp(page + packet, "OpusHead", 8) == 0) {
+        info->codec = "opus";
+        info->channels = page[packet + 9];
+        info->sampleRate = 48000;  // Opus always decodes at 48 kHz
+    } else if (packet + 30 <= got && memcmp(page + packet, "\x01vorbis", 7) == 0) {
+        info->codec = "vorbis";
+        info->channels = page[packet + 11];
+        info->sampleRate = (int)readLe32(page + packet + 12);
+    } else {
+        *error = "Unsupported Ogg stream (not Opus or Vorbis)";
+        return -1;
+    }
+    info->container = "ogg";
+    const uint32_t serial = readLe32(page + 14);
+
+    // The last page of the stream carries its final granule position
+    std::vector<unsigned char> tail((size_t)std::min<long long>(size, kOggTailBytes));
+    const long long tailStart = size - (long long)tail.size();
+    tail.resize(readAt(file, tailStart, tail.data(), tail.size()));
+    for (size_t i = tail.size() >= 27 ? tail.size() - 26 : 0; i-- > 0;) {
+        if (memcmp(&tail[i], "OggS", 4) != 0 || readLe32(&tail[i + 14]) != serial) {
+            continue;
+        }
+        const int64_t granule = (int64_t)readLe64(&tail[i + 6]);
+        if (granule >= 0) {
+            // Opus granules count from before the pre-skip
+            const long long preSkip = info->codec == "opus" ? (page[packet + 10] | (page[packet + 11] << 8)) : 0;
+            info->frames = std::max(0LL, (long long)granule - preSkip);
+            break;
+        }
+    }
+    finish(info, size);
+    return 0;
+}
+
+}  // namespace
+
+int probeFile(const std::string& path, MediaInfo* info, std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *error = "Failed to open input file: " + path;
+        return -1;
+    }
+    *info = MediaInfo();
+    const long long size = fileSize(file);
+    unsigned char head[8] = {0};
+    readAt(file, 0, head, sizeof(head));
+
+    int status;
+    if (isWavFile(file)) {
+        status = probeWav(file, info, error);
+    } else if (memcmp(head + 4, "ftyp", 4) == 0 || memcmp(head + 4, "moov", 4) == 0) {
+        status = probeMp4(file, size, info, error);
+    } else if (memcmp(head, "OggS", 4) == 0) {
+        status = probeOgg(file, size, info, error);
+    } else {
+        const long long start = id3v2Bytes(file);
+        const long long end = size - id3v1Bytes(file, size);
+        unsigned char sync[2] = {0, 0};
+        readAt(file, start, sync, sizeof(sync));
+        status = isAdtsHeader(sync) ? probeAdts(file, start, end, info, error)
+                                    : probeMp3(file, start, end, info, error);
+    }
+    fclose(file);
+    return status;
+}
+
+void probeFiles(const std::vector<std::string>& paths, int threads, std::vector<ProbeResult>* results) {
+    results->assign(paths.size(), ProbeResult());
+    // Each probe is a few reads, so threads mostly overlap I/O latency
+    std::atomic<size_t> next(0);
+    auto worker = [&] {
+        for (size_t index = next++; index < paths.size(); index = next++) {
+            ProbeResult& result = (*results)[index];
+            if (probeFile(paths[index], &result.info, &result.error) != 0 && result.error.empty()) {
+                result.error = "Failed to probe " + paths[index];
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < std::min(threads, (int)paths.size()); i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+std::string formatMediaInfo(const MediaInfo& info) {
+    char numbers[192];
+    snprintf(numbers, sizeof(numbers),
+             "sampleRate=%d\nchannels=%d\nbitsPerSample=%d\nbitrate=%d\nframes=%lld\ndurationMs=%.3f\n"
+             "estimated=%d\n",
+             info.sampleRate, info.channels, info.bitsPerSample, info.bitrate, info.frames, info.durationMs,
+             info.estimated ? 1 : 0);
+    return "container=" + info.container + "\ncodec=" + info.codec + "\n" + numbers;
+}
+
+std::string formatProbeResults(const std::vector<ProbeResult>& results) {
+    std::string text;
+    for (size_t i = 0; i < results.size(); i++) {
+        const std::string prefix = "files." + std::to_string(i) + ".";
+        const std::string lines = results[i].error.empty()
+                                      ? formatMediaInfo(results[i].info)
+                                      : "errorCode=PROBE_ERROR\nerrorMessage=" + results[i].error + "\n";
+        for (size_t begin = 0; begin < lines.size();) {
+            size_t end = lines.find('\n', begin) + 1;
+            text += prefix + lines.substr(begin, end - begin);
+            begin = end;
+        }
+    }
+    return text;
+}
+
+}  // namespace wavtomp3
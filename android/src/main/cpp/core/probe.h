@@ -0,0 +1,51 @@
+// Stream parameters and duration of audio files from their headers alone,
+// for file lists that need them without decoding.
+//
+// WAV/RF64 take the fmt and data (or ds64) chunks, MP4/M4A the first sound
+// track's mdhd and sample entry (mvhd when mdhd has no duration), ADTS AAC
+// the first frames plus the file size, MP3 the Xing/Info or VBRI tag, and
+// Ogg Opus the granule of the last page. An untagged MP3 is estimated from
+// its size when its first frames share one bitrate and scanned frame by
+// frame otherwise. Apart from that scan a probe reads a few kilobytes.
+#ifndef WAV_TO_MP3_PROBE_H
+#define WAV_TO_MP3_PROBE_H
+
+#include <string>
+#include <vector>
+
+namespace wavtomp3 {
+
+struct MediaInfo {
+    std::string container;  // "wav", "rf64", "mp4", "adts", "mp3" or "ogg"
+    std::string codec;      // "pcm", "float", "aac", "mp3", "opus", ... or the MP4 sample entry type
+    int sampleRate = 0;
+    int channels = 0;
+    int bitsPerSample = 0;   // PCM only
+    int bitrate = 0;         // average, kbps
+    long long frames = -1;   // sample frames; -1 if unknown
+    double durationMs = 0.0;
+    bool estimated = false;  // duration from the file size, not a count
+};
+
+// Probes `path`. Returns 0, or -1 with a message in `error`.
+int probeFile(const std::string& path, MediaInfo* info, std::string* error);
+
+struct ProbeResult {
+    MediaInfo info;
+    std::string error;  // empty on success
+};
+
+// Threads the platform glue probes a batch with
+const int kProbeThreads = 4;
+
+// Probes `paths` on up to `threads` threads; results are in the same order.
+void probeFiles(const std::vector<std::string>& paths, int threads, std::vector<ProbeResult>* results);
+
+// "key=value" lines; one file's keys are prefixed with "files.N." as in
+// formatResults().
+std::string formatMediaInfo(const MediaInfo& info);
+std::string formatProbeResults(const std::vector<ProbeResult>& results);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_PROBE_H
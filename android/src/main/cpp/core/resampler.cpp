@@ -0,0 +1,112 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <numeric>
+
+#include "simd.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kTapsPerPhase = 32;
+const double kKaiserBeta = 8.0;
+// Passband edge as a fraction of the lower Nyquist frequency
+const double kCutoff = 0.91;
+
+double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+float dot(const float* a, const float* b, int count) {
+    simd_f32x4 acc = simd_zero();
+    for (int i = 0; i < count; i += SIMD_WIDTH) {
+        acc = simd_madd(simd_load(a + i), simd_load(b + i), acc);
+    }
+    return simd_hsum(acc);
+}
+
+}  // namespace
+
+Resampler::Resampler(int inRate, int outRate, int channels)
+    : channels_(channels), taps_(kTapsPerPhase), history_(channels) {
+    int g = std::gcd(inRate, outRate);
+    up_ = outRate / g;
+    down_ = inRate / g;
+
+    // Prototype low-pass at the upsampled rate, length taps * L and centred
+    // on an integer index so the delay is a whole number of input samples.
+    const int length = taps_ * up_;
+    const double center = length / 2.0;
+    const double cutoff = 0.5 * kCutoff * std::min(1.0, (double)up_ / down_) / up_;
+    const double i0Beta = besselI0(kKaiserBeta);
+    std::vector<double> prototype(length);
+    for (int m = 0; m < length; m++) {
+        double x = m - center;
+        double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+        double r = x / center;
+        double window = besselI0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0Beta;
+        prototype[m] = 2.0 * cutoff * sinc * window * up_;
+    }
+
+    // Phase p, tap i multiplies history[base + i]; stored so each output is a
+    // plain dot product over a contiguous window.
+    coefficients_.resize((size_t)up_ * taps_);
+    for (int p = 0; p < up_; p++) {
+        for (int i = 0; i < taps_; i++) {
+            coefficients_[(size_t)p * taps_ + i] = (float)prototype[p + (taps_ - 1 - i) * up_];
+        }
+    }
+
+    // taps/2 - 1 samples of silence before the signal compensate the delay
+    for (auto& channel : history_) {
+        channel.assign(taps_ / 2 - 1, 0.0f);
+    }
+}
+
+void Resampler::process(const float* in, long frames, std::vector<float>* out) {
+    for (int c = 0; c < channels_; c++) {
+        std::vector<float>& channel = history_[c];
+        size_t start = channel.size();
+        channel.resize(start + frames);
+        for (long i = 0; i < frames; i++) {
+            channel[start + i] = in[i * channels_ + c];
+        }
+    }
+    inputFrames_ += frames;
+    produce(out, -1);
+}
+
+void Resampler::flush(std::vector<float>* out) {
+    for (auto& channel : history_) {
+        channel.resize(channel.size() + taps_, 0.0f);
+    }
+    long long expected = (inputFrames_ * up_ + down_ / 2) / down_;
+    produce(out, expected);
+}
+
+void Resampler::produce(std::vector<float>* out, long long limit) {
+    const long available = (long)history_[0].size();
+    while (base_ + taps_ <= available && (limit < 0 || outputFrames_ < limit)) {
+        const float* coefficients = &coefficients_[(size_t)phase_ * taps_];
+        for (int c = 0; c < channels_; c++) {
+            out->push_back(dot(coefficients, &history_[c][base_], taps_));
+        }
+        outputFrames_++;
+        phase_ += down_;
+        base_ += phase_ / up_;
+        phase_ %= up_;
+    }
+    // Drop history no future output can reach
+    for (auto& channel : history_) {
+        channel.erase(channel.begin(), channel.begin() + std::min<long>(base_, available));
+    }
+    base_ -= std::min<long>(base_, available);
+}
+
+}  // namespace wavtomp3
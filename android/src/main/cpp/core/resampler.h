@@ -0,0 +1,41 @@
+// Streaming sample-rate conversion for encoders that only accept a fixed set
+// of rates (Opus) and for the rates preset: 'auto' picks.
+#ifndef WAV_TO_MP3_RESAMPLER_H
+#define WAV_TO_MP3_RESAMPLER_H
+
+#include <vector>
+
+namespace wavtomp3 {
+
+// Polyphase windowed-sinc resampler for a rational ratio. The output is time
+// aligned with the input (the filter delay is compensated) and, after
+// flush(), has exactly round(inputFrames * outRate / inRate) frames.
+class Resampler {
+public:
+    Resampler(int inRate, int outRate, int channels);
+
+    // Consumes `frames` interleaved input frames and appends the frames that
+    // became available to `out` (interleaved).
+    void process(const float* in, long frames, std::vector<float>* out);
+
+    // Drains the filter at the end of the stream.
+    void flush(std::vector<float>* out);
+
+private:
+    void produce(std::vector<float>* out, long long limit);
+
+    int channels_;
+    int up_;    // L: output rate / gcd
+    int down_;  // M: input rate / gcd
+    int taps_;  // filter taps per phase, a multiple of the SIMD width
+    std::vector<float> coefficients_;       // up_ phases x taps_
+    std::vector<std::vector<float>> history_;  // per channel, planar
+    long base_ = 0;   // first history sample of the next output's window
+    int phase_ = 0;
+    long long inputFrames_ = 0;
+    long long outputFrames_ = 0;
+};
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_RESAMPLER_H
@@ -0,0 +1,97 @@
+#include "sample_convert.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace wavtomp3 {
+
+int bytesPerSample(SampleFormat format) {
+    switch (format) {
+        case SampleFormat::U8: return 1;
+        case SampleFormat::S16: return 2;
+        case SampleFormat::S24: return 3;
+        case SampleFormat::S32: return 4;
+        case SampleFormat::F32: return 4;
+    }
+    return 0;
+}
+
+// The loops below are kept simple and branch-free so the compiler
+// vectorizes them (NEON / SSE) at -O2 and above.
+void convertToFloat(const void* raw, SampleFormat format, size_t count, float gain, float* out) {
+    switch (format) {
+        case SampleFormat::U8: {
+            const uint8_t* in = (const uint8_t*)raw;
+            const float scale = gain / 128.0f;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = ((int)in[i] - 128) * scale;
+            }
+            break;
+        }
+        case SampleFormat::S16: {
+            const int16_t* in = (const int16_t*)raw;
+            const float scale = gain / 32768.0f;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = in[i] * scale;
+            }
+            break;
+        }
+        case SampleFormat::S24: {
+            const uint8_t* in = (const uint8_t*)raw;
+            const float scale = gain / 2147483648.0f;
+            for (size_t i = 0; i < count; i++) {
+                int32_t value = (int32_t)(((uint32_t)in[3 * i] << 8) |
+                                          ((uint32_t)in[3 * i + 1] << 16) |
+                                          ((uint32_t)in[3 * i + 2] << 24));
+                out[i] = value * scale;
+            }
+            break;
+        }
+        case SampleFormat::S32: {
+            const int32_t* in = (const int32_t*)raw;
+            const float scale = gain / 2147483648.0f;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = in[i] * scale;
+            }
+            break;
+        }
+        case SampleFormat::F32: {
+            const float* in = (const float*)raw;
+            if (gain == 1.0f) {
+                memcpy(out, in, count * sizeof(float));
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = in[i] * gain;
+                }
+            }
+            break;
+        }
+    }
+}
+
+void applyGainRamp(float* pcm, size_t frames, int channels, float from, float to) {
+    const size_t count = frames * (size_t)channels;
+    if (from == to) {
+        for (size_t i = 0; i < count; i++) {
+            pcm[i] *= to;
+        }
+        return;
+    }
+    const float step = (to - from) / (float)frames;
+    for (size_t frame = 0; frame < frames; frame++) {
+        const float gain = from + step * (float)(frame + 1);
+        for (int c = 0; c < channels; c++) {
+            pcm[frame * channels + c] *= gain;
+        }
+    }
+}
+
+void convertToS16(const float* in, size_t count, short* out) {
+    for (size_t i = 0; i < count; i++) {
+        float value = in[i] * 32768.0f;
+        value = value > 32767.0f ? 32767.0f : (value < -32768.0f ? -32768.0f : value);
+        out[i] = (short)(value + (value >= 0 ? 0.5f : -0.5f));
+    }
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,32 @@
+// Conversion of raw PCM samples to normalized float.
+#ifndef WAV_TO_MP3_SAMPLE_CONVERT_H
+#define WAV_TO_MP3_SAMPLE_CONVERT_H
+
+#include <cstddef>
+
+namespace wavtomp3 {
+
+enum class SampleFormat {
+    U8,
+    S16,
+    S24,
+    S32,
+    F32,
+};
+
+int bytesPerSample(SampleFormat format);
+
+// Converts `count` little-endian samples to floats in [-1, 1), scaled by
+// `gain`. Integer formats are scaled by 1 / 2^(bits - 1).
+void convertToFloat(const void* raw, SampleFormat format, size_t count, float gain, float* out);
+
+// Scales `frames` interleaved frames by a gain moving linearly from `from`
+// to `to`, which the last frame gets.
+void applyGainRamp(float* pcm, size_t frames, int channels, float from, float to);
+
+// Converts floats to 16-bit PCM with rounding and saturation.
+void convertToS16(const float* in, size_t count, short* out);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_SAMPLE_CONVERT_H
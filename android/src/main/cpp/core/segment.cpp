@@ -0,0 +1,391 @@
+#include "segment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "audio_source.h"
+#include "encoder.h"
+#include "log.h"
+#include "mp3_frame.h"
+#include "options.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kManifestVersion = 1;
+const long kBlockFrames = 4096;
+
+// Applies the manifest options and opens a LAME encoder for the segments.
+std::unique_ptr<Encoder> openSegmentEncoder(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                            const AudioFormat& format, ConversionOptions* options,
+                                            std::string* error) {
+    for (const auto& option : pairs) {
+        if (setOption(options, option.first, option.second, error) != 0) {
+            return nullptr;
+        }
+    }
+    if (options->format != OutputFormat::Mp3 || options->encoder == EncoderBackend::Fixed) {
+        *error = "Segment encoding supports MP3 with the LAME encoder only";
+        return nullptr;
+    }
+    if (encoderSampleRate(options->format, format.sampleRate) != format.sampleRate) {
+        *error = "Segment encoding needs a sample rate MP3 supports, got " +
+                 std::to_string(format.sampleRate) + " Hz";
+        return nullptr;
+    }
+    EncoderConfig config;
+    config.sampleRate = format.sampleRate;
+    config.channels = format.channels;
+    config.bitrate = options->bitrate > 0 ? options->bitrate : defaultBitrate(options->format);
+    config.quality = options->quality;
+    config.lowpassHz = options->lowpassHz;
+    config.highpassHz = options->highpassHz;
+    config.independentFrames = true;
+    std::unique_ptr<Encoder> encoder = createLameEncoder();
+    if (encoder->open(config, error) != 0) {
+        return nullptr;
+    }
+    return encoder;
+}
+
+int readFile(const std::string& path, std::vector<unsigned char>* data, std::string* error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        *error = "Failed to open " + path;
+        return -1;
+    }
+    data->clear();
+    unsigned char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed) {
+        *error = "Failed to read " + path;
+        return -1;
+    }
+    return 0;
+}
+
+bool parseRange(const std::string& text, std::pair<long long, long long>* range) {
+    char* end = nullptr;
+    range->first = strtoll(text.c_str(), &end, 10);
+    if (*end != '-') {
+        return false;
+    }
+    const char* rest = end + 1;
+    range->second = strtoll(rest, &end, 10);
+    return end != rest && *end == '\0' && range->first >= 0 && range->second > range->first;
+}
+
+}  // namespace
+
+int planSegments(const std::string& input, const std::vector<std::pair<std::string, std::string>>& options,
+                 double segmentSeconds, SegmentManifest* manifest, std::string* error) {
+    ConversionOptions conversionOptions;
+    for (const auto& option : options) {
+        if (setOption(&conversionOptions, option.first, option.second, error) != 0) {
+            return -1;
+        }
+    }
+    std::unique_ptr<AudioSource> source = openAudioSource(input, conversionOptions.rawFormat, error);
+    if (!source) {
+        return -1;
+    }
+    const AudioFormat& format = source->format();
+    if (source->totalFrames() <= 0) {
+        *error = "Input length unknown or empty";
+        return -1;
+    }
+    conversionOptions = ConversionOptions();
+    std::unique_ptr<Encoder> encoder = openSegmentEncoder(options, format, &conversionOptions, error);
+    if (!encoder) {
+        return -1;
+    }
+    int frameSamples = 0;
+    int delay = 0;
+    if (!encoder->framing(&frameSamples, &delay) || frameSamples <= 0) {
+        *error = "Encoder does not report its framing";
+        return -1;
+    }
+
+    *manifest = SegmentManifest();
+    manifest->input = input;
+    manifest->options = options;
+    manifest->sampleRate = format.sampleRate;
+    manifest->channels = format.channels;
+    manifest->totalSamples = source->totalFrames();
+    manifest->frameSamples = frameSamples;
+    manifest->encoderDelay = delay;
+
+    // Frames holding any input; the encoder flushes a few more at the end
+    long long totalFrames = (manifest->totalSamples + delay + frameSamples - 1) / frameSamples;
+    long long perSegment = std::max(1LL, (long long)llround(segmentSeconds * format.sampleRate / frameSamples));
+    for (long long first = 0; first < totalFrames; first += perSegment) {
+        manifest->segments.emplace_back(first, std::min(totalFrames, first + perSegment));
+    }
+    return 0;
+}
+
+int writeManifest(const std::string& path, const SegmentManifest& manifest, std::string* error) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        *error = "Failed to open " + path;
+        return -1;
+    }
+    fprintf(file, "version=%d\ninput=%s\nsampleRate=%d\nchannels=%d\ntotalSamples=%lld\n"
+                  "frameSamples=%d\nencoderDelay=%d\nprimeFrames=%d\n",
+            kManifestVersion, manifest.input.c_str(), manifest.sampleRate, manifest.channels,
+            manifest.totalSamples, manifest.frameSamples, manifest.encoderDelay, manifest.primeFrames);
+    for (const auto& option : manifest.options) {
+        fprintf(file, "option.%s=%s\n", option.first.c_str(), option.second.c_str());
+    }
+    for (const auto& segment : manifest.segments) {
+        fprintf(file, "segment=%lld-%lld\n", segment.first, segment.second);
+    }
+    if (fclose(file) != 0) {
+        *error = "Failed to write " + path;
+        return -1;
+    }
+    return 0;
+}
+
+int readManifest(const std::string& path, SegmentManifest* manifest, std::string* error) {
+    std::vector<unsigned char> data;
+    if (readFile(path, &data, error) != 0) {
+        return -1;
+    }
+    *manifest = SegmentManifest();
+    int version = 0;
+    std::string text(data.begin(), data.end());
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t newline = text.find('\n', pos);
+        std::string line = text.substr(pos, newline == std::string::npos ? std::string::npos : newline - pos);
+        pos = newline == std::string::npos ? text.size() : newline + 1;
+        size_t equals = line.find('=');
+        if (line.empty() || equals == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, equals);
+        std::string value = line.substr(equals + 1);
+        if (key == "version") {
+            version = atoi(value.c_str());
+        } else if (key == "input") {
+            manifest->input = value;
+        } else if (key == "sampleRate") {
+            manifest->sampleRate = atoi(value.c_str());
+        } else if (key == "channels") {
+            manifest->channels = atoi(value.c_str());
+        } else if (key == "totalSamples") {
+            manifest->totalSamples = atoll(value.c_str());
+        } else if (key == "frameSamples") {
+            manifest->frameSamples = atoi(value.c_str());
+        } else if (key == "encoderDelay") {
+            manifest->encoderDelay = atoi(value.c_str());
+        } else if (key == "primeFrames") {
+            manifest->primeFrames = atoi(value.c_str());
+        } else if (key.compare(0, 7, "option.") == 0) {
+            manifest->options.emplace_back(key.substr(7), value);
+        } else if (key == "segment") {
+            std::pair<long long, long long> range;
+            if (!parseRange(value, &range) ||
+                (!manifest->segments.empty() && range.first != manifest->segments.back().second)) {
+                *error = "Invalid segment in manifest: " + value;
+                return -1;
+            }
+            manifest->segments.push_back(range);
+        }
+    }
+    if (version != kManifestVersion || manifest->frameSamples <= 0 || manifest->totalSamples <= 0 ||
+        manifest->primeFrames < 0 || manifest->segments.empty() || manifest->segments.front().first != 0) {
+        *error = "Invalid manifest: " + path;
+        return -1;
+    }
+    return 0;
+}
+
+int encodeSegment(const SegmentManifest& manifest, int index, const std::string& blobPath,
+                  std::string* error) {
+    if (index < 0 || index >= (int)manifest.segments.size()) {
+        *error = "No segment " + std::to_string(index);
+        return -1;
+    }
+    ConversionOptions options;
+    for (const auto& option : manifest.options) {
+        if (setOption(&options, option.first, option.second, error) != 0) {
+            return -1;
+        }
+    }
+    std::unique_ptr<AudioSource> source = openAudioSource(manifest.input, options.rawFormat, error);
+    if (!source) {
+        return -1;
+    }
+    const AudioFormat& format = source->format();
+    if (format.sampleRate != manifest.sampleRate || format.channels != manifest.channels ||
+        source->totalFrames() != manifest.totalSamples) {
+        *error = "Input does not match the manifest: " + manifest.input;
+        return -1;
+    }
+    options = ConversionOptions();
+    std::unique_ptr<Encoder> encoder = openSegmentEncoder(manifest.options, format, &options, error);
+    if (!encoder) {
+        return -1;
+    }
+    int frameSamples = 0;
+    int delay = 0;
+    if (!encoder->framing(&frameSamples, &delay) || frameSamples != manifest.frameSamples ||
+        delay != manifest.encoderDelay) {
+        *error = "Encoder framing differs from the manifest; was it planned with another LAME build?";
+        return -1;
+    }
+
+    // Frame k of the whole stream holds samples [k*N - delay, (k+1)*N - delay).
+    // Starting the encoder at frame `start` keeps that grid, so after the
+    // priming frames its output matches the whole-file encode frame for frame.
+    const long long first = manifest.segments[index].first;
+    const long long end = manifest.segments[index].second;
+    const bool last = index + 1 == (int)manifest.segments.size();
+    const long long start = std::max(0LL, first - manifest.primeFrames);
+    const long long lastSample = last ? manifest.totalSamples
+                                      : std::min(manifest.totalSamples, (end + manifest.primeFrames) * frameSamples);
+    if (start > 0 && source->seek(start * frameSamples) != 0) {
+        *error = "Input is not seekable: " + manifest.input;
+        return -1;
+    }
+
+    std::vector<float> pcm((size_t)kBlockFrames * format.channels);
+    std::vector<unsigned char> encoded;
+    for (long long position = start * frameSamples; position < lastSample;) {
+        long frames = source->read(pcm.data(), (long)std::min<long long>(kBlockFrames, lastSample - position));
+        if (frames <= 0) {
+            *error = "Failed to read input";
+            return -1;
+        }
+        if (encoder->encode(pcm.data(), (int)frames, &encoded) != 0) {
+            *error = "Failed to encode buffer";
+            return -1;
+        }
+        position += frames;
+    }
+    if (encoder->finish(&encoded) != 0) {
+        *error = "Failed to flush encoder";
+        return -1;
+    }
+
+    std::vector<size_t> offsets;
+    if (splitMp3Frames(encoded.data(), encoded.size(), &offsets, error) != 0) {
+        return -1;
+    }
+    const size_t skip = (size_t)(first - start);
+    const size_t wanted = (size_t)(end - first);
+    if (offsets.size() < skip + wanted) {
+        *error = "Encoder produced " + std::to_string(offsets.size()) + " frames, expected " +
+                 std::to_string(skip + wanted);
+        return -1;
+    }
+    size_t from = offsets[skip];
+    size_t to = (last || skip + wanted == offsets.size()) ? encoded.size() : offsets[skip + wanted];
+
+    FILE* file = fopen(blobPath.c_str(), "wb");
+    if (!file) {
+        *error = "Failed to open " + blobPath;
+        return -1;
+    }
+    bool written = fwrite(encoded.data() + from, 1, to - from, file) == to - from;
+    if (fclose(file) != 0 || !written) {
+        remove(blobPath.c_str());
+        *error = "Failed to write " + blobPath;
+        return -1;
+    }
+    LOGI("Segment %d: frames %lld-%lld, %zu bytes", index, first, end, to - from);
+    return 0;
+}
+
+int stitchSegments(const SegmentManifest& manifest, const std::vector<std::string>& blobPaths,
+                   const std::string& outputPath, std::string* error) {
+    if (blobPaths.size() != manifest.segments.size()) {
+        *error = "Expected " + std::to_string(manifest.segments.size()) + " segment files, got " +
+                 std::to_string(blobPaths.size());
+        return -1;
+    }
+    ConversionOptions options;
+    for (const auto& option : manifest.options) {
+        if (setOption(&options, option.first, option.second, error) != 0) {
+            return -1;
+        }
+    }
+
+    std::vector<std::vector<unsigned char>> blobs(blobPaths.size());
+    Mp3FrameHeader header;
+    InfoTag tag;
+    for (size_t i = 0; i < blobPaths.size(); i++) {
+        std::vector<size_t> offsets;
+        if (readFile(blobPaths[i], &blobs[i], error) != 0 ||
+            splitMp3Frames(blobs[i].data(), blobs[i].size(), &offsets, error) != 0) {
+            return -1;
+        }
+        long long expected = manifest.segments[i].second - manifest.segments[i].first;
+        bool last = i + 1 == blobPaths.size();
+        Mp3FrameHeader blobHeader;
+        if (offsets.empty() || (long long)offsets.size() < expected ||
+            (!last && (long long)offsets.size() != expected) ||
+            !parseMp3FrameHeader(blobs[i].data(), blobs[i].size(), &blobHeader)) {
+            *error = blobPaths[i] + ": " + std::to_string(offsets.size()) + " frames, expected " +
+                     std::to_string(expected);
+            return -1;
+        }
+        if (i == 0) {
+            header = blobHeader;
+        } else if (blobHeader.version != header.version || blobHeader.sampleRate != header.sampleRate ||
+                   blobHeader.channels != header.channels) {
+            *error = blobPaths[i] + ": stream parameters differ from the first segment";
+            return -1;
+        }
+        if (blobHeader.frameSamples != manifest.frameSamples) {
+            *error = blobPaths[i] + ": frame size differs from the manifest";
+            return -1;
+        }
+        tag.frames += (long long)offsets.size();
+        tag.audioBytes += (long long)blobs[i].size();
+        tag.musicCrc = crc16(blobs[i].data(), blobs[i].size(), tag.musicCrc);
+    }
+    long long padding = tag.frames * manifest.frameSamples - manifest.encoderDelay - manifest.totalSamples;
+    if (padding < 0) {
+        *error = "Segments hold fewer samples than the input";
+        return -1;
+    }
+    tag.encoderDelay = manifest.encoderDelay;
+    tag.padding = (int)std::min(padding, 4095LL);
+    tag.quality = options.quality;
+    tag.lowpassHz = options.lowpassHz;
+    tag.sourceSampleRate = manifest.sampleRate;
+
+    std::vector<unsigned char> infoFrame;
+    if (buildInfoFrame(header, tag, &infoFrame, error) != 0) {
+        return -1;
+    }
+    FILE* file = fopen(outputPath.c_str(), "wb");
+    if (!file) {
+        *error = "Failed to open output file: " + outputPath;
+        return -1;
+    }
+    bool written = fwrite(infoFrame.data(), 1, infoFrame.size(), file) == infoFrame.size();
+    for (const auto& blob : blobs) {
+        written = written && fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    }
+    if (fclose(file) != 0 || !written) {
+        remove(outputPath.c_str());
+        *error = "Failed to write output";
+        return -1;
+    }
+    return 0;
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,54 @@
+// Splitting one MP3 encode across processes or machines.
+//
+// planSegments() cuts the input at MP3 frame boundaries and records the cuts
+// in a manifest. Each segment is then encoded on its own (encodeSegment),
+// starting a few frames early so the encoder has primed by the cut and with
+// the bit reservoir off so no frame depends on bits stored in the previous
+// segment. stitchSegments() concatenates the frame blobs behind a new
+// Info/LAME tag with the delay and padding of the whole stream, giving the
+// same gapless timeline as a single-process encode.
+#ifndef WAV_TO_MP3_SEGMENT_H
+#define WAV_TO_MP3_SEGMENT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wavtomp3 {
+
+struct SegmentManifest {
+    std::string input;
+    // Conversion options, as setOption() key/value pairs
+    std::vector<std::pair<std::string, std::string>> options;
+    int sampleRate = 0;
+    int channels = 0;
+    long long totalSamples = 0;  // per channel
+    int frameSamples = 0;
+    int encoderDelay = 0;
+    // Frames encoded and dropped before each segment to prime the encoder
+    int primeFrames = 2;
+    // [first, end) in frames of the whole stream; the last segment also
+    // takes the frames the encoder flushes
+    std::vector<std::pair<long long, long long>> segments;
+};
+
+// Plans segments of about `segmentSeconds` for `input`. Only MP3 through
+// LAME at a sample rate MP3 supports directly can be segmented.
+int planSegments(const std::string& input, const std::vector<std::pair<std::string, std::string>>& options,
+                 double segmentSeconds, SegmentManifest* manifest, std::string* error);
+
+// The manifest is "key=value" lines. Returns 0, or -1 with a message.
+int writeManifest(const std::string& path, const SegmentManifest& manifest, std::string* error);
+int readManifest(const std::string& path, SegmentManifest* manifest, std::string* error);
+
+// Encodes segment `index` of `manifest.input` into `blobPath` as raw frames.
+int encodeSegment(const SegmentManifest& manifest, int index, const std::string& blobPath,
+                  std::string* error);
+
+// Joins the blobs of all segments, in order, into a tagged MP3 file.
+int stitchSegments(const SegmentManifest& manifest, const std::vector<std::string>& blobPaths,
+                   const std::string& outputPath, std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_SEGMENT_H
@@ -0,0 +1,115 @@
+// Fixed-point MP3 encoding with shine. Lives in its own translation unit:
+// shine's layer3.h and lame.h both define STEREO/MONO.
+#include "encoder.h"
+
+#ifdef WAV_TO_MP3_HAVE_SHINE
+
+#include <algorithm>
+
+#include "log.h"
+#include "sample_convert.h"
+
+extern "C" {
+#include <layer3.h>
+}
+
+namespace wavtomp3 {
+
+namespace {
+
+class ShineMp3Encoder : public Encoder {
+public:
+    ~ShineMp3Encoder() override {
+        if (shine_) {
+            shine_close(shine_);
+        }
+    }
+
+    const char* name() const override { return "fixed"; }
+
+    int open(const EncoderConfig& config, std::string* error) override {
+        if (shine_check_config(config.sampleRate, config.bitrate) < 0) {
+            *error = "Fixed-point encoder does not support " + std::to_string(config.bitrate) +
+                     " kbps at " + std::to_string(config.sampleRate) + " Hz";
+            return -1;
+        }
+        shine_config_t shineConfig;
+        shine_set_config_mpeg_defaults(&shineConfig.mpeg);
+        shineConfig.wave.samplerate = config.sampleRate;
+        shineConfig.wave.channels = config.channels == 1 ? PCM_MONO : PCM_STEREO;
+        shineConfig.mpeg.bitr = config.bitrate;
+        shineConfig.mpeg.mode = config.channels == 1 ? MONO : STEREO;
+
+        shine_ = shine_initialise(&shineConfig);
+        if (!shine_) {
+            *error = "Failed to initialize fixed-point encoder";
+            return -1;
+        }
+        channels_ = config.channels;
+        passSamples_ = shine_samples_per_pass(shine_) * channels_;
+        pending_.reserve(passSamples_);
+        LOGI("shine: %d Hz, %d ch, %d kbps", config.sampleRate, config.channels, config.bitrate);
+        return 0;
+    }
+
+    int encode(const float* pcm, int frames, std::vector<unsigned char>* out) override {
+        // shine consumes exactly one granule pair per call
+        size_t count = (size_t)frames * channels_;
+        size_t offset = 0;
+        while (offset < count) {
+            size_t take = std::min(count - offset, passSamples_ - pending_.size());
+            size_t start = pending_.size();
+            pending_.resize(start + take);
+            convertToS16(pcm + offset, take, pending_.data() + start);
+            offset += take;
+            if (pending_.size() == passSamples_) {
+                encodePass(out);
+            }
+        }
+        return 0;
+    }
+
+    int finish(std::vector<unsigned char>* out) override {
+        if (!pending_.empty()) {
+            pending_.resize(passSamples_, 0);
+            encodePass(out);
+        }
+        int written = 0;
+        unsigned char* data = shine_flush(shine_, &written);
+        out->insert(out->end(), data, data + written);
+        return 0;
+    }
+
+private:
+    void encodePass(std::vector<unsigned char>* out) {
+        int written = 0;
+        unsigned char* data = shine_encode_buffer_interleaved(shine_, pending_.data(), &written);
+        out->insert(out->end(), data, data + written);
+        pending_.clear();
+    }
+
+    shine_t shine_ = nullptr;
+    int channels_ = 0;
+    size_t passSamples_ = 0;
+    std::vector<int16_t> pending_;
+};
+
+}  // namespace
+
+std::unique_ptr<Encoder> createFixedPointEncoder() {
+    return std::unique_ptr<Encoder>(new ShineMp3Encoder());
+}
+
+}  // namespace wavtomp3
+
+#else
+
+namespace wavtomp3 {
+
+std::unique_ptr<Encoder> createFixedPointEncoder() {
+    return nullptr;
+}
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_HAVE_SHINE
@@ -0,0 +1,222 @@
+/*
+ * Minimal 4-lane float SIMD layer shared by the LAME kernels and the
+ * conversion core, plus the float-to-int32 conversion LAME's quantizer needs. Maps to NEON on ARM, SSE2 on x86 and plain structs
+ * elsewhere. Plain C so it can be included from LAME's translation units.
+ *
+ * Every operation is a separate multiply or add (no fused multiply-add), so
+ * kernels that keep the scalar operation order stay bit-exact with it.
+ */
+#ifndef WAV_TO_MP3_SIMD_H
+#define WAV_TO_MP3_SIMD_H
+
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+typedef float32x4_t simd_f32x4;
+typedef int32x4_t simd_i32x4;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+typedef __m128 simd_f32x4;
+typedef __m128i simd_i32x4;
+#else
+#define SIMD_SCALAR 1
+typedef struct { float v[4]; } simd_f32x4;
+typedef struct { int v[4]; } simd_i32x4;
+#endif
+
+#define SIMD_WIDTH 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(SIMD_NEON)
+
+static inline simd_f32x4 simd_load(const float *p) { return vld1q_f32(p); }
+static inline void simd_store(float *p, simd_f32x4 v) { vst1q_f32(p, v); }
+static inline simd_f32x4 simd_set1(float x) { return vdupq_n_f32(x); }
+static inline simd_f32x4 simd_add(simd_f32x4 a, simd_f32x4 b) { return vaddq_f32(a, b); }
+static inline simd_f32x4 simd_sub(simd_f32x4 a, simd_f32x4 b) { return vsubq_f32(a, b); }
+static inline simd_f32x4 simd_mul(simd_f32x4 a, simd_f32x4 b) { return vmulq_f32(a, b); }
+static inline simd_f32x4 simd_min(simd_f32x4 a, simd_f32x4 b) { return vminq_f32(a, b); }
+static inline simd_f32x4 simd_max(simd_f32x4 a, simd_f32x4 b) { return vmaxq_f32(a, b); }
+static inline simd_f32x4 simd_abs(simd_f32x4 a) { return vabsq_f32(a); }
+static inline simd_f32x4 simd_reverse(simd_f32x4 a)
+{
+    float32x4_t r = vrev64q_f32(a);
+    return vcombine_f32(vget_high_f32(r), vget_low_f32(r));
+}
+static inline simd_f32x4 simd_swap_pairs(simd_f32x4 a) { return vrev64q_f32(a); }
+static inline void simd_store_i32(int *p, simd_i32x4 v) { vst1q_s32(p, v); }
+/* Truncates toward zero, like a C cast */
+static inline simd_i32x4 simd_ftoi(simd_f32x4 a) { return vcvtq_s32_f32(a); }
+#if defined(__aarch64__)
+static inline simd_f32x4 simd_sqrt(simd_f32x4 a) { return vsqrtq_f32(a); }
+static inline float simd_hsum(simd_f32x4 a) { return vaddvq_f32(a); }
+static inline float simd_hmax(simd_f32x4 a) { return vmaxvq_f32(a); }
+static inline float simd_hmin(simd_f32x4 a) { return vminvq_f32(a); }
+#else
+static inline simd_f32x4 simd_sqrt(simd_f32x4 a)
+{
+    /* ARMv7 NEON has no exact square root; keep the results IEEE-exact. */
+    float t[4];
+    vst1q_f32(t, a);
+    t[0] = sqrtf(t[0]); t[1] = sqrtf(t[1]); t[2] = sqrtf(t[2]); t[3] = sqrtf(t[3]);
+    return vld1q_f32(t);
+}
+static inline float simd_hsum(simd_f32x4 a)
+{
+    float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+static inline float simd_hmax(simd_f32x4 a)
+{
+    float32x2_t m = vmax_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpmax_f32(m, m), 0);
+}
+static inline float simd_hmin(simd_f32x4 a)
+{
+    float32x2_t m = vmin_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpmin_f32(m, m), 0);
+}
+#endif
+
+#elif defined(SIMD_SSE2)
+
+static inline simd_f32x4 simd_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void simd_store(float *p, simd_f32x4 v) { _mm_storeu_ps(p, v); }
+static inline simd_f32x4 simd_set1(float x) { return _mm_set1_ps(x); }
+static inline simd_f32x4 simd_add(simd_f32x4 a, simd_f32x4 b) { return _mm_add_ps(a, b); }
+static inline simd_f32x4 simd_sub(simd_f32x4 a, simd_f32x4 b) { return _mm_sub_ps(a, b); }
+static inline simd_f32x4 simd_mul(simd_f32x4 a, simd_f32x4 b) { return _mm_mul_ps(a, b); }
+static inline simd_f32x4 simd_min(simd_f32x4 a, simd_f32x4 b) { return _mm_min_ps(a, b); }
+static inline simd_f32x4 simd_max(simd_f32x4 a, simd_f32x4 b) { return _mm_max_ps(a, b); }
+static inline simd_f32x4 simd_abs(simd_f32x4 a)
+{
+    return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+static inline simd_f32x4 simd_reverse(simd_f32x4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 2, 3)); }
+static inline simd_f32x4 simd_swap_pairs(simd_f32x4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+static inline simd_f32x4 simd_sqrt(simd_f32x4 a) { return _mm_sqrt_ps(a); }
+static inline void simd_store_i32(int *p, simd_i32x4 v) { _mm_storeu_si128((__m128i *)p, v); }
+/* Truncates toward zero, like a C cast */
+static inline simd_i32x4 simd_ftoi(simd_f32x4 a) { return _mm_cvttps_epi32(a); }
+static inline float simd_hsum(simd_f32x4 a)
+{
+    __m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+static inline float simd_hmax(simd_f32x4 a)
+{
+    __m128 m = _mm_max_ps(a, _mm_movehl_ps(a, a));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+static inline float simd_hmin(simd_f32x4 a)
+{
+    __m128 m = _mm_min_ps(a, _mm_movehl_ps(a, a));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+#else
+
+static inline simd_f32x4 simd_load(const float *p)
+{
+    simd_f32x4 r;
+    r.v[0] = p[0]; r.v[1] = p[1]; r.v[2] = p[2]; r.v[3] = p[3];
+    return r;
+}
+static inline void simd_store(float *p, simd_f32x4 a)
+{
+    p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3];
+}
+static inline simd_f32x4 simd_set1(float x)
+{
+    simd_f32x4 r;
+    r.v[0] = r.v[1] = r.v[2] = r.v[3] = x;
+    return r;
+}
+#define SIMD_SCALAR_OP2(name, expr) \
+    static inline simd_f32x4 name(simd_f32x4 a, simd_f32x4 b) \
+    { \
+        simd_f32x4 r; \
+        int i; \
+        for (i = 0; i < 4; i++) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } \
+        return r; \
+    }
+SIMD_SCALAR_OP2(simd_add, x + y)
+SIMD_SCALAR_OP2(simd_sub, x - y)
+SIMD_SCALAR_OP2(simd_mul, x * y)
+SIMD_SCALAR_OP2(simd_min, x < y ? x : y)
+SIMD_SCALAR_OP2(simd_max, x > y ? x : y)
+#undef SIMD_SCALAR_OP2
+static inline simd_f32x4 simd_abs(simd_f32x4 a)
+{
+    int i;
+    for (i = 0; i < 4; i++) a.v[i] = fabsf(a.v[i]);
+    return a;
+}
+static inline simd_f32x4 simd_sqrt(simd_f32x4 a)
+{
+    int i;
+    for (i = 0; i < 4; i++) a.v[i] = sqrtf(a.v[i]);
+    return a;
+}
+static inline simd_f32x4 simd_reverse(simd_f32x4 a)
+{
+    simd_f32x4 r;
+    r.v[0] = a.v[3]; r.v[1] = a.v[2]; r.v[2] = a.v[1]; r.v[3] = a.v[0];
+    return r;
+}
+static inline simd_f32x4 simd_swap_pairs(simd_f32x4 a)
+{
+    simd_f32x4 r;
+    r.v[0] = a.v[1]; r.v[1] = a.v[0]; r.v[2] = a.v[3]; r.v[3] = a.v[2];
+    return r;
+}
+static inline void simd_store_i32(int *p, simd_i32x4 a)
+{
+    p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3];
+}
+/* Truncates toward zero, like a C cast */
+static inline simd_i32x4 simd_ftoi(simd_f32x4 a)
+{
+    simd_i32x4 r;
+    int i;
+    for (i = 0; i < 4; i++) r.v[i] = (int)a.v[i];
+    return r;
+}
+static inline float simd_hsum(simd_f32x4 a) { return (a.v[0] + a.v[2]) + (a.v[1] + a.v[3]); }
+static inline float simd_hmax(simd_f32x4 a)
+{
+    float m = a.v[0] > a.v[1] ? a.v[0] : a.v[1];
+    float n = a.v[2] > a.v[3] ? a.v[2] : a.v[3];
+    return m > n ? m : n;
+}
+static inline float simd_hmin(simd_f32x4 a)
+{
+    float m = a.v[0] < a.v[1] ? a.v[0] : a.v[1];
+    float n = a.v[2] < a.v[3] ? a.v[2] : a.v[3];
+    return m < n ? m : n;
+}
+
+#endif
+
+static inline simd_f32x4 simd_zero(void) { return simd_set1(0.0f); }
+
+/* a * b + c as two separately rounded operations */
+static inline simd_f32x4 simd_madd(simd_f32x4 a, simd_f32x4 b, simd_f32x4 c)
+{
+    return simd_add(simd_mul(a, b), c);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAV_TO_MP3_SIMD_H */
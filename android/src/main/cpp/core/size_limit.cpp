@@ -0,0 +1,562 @@
+#include "size_limit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "converter.h"
+#include "log.h"
+#include "mp3_frame.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+const int kMp3Rates[] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
+const int kMaxLimitBitrate = 320;
+const int kMinOpusBitrate = 6;
+
+// An MP3 stretch restarts LAME and encodes its priming frames twice, an
+// Opus stretch only changes a setting. Toward the end stretches shrink to a
+// share of the audio left, so the last bitrate steps move the size little.
+const double kMp3StretchSeconds = 5.0;
+const double kMp3ShortestStretchSeconds = 0.5;
+const double kOpusStretchSeconds = 1.0;
+const double kOpusShortestStretchSeconds = 0.1;
+const int kStretchShare = 4;
+// Frames encoded and dropped before each MP3 cut, as in SegmentManifest
+const int kPrimeFrames = 2;
+
+// LAME's encoder delay, for sizing before an encoder is open
+const int kLameDelaySamples = 576;
+// Side info plus the Xing and LAME tags, which the tag frame must hold
+const int kInfoTagBytes = 120 + 36;
+
+// Ogg Opus overhead as in estimate.cpp: a lacing byte per 20 ms packet, a
+// 27-byte header per page of about 4 KB, and the OpusHead and OpusTags
+// pages. The Ogg writer holds back up to a page and one packet.
+const double kOpusLacingBytesPerSecond = 50.0;
+const double kOggPageBytes = 4096.0;
+const int kOggPageHeaderBytes = 27;
+const int kOpusHeaderBytes = 128;
+const int kOggHeldBytes = 4096 + 27 + 255 + 1275 * 3 + 7;
+
+// LAME's default lowpass for CBR at a given bitrate (optimum_bandwidth() in
+// libmp3lame/lame.c)
+const int kLameLowpass[][2] = {
+    {8, 2000},    {16, 3700},   {24, 3900},   {32, 5500},   {40, 7000},   {48, 7500},
+    {56, 10000},  {64, 11000},  {80, 13500},  {96, 15100},  {112, 15600}, {128, 17000},
+    {160, 17500}, {192, 18600}, {224, 19400}, {256, 19700}, {320, 20500},
+};
+
+// Upper bound on the bytes of `units` of audio at `bitrate`
+typedef std::function<double(int bitrate, double units)> CostFunction;
+
+// Chooses, of `steps` (ascending), the bitrate for the next `units` of
+// audio with `after` more to come and `written` bytes out, give or take
+// `held` more: the one that, kept to the end, lands nearest the target,
+// lowered while maxBytes would not hold even at the lowest bitrate for the
+// rest.
+int chooseBitrate(const std::vector<int>& steps, const SizeLimitOptions& limit, double written, double held,
+                  double units, double after, const CostFunction& cost) {
+    const double aim = (double)(limit.targetBytes > 0 ? limit.targetBytes : limit.maxBytes);
+    size_t best = 0;
+    double bestMiss = 0.0;
+    for (size_t i = 0; i < steps.size(); i++) {
+        const double miss = std::fabs(written + cost(steps[i], units + after) - aim);
+        if (i == 0 || miss < bestMiss) {
+            best = i;
+            bestMiss = miss;
+        }
+    }
+    if (limit.maxBytes > 0) {
+        while (best > 0 &&
+               written + held + cost(steps[best], units) + cost(steps[0], after) > (double)limit.maxBytes) {
+            best--;
+        }
+    }
+    return steps[best];
+}
+
+int mp3FrameSamples(int sampleRate) {
+    // MPEG-2 and 2.5 frames below 32 kHz hold half the samples
+    return sampleRate >= 32000 ? 1152 : 576;
+}
+
+// Bytes of an MP3 frame on average; padding makes some a byte longer
+double mp3FrameBytes(int bitrate, int sampleRate) {
+    return mp3FrameSamples(sampleRate) / 8.0 * bitrate * 1000.0 / sampleRate;
+}
+
+double mp3Cost(int bitrate, double frames, int sampleRate) {
+    return frames * mp3FrameBytes(bitrate, sampleRate) + 1.0;
+}
+
+// Size of the tag frame buildInfoFrame() puts in front of `bitrate` frames
+int infoFrameBytes(int bitrate, int sampleRate, int channels) {
+    const bool mpeg1 = sampleRate >= 32000;
+    const int needed = 4 + (mpeg1 ? (channels == 1 ? 17 : 32) : (channels == 1 ? 9 : 17)) + kInfoTagBytes;
+    int bytes = 0;
+    for (int step : mp3Bitrates(sampleRate, kMaxLimitBitrate)) {
+        bytes = (int)mp3FrameBytes(step, sampleRate);
+        if (step >= bitrate && bytes >= needed) {
+            break;
+        }
+    }
+    return bytes;
+}
+
+// MP3 frames of a whole-stream encode of `samples`: those holding input
+// and the encoder delay, the flushed one, and one to spare
+long long mp3Frames(long long samples, int sampleRate, int delay) {
+    const int frameSamples = mp3FrameSamples(sampleRate);
+    return (samples + delay + frameSamples - 1) / frameSamples + 2;
+}
+
+long long stretchLength(long long left, long long longest, long long shortest) {
+    return std::max(shortest, std::min(longest, left / kStretchShare));
+}
+
+double opusCost(int bitrate, double seconds) {
+    const double packets = seconds * (bitrate * 1000.0 / 8.0 + kOpusLacingBytesPerSecond);
+    return packets + packets / kOggPageBytes * kOggPageHeaderBytes;
+}
+
+int lameLowpass(int bitrate, int channels, int sampleRate) {
+    int lowpass = kLameLowpass[0][1];
+    for (const auto& entry : kLameLowpass) {
+        if (entry[0] <= bitrate) {
+            lowpass = entry[1];
+        }
+    }
+    // LAME widens mono CBR by half
+    if (channels == 1) {
+        lowpass = lowpass * 3 / 2;
+    }
+    return std::min(lowpass, sampleRate * 48 / 100);
+}
+
+// MP3 through one LAME encoder per stretch, see the header comment. Output
+// comes out a stretch at a time, behind a placeholder for the tag frame that
+// finalHeader() fills in.
+class SegmentedMp3Encoder : public Encoder {
+public:
+    SegmentedMp3Encoder(const SizeLimitOptions& limit, long long samples)
+        : limit_(limit), expectedSamples_(samples) {}
+
+    const char* name() const override { return "lame"; }
+
+    int open(const EncoderConfig& config, std::string* error) override {
+        config_ = config;
+        config_.independentFrames = true;
+        steps_ = mp3Bitrates(config.sampleRate, config.bitrate);
+
+        // The framing of this LAME build decides where the cuts fall
+        config_.bitrate = steps_.back();
+        segment_ = createLameEncoder();
+        if (segment_->open(config_, error) != 0) {
+            return -1;
+        }
+        if (!segment_->framing(&frameSamples_, &delay_) || frameSamples_ <= 0) {
+            *error = "Encoder does not report its framing";
+            return -1;
+        }
+        totalFrames_ = mp3Frames(expectedSamples_, config.sampleRate, delay_);
+        longestFrames_ = (long long)std::llround(kMp3StretchSeconds * config.sampleRate / frameSamples_);
+        shortestFrames_ = std::max<long long>(kPrimeFrames + 1, (long long)std::llround(
+            kMp3ShortestStretchSeconds * config.sampleRate / frameSamples_));
+        infoReserve_ = infoFrameBytes(steps_.back(), config.sampleRate, config.channels);
+
+        // The bandwidth of the first stretch's bitrate holds for the whole
+        // stream, so it does not change audibly at the cuts
+        end_ = stretchLength(totalFrames_, longestFrames_, shortestFrames_);
+        const int bitrate = nextBitrate();
+        if (config_.lowpassHz < 0) {
+            config_.lowpassHz = lameLowpass(bitrate, config.channels, config.sampleRate);
+        }
+        LOGI("Size limit: %lld frames of %d samples, starting at %d kbps", totalFrames_, frameSamples_, bitrate);
+        return openSegment(bitrate, error);
+    }
+
+    int encode(const float* pcm, int frames, std::vector<unsigned char>* out) override {
+        buffer_.insert(buffer_.end(), pcm, pcm + (size_t)frames * config_.channels);
+        received_ += frames;
+        for (;;) {
+            const long long cut = (end_ + kPrimeFrames) * frameSamples_;
+            if (feed(std::min(received_, cut)) != 0) {
+                return -1;
+            }
+            if (fed_ < cut) {
+                return 0;
+            }
+            if (closeSegment(false, out) != 0) {
+                return -1;
+            }
+            first_ = end_;
+            start_ = std::max(0LL, first_ - kPrimeFrames);
+            end_ = first_ + stretchLength(totalFrames_ - first_, longestFrames_, shortestFrames_);
+            fed_ = start_ * frameSamples_;
+            std::string error;
+            if (openSegment(nextBitrate(), &error) != 0) {
+                LOGE("%s", error.c_str());
+                return -1;
+            }
+        }
+    }
+
+    int finish(std::vector<unsigned char>* out) override {
+        if (feed(received_) != 0 || closeSegment(true, out) != 0) {
+            return -1;
+        }
+        if (audioBytes_ == 0) {
+            return 0;
+        }
+        InfoTag tag;
+        tag.frames = framesOut_;
+        tag.audioBytes = audioBytes_;
+        tag.encoderDelay = delay_;
+        tag.padding = (int)std::max(0LL, std::min(4095LL, framesOut_ * frameSamples_ - delay_ - received_));
+        tag.quality = config_.quality;
+        tag.lowpassHz = config_.lowpassHz;
+        tag.sourceSampleRate = config_.sourceSampleRate;
+        tag.musicCrc = musicCrc_;
+        if (mixedBitrates_) {
+            buildToc(&tag.toc);
+        }
+        std::string error;
+        if (buildInfoFrame(firstHeader_, tag, &header_, &error) != 0) {
+            LOGE("%s", error.c_str());
+            return -1;
+        }
+        LOGI("Size limit: %lld bytes in %lld frames, %.1f kbps on average", (long long)header_.size() + audioBytes_,
+             framesOut_, audioBytes_ * 8.0 * config_.sampleRate / ((double)framesOut_ * frameSamples_) / 1000.0);
+        return 0;
+    }
+
+    bool finalHeader(std::vector<unsigned char>* header) override {
+        *header = header_;
+        return !header_.empty();
+    }
+
+    bool framing(int* frameSamples, int* delaySamples) const override {
+        *frameSamples = frameSamples_;
+        *delaySamples = delay_;
+        return true;
+    }
+
+private:
+    int nextBitrate() const {
+        const double written = headerWritten_ ? (double)(placeholderBytes_ + audioBytes_) : (double)infoReserve_;
+        const double left = (double)std::max(1LL, totalFrames_ - first_);
+        const double units = std::min(left, (double)(end_ - first_));
+        const int sampleRate = config_.sampleRate;
+        return chooseBitrate(steps_, limit_, written, 0.0, units, left - units,
+                             [sampleRate](int bitrate, double frames) { return mp3Cost(bitrate, frames, sampleRate); });
+    }
+
+    int openSegment(int bitrate, std::string* error) {
+        EncoderConfig config = config_;
+        config.bitrate = bitrate;
+        segment_ = createLameEncoder();
+        return segment_->open(config, error);
+    }
+
+    // Encodes the buffered input up to sample `until` into the segment, and
+    // drops what the next segment will not need for its priming
+    int feed(long long until) {
+        if (until > fed_) {
+            const float* pcm = buffer_.data() + (size_t)(fed_ - bufferStart_) * config_.channels;
+            if (segment_->encode(pcm, (int)(until - fed_), &encoded_) != 0) {
+                return -1;
+            }
+            fed_ = until;
+        }
+        const long long keep = std::min(fed_, (end_ - kPrimeFrames) * frameSamples_);
+        if (keep > bufferStart_) {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + (size_t)(keep - bufferStart_) * config_.channels);
+            bufferStart_ = keep;
+        }
+        return 0;
+    }
+
+    // Flushes the segment and moves its frames from `first_` on to `out`,
+    // up to `end_` or, for the last one, all of them
+    int closeSegment(bool last, std::vector<unsigned char>* out) {
+        std::string error;
+        std::vector<size_t> offsets;
+        if (segment_->finish(&encoded_) != 0 ||
+            splitMp3Frames(encoded_.data(), encoded_.size(), &offsets, &error) != 0) {
+            LOGE("Size-limited segment at frame %lld failed: %s", first_, error.c_str());
+            return -1;
+        }
+        const size_t skip = (size_t)(first_ - start_);
+        const size_t wanted = last ? offsets.size() - std::min(skip, offsets.size()) : (size_t)(end_ - first_);
+        if (offsets.size() < skip + wanted || (!last && wanted == 0)) {
+            LOGE("Segment at frame %lld: %zu frames, expected %zu", first_, offsets.size(), skip + wanted);
+            return -1;
+        }
+        if (wanted == 0) {
+            encoded_.clear();
+            return 0;
+        }
+        const size_t from = offsets[skip];
+        const size_t to = skip + wanted == offsets.size() ? encoded_.size() : offsets[skip + wanted];
+        Mp3FrameHeader header;
+        parseMp3FrameHeader(encoded_.data() + from, to - from, &header);
+        if (!headerWritten_) {
+            // Stands in for the tag frame until finish(); the tag does not
+            // change its size
+            std::vector<unsigned char> placeholder;
+            if (buildInfoFrame(header, InfoTag(), &placeholder, &error) != 0) {
+                LOGE("%s", error.c_str());
+                return -1;
+            }
+            out->insert(out->end(), placeholder.begin(), placeholder.end());
+            placeholderBytes_ = (long long)placeholder.size();
+            firstHeader_ = header;
+            headerWritten_ = true;
+        }
+        mixedBitrates_ = mixedBitrates_ || header.bitrate != firstHeader_.bitrate;
+        out->insert(out->end(), encoded_.begin() + from, encoded_.begin() + to);
+        musicCrc_ = crc16(encoded_.data() + from, to - from, musicCrc_);
+        framesOut_ += (long long)wanted;
+        audioBytes_ += (long long)(to - from);
+        marks_.emplace_back(framesOut_, audioBytes_);
+        encoded_.clear();
+        return 0;
+    }
+
+    // Seek table of the Xing tag: segments are CBR, so positions within one
+    // are interpolated
+    void buildToc(std::vector<unsigned char>* toc) const {
+        const double total = (double)(placeholderBytes_ + audioBytes_);
+        size_t segment = 0;
+        std::pair<long long, long long> previous(0, 0);
+        for (int i = 0; i < 100; i++) {
+            const double frame = (double)i * framesOut_ / 100;
+            while (segment + 1 < marks_.size() && marks_[segment].first <= frame) {
+                previous = marks_[segment++];
+            }
+            const double frames = (double)std::max(1LL, marks_[segment].first - previous.first);
+            const double bytes = previous.second + (frame - previous.first) * (marks_[segment].second - previous.second) / frames;
+            toc->push_back((unsigned char)std::min(255.0, (placeholderBytes_ + bytes) * 256 / total));
+        }
+    }
+
+    const SizeLimitOptions limit_;
+    const long long expectedSamples_;
+    EncoderConfig config_;
+    std::vector<int> steps_;
+    int frameSamples_ = 0;
+    int delay_ = 0;
+    long long totalFrames_ = 0;
+    long long longestFrames_ = 0;
+    long long shortestFrames_ = 0;
+    int infoReserve_ = 0;
+    std::unique_ptr<Encoder> segment_;
+    // The current segment keeps frames [first_, end_) of the stream and was
+    // started at frame start_
+    long long first_ = 0;
+    long long end_ = 0;
+    long long start_ = 0;
+    // Input samples received and fed to the segment; buffer_ holds those
+    // from bufferStart_ on
+    long long received_ = 0;
+    long long fed_ = 0;
+    long long bufferStart_ = 0;
+    std::vector<float> buffer_;
+    std::vector<unsigned char> encoded_;
+    bool headerWritten_ = false;
+    Mp3FrameHeader firstHeader_;
+    long long placeholderBytes_ = 0;
+    bool mixedBitrates_ = false;
+    long long framesOut_ = 0;
+    long long audioBytes_ = 0;
+    uint16_t musicCrc_ = 0;
+    // Frames and audio bytes out at the end of each segment
+    std::vector<std::pair<long long, long long>> marks_;
+    std::vector<unsigned char> header_;
+};
+
+// Opus with its bitrate chosen again every stretch
+class SteeredOpusEncoder : public Encoder {
+public:
+    SteeredOpusEncoder(std::unique_ptr<Encoder> opus, const SizeLimitOptions& limit, long long frames)
+        : opus_(std::move(opus)), limit_(limit), totalFrames_(frames) {}
+
+    const char* name() const override { return opus_->name(); }
+
+    int open(const EncoderConfig& config, std::string* error) override {
+        config_ = config;
+        for (int bitrate = kMinOpusBitrate; bitrate <= std::max(kMinOpusBitrate, config.bitrate); bitrate++) {
+            steps_.push_back(bitrate);
+        }
+        longestFrames_ = (long long)std::llround(kOpusStretchSeconds * config.sampleRate);
+        shortestFrames_ = (long long)std::llround(kOpusShortestStretchSeconds * config.sampleRate);
+        next_ = stretchLength(totalFrames_, longestFrames_, shortestFrames_);
+        bitrate_ = nextBitrate();
+        LOGI("Size limit: %.1f s of Opus, starting at %d kbps", (double)totalFrames_ / config.sampleRate, bitrate_);
+        EncoderConfig opusConfig = config;
+        opusConfig.bitrate = bitrate_;
+        return opus_->open(opusConfig, error);
+    }
+
+    int encode(const float* pcm, int frames, std::vector<unsigned char>* out) override {
+        while (frames > 0) {
+            if (done_ == next_) {
+                next_ += stretchLength(totalFrames_ - done_, longestFrames_, shortestFrames_);
+                const int bitrate = nextBitrate();
+                if (bitrate != bitrate_ && opus_->setBitrate(bitrate) == 0) {
+                    bitrate_ = bitrate;
+                }
+            }
+            const int take = (int)std::min<long long>(frames, next_ - done_);
+            const size_t before = out->size();
+            if (opus_->encode(pcm, take, out) != 0) {
+                return -1;
+            }
+            // A page out leaves about nothing held back
+            if (out->size() > before) {
+                bytes_ += (double)(out->size() - before);
+                held_ = 0.0;
+            } else {
+                held_ += opusCost(bitrate_, (double)take / config_.sampleRate);
+            }
+            pcm += (size_t)take * config_.channels;
+            frames -= take;
+            done_ += take;
+        }
+        return 0;
+    }
+
+    int finish(std::vector<unsigned char>* out) override {
+        const size_t before = out->size();
+        if (opus_->finish(out) != 0) {
+            return -1;
+        }
+        bytes_ += (double)(out->size() - before);
+        LOGI("Size limit: %.0f bytes, %.1f kbps on average", bytes_,
+             done_ > 0 ? bytes_ * 8.0 * config_.sampleRate / done_ / 1000.0 : 0.0);
+        return 0;
+    }
+
+private:
+    // The Ogg writer holds back what it has not paged yet: the bytes
+    // expected of the audio since the last page count as written, and up to
+    // a full page and packet as what maxBytes must allow for
+    int nextBitrate() const {
+        const double left = (double)std::max(1LL, totalFrames_ - done_) / config_.sampleRate;
+        const double units = std::min(left, (double)(next_ - done_) / config_.sampleRate);
+        const double held = std::min((double)kOggHeldBytes, held_);
+        return chooseBitrate(steps_, limit_, bytes_ + held, done_ > 0 ? kOggHeldBytes - held : 0.0, units,
+                             left - units, opusCost);
+    }
+
+    std::unique_ptr<Encoder> opus_;
+    const SizeLimitOptions limit_;
+    const long long totalFrames_;
+    EncoderConfig config_;
+    std::vector<int> steps_;
+    long long longestFrames_ = 0;
+    long long shortestFrames_ = 0;
+    int bitrate_ = 0;
+    long long done_ = 0;
+    long long next_ = 0;
+    double bytes_ = 0.0;
+    double held_ = kOpusHeaderBytes;
+};
+
+}  // namespace
+
+int sizeLimitCeiling(const SizeLimitOptions& limit, int bitrate, OutputFormat format) {
+    if (bitrate > 0) {
+        return bitrate;
+    }
+    return limit.targetBytes > 0 ? kMaxLimitBitrate : defaultBitrate(format);
+}
+
+int sizeLimitSampleRate(OutputFormat format, int sampleRate) {
+    if (format != OutputFormat::Mp3) {
+        return sampleRate;
+    }
+    int rate = kMp3Rates[0];
+    for (int supported : kMp3Rates) {
+        if (supported <= sampleRate) {
+            rate = supported;
+        }
+    }
+    return rate;
+}
+
+std::unique_ptr<Encoder> openSizeLimitedEncoder(EncoderBackend requested, const EncoderConfig& config,
+                                                const SizeLimitOptions& options, long long frames,
+                                                std::string* errorCode, std::string* error) {
+    *errorCode = kErrorSize;
+    if (frames <= 0) {
+        *error = "maxBytes and targetBytes need an input of known length";
+        return nullptr;
+    }
+    SizeLimitOptions limit = options;
+    if (limit.maxBytes > 0 && limit.targetBytes > limit.maxBytes) {
+        limit.targetBytes = limit.maxBytes;
+    }
+    const long long aim = limit.targetBytes > 0 ? limit.targetBytes : limit.maxBytes;
+    const double seconds = (double)frames / config.sampleRate;
+
+    // Bytes at the highest and the lowest bitrate
+    double most;
+    double least;
+    int lowest;
+    if (config.format == OutputFormat::Opus) {
+        lowest = kMinOpusBitrate;
+        most = kOpusHeaderBytes + opusCost(config.bitrate, seconds);
+        least = kOpusHeaderBytes + opusCost(lowest, seconds);
+    } else {
+        const std::vector<int> steps = mp3Bitrates(config.sampleRate, config.bitrate);
+        const long long mp3 = mp3Frames(frames, config.sampleRate, kLameDelaySamples);
+        lowest = steps.front();
+        most = infoFrameBytes(steps.back(), config.sampleRate, config.channels) +
+               mp3Cost(steps.back(), (double)mp3, config.sampleRate);
+        least = infoFrameBytes(lowest, config.sampleRate, config.channels) +
+                mp3Cost(lowest, (double)mp3, config.sampleRate);
+    }
+    if (limit.maxBytes > 0 && least > (double)limit.maxBytes) {
+        char message[160];
+        snprintf(message, sizeof(message), "maxBytes %lld cannot hold %.1f s even at %d kbps, about %.0f bytes",
+                 limit.maxBytes, seconds, lowest, least);
+        *error = message;
+        return nullptr;
+    }
+
+    *errorCode = kErrorEncoder;
+    // Opus VBR may wander past a hard limit, CBR MP3 cannot
+    if (most <= (double)aim && (config.format == OutputFormat::Mp3 || limit.maxBytes == 0)) {
+        LOGI("Size limit: %d kbps fits, about %.0f of %lld bytes", config.bitrate, most, aim);
+        return openEncoder(requested, config, error);
+    }
+    std::unique_ptr<Encoder> encoder;
+    EncoderConfig limited = config;
+    if (config.format == OutputFormat::Opus) {
+        std::unique_ptr<Encoder> opus = createOpusEncoder();
+        if (!opus) {
+            *error = "Opus support was not compiled in";
+            return nullptr;
+        }
+        limited.constantBitrate = limit.maxBytes > 0;
+        encoder.reset(new SteeredOpusEncoder(std::move(opus), limit, frames));
+    } else {
+        if (requested == EncoderBackend::Fixed) {
+            LOGW("The fixed-point encoder cannot change bitrate mid-stream; size limit uses LAME");
+        }
+        encoder.reset(new SegmentedMp3Encoder(limit, frames));
+    }
+    if (encoder->open(limited, error) != 0) {
+        return nullptr;
+    }
+    return encoder;
+}
+
+}  // namespace wavtomp3
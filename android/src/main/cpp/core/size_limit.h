@@ -0,0 +1,60 @@
+// Output size limits, such as the 16 MB a messaging or mail attachment may
+// take, met in a single encode pass.
+//
+// The first bitrate follows from the input's length and the budget. The
+// encode then runs in stretches of a few seconds, and before each one the
+// bitrate is chosen again from the bytes actually written and the audio
+// left, so the rounding to the bitrates a format offers, the Ogg overhead
+// and Opus's VBR wander are made up by the stretches that follow instead of
+// by encoding again.
+//
+// MP3 frames can only change bitrate where no frame borrows bits from the
+// one before it, so each MP3 stretch is a segment as in segment.h: its own
+// CBR LAME encoder with the bit reservoir off, started two frames early so
+// it has primed by the cut, and the frames are joined behind one Xing tag
+// with a seek table. Opus changes its bitrate in place, and under maxBytes
+// runs hard CBR so each packet's size is known before it is encoded.
+//
+// maxBytes holds whenever the input's length is known up front (WAV, raw
+// PCM, decoded AAC) and the limit can take the whole input at the lowest
+// bitrate; targetBytes is aimed at and typically missed by well under 1%.
+// A job whose bitrate fits anyway is encoded as usual.
+#ifndef WAV_TO_MP3_SIZE_LIMIT_H
+#define WAV_TO_MP3_SIZE_LIMIT_H
+
+#include <memory>
+#include <string>
+
+#include "encoder.h"
+
+namespace wavtomp3 {
+
+struct SizeLimitOptions {
+    long long maxBytes = 0;     // never exceeded; 0: no limit
+    long long targetBytes = 0;  // aimed at; 0: maxBytes, if set
+
+    bool enabled() const { return maxBytes > 0 || targetBytes > 0; }
+};
+
+// Highest bitrate a size-limited job may use: `bitrate` if the job sets one
+// (> 0), otherwise the format's default under maxBytes alone and 320 kbps
+// when there is a target to fill.
+int sizeLimitCeiling(const SizeLimitOptions& limit, int bitrate, OutputFormat format);
+
+// Rate to encode `sampleRate` at when the size is limited: MP3 segments
+// cannot leave resampling to LAME, so rates MP3 lacks go to the nearest
+// lower one it has.
+int sizeLimitSampleRate(OutputFormat format, int sampleRate);
+
+// Opens an encoder that keeps a stream of `frames` frames at
+// config.sampleRate within `limit`, at no more than config.bitrate.
+// Returns nullptr with `errorCode` set: kErrorSize if the length is
+// unknown or maxBytes cannot hold the input at the lowest bitrate,
+// kErrorEncoder if the encoder fails to open.
+std::unique_ptr<Encoder> openSizeLimitedEncoder(EncoderBackend requested, const EncoderConfig& config,
+                                                const SizeLimitOptions& limit, long long frames,
+                                                std::string* errorCode, std::string* error);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_SIZE_LIMIT_H
@@ -0,0 +1,144 @@
+#include "wav_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sys/types.h>
+
+namespace wavtomp3 {
+
+namespace {
+
+uint16_t readLe16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t readLe32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t readLe64(const unsigned char* p) {
+    return (uint64_t)readLe32(p) | ((uint64_t)readLe32(p + 4) << 32);
+}
+
+// RIFF, or RF64/BW64 whose 32-bit sizes are in a ds64 chunk
+bool isRiffId(const unsigned char* id) {
+    return memcmp(id, "RIFF", 4) == 0 || memcmp(id, "RF64", 4) == 0 || memcmp(id, "BW64", 4) == 0;
+}
+
+void writeLe16(unsigned char* p, uint16_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+void writeLe32(unsigned char* p, uint32_t value) {
+    writeLe16(p, (uint16_t)value);
+    writeLe16(p + 2, (uint16_t)(value >> 16));
+}
+
+long long fileSize(FILE* file) {
+    off_t current = ftello(file);
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    long long size = ftello(file);
+    fseeko(file, current, SEEK_SET);
+    return size;
+}
+
+}  // namespace
+
+bool isWavFile(FILE* file) {
+    unsigned char header[12];
+    rewind(file);
+    size_t got = fread(header, 1, sizeof(header), file);
+    rewind(file);
+    return got == sizeof(header) && isRiffId(header) && memcmp(header + 8, "WAVE", 4) == 0;
+}
+
+int readWavHeader(FILE* file, WavInfo* info, std::string* error) {
+    unsigned char header[12];
+    rewind(file);
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || !isRiffId(header)) {
+        *error = "Not a valid WAV file (missing RIFF header)";
+        return -1;
+    }
+    if (memcmp(header + 8, "WAVE", 4) != 0) {
+        *error = "Not a valid WAV file (missing WAVE identifier)";
+        return -1;
+    }
+
+    const long long size = fileSize(file);
+    bool fmtFound = false;
+    long long ds64DataSize = -1;
+    unsigned char chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk)) {
+        uint32_t chunkSize = readLe32(chunk + 4);
+        long long chunkStart = ftello(file);
+
+        if (memcmp(chunk, "ds64", 4) == 0) {
+            // RIFF size, data size and sample count, each 64-bit
+            unsigned char ds64[16];
+            if (chunkSize < sizeof(ds64) || fread(ds64, 1, sizeof(ds64), file) != sizeof(ds64)) {
+                *error = "Truncated ds64 chunk in RF64 file";
+                return -1;
+            }
+            ds64DataSize = (long long)readLe64(ds64 + 8);
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[40] = {0};
+            size_t toRead = chunkSize < sizeof(fmt) ? chunkSize : sizeof(fmt);
+            if (chunkSize < 16 || fread(fmt, 1, toRead, file) != toRead) {
+                *error = "Truncated fmt chunk in WAV file";
+                return -1;
+            }
+            info->audioFormat = readLe16(fmt);
+            info->channels = readLe16(fmt + 2);
+            info->sampleRate = (int)readLe32(fmt + 4);
+            info->blockAlign = readLe16(fmt + 12);
+            info->bitsPerSample = readLe16(fmt + 14);
+            if (info->audioFormat == kWavFormatExtensible && toRead >= 26) {
+                // The first two bytes of the sub-format GUID hold the actual format tag
+                info->audioFormat = readLe16(fmt + 24);
+            }
+            fmtFound = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!fmtFound) {
+                *error = "fmt chunk not found in WAV file";
+                return -1;
+            }
+            info->dataOffset = chunkStart;
+            info->dataSize = chunkSize == 0xFFFFFFFFu && ds64DataSize >= 0 ? ds64DataSize : chunkSize;
+            // Recorders that were interrupted leave 0 or 0xFFFFFFFF here
+            if (size > 0 && (info->dataSize == 0 || chunkStart + info->dataSize > size)) {
+                info->dataSize = size - chunkStart;
+            }
+            return 0;
+        }
+
+        // Chunks are word aligned
+        if (fseeko(file, (off_t)(chunkStart + chunkSize + (chunkSize & 1)), SEEK_SET) != 0) {
+            break;
+        }
+    }
+
+    *error = fmtFound ? "data chunk not found in WAV file" : "fmt chunk not found in WAV file";
+    return -1;
+}
+
+void buildWavHeader(int sampleRate, int channels, long long dataSize, unsigned char* header) {
+    // RIFF sizes are 32-bit; longer data is declared as the maximum
+    uint32_t size = dataSize > 0xFFFFFFFFLL - 36 ? 0xFFFFFFFFu - 36 : (uint32_t)dataSize;
+    memcpy(header, "RIFF", 4);
+    writeLe32(header + 4, 36 + size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    writeLe32(header + 16, 16);
+    writeLe16(header + 20, kWavFormatPcm);
+    writeLe16(header + 22, (uint16_t)channels);
+    writeLe32(header + 24, (uint32_t)sampleRate);
+    writeLe32(header + 28, (uint32_t)(sampleRate * channels * 2));
+    writeLe16(header + 32, (uint16_t)(channels * 2));
+    writeLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    writeLe32(header + 40, size);
+}
+
+}  // namespace wavtomp3
@@ -0,0 +1,42 @@
+// RIFF/WAVE (and RF64/BW64) header parsing and writing.
+#ifndef WAV_TO_MP3_WAV_FILE_H
+#define WAV_TO_MP3_WAV_FILE_H
+
+#include <cstdio>
+#include <string>
+
+namespace wavtomp3 {
+
+enum WavFormatTag {
+    kWavFormatPcm = 1,
+    kWavFormatIeeeFloat = 3,
+    kWavFormatExtensible = 0xFFFE,
+};
+
+struct WavInfo {
+    int audioFormat = 0;        // kWavFormatPcm or kWavFormatIeeeFloat (extensible is resolved)
+    int channels = 0;
+    int sampleRate = 0;
+    int bitsPerSample = 0;
+    int blockAlign = 0;
+    long long dataOffset = 0;   // byte offset of the first sample
+    long long dataSize = 0;     // bytes of sample data, clamped to the file size
+};
+
+// Walks the chunk list of a RIFF/WAVE file and fills `info` from the `fmt `
+// and `data` chunks. Leaves the file positioned at the first sample.
+// Returns 0 on success, -1 with a message in `error` otherwise.
+int readWavHeader(FILE* file, WavInfo* info, std::string* error);
+
+// True if the first bytes of `file` look like RIFF/WAVE. Rewinds the file.
+bool isWavFile(FILE* file);
+
+// Size of the header buildWavHeader() writes
+const int kWavHeaderBytes = 44;
+
+// Writes a canonical 16-bit PCM header for `dataSize` bytes of samples.
+void buildWavHeader(int sampleRate, int channels, long long dataSize, unsigned char* header);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_WAV_FILE_H
@@ -0,0 +1,209 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+#include "log.h"
+
+namespace wavtomp3 {
+
+namespace {
+
+// Two interactive encodes in parallel keep a prime + big core busy without
+// starving the UI thread; background work gets a single thread.
+const int kMaxInteractiveThreads = 2;
+const int kBackgroundNice = 10;
+
+}  // namespace
+
+int currentCpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+const char* priorityName(JobPriority priority) {
+    return priority == JobPriority::Background ? "background" : "interactive";
+}
+
+bool parsePriority(const std::string& name, JobPriority* priority) {
+    if (name == "interactive") {
+        *priority = JobPriority::Interactive;
+    } else if (name == "background") {
+        *priority = JobPriority::Background;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Placement planPlacement(const CpuTopology& topology, JobPriority priority) {
+    Placement placement;
+    placement.priority = priority;
+    if (!topology.isHeterogeneous()) {
+        return placement;
+    }
+    if (priority == JobPriority::Interactive) {
+        placement.policy = "performance";
+        placement.cpus = topology.performanceCores();
+    } else {
+        placement.policy = "efficiency";
+        placement.cpus = topology.efficiencyCores();
+    }
+    return placement;
+}
+
+void applyPlacement(Placement* placement, JobPriority priority) {
+#if defined(__linux__)
+    if (!placement->cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : placement->cpus) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            LOGW("Failed to pin %s worker to cpus %s: %s", priorityName(priority),
+                 formatCpuList(placement->cpus).c_str(), strerror(errno));
+            placement->policy = "any";
+            placement->cpus.clear();
+        }
+    }
+    if (priority == JobPriority::Background) {
+        // Nice values are per thread on Linux
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), kBackgroundNice);
+    }
+#elif defined(__APPLE__)
+    // No sysfs here; the QoS class steers the thread to P or E cores.
+    pthread_set_qos_class_self_np(priority == JobPriority::Interactive ? QOS_CLASS_USER_INITIATED
+                                                                       : QOS_CLASS_UTILITY, 0);
+#endif
+    LOGI("%s worker placement: %s %s", priorityName(priority), placement->policy.c_str(),
+         formatCpuList(placement->cpus).c_str());
+}
+
+WorkerPool::WorkerPool(const CpuTopology& topology) {
+    interactive_.priority = JobPriority::Interactive;
+    interactive_.placement = planPlacement(topology, JobPriority::Interactive);
+    int fastCores = (int)topology.performanceCores().size();
+    interactive_.maxThreads = std::max(1, std::min(kMaxInteractiveThreads, fastCores));
+    background_.priority = JobPriority::Background;
+    background_.placement = planPlacement(topology, JobPriority::Background);
+    background_.maxThreads = 1;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (Lane* lane : {&interactive_, &background_}) {
+        for (std::thread& thread : lane->threads) {
+            thread.join();
+        }
+    }
+}
+
+void WorkerPool::submit(JobPriority priority, Job job) {
+    Lane* lane = priority == JobPriority::Background ? &background_ : &interactive_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lane->queue.push_back(std::move(job));
+        if ((int)lane->queue.size() > lane->idle && (int)lane->threads.size() < lane->maxThreads) {
+            lane->threads.emplace_back(&WorkerPool::run, this, lane);
+        }
+    }
+    wake_.notify_all();
+}
+
+void WorkerPool::run(Lane* lane) {
+    Placement placement = lane->placement;
+    applyPlacement(&placement, lane->priority);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        lane->idle++;
+        wake_.wait(lock, [&] { return stopping_ || !lane->queue.empty(); });
+        lane->idle--;
+        if (lane->queue.empty()) {
+            return;
+        }
+        Job job = std::move(lane->queue.front());
+        lane->queue.pop_front();
+        lock.unlock();
+        job(placement);
+        lock.lock();
+    }
+}
+
+WorkerPool& WorkerPool::shared() {
+    // Never destroyed: a conversion may still be running at process exit
+    static WorkerPool* pool = new WorkerPool(cpuTopology());
+    return *pool;
+}
+
+int runOnWorker(JobPriority priority,
+                const std::function<int(const std::function<void(float)>&)>& work,
+                const std::function<void(float)>& progress, Placement* placement) {
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool done = false;
+        bool progressPending = false;
+        float progress = 0.0f;
+        int status = -1;
+        Placement placement;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+
+    WorkerPool::shared().submit(priority, [state, &work](const Placement& lanePlacement) {
+        int status = work([state](float value) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->progress = value;
+            state->progressPending = true;
+            state->changed.notify_one();
+        });
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->status = status;
+        state->placement = lanePlacement;
+        state->placement.cpu = currentCpu();
+        state->done = true;
+        state->changed.notify_one();
+    });
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (;;) {
+        state->changed.wait(lock, [&] { return state->done || state->progressPending; });
+        if (state->progressPending) {
+            // Only the latest value matters; earlier ones may be skipped
+            float value = state->progress;
+            state->progressPending = false;
+            lock.unlock();
+            if (progress) {
+                progress(value);
+            }
+            lock.lock();
+            continue;
+        }
+        break;
+    }
+    *placement = state->placement;
+    return state->status;
+}
+
+}  // namespace wavtomp3
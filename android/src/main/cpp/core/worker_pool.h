@@ -0,0 +1,90 @@
+// Encode worker threads placed on CPU cores according to job priority.
+//
+// On big.LITTLE SoCs a thread left to the scheduler can end up on a little
+// core that encodes several times slower. Interactive jobs are pinned to the
+// performance cores, background jobs to the efficiency cores.
+#ifndef WAV_TO_MP3_WORKER_POOL_H
+#define WAV_TO_MP3_WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu_topology.h"
+
+namespace wavtomp3 {
+
+enum class JobPriority { Interactive, Background };
+
+const char* priorityName(JobPriority priority);
+bool parsePriority(const std::string& name, JobPriority* priority);
+
+struct Placement {
+    JobPriority priority = JobPriority::Interactive;
+    std::string policy = "any";  // "performance", "efficiency" or "any"
+    std::vector<int> cpus;       // affinity mask, empty when not pinned
+    int cpu = -1;                // core the job finished on, -1 if unknown
+};
+
+// Cores a job of `priority` should run on. Homogeneous or unknown
+// topologies are left to the scheduler.
+Placement planPlacement(const CpuTopology& topology, JobPriority priority);
+
+// Core the calling thread is running on, -1 if unknown.
+int currentCpu();
+
+// Applies `placement` to the calling thread. On failure (e.g. the cores are
+// outside the app's cpuset) the thread stays unpinned and the policy is
+// reset to "any".
+void applyPlacement(Placement* placement, JobPriority priority);
+
+class WorkerPool {
+public:
+    typedef std::function<void(const Placement&)> Job;
+
+    explicit WorkerPool(const CpuTopology& topology);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queues `job` on the threads for `priority`; threads start on first use.
+    void submit(JobPriority priority, Job job);
+
+    // Pool used by the platform glue, placed using cpuTopology().
+    static WorkerPool& shared();
+
+private:
+    struct Lane {
+        JobPriority priority;
+        Placement placement;
+        int maxThreads = 1;
+        int idle = 0;
+        std::vector<std::thread> threads;
+        std::deque<Job> queue;
+    };
+
+    void run(Lane* lane);
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    Lane interactive_;
+    Lane background_;
+};
+
+// Runs `work` on the shared pool and blocks until it returns. Progress the
+// job reports is handed to `progress` on the calling thread, so platform
+// callbacks (JNI, ...) never run on pool threads. Returns what `work`
+// returned.
+int runOnWorker(JobPriority priority,
+                const std::function<int(const std::function<void(float)>&)>& work,
+                const std::function<void(float)>& progress, Placement* placement);
+
+}  // namespace wavtomp3
+
+#endif  // WAV_TO_MP3_WORKER_POOL_H
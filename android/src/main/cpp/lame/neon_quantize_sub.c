@@ -0,0 +1,33 @@
+/*
+ * NEON entry points for LAME. The ARM build compiles quantize.c and fft.c
+ * with LAME's SSE hook enabled and the hook names mapped onto these
+ * functions, so LAME picks them up without patching its sources.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "lame.h"
+#include "machine.h"
+#include "encoder.h"
+#include "util.h"
+#include "simd_kernels.h"
+
+void    init_xrpow_core_neon(gr_info * const cod_info, FLOAT xrpow[576], int upper, FLOAT * sum);
+void    fht_neon(FLOAT * fz, int n);
+
+void
+init_xrpow_core_neon(gr_info * const cod_info, FLOAT xrpow[576], int upper, FLOAT * sum)
+{
+    float   max;
+
+    simd_xrpow(cod_info->xr, xrpow, upper + 1, sum, &max);
+    if (max > cod_info->xrpow_max)
+        cod_info->xrpow_max = max;
+}
+
+void
+fht_neon(FLOAT * fz, int n)
+{
+    simd_fht(fz, n);
+}
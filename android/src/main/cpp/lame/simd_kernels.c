@@ -0,0 +1,256 @@
+/*
+ * Vectorized LAME kernels, see simd_kernels.h.
+ */
+#include "simd_kernels.h"
+
+#include "core/simd.h"
+
+/* Same constants as LAME's fft.c / util.h */
+#define SQRT2 1.41421356237309504880
+#define TRI_SIZE (5 - 1)
+#define MAX_FHT_HALF 128
+
+#if defined(WAV_TO_MP3_LAME_AVX2)
+void simd_quantize_xrpow_avx2(const float *xr, int *ix, int count, float istep, const float *adj43);
+
+static int
+have_avx2(void)
+{
+    /* Racing first calls store the same value */
+    static int cached = -1;
+    if (cached < 0)
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return cached;
+}
+#endif
+
+static const float costab[TRI_SIZE * 2] = {
+    9.238795325112867e-01, 3.826834323650898e-01,
+    9.951847266721969e-01, 9.801714032956060e-02,
+    9.996988186962042e-01, 2.454122852291229e-02,
+    9.999811752826011e-01, 6.135884649154475e-03
+};
+
+void
+simd_fht(float *fz, int n)
+{
+    const float *tri = costab;
+    int     k4;
+    float  *fi, *gi;
+    float const *fn;
+    /* Per-lane twiddles, generated with the scalar recurrence so every lane
+     * sees exactly the values the scalar loop would. */
+    float   c1v[MAX_FHT_HALF], s1v[MAX_FHT_HALF], c2v[MAX_FHT_HALF], s2v[MAX_FHT_HALF];
+
+    n <<= 1;
+    fn = fz + n;
+    k4 = 4;
+    do {
+        float   s1, c1;
+        int     i, k1, k2, k3, kx;
+        kx = k4 >> 1;
+        k1 = k4;
+        k2 = k4 << 1;
+        k3 = k2 + k1;
+        k4 = k2 << 1;
+        fi = fz;
+        gi = fi + kx;
+        do {
+            float   f0, f1, f2, f3;
+            f1 = fi[0] - fi[k1];
+            f0 = fi[0] + fi[k1];
+            f3 = fi[k2] - fi[k3];
+            f2 = fi[k2] + fi[k3];
+            fi[k2] = f0 - f2;
+            fi[0] = f0 + f2;
+            fi[k3] = f1 - f3;
+            fi[k1] = f1 + f3;
+            f1 = gi[0] - gi[k1];
+            f0 = gi[0] + gi[k1];
+            f3 = SQRT2 * gi[k3];
+            f2 = SQRT2 * gi[k2];
+            gi[k2] = f0 - f2;
+            gi[0] = f0 + f2;
+            gi[k3] = f1 - f3;
+            gi[k1] = f1 + f3;
+            gi += k4;
+            fi += k4;
+        } while (fi < fn);
+
+        c1 = tri[0];
+        s1 = tri[1];
+        for (i = 1; i < kx; i++) {
+            float   c2, s2;
+            c2 = 1 - (2 * s1) * s1;
+            s2 = (2 * s1) * c1;
+            c1v[i] = c1;
+            s1v[i] = s1;
+            c2v[i] = c2;
+            s2v[i] = s2;
+            c2 = c1;
+            c1 = c2 * tri[0] - s1 * tri[1];
+            s1 = c2 * tri[1] + s1 * tri[0];
+        }
+
+        /* Four consecutive i at once. The fi lanes ascend and the gi lanes
+         * descend, so gi is loaded from its lowest address and reversed.
+         * Distinct i never touch the same elements, so the order of
+         * evaluation across lanes does not matter. */
+        for (i = 1; i + SIMD_WIDTH <= kx; i += SIMD_WIDTH) {
+            const simd_f32x4 vc1 = simd_load(c1v + i);
+            const simd_f32x4 vs1 = simd_load(s1v + i);
+            const simd_f32x4 vc2 = simd_load(c2v + i);
+            const simd_f32x4 vs2 = simd_load(s2v + i);
+            fi = fz + i;
+            gi = fz + k1 - i - (SIMD_WIDTH - 1);
+            do {
+                simd_f32x4 a, b, f0, f1, f2, f3, g0, g1, g2, g3, fx, gx;
+                fx = simd_load(fi + k1);
+                gx = simd_reverse(simd_load(gi + k1));
+                b = simd_sub(simd_mul(vs2, fx), simd_mul(vc2, gx));
+                a = simd_add(simd_mul(vc2, fx), simd_mul(vs2, gx));
+                fx = simd_load(fi);
+                gx = simd_reverse(simd_load(gi));
+                f1 = simd_sub(fx, a);
+                f0 = simd_add(fx, a);
+                g1 = simd_sub(gx, b);
+                g0 = simd_add(gx, b);
+                fx = simd_load(fi + k3);
+                gx = simd_reverse(simd_load(gi + k3));
+                b = simd_sub(simd_mul(vs2, fx), simd_mul(vc2, gx));
+                a = simd_add(simd_mul(vc2, fx), simd_mul(vs2, gx));
+                fx = simd_load(fi + k2);
+                gx = simd_reverse(simd_load(gi + k2));
+                f3 = simd_sub(fx, a);
+                f2 = simd_add(fx, a);
+                g3 = simd_sub(gx, b);
+                g2 = simd_add(gx, b);
+                b = simd_sub(simd_mul(vs1, f2), simd_mul(vc1, g3));
+                a = simd_add(simd_mul(vc1, f2), simd_mul(vs1, g3));
+                simd_store(fi + k2, simd_sub(f0, a));
+                simd_store(fi, simd_add(f0, a));
+                simd_store(gi + k3, simd_reverse(simd_sub(g1, b)));
+                simd_store(gi + k1, simd_reverse(simd_add(g1, b)));
+                b = simd_sub(simd_mul(vc1, g2), simd_mul(vs1, f3));
+                a = simd_add(simd_mul(vs1, g2), simd_mul(vc1, f3));
+                simd_store(gi + k2, simd_reverse(simd_sub(g0, a)));
+                simd_store(gi, simd_reverse(simd_add(g0, a)));
+                simd_store(fi + k3, simd_sub(f1, b));
+                simd_store(fi + k1, simd_add(f1, b));
+                gi += k4;
+                fi += k4;
+            } while (fi < fn);
+        }
+
+        for (; i < kx; i++) {
+            const float c1s = c1v[i], s1s = s1v[i], c2 = c2v[i], s2 = s2v[i];
+            fi = fz + i;
+            gi = fz + k1 - i;
+            do {
+                float   a, b, g0, f0, f1, g1, f2, g2, f3, g3;
+                b = s2 * fi[k1] - c2 * gi[k1];
+                a = c2 * fi[k1] + s2 * gi[k1];
+                f1 = fi[0] - a;
+                f0 = fi[0] + a;
+                g1 = gi[0] - b;
+                g0 = gi[0] + b;
+                b = s2 * fi[k3] - c2 * gi[k3];
+                a = c2 * fi[k3] + s2 * gi[k3];
+                f3 = fi[k2] - a;
+                f2 = fi[k2] + a;
+                g3 = gi[k2] - b;
+                g2 = gi[k2] + b;
+                b = s1s * f2 - c1s * g3;
+                a = c1s * f2 + s1s * g3;
+                fi[k2] = f0 - a;
+                fi[0] = f0 + a;
+                gi[k3] = g1 - b;
+                gi[k1] = g1 + b;
+                b = c1s * g2 - s1s * f3;
+                a = s1s * g2 + c1s * f3;
+                gi[k2] = g0 - a;
+                gi[0] = g0 + a;
+                fi[k3] = f1 - b;
+                fi[k1] = f1 + b;
+                gi += k4;
+                fi += k4;
+            } while (fi < fn);
+        }
+        tri += 2;
+    } while (k4 < n);
+}
+
+void
+simd_xrpow(const float *xr, float *xrpow, int count, float *sum, float *max)
+{
+    simd_f32x4 vsum = simd_zero();
+    simd_f32x4 vmax = simd_zero();
+    float   tail_sum = 0, tail_max = 0;
+    int     i;
+
+    for (i = 0; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        const simd_f32x4 a = simd_abs(simd_load(xr + i));
+        const simd_f32x4 p = simd_sqrt(simd_mul(a, simd_sqrt(a)));
+        vsum = simd_add(vsum, a);
+        vmax = simd_max(vmax, p);
+        simd_store(xrpow + i, p);
+    }
+    for (; i < count; i++) {
+        const float a = fabsf(xr[i]);
+        const float p = sqrtf(a * sqrtf(a));
+        tail_sum += a;
+        if (p > tail_max)
+            tail_max = p;
+        xrpow[i] = p;
+    }
+    *sum = simd_hsum(vsum) + tail_sum;
+    *max = simd_hmax(vmax);
+    if (tail_max > *max)
+        *max = tail_max;
+}
+
+void
+simd_quantize_xrpow(const float *xr, int *ix, int count, float istep, const float *adj43)
+{
+    const simd_f32x4 step = simd_set1(istep);
+    int     rx[SIMD_WIDTH];
+    float   adj[SIMD_WIDTH];
+    int     i;
+
+#if defined(WAV_TO_MP3_LAME_AVX2)
+    if (have_avx2()) {
+        simd_quantize_xrpow_avx2(xr, ix, count, istep, adj43);
+        return;
+    }
+#endif
+    for (i = 0; i + SIMD_WIDTH <= count; i += SIMD_WIDTH) {
+        const simd_f32x4 x = simd_mul(simd_load(xr + i), step);
+        /* No gather below AVX2: look the four adjustments up one by one */
+        simd_store_i32(rx, simd_ftoi(x));
+        adj[0] = adj43[rx[0]];
+        adj[1] = adj43[rx[1]];
+        adj[2] = adj43[rx[2]];
+        adj[3] = adj43[rx[3]];
+        simd_store_i32(ix + i, simd_ftoi(simd_add(x, simd_load(adj))));
+    }
+    for (; i < count; i++) {
+        const float x = xr[i] * istep;
+        ix[i] = (int)(x + adj43[(int)x]);
+    }
+}
+
+const char *
+simd_quantize_isa(void)
+{
+#if defined(WAV_TO_MP3_LAME_AVX2)
+    if (have_avx2())
+        return "avx2";
+#endif
+#if defined(SIMD_NEON)
+    return "neon";
+#elif defined(SIMD_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,41 @@
+/*
+ * Vectorized versions of LAME's hottest hookable inner loops, written against
+ * core/simd.h so the same code runs on NEON (where LAME has no vector code)
+ * and on the host for validation and benchmarking.
+ */
+#ifndef WAV_TO_MP3_LAME_SIMD_KERNELS_H
+#define WAV_TO_MP3_LAME_SIMD_KERNELS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fast Hartley transform used by the psychoacoustic model; same contract as
+ * LAME's fht(): fz holds 2 * n samples, transformed in place. Bit-exact with
+ * the scalar version when neither is built with FMA contraction.
+ */
+void simd_fht(float *fz, int n);
+
+/*
+ * xrpow[i] = |xr[i]|^(3/4) for i < count, as in init_xrpow_core().
+ * Returns the sum of |xr[i]| in *sum and the largest xrpow value in *max.
+ */
+void simd_xrpow(const float *xr, float *xrpow, int count, float *sum, float *max);
+
+/*
+ * ix[i] = (int)(x + adj43[(int)x]) with x = xr[i] * istep, for i < count, as
+ * in takehiro.c's quantize_lines_xrpow() (the non-IEEE754-hack version).
+ * adj43 is LAME's rounding table. Bit-exact. x86 builds switch to an AVX2
+ * version at run time when the CPU has it.
+ */
+void simd_quantize_xrpow(const float *xr, int *ix, int count, float istep, const float *adj43);
+
+/* "avx2", "sse2", "neon" or "scalar": the code simd_quantize_xrpow() runs */
+const char *simd_quantize_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAV_TO_MP3_LAME_SIMD_KERNELS_H */
@@ -0,0 +1,24 @@
+/*
+ * AVX2 version of simd_quantize_xrpow(), built with -mavx2 on x86 and picked
+ * at run time. The adj43 lookups become one gather per eight lines.
+ */
+#include <immintrin.h>
+
+void simd_quantize_xrpow_avx2(const float *xr, int *ix, int count, float istep, const float *adj43);
+
+void
+simd_quantize_xrpow_avx2(const float *xr, int *ix, int count, float istep, const float *adj43)
+{
+    const __m256 step = _mm256_set1_ps(istep);
+    int     i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(xr + i), step);
+        const __m256 adj = _mm256_i32gather_ps(adj43, _mm256_cvttps_epi32(x), 4);
+        _mm256_storeu_si256((__m256i *) (ix + i), _mm256_cvttps_epi32(_mm256_add_ps(x, adj)));
+    }
+    for (; i < count; i++) {
+        const float x = xr[i] * istep;
+        ix[i] = (int)(x + adj43[(int)x]);
+    }
+}
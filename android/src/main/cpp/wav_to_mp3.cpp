@@ -1,6 +1,9 @@
 #include <jni.h>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <android/log.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -8,11 +11,18 @@
 #include <android/native_window_jni.h>
 #include <media/NdkMediaCodec.h>
 #include <media/NdkMediaExtractor.h>
-#include "lame/lame.h"
 
-#define LOG_TAG "WavToMp3"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#include "calibration.h"
+#include "converter.h"
+#include "estimate.h"
+#include "fingerprint.h"
+#include "log.h"
+#include "mp3_edit.h"
+#include "options.h"
+#include "pcm_cache.h"
+#include "probe.h"
+
+using namespace wavtomp3;
 
 // Function to get file size
 long getFileSize(const char* filename) {
@@ -529,613 +539,401 @@ int decodeAacToPcmFallback(const char* inputPath, const char* outputPath, int* s
     return 0;
 }
 
+namespace {
+
+// Strips the file:// scheme React Native passes for local files
+const char* stripFileScheme(const char* path) {
+    return strncmp(path, "file://", 7) == 0 ? path + 7 : path;
+}
+
+std::string toString(JNIEnv* env, jstring value) {
+    const char* chars = env->GetStringUTFChars(value, nullptr);
+    std::string result(chars);
+    env->ReleaseStringUTFChars(value, chars);
+    return result;
+}
+
+// Decodes AAC through MediaCodec into `tempPcmPath` and opens the result,
+// or opens the decoded PCM an earlier job left in options.pcmCache. The
+// decode's speed goes into the estimate() model. The caller removes
+// `tempPcmPath` once the source is closed.
+std::unique_ptr<AudioSource> openAacInput(const std::string& input, const std::string& tempPcmPath,
+                                          const ConversionOptions& options, std::string* errorCode,
+                                          std::string* error) {
+    LOGI("Detected AAC format from file extension");
+    const PcmCacheOptions& cache = options.pcmCache;
+    std::string cacheKey;
+    if (cache.active()) {
+        std::string cacheError;
+        if (pcmCacheKey(input, &cacheKey, &cacheError) != 0) {
+            LOGW("Not caching decoded PCM: %s", cacheError.c_str());
+            cacheKey.clear();
+        } else if (std::unique_ptr<AudioSource> cached = openCachedPcm(cache, cacheKey)) {
+            LOGI("Reading decoded PCM from the cache: %s", cacheKey.c_str());
+            return cached;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    int sampleRate, channels;
+    if (decodeAacToPcm(input.c_str(), tempPcmPath.c_str(), &sampleRate, &channels) != 0) {
+        *errorCode = "DECODE_ERROR";
+        *error = "Failed to decode AAC file";
+        return nullptr;
+    }
+    double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOGI("Successfully decoded AAC to PCM: sampleRate=%d, channels=%d", sampleRate, channels);
+
+    AudioFormat pcmFormat;
+    pcmFormat.sampleRate = sampleRate;
+    pcmFormat.channels = channels;
+    pcmFormat.sampleFormat = SampleFormat::S16;
+    std::unique_ptr<AudioSource> source = openRawPcmSource(tempPcmPath, pcmFormat, error);
+    if (!source) {
+        *errorCode = kErrorFile;
+        return nullptr;
+    }
+    recordDecode(options, decodeMs, (double)source->totalFrames() / sampleRate);
+    std::string cacheError;
+    if (!cacheKey.empty() && storeCachedPcm(cache, cacheKey, source.get(), &cacheError) != 0) {
+        LOGW("Failed to cache decoded PCM: %s", cacheError.c_str());
+    }
+    return source;
+}
+
+bool isAacPath(const std::string& path) {
+    std::string extension = getFileFormat(path.c_str());
+    return extension == "aac" || extension == "m4a";
+}
+
+int readOptions(JNIEnv* env, jobjectArray keys, jobjectArray values, ConversionOptions* options,
+                std::string* error) {
+    jsize count = env->GetArrayLength(keys);
+    for (jsize i = 0; i < count; i++) {
+        jstring key = (jstring)env->GetObjectArrayElement(keys, i);
+        jstring value = (jstring)env->GetObjectArrayElement(values, i);
+        int status = setOption(options, toString(env, key), toString(env, value), error);
+        env->DeleteLocalRef(key);
+        env->DeleteLocalRef(value);
+        if (status != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
 extern "C" {
 
-JNIEXPORT jint JNICALL
-Java_com_wavtomp3_WavToMp3Module_nativeConvertWavToMp3(
+// Converts `inputPath` to MP3 and returns the result as "key=value" lines
+// (see formatResult). Progress is reported through onNativeProgress(float).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeConvertAudioToMp3(
         JNIEnv *env,
-        jobject /* this */,
+        jobject thiz,
         jstring inputPath,
         jstring outputPath,
-        jint bitrate,
-        jint quality) {
-    
-    const char *input = env->GetStringUTFChars(inputPath, nullptr);
-    const char *output = env->GetStringUTFChars(outputPath, nullptr);
-    
-    // Handle file:// prefix
-    const char *inputPathWithoutPrefix = input;
-    const char *outputPathWithoutPrefix = output;
-    
-    if (strncmp(input, "file://", 7) == 0) {
-        inputPathWithoutPrefix = input + 7;
-    }
-    
-    if (strncmp(output, "file://", 7) == 0) {
-        outputPathWithoutPrefix = output + 7;
-    }
-    
-    LOGI("Opening input file: %s", inputPathWithoutPrefix);
-    LOGI("Opening output file: %s", outputPathWithoutPrefix);
-    
-    // Get input file size
-    long inputFileSize = getFileSize(inputPathWithoutPrefix);
-    if (inputFileSize >= 0) {
-        LOGI("Input file size: %ld bytes", inputFileSize);
-    } else {
-        LOGE("Failed to get input file size");
-    }
-    
-    FILE *wav = fopen(inputPathWithoutPrefix, "rb");
-    FILE *mp3 = fopen(outputPathWithoutPrefix, "wb");
-    
-    if (!wav || !mp3) {
-        LOGE("Failed to open files");
-        if (!wav) LOGE("Failed to open input file: %s", inputPathWithoutPrefix);
-        if (!mp3) LOGE("Failed to open output file: %s", outputPathWithoutPrefix);
-        env->ReleaseStringUTFChars(inputPath, input);
-        env->ReleaseStringUTFChars(outputPath, output);
-        return -1;
-    }
-    
-    // Read WAV header
-    short channels;
-    int sampleRate;
-    short bitsPerSample;
-    
-    fseek(wav, 22, SEEK_SET);
-    fread(&channels, sizeof(short), 1, wav);
-    fread(&sampleRate, sizeof(int), 1, wav);
-    fseek(wav, 34, SEEK_SET);
-    fread(&bitsPerSample, sizeof(short), 1, wav);
-    
-    LOGI("WAV file info: channels=%d, sampleRate=%d, bitsPerSample=%d", 
-         channels, sampleRate, bitsPerSample);
-    
-    // Initialize LAME
-    lame_global_flags *gfp = lame_init();
-    if (!gfp) {
-        LOGE("Failed to initialize LAME");
-        fclose(wav);
-        fclose(mp3);
-        env->ReleaseStringUTFChars(inputPath, input);
-        env->ReleaseStringUTFChars(outputPath, output);
-        return -1;
-    }
-    
-    lame_set_num_channels(gfp, channels);
-    lame_set_in_samplerate(gfp, sampleRate);
-    
-    // Set encoding parameters based on provided options
-    if (bitrate != -1) {
-        // If bitrate is provided, use it and disable VBR
-        LOGI("Using bitrate: %d kbps", bitrate);
-        lame_set_brate(gfp, bitrate);
-    } else {
-        // Default settings if no bitrate provided
-        LOGI("Using default bitrate: 128 kbps");
-        lame_set_brate(gfp, 128);
-    }
- 
-    if (quality != -1) {
-        // If quality is provided, use it and enable VBR
-        LOGI("Using quality: %d (0=best, 9=worst)", quality);
-        lame_set_quality(gfp, quality);
-    } else {
-        // Default settings if no options provided
-        LOGI("Using default settings: bitrate=128kbps, quality=5");
-        lame_set_quality(gfp, 5);
-    }
-    lame_set_VBR(gfp, vbr_off);
-    
-    if (lame_init_params(gfp) < 0) {
-        LOGE("Failed to initialize LAME parameters");
-        lame_close(gfp);
-        fclose(wav);
-        fclose(mp3);
-        env->ReleaseStringUTFChars(inputPath, input);
-        env->ReleaseStringUTFChars(outputPath, output);
-        return -1;
-    }
-    
-    // Prepare buffers
-    const int bufferSize = 4096;
-    short *buffer = new short[bufferSize * channels];
-    unsigned char *mp3Buffer = new unsigned char[bufferSize * 2];
-    
-    // Skip WAV header
-    fseek(wav, 44, SEEK_SET);
-    
-    int bytesRead;
-    int bytesWritten;
-    long totalBytesWritten = 0;
-    
-    // Convert
-    while ((bytesRead = fread(buffer, sizeof(short), bufferSize * channels, wav)) > 0) {
-        if (channels == 1) {
-            bytesWritten = lame_encode_buffer(gfp, buffer, nullptr, bytesRead, mp3Buffer, bufferSize * 2);
-        } else {
-            bytesWritten = lame_encode_buffer_interleaved(gfp, buffer, bytesRead / channels, mp3Buffer, bufferSize * 2);
-        }
-        
-        if (bytesWritten < 0) {
-            LOGE("Failed to encode buffer");
-            delete[] buffer;
-            delete[] mp3Buffer;
-            lame_close(gfp);
-            fclose(wav);
-            fclose(mp3);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            return -1;
-        }
-        
-        fwrite(mp3Buffer, 1, bytesWritten, mp3);
-        totalBytesWritten += bytesWritten;
-    }
-    
-    // Flush
-    bytesWritten = lame_encode_flush(gfp, mp3Buffer, bufferSize * 2);
-    if (bytesWritten > 0) {
-        fwrite(mp3Buffer, 1, bytesWritten, mp3);
-        totalBytesWritten += bytesWritten;
+        jstring inputFormat,
+        jobjectArray optionKeys,
+        jobjectArray optionValues) {
+
+    std::string inputString = toString(env, inputPath);
+    std::string outputString = toString(env, outputPath);
+    std::string input = stripFileScheme(inputString.c_str());
+    std::string output = stripFileScheme(outputString.c_str());
+    std::string format = toString(env, inputFormat);
+
+    LOGI("Converting %s to MP3", format.c_str());
+    LOGI("Opening input file: %s", input.c_str());
+    LOGI("Opening output file: %s", output.c_str());
+
+    ConversionResult result;
+    ConversionOptions options;
+    std::string error;
+    if (readOptions(env, optionKeys, optionValues, &options, &error) != 0) {
+        result.errorCode = "OPTIONS_ERROR";
+        result.errorMessage = error;
+        return env->NewStringUTF(formatResult(result).c_str());
     }
-    
-    // Cleanup
-    delete[] buffer;
-    delete[] mp3Buffer;
-    lame_close(gfp);
-    fclose(wav);
-    fclose(mp3);
-    
-    // Get output file size
-    long outputFileSize = getFileSize(outputPathWithoutPrefix);
-    if (outputFileSize >= 0) {
+
+    jclass moduleClass = env->GetObjectClass(thiz);
+    jmethodID onProgress = env->GetMethodID(moduleClass, "onNativeProgress", "(F)V");
+    env->DeleteLocalRef(moduleClass);
+    ProgressCallback progress = [env, thiz, onProgress](float value) {
+        env->CallVoidMethod(thiz, onProgress, (jfloat)value);
+    };
+
+    // The job (including AAC decoding) runs on a worker placed by priority;
+    // progress comes back to this thread, which is attached to the JVM.
+    auto job = [&](const ProgressCallback& workerProgress) -> int {
+        if (!isAacPath(input)) {
+            return convertFile(input, output, options, workerProgress, &result);
+        }
+        // MediaCodec decodes to 16-bit PCM in a temporary file next to the output
+        std::string tempPcmPath = output + ".pcm";
+        std::unique_ptr<AudioSource> source = openAacInput(input, tempPcmPath, options,
+                                                           &result.errorCode, &result.errorMessage);
+        int status = -1;
+        if (source) {
+            status = convertSource(source.get(), output, options, workerProgress, &result);
+        }
+        source.reset();
+        remove(tempPcmPath.c_str());
+        return status;
+    };
+    runOnWorker(options.priority, job, progress, &result.placement);
+    LOGI("Ran as %s job on cpu %d (%s cores %s)", priorityName(options.priority),
+         result.placement.cpu, result.placement.policy.c_str(),
+         formatCpuList(result.placement.cpus).c_str());
+
+    if (result.errorCode.empty()) {
+        long inputFileSize = getFileSize(input.c_str());
+        long outputFileSize = getFileSize(output.c_str());
         LOGI("Output file size: %ld bytes", outputFileSize);
-        LOGI("Total bytes written: %ld bytes", totalBytesWritten);
-        if (inputFileSize > 0) {
-            float compressionRatio = (float)outputFileSize / (float)inputFileSize;
-            LOGI("Compression ratio: %.2f", compressionRatio);
+        if (inputFileSize > 0 && outputFileSize >= 0) {
+            LOGI("Compression ratio: %.2f", (float)outputFileSize / (float)inputFileSize);
         }
-    } else {
-        LOGE("Failed to get output file size");
     }
-    
-    env->ReleaseStringUTFChars(inputPath, input);
-    env->ReleaseStringUTFChars(outputPath, output);
-    
-    return 0;
+    return env->NewStringUTF(formatResult(result).c_str());
 }
 
-JNIEXPORT jint JNICALL
-Java_com_wavtomp3_WavToMp3Module_nativeConvertAudioToMp3(
+// One phase of a two-phase job: the preview (convertFilePreview) or, with
+// `replace`, the full encode at background priority replacing it
+// (convertFileReplacing). Returns the result as "key=value" lines;
+// progress is reported through onNativeProgress(float).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeConvertPhase(
         JNIEnv *env,
-        jobject /* this */,
+        jobject thiz,
         jstring inputPath,
         jstring outputPath,
-        jstring inputFormat,
-        jint bitrate,
-        jint quality) {
-    
-    const char *input = env->GetStringUTFChars(inputPath, nullptr);
-    const char *output = env->GetStringUTFChars(outputPath, nullptr);
-    const char *format = env->GetStringUTFChars(inputFormat, nullptr);
-    
-    // Handle file:// prefix
-    const char *inputPathWithoutPrefix = input;
-    const char *outputPathWithoutPrefix = output;
-    
-    if (strncmp(input, "file://", 7) == 0) {
-        inputPathWithoutPrefix = input + 7;
-    }
-    
-    if (strncmp(output, "file://", 7) == 0) {
-        outputPathWithoutPrefix = output + 7;
+        jboolean replace,
+        jobjectArray optionKeys,
+        jobjectArray optionValues) {
+
+    std::string inputString = toString(env, inputPath);
+    std::string outputString = toString(env, outputPath);
+    std::string input = stripFileScheme(inputString.c_str());
+    std::string output = stripFileScheme(outputString.c_str());
+
+    ConversionResult result;
+    ConversionOptions options;
+    std::string error;
+    if (readOptions(env, optionKeys, optionValues, &options, &error) != 0) {
+        result.errorCode = "OPTIONS_ERROR";
+        result.errorMessage = error;
+        return env->NewStringUTF(formatResult(result).c_str());
     }
-    
-    LOGI("Converting %s to MP3", format);
-    LOGI("Opening input file: %s", inputPathWithoutPrefix);
-    LOGI("Opening output file: %s", outputPathWithoutPrefix);
-    
-    // Get input file size
-    long inputFileSize = getFileSize(inputPathWithoutPrefix);
-    if (inputFileSize >= 0) {
-        LOGI("Input file size: %ld bytes", inputFileSize);
-    } else {
-        LOGE("Failed to get input file size");
+    if (replace) {
+        options.priority = JobPriority::Background;
     }
-    
-    // Try to detect format from file extension
-    std::string detectedFormat = getFileFormat(inputPathWithoutPrefix);
-    if (detectedFormat == "aac") {
-        LOGI("Detected AAC format from file extension");
-        
-        // Create temporary PCM file path
-        std::string tempPcmPath = std::string(outputPathWithoutPrefix) + ".pcm";
-        
-        // Decode AAC to PCM
-        int sampleRate, channels;
-        int decodeResult = decodeAacToPcm(inputPathWithoutPrefix, tempPcmPath.c_str(), &sampleRate, &channels);
-        if (decodeResult != 0) {
-            LOGE("Failed to decode AAC file");
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        LOGI("Successfully decoded AAC to PCM: sampleRate=%d, channels=%d", sampleRate, channels);
-        
-        // Now encode PCM to MP3
-        FILE *pcmFile = fopen(tempPcmPath.c_str(), "rb");
-        FILE *mp3 = fopen(outputPathWithoutPrefix, "wb");
-        
-        if (!pcmFile || !mp3) {
-            LOGE("Failed to open PCM or MP3 files");
-            if (pcmFile) fclose(pcmFile);
-            if (mp3) fclose(mp3);
-            remove(tempPcmPath.c_str()); // Clean up temp file
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Initialize LAME
-        lame_global_flags *gfp = lame_init();
-        if (!gfp) {
-            LOGE("Failed to initialize LAME");
-            fclose(pcmFile);
-            fclose(mp3);
-            remove(tempPcmPath.c_str());
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        lame_set_num_channels(gfp, channels);
-        lame_set_in_samplerate(gfp, sampleRate);
-        
-        // Set encoding parameters
-        if (bitrate != -1) {
-            LOGI("Using bitrate: %d kbps", bitrate);
-            lame_set_brate(gfp, bitrate);
-        } else {
-            LOGI("Using default bitrate: 128 kbps");
-            lame_set_brate(gfp, 128);
-        }
-     
-        if (quality != -1) {
-            LOGI("Using quality: %d (0=best, 9=worst)", quality);
-            lame_set_quality(gfp, quality);
+
+    jclass moduleClass = env->GetObjectClass(thiz);
+    jmethodID onProgress = env->GetMethodID(moduleClass, "onNativeProgress", "(F)V");
+    env->DeleteLocalRef(moduleClass);
+    ProgressCallback progress = [env, thiz, onProgress](float value) {
+        env->CallVoidMethod(thiz, onProgress, (jfloat)value);
+    };
+    auto job = [&](const ProgressCallback& workerProgress) -> int {
+        return replace ? convertFileReplacing(input, output, options, workerProgress, &result)
+                       : convertFilePreview(input, output, options, workerProgress, &result);
+    };
+    runOnWorker(options.priority, job, progress, &result.placement);
+    return env->NewStringUTF(formatResult(result).c_str());
+}
+
+// Converts `inputPath` once into every output named by "outputs.N.path" in
+// the options and returns the results as "key=value" lines (see
+// formatResults). Progress is reported through onNativeProgress(float).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeConvertMulti(
+        JNIEnv *env,
+        jobject thiz,
+        jstring inputPath,
+        jobjectArray optionKeys,
+        jobjectArray optionValues) {
+
+    std::string inputString = toString(env, inputPath);
+    std::string input = stripFileScheme(inputString.c_str());
+
+    std::vector<std::pair<std::string, std::string>> fields;
+    jsize count = env->GetArrayLength(optionKeys);
+    for (jsize i = 0; i < count; i++) {
+        jstring key = (jstring)env->GetObjectArrayElement(optionKeys, i);
+        jstring value = (jstring)env->GetObjectArrayElement(optionValues, i);
+        fields.emplace_back(toString(env, key), toString(env, value));
+        env->DeleteLocalRef(key);
+        env->DeleteLocalRef(value);
+    }
+    ConversionOptions options;
+    std::vector<OutputSpec> outputs;
+    std::string error;
+    if (setOutputOptions(fields, &options, &outputs, &error) != 0) {
+        return env->NewStringUTF(("errorCode=OPTIONS_ERROR\nerrorMessage=" + error + "\n").c_str());
+    }
+    for (OutputSpec& output : outputs) {
+        output.path = stripFileScheme(output.path.c_str());
+    }
+    LOGI("Converting %s to %zu outputs", input.c_str(), outputs.size());
+
+    jclass moduleClass = env->GetObjectClass(thiz);
+    jmethodID onProgress = env->GetMethodID(moduleClass, "onNativeProgress", "(F)V");
+    env->DeleteLocalRef(moduleClass);
+    ProgressCallback progress = [env, thiz, onProgress](float value) {
+        env->CallVoidMethod(thiz, onProgress, (jfloat)value);
+    };
+
+    std::vector<ConversionResult> results(outputs.size());
+    Placement placement;
+    runOnWorker(options.priority, [&](const ProgressCallback& workerProgress) -> int {
+        if (!isAacPath(input)) {
+            return convertFileMulti(input, options, outputs, workerProgress, &results);
+        }
+        std::string tempPcmPath = outputs[0].path + ".pcm";
+        std::string errorCode, errorMessage;
+        std::unique_ptr<AudioSource> source = openAacInput(input, tempPcmPath, options, &errorCode,
+                                                           &errorMessage);
+        int status = -1;
+        if (source) {
+            status = convertSourceMulti(source.get(), outputs, workerProgress, &results);
         } else {
-            LOGI("Using default quality: 5");
-            lame_set_quality(gfp, 5);
-        }
-        lame_set_VBR(gfp, vbr_off);
-        
-        if (lame_init_params(gfp) < 0) {
-            LOGE("Failed to initialize LAME parameters");
-            lame_close(gfp);
-            fclose(pcmFile);
-            fclose(mp3);
-            remove(tempPcmPath.c_str());
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Prepare buffers
-        const int bufferSize = 4096;
-        short *buffer = new short[bufferSize * channels];
-        unsigned char *mp3Buffer = new unsigned char[bufferSize * 2];
-        
-        int bytesRead;
-        int bytesWritten;
-        long totalBytesWritten = 0;
-        
-        // Convert PCM to MP3
-        while ((bytesRead = fread(buffer, sizeof(short), bufferSize * channels, pcmFile)) > 0) {
-            if (channels == 1) {
-                bytesWritten = lame_encode_buffer(gfp, buffer, nullptr, bytesRead, mp3Buffer, bufferSize * 2);
-            } else {
-                bytesWritten = lame_encode_buffer_interleaved(gfp, buffer, bytesRead / channels, mp3Buffer, bufferSize * 2);
-            }
-            
-            if (bytesWritten < 0) {
-                LOGE("Failed to encode buffer");
-                delete[] buffer;
-                delete[] mp3Buffer;
-                lame_close(gfp);
-                fclose(pcmFile);
-                fclose(mp3);
-                remove(tempPcmPath.c_str());
-                env->ReleaseStringUTFChars(inputPath, input);
-                env->ReleaseStringUTFChars(outputPath, output);
-                env->ReleaseStringUTFChars(inputFormat, format);
-                return -1;
+            for (ConversionResult& result : results) {
+                result.errorCode = errorCode;
+                result.errorMessage = errorMessage;
             }
-            
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
-        }
-        
-        // Flush
-        bytesWritten = lame_encode_flush(gfp, mp3Buffer, bufferSize * 2);
-        if (bytesWritten > 0) {
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
         }
-        
-        // Cleanup
-        delete[] buffer;
-        delete[] mp3Buffer;
-        lame_close(gfp);
-        fclose(pcmFile);
-        fclose(mp3);
-        
-        // Remove temporary PCM file
+        source.reset();
         remove(tempPcmPath.c_str());
-        
-        LOGI("Successfully converted AAC to MP3");
-        
-    } else if (detectedFormat == "wav") {
-        LOGI("Detected WAV format from file extension");
-        
-        FILE *inputFile = fopen(inputPathWithoutPrefix, "rb");
-        FILE *mp3 = fopen(outputPathWithoutPrefix, "wb");
-        
-        if (!inputFile || !mp3) {
-            LOGE("Failed to open files");
-            if (!inputFile) LOGE("Failed to open input file: %s", inputPathWithoutPrefix);
-            if (!mp3) LOGE("Failed to open output file: %s", outputPathWithoutPrefix);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Read WAV header
-        short channels;
-        int sampleRate;
-        short bitsPerSample;
-        
-        fseek(inputFile, 22, SEEK_SET);
-        fread(&channels, sizeof(short), 1, inputFile);
-        fread(&sampleRate, sizeof(int), 1, inputFile);
-        fseek(inputFile, 34, SEEK_SET);
-        fread(&bitsPerSample, sizeof(short), 1, inputFile);
-        
-        LOGI("WAV file info: channels=%d, sampleRate=%d, bitsPerSample=%d", 
-             channels, sampleRate, bitsPerSample);
-        
-        // Skip WAV header
-        fseek(inputFile, 44, SEEK_SET);
-        
-        // Initialize LAME
-        lame_global_flags *gfp = lame_init();
-        if (!gfp) {
-            LOGE("Failed to initialize LAME");
-            fclose(inputFile);
-            fclose(mp3);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        lame_set_num_channels(gfp, channels);
-        lame_set_in_samplerate(gfp, sampleRate);
-        
-        // Set encoding parameters
-        if (bitrate != -1) {
-            LOGI("Using bitrate: %d kbps", bitrate);
-            lame_set_brate(gfp, bitrate);
-        } else {
-            LOGI("Using default bitrate: 128 kbps");
-            lame_set_brate(gfp, 128);
-        }
-     
-        if (quality != -1) {
-            LOGI("Using quality: %d (0=best, 9=worst)", quality);
-            lame_set_quality(gfp, quality);
-        } else {
-            LOGI("Using default quality: 5");
-            lame_set_quality(gfp, 5);
-        }
-        lame_set_VBR(gfp, vbr_off);
-        
-        if (lame_init_params(gfp) < 0) {
-            LOGE("Failed to initialize LAME parameters");
-            lame_close(gfp);
-            fclose(inputFile);
-            fclose(mp3);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Prepare buffers
-        const int bufferSize = 4096;
-        short *buffer = new short[bufferSize * channels];
-        unsigned char *mp3Buffer = new unsigned char[bufferSize * 2];
-        
-        int bytesRead;
-        int bytesWritten;
-        long totalBytesWritten = 0;
-        
-        // Convert
-        while ((bytesRead = fread(buffer, sizeof(short), bufferSize * channels, inputFile)) > 0) {
-            if (channels == 1) {
-                bytesWritten = lame_encode_buffer(gfp, buffer, nullptr, bytesRead, mp3Buffer, bufferSize * 2);
-            } else {
-                bytesWritten = lame_encode_buffer_interleaved(gfp, buffer, bytesRead / channels, mp3Buffer, bufferSize * 2);
-            }
-            
-            if (bytesWritten < 0) {
-                LOGE("Failed to encode buffer");
-                delete[] buffer;
-                delete[] mp3Buffer;
-                lame_close(gfp);
-                fclose(inputFile);
-                fclose(mp3);
-                env->ReleaseStringUTFChars(inputPath, input);
-                env->ReleaseStringUTFChars(outputPath, output);
-                env->ReleaseStringUTFChars(inputFormat, format);
-                return -1;
-            }
-            
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
-        }
-        
-        // Flush
-        bytesWritten = lame_encode_flush(gfp, mp3Buffer, bufferSize * 2);
-        if (bytesWritten > 0) {
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
-        }
-        
-        // Cleanup
-        delete[] buffer;
-        delete[] mp3Buffer;
-        lame_close(gfp);
-        fclose(inputFile);
-        fclose(mp3);
-        
-    } else {
-        LOGI("Unknown format, treating as raw PCM");
-        
-        FILE *inputFile = fopen(inputPathWithoutPrefix, "rb");
-        FILE *mp3 = fopen(outputPathWithoutPrefix, "wb");
-        
-        if (!inputFile || !mp3) {
-            LOGE("Failed to open files");
-            if (!inputFile) LOGE("Failed to open input file: %s", inputPathWithoutPrefix);
-            if (!mp3) LOGE("Failed to open output file: %s", outputPathWithoutPrefix);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Default audio parameters for raw PCM
-        short channels = 1;  // mono
-        int sampleRate = 44100;  // 44.1kHz
-        
-        // Initialize LAME
-        lame_global_flags *gfp = lame_init();
-        if (!gfp) {
-            LOGE("Failed to initialize LAME");
-            fclose(inputFile);
-            fclose(mp3);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        lame_set_num_channels(gfp, channels);
-        lame_set_in_samplerate(gfp, sampleRate);
-        
-        // Set encoding parameters
-        if (bitrate != -1) {
-            LOGI("Using bitrate: %d kbps", bitrate);
-            lame_set_brate(gfp, bitrate);
-        } else {
-            LOGI("Using default bitrate: 128 kbps");
-            lame_set_brate(gfp, 128);
-        }
-     
-        if (quality != -1) {
-            LOGI("Using quality: %d (0=best, 9=worst)", quality);
-            lame_set_quality(gfp, quality);
-        } else {
-            LOGI("Using default quality: 5");
-            lame_set_quality(gfp, 5);
-        }
-        lame_set_VBR(gfp, vbr_off);
-        
-        if (lame_init_params(gfp) < 0) {
-            LOGE("Failed to initialize LAME parameters");
-            lame_close(gfp);
-            fclose(inputFile);
-            fclose(mp3);
-            env->ReleaseStringUTFChars(inputPath, input);
-            env->ReleaseStringUTFChars(outputPath, output);
-            env->ReleaseStringUTFChars(inputFormat, format);
-            return -1;
-        }
-        
-        // Prepare buffers
-        const int bufferSize = 4096;
-        short *buffer = new short[bufferSize * channels];
-        unsigned char *mp3Buffer = new unsigned char[bufferSize * 2];
-        
-        int bytesRead;
-        int bytesWritten;
-        long totalBytesWritten = 0;
-        
-        // Convert
-        while ((bytesRead = fread(buffer, sizeof(short), bufferSize * channels, inputFile)) > 0) {
-            if (channels == 1) {
-                bytesWritten = lame_encode_buffer(gfp, buffer, nullptr, bytesRead, mp3Buffer, bufferSize * 2);
-            } else {
-                bytesWritten = lame_encode_buffer_interleaved(gfp, buffer, bytesRead / channels, mp3Buffer, bufferSize * 2);
-            }
-            
-            if (bytesWritten < 0) {
-                LOGE("Failed to encode buffer");
-                delete[] buffer;
-                delete[] mp3Buffer;
-                lame_close(gfp);
-                fclose(inputFile);
-                fclose(mp3);
-                env->ReleaseStringUTFChars(inputPath, input);
-                env->ReleaseStringUTFChars(outputPath, output);
-                env->ReleaseStringUTFChars(inputFormat, format);
-                return -1;
-            }
-            
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
-        }
-        
-        // Flush
-        bytesWritten = lame_encode_flush(gfp, mp3Buffer, bufferSize * 2);
-        if (bytesWritten > 0) {
-            fwrite(mp3Buffer, 1, bytesWritten, mp3);
-            totalBytesWritten += bytesWritten;
-        }
-        
-        // Cleanup
-        delete[] buffer;
-        delete[] mp3Buffer;
-        lame_close(gfp);
-        fclose(inputFile);
-        fclose(mp3);
+        return status;
+    }, progress, &placement);
+    for (ConversionResult& result : results) {
+        result.placement = placement;
     }
-    
-    // Get output file size
-    long outputFileSize = getFileSize(outputPathWithoutPrefix);
-    if (outputFileSize >= 0) {
-        LOGI("Output file size: %ld bytes", outputFileSize);
-        if (inputFileSize > 0) {
-            float compressionRatio = (float)outputFileSize / (float)inputFileSize;
-            LOGI("Compression ratio: %.2f", compressionRatio);
+    return env->NewStringUTF(formatResults(results).c_str());
+}
+
+// Measures encode speed per quality level on an interactive worker, saves
+// it to `path` for deadlineMs and returns it as "key=value" lines.
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeCalibrate(JNIEnv *env, jobject thiz, jstring path) {
+    std::string file = toString(env, path);
+    Calibration calibration;
+    std::string error;
+    Placement placement;
+    int status = runOnWorker(JobPriority::Interactive, [&](const ProgressCallback&) {
+        if (runCalibration(&calibration, &error) != 0) {
+            return -1;
         }
-    } else {
-        LOGE("Failed to get output file size");
+        return saveCalibration(file, calibration, &error);
+    }, nullptr, &placement);
+    if (status != 0) {
+        return env->NewStringUTF(("errorCode=CALIBRATION_ERROR\nerrorMessage=" + error + "\n").c_str());
     }
-    
-    env->ReleaseStringUTFChars(inputPath, input);
-    env->ReleaseStringUTFChars(outputPath, output);
-    env->ReleaseStringUTFChars(inputFormat, format);
-    
-    return 0;
+    return env->NewStringUTF(formatCalibration(calibration).c_str());
+}
+
+// Reads format and duration of each of `paths` from its header; returns
+// "files.N.key=value" lines (see formatProbeResults).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeProbe(JNIEnv *env, jobject thiz, jobjectArray paths) {
+    std::vector<std::string> files;
+    jsize count = env->GetArrayLength(paths);
+    for (jsize i = 0; i < count; i++) {
+        jstring path = (jstring)env->GetObjectArrayElement(paths, i);
+        std::string file = toString(env, path);
+        files.push_back(stripFileScheme(file.c_str()));
+        env->DeleteLocalRef(path);
+    }
+    std::vector<ProbeResult> results;
+    probeFiles(files, kProbeThreads, &results);
+    return env->NewStringUTF(formatProbeResults(results).c_str());
+}
+
+// Predicts output size and conversion time of `inputPath`; returns the
+// estimate or the error as "key=value" lines (see formatEstimate).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeEstimate(
+        JNIEnv *env,
+        jobject thiz,
+        jstring inputPath,
+        jstring outputPath,
+        jobjectArray optionKeys,
+        jobjectArray optionValues) {
+    std::string inputString = toString(env, inputPath);
+    std::string outputString = toString(env, outputPath);
+    ConversionOptions options;
+    std::string error;
+    if (readOptions(env, optionKeys, optionValues, &options, &error) != 0) {
+        return env->NewStringUTF(("errorCode=OPTIONS_ERROR\nerrorMessage=" + error + "\n").c_str());
+    }
+    ConversionEstimate estimate;
+    std::string errorCode;
+    if (estimateConversion(stripFileScheme(inputString.c_str()), stripFileScheme(outputString.c_str()), options,
+                           &estimate, &errorCode, &error) != 0) {
+        return env->NewStringUTF(("errorCode=" + errorCode + "\nerrorMessage=" + error + "\n").c_str());
+    }
+    return env->NewStringUTF(formatEstimate(estimate).c_str());
+}
+
+// Cuts `inputPath` to [startMs, endMs) (the end if endMs is negative) at
+// MP3 frame boundaries; returns the result or the error as "key=value"
+// lines (see formatMp3EditResult).
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeTrimMp3(
+        JNIEnv *env,
+        jobject thiz,
+        jstring inputPath,
+        jstring outputPath,
+        jdouble startMs,
+        jdouble endMs) {
+    std::string inputString = toString(env, inputPath);
+    std::string outputString = toString(env, outputPath);
+    Mp3EditResult result;
+    std::string errorCode, error;
+    if (trimMp3(stripFileScheme(inputString.c_str()), stripFileScheme(outputString.c_str()), startMs, endMs,
+                &result, &errorCode, &error) != 0) {
+        return env->NewStringUTF(("errorCode=" + errorCode + "\nerrorMessage=" + error + "\n").c_str());
+    }
+    return env->NewStringUTF(formatMp3EditResult(result).c_str());
 }
 
-} 
\ No newline at end of file
+// Joins `inputPaths` into `outputPath` at MP3 frame boundaries; returns the
+// result or the error as "key=value" lines.
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeJoinMp3(
+        JNIEnv *env,
+        jobject thiz,
+        jobjectArray inputPaths,
+        jstring outputPath) {
+    std::vector<std::string> inputs;
+    jsize count = env->GetArrayLength(inputPaths);
+    for (jsize i = 0; i < count; i++) {
+        jstring path = (jstring)env->GetObjectArrayElement(inputPaths, i);
+        std::string input = toString(env, path);
+        inputs.push_back(stripFileScheme(input.c_str()));
+        env->DeleteLocalRef(path);
+    }
+    std::string outputString = toString(env, outputPath);
+    Mp3EditResult result;
+    std::string errorCode, error;
+    if (joinMp3(inputs, stripFileScheme(outputString.c_str()), &result, &errorCode, &error) != 0) {
+        return env->NewStringUTF(("errorCode=" + errorCode + "\nerrorMessage=" + error + "\n").c_str());
+    }
+    return env->NewStringUTF(formatMp3EditResult(result).c_str());
+}
+
+// Compares two fingerprints from ConversionResult; returns "similarity=S"
+// or the error as "key=value" lines.
+JNIEXPORT jstring JNICALL
+Java_com_wavtomp3_WavToMp3Module_nativeCompareFingerprints(JNIEnv *env, jobject thiz, jstring a, jstring b) {
+    double similarity = 0.0;
+    std::string error;
+    if (compareFingerprints(toString(env, a), toString(env, b), &similarity, &error) != 0) {
+        return env->NewStringUTF(("errorCode=FINGERPRINT_ERROR\nerrorMessage=" + error + "\n").c_str());
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "similarity=%.4f\n", similarity);
+    return env->NewStringUTF(text);
+}
+
+}
@@ -1,18 +1,26 @@
 package com.wavtomp3
 
 import android.util.Log
+import com.facebook.react.bridge.Arguments
 import com.facebook.react.bridge.ReactApplicationContext
 import com.facebook.react.bridge.ReactContextBaseJavaModule
 import com.facebook.react.bridge.ReactMethod
 import com.facebook.react.bridge.Promise
+import com.facebook.react.bridge.ReadableArray
 import com.facebook.react.bridge.ReadableMap
+import com.facebook.react.bridge.WritableMap
 import com.facebook.react.module.annotations.ReactModule
+import com.facebook.react.modules.core.DeviceEventManagerModule
 import java.io.File
+import java.util.concurrent.Executors
 
 @ReactModule(name = WavToMp3Module.NAME)
 class WavToMp3Module(reactContext: ReactApplicationContext) :
   ReactContextBaseJavaModule(reactContext) {
 
+  // Second phases of convertWithPreview, one at a time
+  private val finalEncodes = Executors.newSingleThreadExecutor()
+
   init {
     System.loadLibrary("wav-to-mp3")
   }
@@ -33,25 +41,282 @@ class WavToMp3Module(reactContext: ReactApplicationContext) :
 
   @ReactMethod
   fun convertAudioToMp3(inputPath: String, outputPath: String, inputFormat: String, options: ReadableMap?, promise: Promise) {
+    convert(inputPath, outputPath, inputFormat, options, promise, false)
+  }
+
+  // Like convertAudioToMp3, but resolves with the job stats instead of the path
+  @ReactMethod
+  fun convertWithResult(inputPath: String, outputPath: String, options: ReadableMap?, promise: Promise) {
+    convert(inputPath, outputPath, "auto", options, promise, true)
+  }
+
+  // Resolves as soon as a quick preview is at outputPath, then encodes the full
+  // quality at background priority, replaces the preview with it and emits
+  // onFinalOutput for jobId
+  @ReactMethod
+  fun convertWithPreview(jobId: String, inputPath: String, outputPath: String, options: ReadableMap?,
+                         promise: Promise) {
     try {
-      // Remove file:// prefix if present and clean up path
-      var processedInputPath = inputPath
-      var processedOutputPath = outputPath
-      
-      if (inputPath.startsWith("file://")) {
-        processedInputPath = inputPath.substring(7)
-        // Remove any leading double slashes
-        if (processedInputPath.startsWith("//")) {
-          processedInputPath = processedInputPath.substring(1)
+      val input = localPath(inputPath)
+      val output = localPath(outputPath)
+      val outputDir = File(output).parentFile
+      if (outputDir != null && !outputDir.exists() && !outputDir.mkdirs()) {
+        promise.reject("DIRECTORY_ERROR", "Failed to create output directory: ${outputDir.absolutePath}")
+        return
+      }
+      val keys = ArrayList<String>()
+      val values = ArrayList<String>()
+      if (options != null) {
+        flattenOptions(options.toHashMap(), "", keys, values)
+      }
+      addDeviceFiles(keys, values)
+      val optionKeys = keys.toTypedArray()
+      val optionValues = values.toTypedArray()
+
+      val preview = parseResult(nativeConvertPhase(input, output, false, optionKeys, optionValues))
+      val errorCode = preview["errorCode"]
+      if (errorCode != null) {
+        promise.reject(errorCode, preview["errorMessage"] ?: "Failed to encode preview")
+        return
+      }
+      promise.resolve(resultToMap(output, preview))
+
+      finalEncodes.execute {
+        val result = parseResult(nativeConvertPhase(input, output, true, optionKeys, optionValues))
+        val body = Arguments.createMap()
+        body.putString("jobId", jobId)
+        val finalError = result["errorCode"]
+        if (finalError != null) {
+          body.putString("errorCode", finalError)
+          body.putString("errorMessage", result["errorMessage"] ?: "Failed to convert audio file")
+        } else {
+          body.putMap("result", resultToMap(output, result))
+        }
+        reactApplicationContext
+          .getJSModule(DeviceEventManagerModule.RCTDeviceEventEmitter::class.java)
+          .emit("onFinalOutput", body)
+      }
+    } catch (e: Exception) {
+      promise.reject("CONVERSION_ERROR", e.message)
+    }
+  }
+
+  // Encodes one input into several outputs in a single pass; resolves with
+  // one result per output
+  @ReactMethod
+  fun convertMulti(inputPath: String, outputs: ReadableArray, options: ReadableMap?, promise: Promise) {
+    try {
+      // Shared options as flat keys, each output's as "outputs.N.KEY"
+      val keys = ArrayList<String>()
+      val values = ArrayList<String>()
+      if (options != null) {
+        flattenOptions(options.toHashMap(), "", keys, values)
+      }
+      addDeviceFiles(keys, values)
+      val outputPaths = ArrayList<String>()
+      for (i in 0 until outputs.size()) {
+        val output = outputs.getMap(i)?.toHashMap() ?: HashMap()
+        val outputPath = localPath(output.remove("outputPath")?.toString() ?: "")
+        val outputDir = File(outputPath).parentFile
+        if (outputDir != null && !outputDir.exists() && !outputDir.mkdirs()) {
+          promise.reject("DIRECTORY_ERROR", "Failed to create output directory: ${outputDir.absolutePath}")
+          return
         }
+        outputPaths.add(outputPath)
+        keys.add("outputs.$i.path")
+        values.add(outputPath)
+        flattenOptions(output, "outputs.$i.", keys, values)
+      }
+
+      val result = parseResult(nativeConvertMulti(localPath(inputPath), keys.toTypedArray(), values.toTypedArray()))
+      val errorCode = result["errorCode"]
+      if (errorCode != null) {
+        promise.reject(errorCode, result["errorMessage"] ?: "Failed to convert audio file")
+        return
+      }
+      val results = Arguments.createArray()
+      for ((i, outputPath) in outputPaths.withIndex()) {
+        val prefix = "outputs.$i."
+        val outputResult = result.filterKeys { it.startsWith(prefix) }.mapKeys { it.key.substring(prefix.length) }
+        results.pushMap(resultToMap(outputPath, outputResult))
+      }
+      promise.resolve(results)
+    } catch (e: Exception) {
+      promise.reject("CONVERSION_ERROR", e.message)
+    }
+  }
+
+  // Measures encode speed per quality level and stores it for deadlineMs
+  @ReactMethod
+  fun calibrate(promise: Promise) {
+    val result = parseResult(nativeCalibrate(calibrationFile().path))
+    val errorCode = result["errorCode"]
+    if (errorCode != null) {
+      promise.reject(errorCode, result["errorMessage"] ?: "Calibration failed")
+      return
+    }
+    val realtime = Arguments.createArray()
+    for (quality in 0..9) {
+      realtime.pushDouble(result["realtime.$quality"]?.toDoubleOrNull() ?: 0.0)
+    }
+    val map = Arguments.createMap()
+    map.putArray("realtimeFactors", realtime)
+    map.putString("file", calibrationFile().path)
+    promise.resolve(map)
+  }
+
+  // Similarity of two fingerprints from convertWithResult, 0 (unrelated) to 1
+  @ReactMethod
+  fun compareFingerprints(a: String, b: String, promise: Promise) {
+    val result = parseResult(nativeCompareFingerprints(a, b))
+    val errorCode = result["errorCode"]
+    if (errorCode != null) {
+      promise.reject(errorCode, result["errorMessage"] ?: "Invalid fingerprint")
+      return
+    }
+    promise.resolve(result["similarity"]?.toDoubleOrNull() ?: 0.0)
+  }
+
+  // Predicted output size and conversion time; rejects with SPACE_ERROR when
+  // the output's file system is short of space
+  @ReactMethod
+  fun estimate(inputPath: String, outputPath: String, options: ReadableMap?, promise: Promise) {
+    try {
+      val keys = ArrayList<String>()
+      val values = ArrayList<String>()
+      if (options != null) {
+        flattenOptions(options.toHashMap(), "", keys, values)
+      }
+      addDeviceFiles(keys, values)
+      val result = parseResult(nativeEstimate(localPath(inputPath), localPath(outputPath),
+        keys.toTypedArray(), values.toTypedArray()))
+      val errorCode = result["errorCode"]
+      if (errorCode != null) {
+        promise.reject(errorCode, result["errorMessage"] ?: "Failed to estimate $inputPath")
+        return
       }
-      if (outputPath.startsWith("file://")) {
-        processedOutputPath = outputPath.substring(7)
-        // Remove any leading double slashes
-        if (processedOutputPath.startsWith("//")) {
-          processedOutputPath = processedOutputPath.substring(1)
+      promise.resolve(estimateToMap(inputPath, result))
+    } catch (e: Exception) {
+      promise.reject("ESTIMATE_ERROR", e.message)
+    }
+  }
+
+  // Format and duration of a file, read from its header
+  @ReactMethod
+  fun probe(path: String, promise: Promise) {
+    val result = parseResult(nativeProbe(arrayOf(path)))
+    val errorCode = result["files.0.errorCode"]
+    if (errorCode != null) {
+      promise.reject(errorCode, result["files.0.errorMessage"] ?: "Failed to probe $path")
+      return
+    }
+    promise.resolve(mediaInfoToMap(path, result, "files.0."))
+  }
+
+  // probe() for many files at once, in parallel; failures are reported per file
+  @ReactMethod
+  fun probeMany(paths: ReadableArray, promise: Promise) {
+    try {
+      val files = Array(paths.size()) { paths.getString(it) ?: "" }
+      val result = parseResult(nativeProbe(files))
+      val infos = Arguments.createArray()
+      for ((i, path) in files.withIndex()) {
+        val prefix = "files.$i."
+        val errorMessage = result["${prefix}errorMessage"]
+        if (errorMessage != null) {
+          val map = Arguments.createMap()
+          map.putString("path", path)
+          map.putString("error", errorMessage)
+          infos.pushMap(map)
+        } else {
+          infos.pushMap(mediaInfoToMap(path, result, prefix))
         }
       }
+      promise.resolve(infos)
+    } catch (e: Exception) {
+      promise.reject("PROBE_ERROR", e.message)
+    }
+  }
+
+  // The part of an MP3 from startMs to endMs (-1: the end), cut at frame
+  // boundaries without re-encoding
+  @ReactMethod
+  fun trimMp3(inputPath: String, outputPath: String, startMs: Double, endMs: Double, promise: Promise) {
+    try {
+      val output = localPath(outputPath)
+      val outputDir = File(output).parentFile
+      if (outputDir != null && !outputDir.exists() && !outputDir.mkdirs()) {
+        promise.reject("DIRECTORY_ERROR", "Failed to create output directory: ${outputDir.absolutePath}")
+        return
+      }
+      val result = parseResult(nativeTrimMp3(localPath(inputPath), output, startMs, endMs))
+      val errorCode = result["errorCode"]
+      if (errorCode != null) {
+        promise.reject(errorCode, result["errorMessage"] ?: "Failed to trim $inputPath")
+        return
+      }
+      promise.resolve(mp3EditToMap(outputPath, result))
+    } catch (e: Exception) {
+      promise.reject("MP3_ERROR", e.message)
+    }
+  }
+
+  // MP3s of the same rate and channels one after the other, without re-encoding
+  @ReactMethod
+  fun joinMp3(inputPaths: ReadableArray, outputPath: String, promise: Promise) {
+    try {
+      val inputs = Array(inputPaths.size()) { localPath(inputPaths.getString(it) ?: "") }
+      val output = localPath(outputPath)
+      val outputDir = File(output).parentFile
+      if (outputDir != null && !outputDir.exists() && !outputDir.mkdirs()) {
+        promise.reject("DIRECTORY_ERROR", "Failed to create output directory: ${outputDir.absolutePath}")
+        return
+      }
+      val result = parseResult(nativeJoinMp3(inputs, output))
+      val errorCode = result["errorCode"]
+      if (errorCode != null) {
+        promise.reject(errorCode, result["errorMessage"] ?: "Failed to join into $outputPath")
+        return
+      }
+      promise.resolve(mp3EditToMap(outputPath, result))
+    } catch (e: Exception) {
+      promise.reject("MP3_ERROR", e.message)
+    }
+  }
+
+  private fun calibrationFile(): File = File(reactApplicationContext.filesDir, "wav_to_mp3_calibration.txt")
+
+  private fun throughputFile(): File = File(reactApplicationContext.filesDir, "wav_to_mp3_throughput.txt")
+
+  private fun pcmCacheDir(): File = File(reactApplicationContext.cacheDir, "wav_to_mp3_pcm")
+
+  // Per-device state the core reads and updates: calibration, the encode
+  // speed learned from finished jobs and the decoded PCM cache, used when
+  // options.pcmCache.enabled is set
+  private fun addDeviceFiles(keys: MutableList<String>, values: MutableList<String>) {
+    keys.add("calibrationFile")
+    values.add(calibrationFile().path)
+    keys.add("throughputFile")
+    values.add(throughputFile().path)
+    keys.add("pcmCache.dir")
+    values.add(pcmCacheDir().path)
+  }
+
+  // Removes the file:// prefix and any doubled leading slash
+  private fun localPath(path: String): String {
+    if (!path.startsWith("file://")) {
+      return path
+    }
+    val local = path.substring(7)
+    return if (local.startsWith("//")) local.substring(1) else local
+  }
+
+  private fun convert(inputPath: String, outputPath: String, inputFormat: String, options: ReadableMap?,
+                      promise: Promise, withResult: Boolean) {
+    try {
+      // Remove file:// prefix if present and clean up path
+      val processedInputPath = localPath(inputPath)
+      val processedOutputPath = localPath(outputPath)
       
       // Ensure output directory exists
       val outputFile = File(processedOutputPath)
@@ -75,11 +340,16 @@ class WavToMp3Module(reactContext: ReactApplicationContext) :
       
       Log.d(TAG, "Output path: $processedOutputPath")
       
-      // Get options with defaults
-      val bitrate = options?.getInt("bitrate") ?: -1
-      val quality = options?.getInt("quality") ?: -1
+      // Options go to the native core as flat key/value strings
+      val keys = ArrayList<String>()
+      val values = ArrayList<String>()
+      if (options != null) {
+        flattenOptions(options.toHashMap(), "", keys, values)
+      }
+      addDeviceFiles(keys, values)
       
-      val result = nativeConvertAudioToMp3(processedInputPath, processedOutputPath, inputFormat, bitrate, quality)
+      val result = parseResult(nativeConvertAudioToMp3(processedInputPath, processedOutputPath, inputFormat,
+        keys.toTypedArray(), values.toTypedArray()))
       
       // Log output file size after conversion
       val resultFile = File(processedOutputPath)
@@ -88,18 +358,233 @@ class WavToMp3Module(reactContext: ReactApplicationContext) :
         Log.d(TAG, "Output file size: ${resultFile.length()} bytes")
       }
       
-      if (result == 0) {
-        promise.resolve(processedOutputPath)
+      val errorCode = result["errorCode"]
+      if (errorCode == null) {
+        Log.d(TAG, "Encoded with ${result["encoder"]} in ${result["elapsedMs"]} ms " +
+          "(${result["priority"]} job on cpu ${result["cpu"]}, ${result["placement"]} cores ${result["cpus"]})")
+        if (withResult) {
+          promise.resolve(resultToMap(processedOutputPath, result))
+        } else {
+          promise.resolve(processedOutputPath)
+        }
       } else {
-        promise.reject("CONVERSION_ERROR", "Failed to convert audio file from $inputFormat to MP3")
+        promise.reject(errorCode, result["errorMessage"] ?: "Failed to convert audio file from $inputFormat to MP3")
       }
     } catch (e: Exception) {
       promise.reject("CONVERSION_ERROR", e.message)
     }
   }
 
-  private external fun nativeConvertWavToMp3(inputPath: String, outputPath: String, bitrate: Int?, quality: Int?): Int
-  private external fun nativeConvertAudioToMp3(inputPath: String, outputPath: String, inputFormat: String, bitrate: Int?, quality: Int?): Int
+  // Required by NativeEventEmitter; events are emitted regardless of listeners
+  @ReactMethod
+  fun addListener(eventName: String) {}
+
+  @ReactMethod
+  fun removeListeners(count: Int) {}
+
+  // Called from native code during conversion
+  @Suppress("unused")
+  private fun onNativeProgress(progress: Float) {
+    val body = Arguments.createMap()
+    body.putDouble("progress", progress.toDouble())
+    reactApplicationContext
+      .getJSModule(DeviceEventManagerModule.RCTDeviceEventEmitter::class.java)
+      .emit("onProgress", body)
+  }
+
+  // Nested maps become dotted keys ("a": {"b": 1} -> "a.b" = "1")
+  private fun flattenOptions(map: Map<String, Any?>, prefix: String, keys: MutableList<String>, values: MutableList<String>) {
+    for ((key, value) in map) {
+      val name = prefix + key
+      when (value) {
+        null -> {}
+        is Map<*, *> -> {
+          @Suppress("UNCHECKED_CAST")
+          flattenOptions(value as Map<String, Any?>, "$name.", keys, values)
+        }
+        is Double -> {
+          keys.add(name)
+          values.add(if (value % 1.0 == 0.0) value.toLong().toString() else value.toString())
+        }
+        else -> {
+          keys.add(name)
+          values.add(value.toString())
+        }
+      }
+    }
+  }
+
+  private fun parseResult(text: String): Map<String, String> {
+    val result = HashMap<String, String>()
+    for (line in text.lineSequence()) {
+      val separator = line.indexOf('=')
+      if (separator > 0) {
+        result[line.substring(0, separator)] = line.substring(separator + 1)
+      }
+    }
+    return result
+  }
+
+  private fun resultToMap(outputPath: String, result: Map<String, String>): WritableMap {
+    val map = Arguments.createMap()
+    map.putString("outputPath", outputPath)
+    map.putString("encoder", result["encoder"] ?: "")
+    map.putDouble("inputFrames", result["inputFrames"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("outputBytes", result["outputBytes"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("elapsedMs", result["elapsedMs"]?.toDoubleOrNull() ?: 0.0)
+    map.putString("priority", result["priority"] ?: "interactive")
+    map.putString("placement", result["placement"] ?: "any")
+    map.putString("cpus", result["cpus"] ?: "")
+    map.putInt("cpu", result["cpu"]?.toIntOrNull() ?: -1)
+    map.putBoolean("monoDownmix", result["monoDownmix"] == "1")
+    map.putInt("bitrate", result["bitrate"]?.toIntOrNull() ?: 0)
+    map.putInt("sampleRate", result["sampleRate"]?.toIntOrNull() ?: 0)
+    map.putInt("channels", result["channels"]?.toIntOrNull() ?: 0)
+    map.putInt("quality", result["quality"]?.toIntOrNull() ?: 0)
+    map.putDouble("speechOutputBytes", result["speechOutputBytes"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("logMelFrames", result["logMelFrames"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("clippedSamples", result["clippedSamples"]?.toDoubleOrNull() ?: 0.0)
+    val deadlineMet = result["deadlineMet"]
+    if (deadlineMet != null) {
+      map.putBoolean("deadlineMet", deadlineMet == "1")
+    } else {
+      map.putNull("deadlineMet")
+    }
+    val content = result["content"]
+    if (content != null) {
+      map.putString("content", content)
+    } else {
+      map.putNull("content")
+    }
+    val logMel = result["logMel"]
+    if (logMel != null) {
+      map.putString("logMel", logMel)
+    } else {
+      map.putNull("logMel")
+    }
+    val peaks = result["peaks"]
+    if (peaks != null) {
+      map.putString("peaks", peaks)
+    } else {
+      map.putNull("peaks")
+    }
+    val fingerprint = result["fingerprint"]
+    if (fingerprint != null) {
+      map.putString("fingerprint", fingerprint)
+    } else {
+      map.putNull("fingerprint")
+    }
+    for (key in listOf("loudness", "outputLoudness")) {
+      val lufs = result[key]?.toDoubleOrNull()
+      if (lufs != null) {
+        map.putDouble(key, lufs)
+      } else {
+        map.putNull(key)
+      }
+    }
+    // "highpass:1.20,compressor:3.10"
+    val filterMs = result["filterMs"]
+    if (filterMs != null) {
+      val stages = Arguments.createMap()
+      for (stage in filterMs.split(",")) {
+        val parts = stage.split(":")
+        if (parts.size == 2) {
+          stages.putDouble(parts[0], parts[1].toDoubleOrNull() ?: 0.0)
+        }
+      }
+      map.putMap("filterMs", stages)
+    } else {
+      map.putNull("filterMs")
+    }
+    return map
+  }
+
+  private fun mediaInfoToMap(path: String, result: Map<String, String>, prefix: String): WritableMap {
+    val map = Arguments.createMap()
+    map.putString("path", path)
+    map.putString("container", result["${prefix}container"] ?: "")
+    map.putString("codec", result["${prefix}codec"] ?: "")
+    map.putInt("sampleRate", result["${prefix}sampleRate"]?.toIntOrNull() ?: 0)
+    map.putInt("channels", result["${prefix}channels"]?.toIntOrNull() ?: 0)
+    map.putInt("bitsPerSample", result["${prefix}bitsPerSample"]?.toIntOrNull() ?: 0)
+    map.putInt("bitrate", result["${prefix}bitrate"]?.toIntOrNull() ?: 0)
+    // -1: the file does not say
+    val frames = result["${prefix}frames"]?.toDoubleOrNull() ?: -1.0
+    if (frames >= 0) {
+      map.putDouble("frames", frames)
+      map.putDouble("durationMs", result["${prefix}durationMs"]?.toDoubleOrNull() ?: 0.0)
+    } else {
+      map.putNull("frames")
+      map.putNull("durationMs")
+    }
+    map.putBoolean("estimated", result["${prefix}estimated"] == "1")
+    return map
+  }
+
+  private fun estimateToMap(inputPath: String, result: Map<String, String>): WritableMap {
+    val map = Arguments.createMap()
+    map.putMap("input", mediaInfoToMap(inputPath, result, "input."))
+    map.putString("encoder", result["encoder"] ?: "")
+    map.putInt("bitrate", result["bitrate"]?.toIntOrNull() ?: 0)
+    map.putInt("sampleRate", result["sampleRate"]?.toIntOrNull() ?: 0)
+    map.putInt("channels", result["channels"]?.toIntOrNull() ?: 0)
+    map.putInt("quality", result["quality"]?.toIntOrNull() ?: 0)
+    map.putDouble("outputBytes", result["outputBytes"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("decodedBytes", result["decodedBytes"]?.toDoubleOrNull() ?: 0.0)
+    // -1: unknown
+    val freeBytes = result["freeBytes"]?.toDoubleOrNull() ?: -1.0
+    if (freeBytes >= 0) {
+      map.putDouble("freeBytes", freeBytes)
+    } else {
+      map.putNull("freeBytes")
+    }
+    val timeModel = result["timeModel"] ?: ""
+    if (timeModel.isNotEmpty()) {
+      map.putDouble("elapsedMs", result["elapsedMs"]?.toDoubleOrNull() ?: 0.0)
+      map.putString("timeModel", timeModel)
+    } else {
+      map.putNull("elapsedMs")
+      map.putNull("timeModel")
+    }
+    map.putInt("modelJobs", result["modelJobs"]?.toIntOrNull() ?: 0)
+    return map
+  }
+
+  private fun mp3EditToMap(outputPath: String, result: Map<String, String>): WritableMap {
+    val map = Arguments.createMap()
+    map.putString("outputPath", outputPath)
+    map.putInt("sampleRate", result["sampleRate"]?.toIntOrNull() ?: 0)
+    map.putInt("channels", result["channels"]?.toIntOrNull() ?: 0)
+    map.putDouble("frames", result["frames"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("outputBytes", result["outputBytes"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("durationMs", result["durationMs"]?.toDoubleOrNull() ?: 0.0)
+    map.putInt("resizedFrames", result["resizedFrames"]?.toIntOrNull() ?: 0)
+    map.putDouble("gapMs", result["gapMs"]?.toDoubleOrNull() ?: 0.0)
+    map.putDouble("elapsedMs", result["elapsedMs"]?.toDoubleOrNull() ?: 0.0)
+    return map
+  }
+
+  private external fun nativeConvertAudioToMp3(inputPath: String, outputPath: String, inputFormat: String,
+                                               optionKeys: Array<String>, optionValues: Array<String>): String
+
+  private external fun nativeConvertPhase(inputPath: String, outputPath: String, replace: Boolean,
+                                         optionKeys: Array<String>, optionValues: Array<String>): String
+
+  private external fun nativeConvertMulti(inputPath: String, optionKeys: Array<String>,
+                                         optionValues: Array<String>): String
+
+  private external fun nativeCalibrate(path: String): String
+
+  private external fun nativeCompareFingerprints(a: String, b: String): String
+
+  private external fun nativeProbe(paths: Array<String>): String
+
+  private external fun nativeEstimate(inputPath: String, outputPath: String, optionKeys: Array<String>,
+                                      optionValues: Array<String>): String
+
+  private external fun nativeTrimMp3(inputPath: String, outputPath: String, startMs: Double, endMs: Double): String
+
+  private external fun nativeJoinMp3(inputPaths: Array<String>, outputPath: String): String
 
   companion object {
     const val NAME = "WavToMp3"
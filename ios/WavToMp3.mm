@@ -1,13 +1,76 @@
 #import "WavToMp3.h"
 #import <React/RCTLog.h>
-#import <LAME/lame.h>
+
+#include "calibration.h"
+#include "converter.h"
+#include "estimate.h"
+#include "fingerprint.h"
+#include "mp3_edit.h"
+#include "options.h"
+#include "probe.h"
 
 @implementation WavToMp3
 
 RCT_EXPORT_MODULE();
 
+// Hands the JS options to the core as flat key/value strings; nested
+// dictionaries become dotted keys.
+- (BOOL)applyOptions:(NSDictionary *)options
+              prefix:(NSString *)prefix
+                  to:(wavtomp3::ConversionOptions *)conversionOptions
+               error:(std::string *)error {
+    for (NSString *key in options) {
+        id value = options[key];
+        NSString *name = [prefix stringByAppendingString:key];
+        if ([value isKindOfClass:[NSDictionary class]]) {
+            NSString *nested = [name stringByAppendingString:@"."];
+            if (![self applyOptions:value prefix:nested to:conversionOptions error:error]) {
+                return NO;
+            }
+        } else if (value != [NSNull null]) {
+            NSString *text = [value isKindOfClass:[NSString class]] ? value : [value stringValue];
+            if (wavtomp3::setOption(conversionOptions, [name UTF8String], [text UTF8String], error) != 0) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+// iOS has always defaulted to a speech preset: 32 kbps, quality 7,
+// 80 Hz - 8 kHz band. preset: 'auto' picks from the content instead.
+- (BOOL)conversionOptions:(NSDictionary *)options
+                     into:(wavtomp3::ConversionOptions *)conversionOptions
+                    error:(std::string *)error {
+    if (![options[@"preset"] isEqual:@"auto"]) {
+        conversionOptions->bitrate = 32;
+        conversionOptions->quality = 7;
+        conversionOptions->lowpassHz = 8000;
+        conversionOptions->highpassHz = 80;
+    }
+    if (![self applyOptions:options prefix:@"" to:conversionOptions error:error]) {
+        return NO;
+    }
+    conversionOptions->calibrationFile = [[self calibrationFile] UTF8String];
+    conversionOptions->throughputFile = [[self supportFile:@"wav_to_mp3_throughput.txt"] UTF8String];
+    return YES;
+}
+
+// Per-device state the core reads and updates, kept with the app's support
+// files
+- (NSString *)supportFile:(NSString *)name {
+    NSString *directory = NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES).firstObject;
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    return [directory stringByAppendingPathComponent:name];
+}
+
+// Calibration for deadlineMs
+- (NSString *)calibrationFile {
+    return [self supportFile:@"wav_to_mp3_calibration.txt"];
+}
+
 - (NSArray<NSString *> *)supportedEvents {
-    return @[@"onProgress"];
+    return @[@"onProgress", @"onFinalOutput"];
 }
 
 RCT_EXPORT_METHOD(convertWavToMp3:(NSString *)inputPath
@@ -15,319 +78,402 @@ RCT_EXPORT_METHOD(convertWavToMp3:(NSString *)inputPath
                   options:(NSDictionary *)options
                   resolver:(RCTPromiseResolveBlock)resolve
                   rejecter:(RCTPromiseRejectBlock)reject) {
-    
-    // Remove file:// prefix if present
+    [self convert:inputPath outputPath:outputPath options:options withResult:NO resolver:resolve rejecter:reject];
+}
+
+// Like convertWavToMp3, but resolves with the job stats instead of the path
+RCT_EXPORT_METHOD(convertWithResult:(NSString *)inputPath
+                  outputPath:(NSString *)outputPath
+                  options:(NSDictionary *)options
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    [self convert:inputPath outputPath:outputPath options:options withResult:YES resolver:resolve rejecter:reject];
+}
+
+// Second phases of convertWithPreview, one at a time
+static dispatch_queue_t finalEncodeQueue() {
+    static dispatch_queue_t queue;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        queue = dispatch_queue_create("com.wavtomp3.final", dispatch_queue_attr_make_with_qos_class(
+            DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+    });
+    return queue;
+}
+
+// Resolves as soon as a quick preview is at outputPath, then encodes the full
+// quality at background priority, replaces the preview with it and emits
+// onFinalOutput for jobId
+RCT_EXPORT_METHOD(convertWithPreview:(NSString *)jobId
+                  inputPath:(NSString *)inputPath
+                  outputPath:(NSString *)outputPath
+                  options:(NSDictionary *)options
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    inputPath = [self localPath:inputPath];
+    outputPath = [self localPath:outputPath];
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:[outputPath stringByDeletingLastPathComponent]
+                                   withIntermediateDirectories:YES attributes:nil error:&error]) {
+        reject(@"DIRECTORY_ERROR", @"Failed to create output directory", error);
+        return;
+    }
+    wavtomp3::ConversionOptions conversionOptions;
+    std::string optionError;
+    if (![self conversionOptions:options ?: @{} into:&conversionOptions error:&optionError]) {
+        reject(@"OPTIONS_ERROR", [NSString stringWithUTF8String:optionError.c_str()], nil);
+        return;
+    }
+
+    __weak WavToMp3 *weakSelf = self;
+    auto progress = [weakSelf](float value) {
+        [weakSelf sendEventWithName:@"onProgress" body:@{@"progress": @(value)}];
+    };
+    wavtomp3::ConversionResult preview;
+    std::string input = [inputPath UTF8String];
+    std::string output = [outputPath UTF8String];
+    wavtomp3::runOnWorker(conversionOptions.priority, [&](const wavtomp3::ProgressCallback &workerProgress) {
+        return wavtomp3::convertFilePreview(input, output, conversionOptions, workerProgress, &preview);
+    }, progress, &preview.placement);
+    if (!preview.errorCode.empty()) {
+        reject([NSString stringWithUTF8String:preview.errorCode.c_str()],
+               [NSString stringWithUTF8String:preview.errorMessage.c_str()], nil);
+        return;
+    }
+    resolve([self resultDictionary:preview outputPath:outputPath]);
+
+    conversionOptions.priority = wavtomp3::JobPriority::Background;
+    dispatch_async(finalEncodeQueue(), ^{
+        wavtomp3::ConversionResult result;
+        wavtomp3::runOnWorker(conversionOptions.priority, [&](const wavtomp3::ProgressCallback &workerProgress) {
+            return wavtomp3::convertFileReplacing(input, output, conversionOptions, workerProgress, &result);
+        }, progress, &result.placement);
+        WavToMp3 *strongSelf = weakSelf;
+        if (!strongSelf) {
+            return;
+        }
+        NSDictionary *body = result.errorCode.empty()
+            ? @{@"jobId": jobId, @"result": [strongSelf resultDictionary:result outputPath:outputPath]}
+            : @{@"jobId": jobId,
+                @"errorCode": [NSString stringWithUTF8String:result.errorCode.c_str()],
+                @"errorMessage": [NSString stringWithUTF8String:result.errorMessage.c_str()]};
+        [strongSelf sendEventWithName:@"onFinalOutput" body:body];
+    });
+}
+
+// Encodes one input into several outputs in a single pass; resolves with
+// one result per output
+RCT_EXPORT_METHOD(convertMulti:(NSString *)inputPath
+                  outputs:(NSArray *)outputs
+                  options:(NSDictionary *)options
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
     if ([inputPath hasPrefix:@"file://"]) {
         inputPath = [inputPath substringFromIndex:7];
     }
-    if ([outputPath hasPrefix:@"file://"]) {
-        outputPath = [outputPath substringFromIndex:7];
+    wavtomp3::ConversionOptions conversionOptions;
+    std::string optionError;
+    if (![self conversionOptions:options ?: @{} into:&conversionOptions error:&optionError]) {
+        reject(@"OPTIONS_ERROR", [NSString stringWithUTF8String:optionError.c_str()], nil);
+        return;
     }
-    
-    // Ensure output directory exists
-    NSFileManager *fileManager = [NSFileManager defaultManager];
-    NSString *outputDir = [outputPath stringByDeletingLastPathComponent];
-    NSError *error = nil;
-    
-    if (![fileManager fileExistsAtPath:outputDir]) {
-        [fileManager createDirectoryAtPath:outputDir withIntermediateDirectories:YES attributes:nil error:&error];
-        if (error) {
+
+    // Each output's own options override the shared ones
+    NSMutableArray<NSString *> *outputPaths = [NSMutableArray array];
+    std::vector<wavtomp3::OutputSpec> specs;
+    for (NSDictionary *output in outputs) {
+        NSString *outputPath = output[@"outputPath"];
+        if ([outputPath hasPrefix:@"file://"]) {
+            outputPath = [outputPath substringFromIndex:7];
+        }
+        NSString *outputDir = [outputPath stringByDeletingLastPathComponent];
+        NSError *error = nil;
+        if (![[NSFileManager defaultManager] createDirectoryAtPath:outputDir withIntermediateDirectories:YES attributes:nil error:&error]) {
             reject(@"DIRECTORY_ERROR", @"Failed to create output directory", error);
             return;
         }
+        NSMutableDictionary *outputOptions = [(options ?: @{}) mutableCopy];
+        [outputOptions addEntriesFromDictionary:output];
+        [outputOptions removeObjectForKey:@"outputPath"];
+        wavtomp3::OutputSpec spec;
+        spec.path = [outputPath UTF8String];
+        if (![self conversionOptions:outputOptions into:&spec.options error:&optionError]) {
+            reject(@"OPTIONS_ERROR", [NSString stringWithUTF8String:optionError.c_str()], nil);
+            return;
+        }
+        specs.push_back(spec);
+        [outputPaths addObject:outputPath];
     }
-    
-    // Log file paths and sizes
-    NSDictionary *inputAttributes = [fileManager attributesOfItemAtPath:inputPath error:&error];
-    if (error) {
-        reject(@"FILE_ERROR", @"Failed to get input file attributes", error);
-        return;
+
+    __weak WavToMp3 *weakSelf = self;
+    std::vector<wavtomp3::ConversionResult> results;
+    wavtomp3::Placement placement;
+    std::string input = [inputPath UTF8String];
+    wavtomp3::runOnWorker(conversionOptions.priority, [&](const wavtomp3::ProgressCallback &progress) {
+        return wavtomp3::convertFileMulti(input, conversionOptions, specs, progress, &results);
+    }, [weakSelf](float progress) {
+        [weakSelf sendEventWithName:@"onProgress" body:@{@"progress": @(progress)}];
+    }, &placement);
+
+    NSMutableArray *resolved = [NSMutableArray array];
+    for (size_t i = 0; i < results.size(); i++) {
+        wavtomp3::ConversionResult &result = results[i];
+        if (!result.errorCode.empty()) {
+            reject([NSString stringWithUTF8String:result.errorCode.c_str()],
+                   [NSString stringWithUTF8String:result.errorMessage.c_str()], nil);
+            return;
+        }
+        result.placement = placement;
+        [resolved addObject:[self resultDictionary:result outputPath:outputPaths[i]]];
     }
-    
-    RCTLogInfo(@"Input path: %@", inputPath);
-    RCTLogInfo(@"Input file size: %llu bytes", [inputAttributes fileSize]);
-    RCTLogInfo(@"Output path: %@", outputPath);
-    
-    // Open files
-    FILE *wav = fopen([inputPath UTF8String], "rb");
-    FILE *mp3 = fopen([outputPath UTF8String], "wb");
-    
-    if (!wav || !mp3) {
-        if (wav) fclose(wav);
-        if (mp3) fclose(mp3);
-        reject(@"FILE_ERROR", @"Failed to open input or output file", nil);
+    resolve(resolved);
+}
+
+// Measures encode speed per quality level and stores it for deadlineMs
+RCT_EXPORT_METHOD(calibrate:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    std::string file = [[self calibrationFile] UTF8String];
+    wavtomp3::Calibration calibration;
+    std::string error;
+    wavtomp3::Placement placement;
+    int status = wavtomp3::runOnWorker(wavtomp3::JobPriority::Interactive, [&](const wavtomp3::ProgressCallback &) {
+        if (wavtomp3::runCalibration(&calibration, &error) != 0) {
+            return -1;
+        }
+        return wavtomp3::saveCalibration(file, calibration, &error);
+    }, nullptr, &placement);
+    if (status != 0) {
+        reject(@"CALIBRATION_ERROR", [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
-    
-    // Read WAV header
-    short channels;
-    int sampleRate;
-    short bitsPerSample;
-    
-    // Read RIFF header
-    char riffHeader[4];
-    fread(riffHeader, 1, 4, wav);
-    if (strncmp(riffHeader, "RIFF", 4) != 0) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"Not a valid WAV file (missing RIFF header)", nil);
+    NSMutableArray *realtime = [NSMutableArray array];
+    for (int quality = 0; quality < wavtomp3::kQualityLevels; quality++) {
+        [realtime addObject:@(calibration.realtime[quality])];
+    }
+    resolve(@{@"realtimeFactors": realtime, @"file": [NSString stringWithUTF8String:file.c_str()]});
+}
+
+// Similarity of two fingerprints from convertWithResult, 0 (unrelated) to 1
+RCT_EXPORT_METHOD(compareFingerprints:(NSString *)a
+                  b:(NSString *)b
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    double similarity = 0.0;
+    std::string error;
+    if (wavtomp3::compareFingerprints([a UTF8String], [b UTF8String], &similarity, &error) != 0) {
+        reject(@"FINGERPRINT_ERROR", [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
-    
-    // Skip file size
-    fseek(wav, 4, SEEK_CUR);
-    
-    // Read WAVE identifier
-    char waveHeader[4];
-    fread(waveHeader, 1, 4, wav);
-    if (strncmp(waveHeader, "WAVE", 4) != 0) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"Not a valid WAV file (missing WAVE identifier)", nil);
+    resolve(@(similarity));
+}
+
+// Predicted output size and conversion time; rejects with SPACE_ERROR when
+// the output's file system is short of space
+RCT_EXPORT_METHOD(estimate:(NSString *)inputPath
+                  outputPath:(NSString *)outputPath
+                  options:(NSDictionary *)options
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    wavtomp3::ConversionOptions conversionOptions;
+    std::string error;
+    if (![self conversionOptions:options ?: @{} into:&conversionOptions error:&error]) {
+        reject(@"OPTIONS_ERROR", [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
-    
-    // Search for fmt chunk
-    char chunkId[4];
-    unsigned int chunkSize;
-    bool fmtFound = false;
-    
-    while (!fmtFound && !feof(wav)) {
-        if (fread(chunkId, 1, 4, wav) != 4) {
-            break;
-        }
-        
-        if (fread(&chunkSize, 4, 1, wav) != 1) {
-            break;
-        }
-        
-        if (strncmp(chunkId, "fmt ", 4) == 0) {
-            fmtFound = true;
-            break;
-        } else {
-            // Skip this chunk
-            fseek(wav, chunkSize, SEEK_CUR);
-        }
+    wavtomp3::ConversionEstimate estimate;
+    std::string errorCode;
+    if (wavtomp3::estimateConversion([[self localPath:inputPath] UTF8String], [[self localPath:outputPath] UTF8String],
+                                     conversionOptions, &estimate, &errorCode, &error) != 0) {
+        reject([NSString stringWithUTF8String:errorCode.c_str()], [NSString stringWithUTF8String:error.c_str()], nil);
+        return;
     }
-    
-    if (!fmtFound) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"fmt chunk not found in WAV file", nil);
+    BOOL timed = !estimate.timeModel.empty();
+    resolve(@{
+        @"input": [self mediaInfoDictionary:estimate.input path:inputPath],
+        @"encoder": [NSString stringWithUTF8String:estimate.encoder.c_str()],
+        @"bitrate": @(estimate.bitrate),
+        @"sampleRate": @(estimate.sampleRate),
+        @"channels": @(estimate.channels),
+        @"quality": @(estimate.quality),
+        @"outputBytes": @(estimate.outputBytes),
+        @"decodedBytes": @(estimate.decodedBytes),
+        @"freeBytes": estimate.freeBytes >= 0 ? @(estimate.freeBytes) : [NSNull null],
+        @"elapsedMs": timed ? @(estimate.elapsedMs) : [NSNull null],
+        @"timeModel": timed ? [NSString stringWithUTF8String:estimate.timeModel.c_str()] : [NSNull null],
+        @"modelJobs": @(estimate.modelJobs),
+    });
+}
+
+// Format and duration of a file, read from its header
+RCT_EXPORT_METHOD(probe:(NSString *)path
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    wavtomp3::MediaInfo info;
+    std::string error;
+    if (wavtomp3::probeFile([[self localPath:path] UTF8String], &info, &error) != 0) {
+        reject(@"PROBE_ERROR", [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
-    
-    // Read fmt chunk data
-    short audioFormat;
-    fread(&audioFormat, sizeof(short), 1, wav);
-    fread(&channels, sizeof(short), 1, wav);
-    fread(&sampleRate, sizeof(int), 1, wav);
-    
-    int byteRate;
-    short blockAlign;
-    fread(&byteRate, sizeof(int), 1, wav);
-    fread(&blockAlign, sizeof(short), 1, wav);
-    fread(&bitsPerSample, sizeof(short), 1, wav);
-    
-    // Skip any remaining fmt chunk data
-    if (chunkSize > 16) {
-        fseek(wav, chunkSize - 16, SEEK_CUR);
+    resolve([self mediaInfoDictionary:info path:path]);
+}
+
+// probe() for many files at once, in parallel; failures are reported per file
+RCT_EXPORT_METHOD(probeMany:(NSArray<NSString *> *)paths
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    std::vector<std::string> files;
+    for (NSString *path in paths) {
+        files.push_back([[self localPath:path] UTF8String]);
     }
-    
-    // Search for data chunk
-    bool dataFound = false;
-    while (!dataFound && !feof(wav)) {
-        if (fread(chunkId, 1, 4, wav) != 4) {
-            break;
-        }
-        
-        if (fread(&chunkSize, 4, 1, wav) != 1) {
-            break;
-        }
-        
-        if (strncmp(chunkId, "data", 4) == 0) {
-            dataFound = true;
-            break;
+    std::vector<wavtomp3::ProbeResult> results;
+    wavtomp3::probeFiles(files, wavtomp3::kProbeThreads, &results);
+    NSMutableArray *infos = [NSMutableArray arrayWithCapacity:results.size()];
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!results[i].error.empty()) {
+            [infos addObject:@{@"path": paths[i], @"error": [NSString stringWithUTF8String:results[i].error.c_str()]}];
         } else {
-            // Skip this chunk
-            fseek(wav, chunkSize, SEEK_CUR);
+            [infos addObject:[self mediaInfoDictionary:results[i].info path:paths[i]]];
         }
     }
-    
-    if (!dataFound) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"data chunk not found in WAV file", nil);
+    resolve(infos);
+}
+
+// The part of an MP3 from startMs to endMs (-1: the end), cut at frame
+// boundaries without re-encoding
+RCT_EXPORT_METHOD(trimMp3:(NSString *)inputPath
+                  outputPath:(NSString *)outputPath
+                  startMs:(double)startMs
+                  endMs:(double)endMs
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    NSString *output = [self localPath:outputPath];
+    NSError *directoryError = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:[output stringByDeletingLastPathComponent]
+                                   withIntermediateDirectories:YES attributes:nil error:&directoryError]) {
+        reject(@"DIRECTORY_ERROR", @"Failed to create output directory", directoryError);
         return;
     }
-    
-    // Now we're positioned at the start of audio data
-    long dataStartPosition = ftell(wav);
-    
-    RCTLogInfo(@"WAV file info: channels=%d, sampleRate=%d, bitsPerSample=%d, audioFormat=%d", 
-               channels, sampleRate, bitsPerSample, audioFormat);
-    RCTLogInfo(@"Data chunk size: %u bytes", chunkSize);
-    RCTLogInfo(@"Data starts at position: %ld", dataStartPosition);
-    
-    // Validate audio format
-    if (audioFormat != 1) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"Unsupported audio format (only PCM supported)", nil);
+    wavtomp3::Mp3EditResult result;
+    std::string errorCode;
+    std::string error;
+    if (wavtomp3::trimMp3([[self localPath:inputPath] UTF8String], [output UTF8String], startMs, endMs, &result,
+                          &errorCode, &error) != 0) {
+        reject([NSString stringWithUTF8String:errorCode.c_str()], [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
-    
-    if (bitsPerSample != 16) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"WAV_ERROR", @"Unsupported bit depth (only 16-bit supported)", nil);
+    resolve([self mp3EditDictionary:result outputPath:outputPath]);
+}
+
+// MP3s of the same rate and channels one after the other, without re-encoding
+RCT_EXPORT_METHOD(joinMp3:(NSArray<NSString *> *)inputPaths
+                  outputPath:(NSString *)outputPath
+                  resolver:(RCTPromiseResolveBlock)resolve
+                  rejecter:(RCTPromiseRejectBlock)reject) {
+    std::vector<std::string> inputs;
+    for (NSString *path in inputPaths) {
+        inputs.push_back([[self localPath:path] UTF8String]);
+    }
+    NSString *output = [self localPath:outputPath];
+    NSError *directoryError = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:[output stringByDeletingLastPathComponent]
+                                   withIntermediateDirectories:YES attributes:nil error:&directoryError]) {
+        reject(@"DIRECTORY_ERROR", @"Failed to create output directory", directoryError);
         return;
     }
-    
-    // Initialize LAME
-    lame_global_flags *gfp = lame_init();
-    if (!gfp) {
-        fclose(wav);
-        fclose(mp3);
-        reject(@"LAME_ERROR", @"Failed to initialize LAME", nil);
+    wavtomp3::Mp3EditResult result;
+    std::string errorCode;
+    std::string error;
+    if (wavtomp3::joinMp3(inputs, [output UTF8String], &result, &errorCode, &error) != 0) {
+        reject([NSString stringWithUTF8String:errorCode.c_str()], [NSString stringWithUTF8String:error.c_str()], nil);
         return;
     }
+    resolve([self mp3EditDictionary:result outputPath:outputPath]);
+}
+
+- (NSString *)localPath:(NSString *)path {
+    return [path hasPrefix:@"file://"] ? [path substringFromIndex:7] : path;
+}
+
+- (NSDictionary *)mediaInfoDictionary:(const wavtomp3::MediaInfo &)info path:(NSString *)path {
+    // frames is -1 when the file does not say
+    BOOL known = info.frames >= 0;
+    return @{
+        @"path": path,
+        @"container": [NSString stringWithUTF8String:info.container.c_str()],
+        @"codec": [NSString stringWithUTF8String:info.codec.c_str()],
+        @"sampleRate": @(info.sampleRate),
+        @"channels": @(info.channels),
+        @"bitsPerSample": @(info.bitsPerSample),
+        @"bitrate": @(info.bitrate),
+        @"frames": known ? @(info.frames) : [NSNull null],
+        @"durationMs": known ? @(info.durationMs) : [NSNull null],
+        @"estimated": @(info.estimated),
+    };
+}
+
+- (void)convert:(NSString *)inputPath
+     outputPath:(NSString *)outputPath
+        options:(NSDictionary *)options
+     withResult:(BOOL)withResult
+       resolver:(RCTPromiseResolveBlock)resolve
+       rejecter:(RCTPromiseRejectBlock)reject {
     
-    // Apply options if provided
-    if (options) {
-        NSNumber *bitrate = options[@"bitrate"];
-        NSNumber *quality = options[@"quality"];
-        
-        if (bitrate) {
-            lame_set_brate(gfp, [bitrate intValue]);
-            RCTLogInfo(@"Setting bitrate to: %d", [bitrate intValue]);
-        } else {
-            lame_set_brate(gfp, 32); // Default 32kbps for maximum compression
-        }
-        
-        if (quality) {
-            lame_set_quality(gfp, [quality intValue]);
-            RCTLogInfo(@"Setting quality to: %d", [quality intValue]);
-        } else {
-            lame_set_quality(gfp, 7); // Default quality 7 (good compression, acceptable for speech)
-        }
-    } else {
-        lame_set_brate(gfp, 32); // 32kbps for maximum compression
-        lame_set_quality(gfp, 7); // 0=best, 9=worst - 7 is good for speech
+    // Remove file:// prefix if present
+    if ([inputPath hasPrefix:@"file://"]) {
+        inputPath = [inputPath substringFromIndex:7];
+    }
+    if ([outputPath hasPrefix:@"file://"]) {
+        outputPath = [outputPath substringFromIndex:7];
     }
     
-    lame_set_num_channels(gfp, channels);
-    lame_set_in_samplerate(gfp, sampleRate);
-    lame_set_VBR(gfp, vbr_off);
-    
-    // Set additional parameters optimized for maximum compression and speech recognition
-    lame_set_compression_ratio(gfp, 11.025); // Good compression ratio
-    lame_set_force_ms(gfp, 0); // Don't force mid/side encoding
-    
-    // Audio quality improvements - preserve original volume
-    lame_set_scale(gfp, 1.0); // Preserve original volume
-    lame_set_scale_left(gfp, 1.0); // Left channel scaling
-    lame_set_scale_right(gfp, 1.0); // Right channel scaling
-    
-    // Speech optimization settings for maximum compression
-    lame_set_lowpassfreq(gfp, 8000); // Low-pass filter at 8kHz (speech frequencies)
-    lame_set_highpassfreq(gfp, 80); // High-pass filter at 80Hz (remove low noise)
-    lame_set_strict_ISO(gfp, 0); // Don't strictly follow ISO (allows better compression)
-    lame_set_ATHonly(gfp, 0); // Use full psychoacoustic model
-    lame_set_ATHshort(gfp, 0); // Use long blocks for better compression
-    lame_set_noATH(gfp, 0); // Use ATH (Absolute Threshold of Hearing)
-    lame_set_quant_comp(gfp, 0); // No quantization compensation
-    lame_set_quant_comp_short(gfp, 0); // No short block quantization compensation
-    
-    // Better encoding settings
-    lame_set_emphasis(gfp, 0); // No emphasis
-    lame_set_original(gfp, 1); // Mark as original
-    lame_set_copyright(gfp, 0); // No copyright bit
-    lame_set_extension(gfp, 0); // No extension
+    // Ensure output directory exists
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *outputDir = [outputPath stringByDeletingLastPathComponent];
+    NSError *error = nil;
     
-    // Speech-specific optimizations
-    if (sampleRate > 16000) {
-        // For higher sample rates, we can be more aggressive with compression
-        lame_set_lowpassfreq(gfp, 8000); // Focus on speech frequencies
+    if (![fileManager fileExistsAtPath:outputDir]) {
+        [fileManager createDirectoryAtPath:outputDir withIntermediateDirectories:YES attributes:nil error:&error];
+        if (error) {
+            reject(@"DIRECTORY_ERROR", @"Failed to create output directory", error);
+            return;
+        }
     }
     
-    if (lame_init_params(gfp) < 0) {
-        lame_close(gfp);
-        fclose(wav);
-        fclose(mp3);
-        reject(@"LAME_ERROR", @"Failed to initialize LAME parameters", nil);
+    // Log file paths and sizes
+    NSDictionary *inputAttributes = [fileManager attributesOfItemAtPath:inputPath error:&error];
+    if (error) {
+        reject(@"FILE_ERROR", @"Failed to get input file attributes", error);
         return;
     }
     
-    // Prepare buffers
-    const int bufferSize = 4096;
-    short *buffer = (short *)malloc(bufferSize * channels * sizeof(short));
-    unsigned char *mp3Buffer = (unsigned char *)malloc(bufferSize * 2);
+    RCTLogInfo(@"Input path: %@", inputPath);
+    RCTLogInfo(@"Input file size: %llu bytes", [inputAttributes fileSize]);
+    RCTLogInfo(@"Output path: %@", outputPath);
     
-    if (!buffer || !mp3Buffer) {
-        if (buffer) free(buffer);
-        if (mp3Buffer) free(mp3Buffer);
-        lame_close(gfp);
-        fclose(wav);
-        fclose(mp3);
-        reject(@"MEMORY_ERROR", @"Failed to allocate memory", nil);
+    wavtomp3::ConversionOptions conversionOptions;
+    std::string optionError;
+    if (![self conversionOptions:options into:&conversionOptions error:&optionError]) {
+        reject(@"OPTIONS_ERROR", [NSString stringWithUTF8String:optionError.c_str()], nil);
         return;
     }
-    
-    // Position at the start of audio data (we already found this position)
-    fseek(wav, dataStartPosition, SEEK_SET);
-    
-    int bytesRead;
-    int bytesWritten;
-    long totalBytesWritten = 0;
-    long totalBytes = [inputAttributes fileSize];
-    long bytesProcessed = dataStartPosition; // Start from where data begins
-    
-    // Convert
-    while ((bytesRead = fread(buffer, sizeof(short), bufferSize * channels, wav)) > 0) {
-        int samplesRead = bytesRead / channels;
-        
-        // Ensure we have complete samples
-        if (samplesRead <= 0) continue;
-        
-        if (channels == 1) {
-            bytesWritten = lame_encode_buffer(gfp, buffer, NULL, samplesRead, mp3Buffer, bufferSize * 2);
-        } else {
-            bytesWritten = lame_encode_buffer_interleaved(gfp, buffer, samplesRead, mp3Buffer, bufferSize * 2);
-        }
-        
-        if (bytesWritten < 0) {
-            free(buffer);
-            free(mp3Buffer);
-            lame_close(gfp);
-            fclose(wav);
-            fclose(mp3);
-            reject(@"ENCODE_ERROR", @"Failed to encode buffer", nil);
-            return;
-        }
-        
-        fwrite(mp3Buffer, 1, bytesWritten, mp3);
-        totalBytesWritten += bytesWritten;
-        bytesProcessed += bytesRead * sizeof(short);
-        
-        // Send progress event
-        float progress = (float)bytesProcessed / (float)totalBytes;
-        [self sendEventWithName:@"onProgress" body:@{@"progress": @(progress)}];
-    }
-    
-    // Flush
-    bytesWritten = lame_encode_flush(gfp, mp3Buffer, bufferSize * 2);
-    if (bytesWritten > 0) {
-        fwrite(mp3Buffer, 1, bytesWritten, mp3);
-        totalBytesWritten += bytesWritten;
+
+    __weak WavToMp3 *weakSelf = self;
+    wavtomp3::ConversionResult result;
+    std::string input = [inputPath UTF8String];
+    std::string output = [outputPath UTF8String];
+    // Runs on a pool thread at the requested QoS; progress comes back here
+    wavtomp3::runOnWorker(conversionOptions.priority, [&](const wavtomp3::ProgressCallback &progress) {
+        return wavtomp3::convertFile(input, output, conversionOptions, progress, &result);
+    }, [weakSelf](float progress) {
+        [weakSelf sendEventWithName:@"onProgress" body:@{@"progress": @(progress)}];
+    }, &result.placement);
+
+    if (!result.errorCode.empty()) {
+        reject([NSString stringWithUTF8String:result.errorCode.c_str()],
+               [NSString stringWithUTF8String:result.errorMessage.c_str()], nil);
+        return;
     }
-    
-    // Cleanup
-    free(buffer);
-    free(mp3Buffer);
-    lame_close(gfp);
-    fclose(wav);
-    fclose(mp3);
+    RCTLogInfo(@"Encoded with %s in %.1f ms", result.encoder.c_str(), result.elapsedMs);
     
     // Get output file size
     NSDictionary *outputAttributes = [fileManager attributesOfItemAtPath:outputPath error:&error];
@@ -337,14 +483,66 @@ RCT_EXPORT_METHOD(convertWavToMp3:(NSString *)inputPath
     }
     
     RCTLogInfo(@"Output file size: %llu bytes", [outputAttributes fileSize]);
-    RCTLogInfo(@"Total bytes written: %ld bytes", totalBytesWritten);
+    RCTLogInfo(@"Total bytes written: %lld bytes", result.outputBytes);
     
     if ([inputAttributes fileSize] > 0) {
         float compressionRatio = (float)[outputAttributes fileSize] / (float)[inputAttributes fileSize];
         RCTLogInfo(@"Compression ratio: %.2f", compressionRatio);
     }
     
-    resolve(outputPath);
+    if (!withResult) {
+        resolve(outputPath);
+        return;
+    }
+    resolve([self resultDictionary:result outputPath:outputPath]);
+}
+
+- (NSDictionary *)mp3EditDictionary:(const wavtomp3::Mp3EditResult &)result outputPath:(NSString *)outputPath {
+    return @{
+        @"outputPath": outputPath,
+        @"sampleRate": @(result.sampleRate),
+        @"channels": @(result.channels),
+        @"frames": @(result.frames),
+        @"outputBytes": @(result.outputBytes),
+        @"durationMs": @(result.durationMs),
+        @"resizedFrames": @(result.resizedFrames),
+        @"gapMs": @(result.gapMs),
+        @"elapsedMs": @(result.elapsedMs),
+    };
+}
+
+- (NSDictionary *)resultDictionary:(const wavtomp3::ConversionResult &)result outputPath:(NSString *)outputPath {
+    NSMutableDictionary *filterMs = [NSMutableDictionary dictionary];
+    for (const auto &stage : result.filterMs) {
+        filterMs[[NSString stringWithUTF8String:stage.first.c_str()]] = @(stage.second);
+    }
+    return @{
+        @"outputPath": outputPath,
+        @"encoder": [NSString stringWithUTF8String:result.encoder.c_str()],
+        @"inputFrames": @(result.inputFrames),
+        @"outputBytes": @(result.outputBytes),
+        @"elapsedMs": @(result.elapsedMs),
+        @"priority": @(wavtomp3::priorityName(result.placement.priority)),
+        @"placement": [NSString stringWithUTF8String:result.placement.policy.c_str()],
+        @"cpus": [NSString stringWithUTF8String:wavtomp3::formatCpuList(result.placement.cpus).c_str()],
+        @"cpu": @(result.placement.cpu),
+        @"monoDownmix": @(result.monoDownmix),
+        @"bitrate": @(result.bitrate),
+        @"sampleRate": @(result.sampleRate),
+        @"channels": @(result.channels),
+        @"quality": @(result.quality),
+        @"speechOutputBytes": @(result.speechOutputBytes),
+        @"logMelFrames": @(result.logMelFrames),
+        @"logMel": result.logMel.empty() ? [NSNull null] : [NSString stringWithUTF8String:result.logMel.c_str()],
+        @"clippedSamples": @(result.clippedSamples),
+        @"peaks": result.peaks.empty() ? [NSNull null] : [NSString stringWithUTF8String:result.peaks.c_str()],
+        @"fingerprint": result.fingerprint.empty() ? [NSNull null] : [NSString stringWithUTF8String:result.fingerprint.c_str()],
+        @"loudness": result.loudnessMeasured ? @(result.loudness) : [NSNull null],
+        @"outputLoudness": result.loudnessMeasured ? @(result.outputLoudness) : [NSNull null],
+        @"filterMs": result.filterMs.empty() ? [NSNull null] : filterMs,
+        @"deadlineMet": result.deadlineMs > 0 ? @(result.deadlineMet) : [NSNull null],
+        @"content": result.content.empty() ? [NSNull null] : [NSString stringWithUTF8String:result.content.c_str()],
+    };
 }
 
 @end
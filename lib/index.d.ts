@@ -4,13 +4,571 @@ import { EmitterSubscription } from 'react-native';
  */
 export interface WavToMp3Options {
     /**
-     * MP3 encoding bitrate in kbps (default: 128)
+     * Output format (default: 'mp3'). 'opus' writes Ogg/Opus and is Android only.
+     */
+    format?: OutputFormat;
+    /**
+     * Encoding bitrate in kbps (default: 128 for MP3, 24 for Opus)
      */
     bitrate?: number;
     /**
-     * Encoding quality (0=best, 9=worst, default: 5)
+     * Encoding quality (0=best, 9=worst, default: 5). Ignored by the fixed-point encoder;
+     * sets the encoder complexity for Opus.
      */
     quality?: number;
+    /**
+     * MP3 encoder backend (default: 'auto')
+     * - 'lame': LAME, best quality
+     * - 'fixed': fixed-point encoder, several times faster on low-end ARM devices; CBR only
+     * - 'auto': 'fixed' for speech bitrates (64 kbps or less) on low-end devices, 'lame' otherwise
+     */
+    encoder?: EncoderBackend;
+    /**
+     * Scheduling of the encode thread (default: 'interactive')
+     * - 'interactive': pinned to the performance cores on big.LITTLE devices
+     * - 'background': pinned to the efficiency cores at low priority, for batch work
+     */
+    priority?: JobPriority;
+    /**
+     * Encode stereo input whose two channels carry the same signal as mono (default: true).
+     * The first seconds are checked before encoding and the rest while encoding; if the
+     * channels differ later, the file is encoded again as stereo.
+     */
+    detectMono?: boolean;
+    /**
+     * 'auto' analyzes the first seconds (speech or music, bandwidth, level) and picks the
+     * bitrate, sample rate, lowpass and channel mode; bitrate and other options given
+     * explicitly still apply (default: 'manual')
+     */
+    preset?: Preset;
+    /**
+     * Time budget in ms: picks the best quality predicted to finish in time, from the speed
+     * measured by calibrate(). Overrides quality; without a calibration quality is kept.
+     */
+    deadlineMs?: number;
+    /**
+     * Hard cap on the output size in bytes, e.g. 16e6 for a messaging attachment. The
+     * bitrate is lowered as far as needed in a single pass, up to the bitrate option or
+     * the default. Rejects with SIZE_ERROR when even the lowest bitrate does not fit.
+     */
+    maxBytes?: number;
+    /**
+     * Output size in bytes to aim for, typically met within 1%: the bitrate follows from
+     * it, up to the bitrate option or 320 kbps. May be combined with maxBytes.
+     */
+    targetBytes?: number;
+    /**
+     * Also write the audio as 16-bit mono PCM, e.g. 16 kHz for a speech recognizer, from
+     * the same pass over the input. Not written by convertMulti().
+     */
+    speechOutput?: SpeechOutput;
+    /**
+     * Compute a log-mel spectrogram (16 kHz, 25 ms frames every 10 ms) from the same
+     * pass over the input, for keyword spotting or embeddings. Not computed by convertMulti().
+     */
+    logMel?: LogMelOptions;
+    /**
+     * Compute min/max/RMS waveform peaks at several zoom levels, with clipping counts,
+     * from the same pass over the input. Not computed by convertMulti().
+     */
+    peaks?: PeakOptions;
+    /**
+     * Return a perceptual fingerprint of the audio in the result, for compareFingerprints()
+     * (default: false). Not computed by convertMulti().
+     */
+    fingerprint?: boolean;
+    /**
+     * Measure EBU R128 loudness and optionally normalize to a target, in the same pass
+     * over the input. Not applied by convertMulti().
+     */
+    loudness?: LoudnessOptions;
+    /**
+     * Filters applied to the audio before it is encoded and measured, the same on every
+     * platform. Not applied by convertMulti().
+     */
+    filters?: FilterOptions;
+    /**
+     * The quick first phase of convertWithPreview(); ignored by the other methods
+     */
+    preview?: PreviewOptions;
+    /**
+     * Keep the decoded audio of AAC/M4A input so a later conversion of the same file
+     * skips the decode (Android; default: off)
+     */
+    pcmCache?: PcmCacheOptions;
+}
+/**
+ * Output formats
+ */
+export type OutputFormat = 'mp3' | 'opus';
+/**
+ * MP3 encoder backends
+ */
+export type EncoderBackend = 'auto' | 'lame' | 'fixed';
+/**
+ * Encode job priorities
+ */
+export type JobPriority = 'interactive' | 'background';
+
+/**
+ * Encoder setting presets
+ */
+export type Preset = 'manual' | 'auto';
+
+/**
+ * PCM side output written next to the encoded file
+ */
+export interface SpeechOutput {
+    /**
+     * Path of the PCM file (can be file:// URI); its directory must exist
+     */
+    path: string;
+    /**
+     * 'wav' (default) or 'raw' headerless little-endian samples
+     */
+    format?: 'wav' | 'raw';
+    /**
+     * Sample rate, 8000 to 48000 (default: 16000)
+     */
+    sampleRate?: number;
+}
+/**
+ * Log-mel features computed while encoding
+ */
+export interface LogMelOptions {
+    /**
+     * Path of the binary feature file (can be file:// URI); its directory must exist
+     */
+    path?: string;
+    /**
+     * Also return the features in the result, for decodeLogMel() (default: false)
+     */
+    returnData?: boolean;
+    /**
+     * Mel bands, 1 to 128 (default: 64)
+     */
+    bands?: number;
+}
+/**
+ * Log-mel spectrogram decoded by decodeLogMel()
+ */
+export interface LogMelFeatures {
+    bands: number;
+    frames: number;
+    /**
+     * Rate the features were computed at (16000)
+     */
+    sampleRate: number;
+    /**
+     * Samples between frames (160)
+     */
+    hopLength: number;
+    /**
+     * Samples per frame (400)
+     */
+    windowLength: number;
+    /**
+     * frames * bands natural-log mel energies, frame by frame
+     */
+    data: Float32Array;
+}
+/**
+ * Waveform peaks computed while encoding
+ */
+export interface PeakOptions {
+    /**
+     * Path of the binary sidecar (can be file:// URI); its directory must exist
+     */
+    path?: string;
+    /**
+     * Also return the peaks in the result, for decodePeaks() (default: false)
+     */
+    returnData?: boolean;
+    /**
+     * Frames per bin of the finest level, 16 to 65536 (default: 256)
+     */
+    samplesPerBin?: number;
+    /**
+     * Levels, 1 to 8, each four times coarser than the one before (default: 3)
+     */
+    levels?: number;
+}
+/**
+ * Loudness measurement and normalization
+ */
+export interface LoudnessOptions {
+    /**
+     * Normalize to this integrated loudness, -40 to -5 LUFS (e.g. -16 for podcasts);
+     * without it the loudness is only measured
+     */
+    target?: number;
+    /**
+     * Audio held back to steer the gain, 0 to 10000 ms (default: 3000)
+     */
+    lookaheadMs?: number;
+    /**
+     * Largest boost, 0 to 40 dB (default: 20); cuts are not limited
+     */
+    maxGainDb?: number;
+    /**
+     * Write the output's ReplayGain to the MP3's LAME tag (default: false)
+     */
+    replayGain?: boolean;
+}
+/**
+ * Filters run in this order: DC removal, high-pass, low-pass, gate, compressor, gain
+ */
+export interface FilterOptions {
+    /**
+     * Remove DC offset with a 10 Hz high-pass (default: false)
+     */
+    dcRemoval?: boolean;
+    /**
+     * 4th-order Butterworth high-pass, 10 to 20000 Hz
+     */
+    highpassHz?: number;
+    /**
+     * 4th-order Butterworth low-pass, 100 to 24000 Hz; ignored at or above half the sample rate
+     */
+    lowpassHz?: number;
+    /**
+     * Noise gate threshold, -100 to -1 dBFS; quieter passages are attenuated by 80 dB
+     */
+    gateDb?: number;
+    compressor?: CompressorOptions;
+    /**
+     * Gain, -40 to 40 dB
+     */
+    gainDb?: number;
+}
+/**
+ * The preview convertWithPreview() writes before the full-quality output
+ */
+export interface PreviewOptions {
+    /**
+     * Encode only the first seconds of the input, or 0 for all of it (default: 0)
+     */
+    seconds?: number;
+    /**
+     * Bitrate, 8 to 320 kbps for MP3 and 6 to 256 for Opus (default: 32, or the job's
+     * bitrate if lower)
+     */
+    bitrate?: number;
+}
+/**
+ * Cache of decoded AAC/M4A audio, stored losslessly compressed in the app's cache
+ * directory and keyed by the input's contents
+ */
+export interface PcmCacheOptions {
+    enabled?: boolean;
+    /**
+     * Size of the cache; the least recently used entries are removed beyond it
+     * (default: 256 MB)
+     */
+    maxBytes?: number;
+}
+/**
+ * Downward compressor with a hard knee, linked across channels
+ */
+export interface CompressorOptions {
+    /**
+     * Peak level above which the gain is reduced, -60 to -1 dBFS
+     */
+    thresholdDb: number;
+    /**
+     * 1 to 20 (default: 4)
+     */
+    ratio?: number;
+    /**
+     * 0 to 1000 ms (default: 10)
+     */
+    attackMs?: number;
+    /**
+     * 1 to 5000 ms (default: 100)
+     */
+    releaseMs?: number;
+    /**
+     * Gain after compression, 0 to 30 dB (default: 0)
+     */
+    makeupDb?: number;
+}
+/**
+ * One zoom level of a peak pyramid, every channel folded into the same bins
+ */
+export interface PeakLevel {
+    samplesPerBin: number;
+    /**
+     * Per bin, in [-1, 1]
+     */
+    min: Float32Array;
+    max: Float32Array;
+    rms: Float32Array;
+    /**
+     * Samples at full scale per bin, saturating at 65535
+     */
+    clipped: Uint16Array;
+}
+/**
+ * Peak pyramid decoded by decodePeaks()
+ */
+export interface Peaks {
+    sampleRate: number;
+    channels: number;
+    frames: number;
+    /**
+     * Finest level first
+     */
+    levels: PeakLevel[];
+}
+/**
+ * Statistics of a finished conversion
+ */
+export interface ConversionResult {
+    /**
+     * Path of the written file
+     */
+    outputPath: string;
+    /**
+     * Encoder backend that produced the output
+     */
+    encoder: string;
+    /**
+     * Input frames (samples per channel) read
+     */
+    inputFrames: number;
+    /**
+     * Bytes written
+     */
+    outputBytes: number;
+    /**
+     * Time spent decoding and encoding
+     */
+    elapsedMs: number;
+    /**
+     * Priority the job ran at
+     */
+    priority: JobPriority;
+    /**
+     * Cores the worker was pinned to: 'performance', 'efficiency', or 'any' when
+     * the device is not big.LITTLE or pinning is unavailable
+     */
+    placement: 'performance' | 'efficiency' | 'any';
+    /**
+     * Affinity mask as a CPU list, e.g. "4-7"; empty when not pinned
+     */
+    cpus: string;
+    /**
+     * Core the job finished on, -1 if unknown
+     */
+    cpu: number;
+    /**
+     * True when dual-mono stereo input was encoded as mono, see detectMono
+     */
+    monoDownmix: boolean;
+    /**
+     * Bitrate of the output in kbps
+     */
+    bitrate: number;
+    /**
+     * Sample rate of the output
+     */
+    sampleRate: number;
+    /**
+     * Channels of the output
+     */
+    channels: number;
+    /**
+     * Content detected by preset 'auto'; null otherwise
+     */
+    content: 'speech' | 'music' | 'silence' | null;
+    /**
+     * Quality level used, e.g. chosen for deadlineMs
+     */
+    quality: number;
+    /**
+     * Whether the conversion finished within deadlineMs; null without a deadline
+     */
+    deadlineMet: boolean | null;
+    /**
+     * Bytes of PCM written to speechOutput, including the WAV header; 0 without one
+     */
+    speechOutputBytes: number;
+    /**
+     * Log-mel frames computed; 0 without logMel
+     */
+    logMelFrames: number;
+    /**
+     * Features for decodeLogMel() when logMel.returnData is set; null otherwise
+     */
+    logMel: string | null;
+    /**
+     * Samples at full scale, every channel counted; 0 without peaks
+     */
+    clippedSamples: number;
+    /**
+     * Pyramid for decodePeaks() when peaks.returnData is set; null otherwise
+     */
+    peaks: string | null;
+    /**
+     * Perceptual fingerprint when the fingerprint option is set; null otherwise
+     */
+    fingerprint: string | null;
+    /**
+     * Integrated loudness of the input in LUFS, -70 for silence; null without loudness
+     */
+    loudness: number | null;
+    /**
+     * Integrated loudness of the output after normalization; null without loudness
+     */
+    outputLoudness: number | null;
+    /**
+     * Milliseconds spent in each filter, keyed by name (e.g. highpass); null without filters
+     */
+    filterMs: { [filter: string]: number } | null;
+}
+
+/**
+ * Encode speed of this device, measured by calibrate()
+ */
+export interface CalibrationResult {
+    /**
+     * Seconds of 44.1 kHz stereo audio encoded per second, for each quality level 0-9
+     */
+    realtimeFactors: number[];
+    /**
+     * Where the calibration is stored
+     */
+    file: string;
+}
+/**
+ * Format and duration of a file, read from its header by probe()
+ */
+export interface MediaInfo {
+    /**
+     * The path as given
+     */
+    path: string;
+    /**
+     * 'wav', 'rf64', 'mp4', 'adts' (raw AAC), 'mp3' or 'ogg'
+     */
+    container: string;
+    /**
+     * 'pcm', 'float', 'aac', 'mp3', 'opus', 'vorbis', 'alac', ...
+     */
+    codec: string;
+    sampleRate: number;
+    channels: number;
+    /**
+     * Bits per PCM sample; 0 for compressed audio
+     */
+    bitsPerSample: number;
+    /**
+     * Average bitrate in kbps
+     */
+    bitrate: number;
+    /**
+     * Length in sample frames, or null if the file does not say
+     */
+    frames: number | null;
+    /**
+     * Length in milliseconds, or null if the file does not say
+     */
+    durationMs: number | null;
+    /**
+     * True if the length was estimated from the file size (ADTS AAC, untagged CBR MP3)
+     * rather than counted
+     */
+    estimated: boolean;
+}
+/**
+ * A file probeMany() could not read
+ */
+export interface ProbeError {
+    path: string;
+    error: string;
+}
+/**
+ * What estimate() predicts for a conversion
+ */
+export interface ConversionEstimate {
+    /**
+     * The input as probe() reads it; container 'raw' for headerless PCM
+     */
+    input: MediaInfo;
+    /**
+     * Backend expected to encode: 'lame', 'fixed' or 'opus'
+     */
+    encoder: string;
+    /**
+     * Encoded stream. preset 'auto' may choose a lower bitrate or rate than estimated.
+     */
+    bitrate: number;
+    sampleRate: number;
+    channels: number;
+    quality: number;
+    /**
+     * Predicted size of the output file
+     */
+    outputBytes: number;
+    /**
+     * 16-bit PCM a compressed input (AAC on Android) is decoded to next to the output first
+     */
+    decodedBytes: number;
+    /**
+     * Free space where the output goes, or null if unknown
+     */
+    freeBytes: number | null;
+    /**
+     * Predicted conversion time, or null before the device has a calibration or a finished
+     * job with this encoder to go by
+     */
+    elapsedMs: number | null;
+    /**
+     * 'jobs' when the time is learned from finished conversions, 'calibration' when it
+     * comes from calibrate()
+     */
+    timeModel: 'jobs' | 'calibration' | null;
+    /**
+     * Finished conversions behind a 'jobs' prediction
+     */
+    modelJobs: number;
+}
+/**
+ * What trimMp3() and joinMp3() resolve with
+ */
+export interface Mp3EditResult {
+    outputPath: string;
+    sampleRate: number;
+    channels: number;
+    /**
+     * MP3 frames written
+     */
+    frames: number;
+    outputBytes: number;
+    /**
+     * Playing time of the output; gapless players skip the encoder delay and padding
+     */
+    durationMs: number;
+    /**
+     * Frames moved to a higher bitrate because the data they borrowed from earlier
+     * frames was cut away
+     */
+    resizedFrames: number;
+    /**
+     * joinMp3(): near-silence kept where the inputs meet, from their encoder delay and padding
+     */
+    gapMs: number;
+    elapsedMs: number;
+}
+/**
+ * One output of convertMulti(). Its options override the ones shared by the job;
+ * priority only applies to the job as a whole.
+ */
+export interface OutputSpec extends WavToMp3Options {
+    /**
+     * Path where this output should be saved (can be file:// URI)
+     */
+    outputPath: string;
 }
 /**
  * Progress event data during conversion
@@ -21,6 +579,29 @@ export interface ConversionProgress {
      */
     progress: number;
 }
+/**
+ * Sent when the full-quality output of convertWithPreview() has replaced the preview,
+ * or failed to
+ */
+export interface FinalOutputEvent {
+    jobId: string;
+    result?: ConversionResult;
+    errorCode?: string;
+    errorMessage?: string;
+}
+/**
+ * What convertWithPreview() resolves with
+ */
+export interface PreviewJob {
+    /**
+     * Statistics of the preview, already at outputPath
+     */
+    preview: ConversionResult;
+    /**
+     * Settles when the full-quality output has replaced the preview
+     */
+    final: Promise<ConversionResult>;
+}
 /**
  * Event types that can be emitted by the converter
  */
@@ -28,8 +609,24 @@ export declare enum WavToMp3Events {
     /**
      * Progress update event
      */
-    Progress = "onProgress"
+    Progress = "onProgress",
+    /**
+     * Background phase of convertWithPreview() finished
+     */
+    FinalOutput = "onFinalOutput"
 }
+/**
+ * Decode ConversionResult.logMel, or a logMel.path file read as base64
+ * @param logMel Base64 features
+ * @returns The features as a typed array
+ */
+export declare function decodeLogMel(logMel: string): LogMelFeatures;
+/**
+ * Decode ConversionResult.peaks, or a peaks.path sidecar read as base64
+ * @param peaks Base64 peak pyramid
+ * @returns Every level as typed arrays
+ */
+export declare function decodePeaks(peaks: string): Peaks;
 /**
  * Event emitter for conversion progress updates
  */
@@ -42,6 +639,12 @@ declare class WavToMp3Emitter {
      * @returns Subscription that should be removed when no longer needed
      */
     addProgressListener(callback: (progress: ConversionProgress) => void): EmitterSubscription;
+    /**
+     * Add a listener for the background phase of convertWithPreview() finishing
+     * @param callback Function to be called with the job's outcome
+     * @returns Subscription that should be removed when no longer needed
+     */
+    addFinalOutputListener(callback: (event: FinalOutputEvent) => void): EmitterSubscription;
     /**
      * Remove all event listeners
      */
@@ -122,6 +725,100 @@ declare class WavToMp3Converter {
      * ```
      */
     convertAac(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<string>;
+    /**
+     * Convert like convert(), resolving with the job statistics, including where
+     * the encode thread was placed
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputPath Path where the output file should be saved (can be file:// URI)
+     * @param options Optional conversion settings
+     * @returns Promise that resolves with the conversion statistics
+     */
+    convertWithResult(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<ConversionResult>;
+    /**
+     * Encode one input into several outputs, e.g. 128 kbps for download and 32 kbps for
+     * streaming. The input is read, converted and resampled once and every output is
+     * encoded on its own thread. If any output fails, none is kept.
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputs Up to 8 outputs, each with its path and its own options
+     * @param options Optional settings shared by every output
+     * @returns Promise that resolves with the statistics of each output, in order
+     */
+    convertMulti(inputPath: string, outputs: OutputSpec[], options?: WavToMp3Options): Promise<ConversionResult[]>;
+    /**
+     * Measure how fast this device encodes at each quality level and store the result
+     * for the deadlineMs option. Takes about a second; run it once, e.g. after install.
+     * @returns Promise that resolves with the measured speeds
+     */
+    calibrate(): Promise<CalibrationResult>;
+    /**
+     * Compare two fingerprints from convertWithResult() with the fingerprint option, e.g.
+     * to find the same recording imported in another container or bitrate. The best
+     * alignment within 10 s is used.
+     * @param a Fingerprint of one conversion
+     * @param b Fingerprint of another conversion
+     * @returns Promise that resolves with the similarity, about 0 for unrelated audio and
+     * close to 1 for the same audio
+     */
+    compareFingerprints(a: string, b: string): Promise<number>;
+    /**
+     * Read format and duration of an audio file from its header, without decoding it,
+     * e.g. to show durations in a file list. Takes well under a millisecond per file.
+     * @param path Path to a WAV/RF64, MP4/M4A, AAC (ADTS), MP3 or Ogg Opus/Vorbis file
+     * (can be file:// URI)
+     * @returns Promise that resolves with the file's format and duration
+     */
+    probe(path: string): Promise<MediaInfo>;
+    /**
+     * probe() many files at once, reading them in parallel
+     * @param paths Paths to the files (can be file:// URIs)
+     * @returns Promise that resolves with one entry per path, in order: its MediaInfo, or
+     * a ProbeError if it could not be read
+     */
+    probeMany(paths: string[]): Promise<(MediaInfo | ProbeError)[]>;
+    /**
+     * Predict the output size and conversion time before starting, e.g. to warn about a
+     * large file or a long wait. The size follows from the input's duration and the
+     * bitrate; the time from how fast this device finished earlier conversions with the
+     * same encoder, or from calibrate() until it has. Rejects with SPACE_ERROR when the
+     * output's file system lacks the space.
+     * @param inputPath Path to the input file (can be file:// URI)
+     * @param outputPath Path the output would be saved to (can be file:// URI)
+     * @param options The conversion settings
+     * @returns Promise that resolves with the predicted size and time
+     */
+    estimate(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<ConversionEstimate>;
+    /**
+     * Cut an MP3 to the part from startMs to endMs without re-encoding, so it takes about
+     * as long as copying the file. The cut falls on frame boundaries (26 ms at 44.1 kHz);
+     * the output's LAME tag tells gapless players to skip to the exact millisecond.
+     * Rejects with MP3_ERROR when the input is not an MP3 stream.
+     * @param inputPath Path to the input MP3 (can be file:// URI)
+     * @param outputPath Path where the output should be saved; may be inputPath (can be file:// URI)
+     * @param startMs Where the kept part starts
+     * @param endMs Where it ends (default: the end of the file)
+     * @returns Promise that resolves with the output's statistics
+     */
+    trimMp3(inputPath: string, outputPath: string, startMs: number, endMs?: number): Promise<Mp3EditResult>;
+    /**
+     * Join MP3 files one after the other without re-encoding. All must share the sample
+     * rate and channel count; bitrates may differ. Each seam keeps the encoder delay and
+     * padding of the files it joins, about 25 to 50 ms of near-silence (gapMs in total).
+     * @param inputPaths Paths to the input MP3s, in order (can be file:// URIs)
+     * @param outputPath Path where the output should be saved (can be file:// URI)
+     * @returns Promise that resolves with the output's statistics
+     */
+    joinMp3(inputPaths: string[], outputPath: string): Promise<Mp3EditResult>;
+    /**
+     * Convert in two phases: first a quick low-bitrate preview at outputPath, resolved as
+     * soon as it is written, then the full-quality output at background priority, which
+     * replaces the preview atomically. Both phases read the input once from storage; the
+     * second finds it in the page cache. WAV and raw PCM input only.
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputPath Path where the output file should be saved (can be file:// URI)
+     * @param options Conversion settings of the final output; options.preview shapes the preview
+     * @returns Promise that resolves with the preview's statistics and a promise of the final ones
+     */
+    convertWithPreview(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<PreviewJob>;
 }
 export declare const wavToMp3: WavToMp3Converter;
 export { WavToMp3Converter };
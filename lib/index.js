@@ -9,7 +9,7 @@ var __awaiter = (this && this.__awaiter) || function (thisArg, _arguments, P, ge
     });
 };
 Object.defineProperty(exports, "__esModule", { value: true });
-exports.WavToMp3Converter = exports.wavToMp3 = exports.WavToMp3Events = void 0;
+exports.WavToMp3Converter = exports.wavToMp3 = exports.decodePeaks = exports.decodeLogMel = exports.WavToMp3Events = void 0;
 const react_native_1 = require("react-native");
 /**
  * Event types that can be emitted by the converter
@@ -20,6 +20,10 @@ var WavToMp3Events;
      * Progress update event
      */
     WavToMp3Events["Progress"] = "onProgress";
+    /**
+     * Background phase of convertWithPreview() finished
+     */
+    WavToMp3Events["FinalOutput"] = "onFinalOutput";
 })(WavToMp3Events = exports.WavToMp3Events || (exports.WavToMp3Events = {}));
 const LINKING_ERROR = `The package '@bitnet-infotech/react-native-wav-to-mp3' doesn't seem to be linked. Make sure: \n\n${react_native_1.Platform.select({ ios: "- You have run 'pod install'\n", default: '' })}- You rebuilt the app after installing the package\n` +
     `- You are not using Expo Go\n`;
@@ -31,6 +35,442 @@ const NativeWavToMp3 = react_native_1.NativeModules.WavToMp3
             throw new Error(LINKING_ERROR);
         }
     });
+/**
+ * Validates conversion options and drops unknown keys before they reach native code
+ */
+function processOptions(options) {
+    if (!options) {
+        return options;
+    }
+    const processedOptions = {};
+    // Handle format
+    if (options.format !== undefined) {
+        if (options.format !== 'mp3' && options.format !== 'opus') {
+            throw new Error("Format must be 'mp3' or 'opus'");
+        }
+        if (options.format === 'opus' && react_native_1.Platform.OS !== 'android') {
+            throw new Error('Opus output is only supported on Android');
+        }
+        processedOptions.format = options.format;
+    }
+    // Handle bitrate
+    if (options.bitrate !== undefined) {
+        const bitrate = Number(options.bitrate);
+        if (isNaN(bitrate)) {
+            throw new Error('Bitrate must be a valid number');
+        }
+        if (processedOptions.format === 'opus') {
+            if (bitrate < 6 || bitrate > 256) {
+                throw new Error('Bitrate must be between 6 and 256 kbps for Opus');
+            }
+        } else if (bitrate < 32 || bitrate > 320) {
+            throw new Error('Bitrate must be between 32 and 320 kbps');
+        }
+        processedOptions.bitrate = bitrate;
+    }
+    // Handle quality
+    if (options.quality !== undefined) {
+        const quality = Number(options.quality);
+        if (isNaN(quality)) {
+            throw new Error('Quality must be a valid number');
+        }
+        if (quality < 0 || quality > 9) {
+            throw new Error('Quality must be between 0 (best) and 9 (worst)');
+        }
+        processedOptions.quality = quality;
+    }
+    // Handle encoder
+    if (options.encoder !== undefined) {
+        if (options.encoder !== 'auto' && options.encoder !== 'lame' && options.encoder !== 'fixed') {
+            throw new Error("Encoder must be 'auto', 'lame' or 'fixed'");
+        }
+        processedOptions.encoder = options.encoder;
+    }
+    // Handle priority
+    if (options.priority !== undefined) {
+        if (options.priority !== 'interactive' && options.priority !== 'background') {
+            throw new Error("Priority must be 'interactive' or 'background'");
+        }
+        processedOptions.priority = options.priority;
+    }
+    // Handle preset
+    if (options.preset !== undefined) {
+        if (options.preset !== 'manual' && options.preset !== 'auto') {
+            throw new Error("Preset must be 'manual' or 'auto'");
+        }
+        processedOptions.preset = options.preset;
+    }
+    // Handle deadlineMs
+    if (options.deadlineMs !== undefined) {
+        const deadlineMs = Number(options.deadlineMs);
+        if (isNaN(deadlineMs) || deadlineMs <= 0) {
+            throw new Error('deadlineMs must be a positive number');
+        }
+        processedOptions.deadlineMs = deadlineMs;
+    }
+    // Handle maxBytes and targetBytes
+    if (options.maxBytes !== undefined) {
+        const maxBytes = Number(options.maxBytes);
+        if (!(maxBytes >= 1e3 && maxBytes <= 1e12)) {
+            throw new Error('maxBytes must be between 1e3 and 1e12');
+        }
+        processedOptions.maxBytes = maxBytes;
+    }
+    if (options.targetBytes !== undefined) {
+        const targetBytes = Number(options.targetBytes);
+        if (!(targetBytes >= 1e3 && targetBytes <= 1e12)) {
+            throw new Error('targetBytes must be between 1e3 and 1e12');
+        }
+        if (processedOptions.maxBytes !== undefined && targetBytes > processedOptions.maxBytes) {
+            throw new Error('targetBytes must not exceed maxBytes');
+        }
+        processedOptions.targetBytes = targetBytes;
+    }
+    // Handle speechOutput
+    if (options.speechOutput !== undefined) {
+        const { path, format, sampleRate } = options.speechOutput;
+        if (typeof path !== 'string' || path === '') {
+            throw new Error('speechOutput.path must be a non-empty string');
+        }
+        if (format !== undefined && format !== 'wav' && format !== 'raw') {
+            throw new Error("speechOutput.format must be 'wav' or 'raw'");
+        }
+        if (sampleRate !== undefined && !(Number(sampleRate) >= 8000 && Number(sampleRate) <= 48000)) {
+            throw new Error('speechOutput.sampleRate must be between 8000 and 48000');
+        }
+        const speechOutput = { path: path.replace(/^file:\/\//, '') };
+        if (format !== undefined) {
+            speechOutput.format = format;
+        }
+        if (sampleRate !== undefined) {
+            speechOutput.sampleRate = Number(sampleRate);
+        }
+        processedOptions.speechOutput = speechOutput;
+    }
+    // Handle logMel
+    if (options.logMel !== undefined) {
+        const { path, returnData, bands } = options.logMel;
+        if (path !== undefined && (typeof path !== 'string' || path === '')) {
+            throw new Error('logMel.path must be a non-empty string');
+        }
+        if (returnData !== undefined && typeof returnData !== 'boolean') {
+            throw new Error('logMel.returnData must be a boolean');
+        }
+        if (path === undefined && !returnData) {
+            throw new Error('logMel needs a path or returnData: true');
+        }
+        if (bands !== undefined && !(Number(bands) >= 1 && Number(bands) <= 128)) {
+            throw new Error('logMel.bands must be between 1 and 128');
+        }
+        const logMel = {};
+        if (path !== undefined) {
+            logMel.path = path.replace(/^file:\/\//, '');
+        }
+        if (returnData !== undefined) {
+            logMel.returnData = returnData;
+        }
+        if (bands !== undefined) {
+            logMel.bands = Number(bands);
+        }
+        processedOptions.logMel = logMel;
+    }
+    // Handle peaks
+    if (options.peaks !== undefined) {
+        const { path, returnData, samplesPerBin, levels } = options.peaks;
+        if (path !== undefined && (typeof path !== 'string' || path === '')) {
+            throw new Error('peaks.path must be a non-empty string');
+        }
+        if (returnData !== undefined && typeof returnData !== 'boolean') {
+            throw new Error('peaks.returnData must be a boolean');
+        }
+        if (path === undefined && !returnData) {
+            throw new Error('peaks needs a path or returnData: true');
+        }
+        if (samplesPerBin !== undefined && !(Number(samplesPerBin) >= 16 && Number(samplesPerBin) <= 65536)) {
+            throw new Error('peaks.samplesPerBin must be between 16 and 65536');
+        }
+        if (levels !== undefined && !(Number(levels) >= 1 && Number(levels) <= 8)) {
+            throw new Error('peaks.levels must be between 1 and 8');
+        }
+        const peaks = {};
+        if (path !== undefined) {
+            peaks.path = path.replace(/^file:\/\//, '');
+        }
+        if (returnData !== undefined) {
+            peaks.returnData = returnData;
+        }
+        if (samplesPerBin !== undefined) {
+            peaks.samplesPerBin = Number(samplesPerBin);
+        }
+        if (levels !== undefined) {
+            peaks.levels = Number(levels);
+        }
+        processedOptions.peaks = peaks;
+    }
+    // Handle fingerprint
+    if (options.fingerprint !== undefined) {
+        if (typeof options.fingerprint !== 'boolean') {
+            throw new Error('fingerprint must be a boolean');
+        }
+        processedOptions.fingerprint = options.fingerprint;
+    }
+    // Handle loudness
+    if (options.loudness !== undefined) {
+        const { target, lookaheadMs, maxGainDb, replayGain } = options.loudness;
+        if (target !== undefined && !(Number(target) >= -40 && Number(target) <= -5)) {
+            throw new Error('loudness.target must be between -40 and -5 LUFS');
+        }
+        if (lookaheadMs !== undefined && !(Number(lookaheadMs) >= 0 && Number(lookaheadMs) <= 10000)) {
+            throw new Error('loudness.lookaheadMs must be between 0 and 10000');
+        }
+        if (maxGainDb !== undefined && !(Number(maxGainDb) >= 0 && Number(maxGainDb) <= 40)) {
+            throw new Error('loudness.maxGainDb must be between 0 and 40');
+        }
+        if (replayGain !== undefined && typeof replayGain !== 'boolean') {
+            throw new Error('loudness.replayGain must be a boolean');
+        }
+        const loudness = { measure: true };
+        if (target !== undefined) {
+            loudness.target = Number(target);
+        }
+        if (lookaheadMs !== undefined) {
+            loudness.lookaheadMs = Number(lookaheadMs);
+        }
+        if (maxGainDb !== undefined) {
+            loudness.maxGainDb = Number(maxGainDb);
+        }
+        if (replayGain !== undefined) {
+            loudness.replayGain = replayGain;
+        }
+        processedOptions.loudness = loudness;
+    }
+    // Handle filters
+    if (options.filters !== undefined) {
+        const { dcRemoval, highpassHz, lowpassHz, gateDb, compressor, gainDb } = options.filters;
+        const inRange = (value, min, max) =>
+            value === undefined || (Number(value) >= min && Number(value) <= max);
+        if (dcRemoval !== undefined && typeof dcRemoval !== 'boolean') {
+            throw new Error('filters.dcRemoval must be a boolean');
+        }
+        if (!inRange(highpassHz, 10, 20000)) {
+            throw new Error('filters.highpassHz must be between 10 and 20000');
+        }
+        if (!inRange(lowpassHz, 100, 24000)) {
+            throw new Error('filters.lowpassHz must be between 100 and 24000');
+        }
+        if (!inRange(gateDb, -100, -1)) {
+            throw new Error('filters.gateDb must be between -100 and -1');
+        }
+        if (!inRange(gainDb, -40, 40)) {
+            throw new Error('filters.gainDb must be between -40 and 40');
+        }
+        const filters = {};
+        if (dcRemoval !== undefined) {
+            filters.dcRemoval = dcRemoval;
+        }
+        if (highpassHz !== undefined) {
+            filters.highpassHz = Number(highpassHz);
+        }
+        if (lowpassHz !== undefined) {
+            filters.lowpassHz = Number(lowpassHz);
+        }
+        if (gateDb !== undefined) {
+            filters.gateDb = Number(gateDb);
+        }
+        if (compressor !== undefined) {
+            const { thresholdDb, ratio, attackMs, releaseMs, makeupDb } = compressor;
+            if (thresholdDb === undefined || !inRange(thresholdDb, -60, -1)) {
+                throw new Error('filters.compressor.thresholdDb must be between -60 and -1');
+            }
+            if (!inRange(ratio, 1, 20)) {
+                throw new Error('filters.compressor.ratio must be between 1 and 20');
+            }
+            if (!inRange(attackMs, 0, 1000)) {
+                throw new Error('filters.compressor.attackMs must be between 0 and 1000');
+            }
+            if (!inRange(releaseMs, 1, 5000)) {
+                throw new Error('filters.compressor.releaseMs must be between 1 and 5000');
+            }
+            if (!inRange(makeupDb, 0, 30)) {
+                throw new Error('filters.compressor.makeupDb must be between 0 and 30');
+            }
+            filters.compressor = { thresholdDb: Number(thresholdDb) };
+            if (ratio !== undefined) {
+                filters.compressor.ratio = Number(ratio);
+            }
+            if (attackMs !== undefined) {
+                filters.compressor.attackMs = Number(attackMs);
+            }
+            if (releaseMs !== undefined) {
+                filters.compressor.releaseMs = Number(releaseMs);
+            }
+            if (makeupDb !== undefined) {
+                filters.compressor.makeupDb = Number(makeupDb);
+            }
+        }
+        if (gainDb !== undefined) {
+            filters.gainDb = Number(gainDb);
+        }
+        processedOptions.filters = filters;
+    }
+    // Handle detectMono
+    if (options.detectMono !== undefined) {
+        if (typeof options.detectMono !== 'boolean') {
+            throw new Error('detectMono must be a boolean');
+        }
+        processedOptions.detectMono = options.detectMono;
+    }
+
+    // Handle preview
+    if (options.preview !== undefined) {
+        const { seconds, bitrate } = options.preview;
+        if (seconds !== undefined && !(Number(seconds) >= 0 && Number(seconds) <= 86400)) {
+            throw new Error('preview.seconds must be between 0 and 86400');
+        }
+        if (bitrate !== undefined) {
+            // MP3 has no bitrate below 8 kbps
+            const opus = processedOptions.format === 'opus';
+            const min = opus ? 6 : 8;
+            const max = opus ? 256 : 320;
+            if (!(Number(bitrate) >= min && Number(bitrate) <= max)) {
+                throw new Error(`preview.bitrate must be between ${min} and ${max} kbps for ${opus ? 'Opus' : 'MP3'}`);
+            }
+        }
+        const preview = {};
+        if (seconds !== undefined) {
+            preview.seconds = Number(seconds);
+        }
+        if (bitrate !== undefined) {
+            preview.bitrate = Number(bitrate);
+        }
+        processedOptions.preview = preview;
+    }
+    // Handle pcmCache
+    if (options.pcmCache !== undefined) {
+        const { enabled, maxBytes } = options.pcmCache;
+        if (enabled !== undefined && typeof enabled !== 'boolean') {
+            throw new Error('pcmCache.enabled must be a boolean');
+        }
+        if (maxBytes !== undefined && !(Number(maxBytes) >= 1e6 && Number(maxBytes) <= 1e12)) {
+            throw new Error('pcmCache.maxBytes must be between 1e6 and 1e12');
+        }
+        const pcmCache = {};
+        if (enabled !== undefined) {
+            pcmCache.enabled = enabled;
+        }
+        if (maxBytes !== undefined) {
+            pcmCache.maxBytes = Number(maxBytes);
+        }
+        processedOptions.pcmCache = pcmCache;
+    }
+    return processedOptions;
+}
+const BASE64_ALPHABET = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/';
+function decodeBase64(text) {
+    const digits = new Int8Array(128).fill(-1);
+    for (let i = 0; i < BASE64_ALPHABET.length; i++) {
+        digits[BASE64_ALPHABET.charCodeAt(i)] = i;
+    }
+    const end = text.replace(/=+$/, '').length;
+    const bytes = new Uint8Array(Math.floor((end * 3) / 4));
+    let value = 0;
+    let bits = 0;
+    let length = 0;
+    for (let i = 0; i < end; i++) {
+        const code = text.charCodeAt(i);
+        const digit = code < 128 ? digits[code] : -1;
+        if (digit < 0) {
+            throw new Error('Invalid base64 data');
+        }
+        value = ((value << 6) | digit) & 0xffffff;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            bytes[length++] = (value >> bits) & 0xff;
+        }
+    }
+    return bytes;
+}
+function halfToFloat(half) {
+    const sign = half & 0x8000 ? -1 : 1;
+    const exponent = (half >> 10) & 0x1f;
+    const mantissa = half & 0x3ff;
+    if (exponent === 0) {
+        return sign * mantissa * Math.pow(2, -24);
+    }
+    if (exponent === 31) {
+        return mantissa ? NaN : sign * Infinity;
+    }
+    return sign * (1 + mantissa / 1024) * Math.pow(2, exponent - 15);
+}
+/**
+ * Decode ConversionResult.logMel, or a logMel.path file read as base64
+ * @param logMel Base64 features
+ * @returns The features as a typed array
+ */
+function decodeLogMel(logMel) {
+    const bytes = decodeBase64(logMel);
+    const u16 = (offset) => bytes[offset] | (bytes[offset + 1] << 8);
+    const u32 = (offset) => u16(offset) + u16(offset + 2) * 65536;
+    if (bytes.length < 20 || String.fromCharCode(bytes[0], bytes[1], bytes[2], bytes[3]) !== 'LMEL') {
+        throw new Error('Not log-mel data');
+    }
+    if (u16(4) !== 1) {
+        throw new Error(`Unsupported log-mel version ${u16(4)}`);
+    }
+    const bands = u16(6);
+    const frames = u32(16);
+    if (bytes.length < 20 + frames * bands * 2) {
+        throw new Error('Truncated log-mel data');
+    }
+    const data = new Float32Array(frames * bands);
+    for (let i = 0; i < data.length; i++) {
+        data[i] = halfToFloat(u16(20 + 2 * i));
+    }
+    return { bands, frames, sampleRate: u32(8), hopLength: u16(12), windowLength: u16(14), data };
+}
+exports.decodeLogMel = decodeLogMel;
+/**
+ * Decode ConversionResult.peaks, or a peaks.path sidecar read as base64
+ * @param peaks Base64 peak pyramid
+ * @returns Every level as typed arrays
+ */
+function decodePeaks(peaks) {
+    const bytes = decodeBase64(peaks);
+    const u16 = (offset) => bytes[offset] | (bytes[offset + 1] << 8);
+    const u32 = (offset) => u16(offset) + u16(offset + 2) * 65536;
+    const i16 = (offset) => (u16(offset) << 16) >> 16;
+    if (bytes.length < 20 || String.fromCharCode(bytes[0], bytes[1], bytes[2], bytes[3]) !== 'PEAK') {
+        throw new Error('Not peak data');
+    }
+    if (u16(4) !== 1) {
+        throw new Error(`Unsupported peak version ${u16(4)}`);
+    }
+    const levelCount = u16(6);
+    let offset = 20 + levelCount * 8;
+    const levels = [];
+    for (let level = 0; level < levelCount; level++) {
+        const bins = u32(24 + level * 8);
+        if (bytes.length < offset + bins * 8) {
+            throw new Error('Truncated peak data');
+        }
+        const min = new Float32Array(bins);
+        const max = new Float32Array(bins);
+        const rms = new Float32Array(bins);
+        const clipped = new Uint16Array(bins);
+        for (let i = 0; i < bins; i++, offset += 8) {
+            min[i] = i16(offset) / 32767;
+            max[i] = i16(offset + 2) / 32767;
+            rms[i] = u16(offset + 4) / 32767;
+            clipped[i] = u16(offset + 6);
+        }
+        levels.push({ samplesPerBin: u32(20 + level * 8), min, max, rms, clipped });
+    }
+    return { sampleRate: u32(8), channels: u16(12), frames: u32(16), levels };
+}
+exports.decodePeaks = decodePeaks;
+// Ids that match convertWithPreview() calls to their onFinalOutput events
+let previewJobCount = 0;
 /**
  * Event emitter for conversion progress updates
  */
@@ -46,11 +486,20 @@ class WavToMp3Emitter {
     addProgressListener(callback) {
         return this.eventEmitter.addListener(WavToMp3Events.Progress, callback);
     }
+    /**
+     * Add a listener for the background phase of convertWithPreview() finishing
+     * @param callback Function to be called with the job's outcome
+     * @returns Subscription that should be removed when no longer needed
+     */
+    addFinalOutputListener(callback) {
+        return this.eventEmitter.addListener(WavToMp3Events.FinalOutput, callback);
+    }
     /**
      * Remove all event listeners
      */
     removeAllListeners() {
         this.eventEmitter.removeAllListeners(WavToMp3Events.Progress);
+        this.eventEmitter.removeAllListeners(WavToMp3Events.FinalOutput);
     }
 }
 /**
@@ -96,34 +545,7 @@ class WavToMp3Converter {
      */
     convert(inputPath, outputPath, options) {
         return __awaiter(this, void 0, void 0, function* () {
-            // Validate options
-            if (options) {
-                let processedOptions = {};
-                // Handle bitrate
-                if (options.bitrate !== undefined) {
-                    const bitrate = Number(options.bitrate);
-                    if (isNaN(bitrate)) {
-                        throw new Error('Bitrate must be a valid number');
-                    }
-                    if (bitrate < 32 || bitrate > 320) {
-                        throw new Error('Bitrate must be between 32 and 320 kbps');
-                    }
-                    processedOptions.bitrate = bitrate;
-                }
-                // Handle quality
-                if (options.quality !== undefined) {
-                    const quality = Number(options.quality);
-                    if (isNaN(quality)) {
-                        throw new Error('Quality must be a valid number');
-                    }
-                    if (quality < 0 || quality > 9) {
-                        throw new Error('Quality must be between 0 (best) and 9 (worst)');
-                    }
-                    processedOptions.quality = quality;
-                }
-                return this.nativeModule.convertWavToMp3(inputPath, outputPath, processedOptions);
-            }
-            return this.nativeModule.convertWavToMp3(inputPath, outputPath, options);
+            return this.nativeModule.convertWavToMp3(inputPath, outputPath, processOptions(options));
         });
     }
     /**
@@ -168,34 +590,226 @@ class WavToMp3Converter {
             if (!this.nativeModule.convertAacToMp3) {
                 throw new Error('AAC to MP3 conversion is not available in this version');
             }
-            // Validate options
-            if (options) {
-                let processedOptions = {};
-                // Handle bitrate
-                if (options.bitrate !== undefined) {
-                    const bitrate = Number(options.bitrate);
-                    if (isNaN(bitrate)) {
-                        throw new Error('Bitrate must be a valid number');
-                    }
-                    if (bitrate < 32 || bitrate > 320) {
-                        throw new Error('Bitrate must be between 32 and 320 kbps');
-                    }
-                    processedOptions.bitrate = bitrate;
+            return this.nativeModule.convertAacToMp3(inputPath, outputPath, processOptions(options));
+        });
+    }
+    /**
+     * Convert like convert(), resolving with the job statistics, including where
+     * the encode thread was placed
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputPath Path where the output file should be saved (can be file:// URI)
+     * @param options Optional conversion settings
+     * @returns Promise that resolves with the conversion statistics
+     */
+    convertWithResult(inputPath, outputPath, options) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.convertWithResult) {
+                throw new Error('convertWithResult is not available in this version');
+            }
+            return this.nativeModule.convertWithResult(inputPath, outputPath, processOptions(options));
+        });
+    }
+    /**
+     * Encode one input into several outputs, e.g. 128 kbps for download and 32 kbps for
+     * streaming. The input is read, converted and resampled once and every output is
+     * encoded on its own thread. If any output fails, none is kept.
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputs Up to 8 outputs, each with its path and its own options
+     * @param options Optional settings shared by every output
+     * @returns Promise that resolves with the statistics of each output, in order
+     */
+    convertMulti(inputPath, outputs, options) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.convertMulti) {
+                throw new Error('convertMulti is not available in this version');
+            }
+            if (!Array.isArray(outputs) || outputs.length === 0 || outputs.length > 8) {
+                throw new Error('outputs must be an array of 1 to 8 outputs');
+            }
+            const processedOutputs = outputs.map((output) => {
+                if (!output || typeof output.outputPath !== 'string' || output.outputPath === '') {
+                    throw new Error('Each output needs an outputPath');
                 }
-                // Handle quality
-                if (options.quality !== undefined) {
-                    const quality = Number(options.quality);
-                    if (isNaN(quality)) {
-                        throw new Error('Quality must be a valid number');
+                return Object.assign(Object.assign({}, processOptions(output)), { outputPath: output.outputPath });
+            });
+            return this.nativeModule.convertMulti(inputPath, processedOutputs, processOptions(options));
+        });
+    }
+    /**
+     * Measure how fast this device encodes at each quality level and store the result
+     * for the deadlineMs option. Takes about a second; run it once, e.g. after install.
+     * @returns Promise that resolves with the measured speeds
+     */
+    calibrate() {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.calibrate) {
+                throw new Error('calibrate is not available in this version');
+            }
+            return this.nativeModule.calibrate();
+        });
+    }
+    /**
+     * Compare two fingerprints from convertWithResult() with the fingerprint option, e.g.
+     * to find the same recording imported in another container or bitrate. The best
+     * alignment within 10 s is used.
+     * @param a Fingerprint of one conversion
+     * @param b Fingerprint of another conversion
+     * @returns Promise that resolves with the similarity, about 0 for unrelated audio and
+     * close to 1 for the same audio
+     */
+    compareFingerprints(a, b) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.compareFingerprints) {
+                throw new Error('compareFingerprints is not available in this version');
+            }
+            if (typeof a !== 'string' || typeof b !== 'string') {
+                throw new Error('Fingerprints must be strings');
+            }
+            return this.nativeModule.compareFingerprints(a, b);
+        });
+    }
+    /**
+     * Read format and duration of an audio file from its header, without decoding it,
+     * e.g. to show durations in a file list. Takes well under a millisecond per file.
+     * @param path Path to a WAV/RF64, MP4/M4A, AAC (ADTS), MP3 or Ogg Opus/Vorbis file
+     * (can be file:// URI)
+     * @returns Promise that resolves with the file's format and duration
+     */
+    probe(path) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.probe) {
+                throw new Error('probe is not available in this version');
+            }
+            if (typeof path !== 'string' || path.length === 0) {
+                throw new Error('Path must be a non-empty string');
+            }
+            return this.nativeModule.probe(path);
+        });
+    }
+    /**
+     * probe() many files at once, reading them in parallel
+     * @param paths Paths to the files (can be file:// URIs)
+     * @returns Promise that resolves with one entry per path, in order: its MediaInfo, or
+     * a ProbeError if it could not be read
+     */
+    probeMany(paths) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.probeMany) {
+                throw new Error('probeMany is not available in this version');
+            }
+            if (!Array.isArray(paths) || paths.some((path) => typeof path !== 'string')) {
+                throw new Error('Paths must be an array of strings');
+            }
+            return this.nativeModule.probeMany(paths);
+        });
+    }
+    /**
+     * Predict the output size and conversion time before starting, e.g. to warn about a
+     * large file or a long wait. The size follows from the input's duration and the
+     * bitrate; the time from how fast this device finished earlier conversions with the
+     * same encoder, or from calibrate() until it has. Rejects with SPACE_ERROR when the
+     * output's file system lacks the space.
+     * @param inputPath Path to the input file (can be file:// URI)
+     * @param outputPath Path the output would be saved to (can be file:// URI)
+     * @param options The conversion settings
+     * @returns Promise that resolves with the predicted size and time
+     */
+    estimate(inputPath, outputPath, options) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.estimate) {
+                throw new Error('estimate is not available in this version');
+            }
+            return this.nativeModule.estimate(inputPath, outputPath, processOptions(options));
+        });
+    }
+    /**
+     * Cut an MP3 to the part from startMs to endMs without re-encoding, so it takes about
+     * as long as copying the file. The cut falls on frame boundaries (26 ms at 44.1 kHz);
+     * the output's LAME tag tells gapless players to skip to the exact millisecond.
+     * Rejects with MP3_ERROR when the input is not an MP3 stream.
+     * @param inputPath Path to the input MP3 (can be file:// URI)
+     * @param outputPath Path where the output should be saved; may be inputPath (can be file:// URI)
+     * @param startMs Where the kept part starts
+     * @param endMs Where it ends (default: the end of the file)
+     * @returns Promise that resolves with the output's statistics
+     */
+    trimMp3(inputPath, outputPath, startMs, endMs) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.trimMp3) {
+                throw new Error('trimMp3 is not available in this version');
+            }
+            if (typeof startMs !== 'number' || !(startMs >= 0)) {
+                throw new Error('startMs must be a number of 0 or more');
+            }
+            if (endMs !== undefined && (typeof endMs !== 'number' || !(endMs > startMs))) {
+                throw new Error('endMs must be a number greater than startMs');
+            }
+            return this.nativeModule.trimMp3(inputPath, outputPath, startMs, endMs !== null && endMs !== void 0 ? endMs : -1);
+        });
+    }
+    /**
+     * Join MP3 files one after the other without re-encoding. All must share the sample
+     * rate and channel count; bitrates may differ. Each seam keeps the encoder delay and
+     * padding of the files it joins, about 25 to 50 ms of near-silence (gapMs in total).
+     * @param inputPaths Paths to the input MP3s, in order (can be file:// URIs)
+     * @param outputPath Path where the output should be saved (can be file:// URI)
+     * @returns Promise that resolves with the output's statistics
+     */
+    joinMp3(inputPaths, outputPath) {
+        return __awaiter(this, void 0, void 0, function* () {
+            if (!this.nativeModule.joinMp3) {
+                throw new Error('joinMp3 is not available in this version');
+            }
+            if (!Array.isArray(inputPaths) || inputPaths.length === 0 ||
+                inputPaths.some((path) => typeof path !== 'string')) {
+                throw new Error('Input paths must be a non-empty array of strings');
+            }
+            return this.nativeModule.joinMp3(inputPaths, outputPath);
+        });
+    }
+    /**
+     * Convert in two phases: first a quick low-bitrate preview at outputPath, resolved as
+     * soon as it is written, then the full-quality output at background priority, which
+     * replaces the preview atomically. Both phases read the input once from storage; the
+     * second finds it in the page cache. WAV and raw PCM input only.
+     * @param inputPath Path to the input WAV file (can be file:// URI)
+     * @param outputPath Path where the output file should be saved (can be file:// URI)
+     * @param options Conversion settings of the final output; options.preview shapes the preview
+     * @returns Promise that resolves with the preview's statistics and a promise of the final ones
+     */
+    convertWithPreview(inputPath, outputPath, options) {
+        return __awaiter(this, void 0, void 0, function* () {
+            const nativeModule = this.nativeModule;
+            if (!nativeModule.convertWithPreview) {
+                throw new Error('convertWithPreview is not available in this version');
+            }
+            const processed = processOptions(options);
+            const jobId = `preview-${++previewJobCount}`;
+            let subscription;
+            const final = new Promise((resolve, reject) => {
+                subscription = this.events.addFinalOutputListener((event) => {
+                    if (event.jobId !== jobId) {
+                        return;
                     }
-                    if (quality < 0 || quality > 9) {
-                        throw new Error('Quality must be between 0 (best) and 9 (worst)');
+                    subscription === null || subscription === void 0 ? void 0 : subscription.remove();
+                    if (event.result) {
+                        resolve(event.result);
                     }
-                    processedOptions.quality = quality;
-                }
-                return this.nativeModule.convertAacToMp3(inputPath, outputPath, processedOptions);
+                    else {
+                        const error = new Error(event.errorMessage);
+                        error.code = event.errorCode;
+                        reject(error);
+                    }
+                });
+            });
+            try {
+                const preview = yield nativeModule.convertWithPreview(jobId, inputPath, outputPath, processed);
+                return { preview, final };
+            }
+            catch (error) {
+                subscription === null || subscription === void 0 ? void 0 : subscription.remove();
+                throw error;
             }
-            return this.nativeModule.convertAacToMp3(inputPath, outputPath, options);
         });
     }
 }
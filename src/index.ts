@@ -5,13 +5,590 @@ import { EmitterSubscription,NativeEventEmitter, NativeModules, Platform } from
  */
 export interface WavToMp3Options {
   /**
-   * MP3 encoding bitrate in kbps (default: 128)
+   * Output format (default: 'mp3'). 'opus' writes Ogg/Opus and is Android only.
+   */
+  format?: OutputFormat;
+  /**
+   * Encoding bitrate in kbps (default: 128 for MP3, 24 for Opus)
+   */
+  bitrate?: number;
+  /**
+   * Encoding quality (0=best, 9=worst, default: 5). Ignored by the fixed-point encoder;
+   * sets the encoder complexity for Opus.
+   */
+  quality?: number;
+  /**
+   * MP3 encoder backend (default: 'auto')
+   * - 'lame': LAME, best quality
+   * - 'fixed': fixed-point encoder, several times faster on low-end ARM devices; CBR only
+   * - 'auto': 'fixed' for speech bitrates (64 kbps or less) on low-end devices, 'lame' otherwise
+   */
+  encoder?: EncoderBackend;
+  /**
+   * Scheduling of the encode thread (default: 'interactive')
+   * - 'interactive': pinned to the performance cores on big.LITTLE devices
+   * - 'background': pinned to the efficiency cores at low priority, for batch work
+   */
+  priority?: JobPriority;
+  /**
+   * Encode stereo input whose two channels carry the same signal as mono (default: true).
+   * The first seconds are checked before encoding and the rest while encoding; if the
+   * channels differ later, the file is encoded again as stereo.
+   */
+  detectMono?: boolean;
+  /**
+   * 'auto' analyzes the first seconds (speech or music, bandwidth, level) and picks the
+   * bitrate, sample rate, lowpass and channel mode; bitrate and other options given
+   * explicitly still apply (default: 'manual')
+   */
+  preset?: Preset;
+  /**
+   * Time budget in ms: picks the best quality predicted to finish in time, from the speed
+   * measured by calibrate(). Overrides quality; without a calibration quality is kept.
+   */
+  deadlineMs?: number;
+  /**
+   * Hard cap on the output size in bytes, e.g. 16e6 for a messaging attachment. The
+   * bitrate is lowered as far as needed in a single pass, up to the bitrate option or
+   * the default. Rejects with SIZE_ERROR when even the lowest bitrate does not fit.
+   */
+  maxBytes?: number;
+  /**
+   * Output size in bytes to aim for, typically met within 1%: the bitrate follows from
+   * it, up to the bitrate option or 320 kbps. May be combined with maxBytes.
+   */
+  targetBytes?: number;
+  /**
+   * Also write the audio as 16-bit mono PCM, e.g. 16 kHz for a speech recognizer, from
+   * the same pass over the input. Not written by convertMulti().
+   */
+  speechOutput?: SpeechOutput;
+  /**
+   * Compute a log-mel spectrogram (16 kHz, 25 ms frames every 10 ms) from the same
+   * pass over the input, for keyword spotting or embeddings. Not computed by convertMulti().
+   */
+  logMel?: LogMelOptions;
+  /**
+   * Compute min/max/RMS waveform peaks at several zoom levels, with clipping counts,
+   * from the same pass over the input. Not computed by convertMulti().
+   */
+  peaks?: PeakOptions;
+  /**
+   * Return a perceptual fingerprint of the audio in the result, for compareFingerprints()
+   * (default: false). Not computed by convertMulti().
+   */
+  fingerprint?: boolean;
+  /**
+   * Measure EBU R128 loudness and optionally normalize to a target, in the same pass
+   * over the input. Not applied by convertMulti().
+   */
+  loudness?: LoudnessOptions;
+  /**
+   * Filters applied to the audio before it is encoded and measured, the same on every
+   * platform. Not applied by convertMulti().
+   */
+  filters?: FilterOptions;
+  /**
+   * The quick first phase of convertWithPreview(); ignored by the other methods
+   */
+  preview?: PreviewOptions;
+  /**
+   * Keep the decoded audio of AAC/M4A input so a later conversion of the same file
+   * skips the decode (Android; default: off)
+   */
+  pcmCache?: PcmCacheOptions;
+}
+
+/**
+ * Output formats
+ */
+export type OutputFormat = 'mp3' | 'opus';
+
+/**
+ * MP3 encoder backends
+ */
+export type EncoderBackend = 'auto' | 'lame' | 'fixed';
+
+/**
+ * Encode job priorities
+ */
+export type JobPriority = 'interactive' | 'background';
+
+/**
+ * Encoder setting presets
+ */
+export type Preset = 'manual' | 'auto';
+
+/**
+ * PCM side output written next to the encoded file
+ */
+export interface SpeechOutput {
+  /**
+   * Path of the PCM file (can be file:// URI); its directory must exist
+   */
+  path: string;
+  /**
+   * 'wav' (default) or 'raw' headerless little-endian samples
+   */
+  format?: 'wav' | 'raw';
+  /**
+   * Sample rate, 8000 to 48000 (default: 16000)
+   */
+  sampleRate?: number;
+}
+
+/**
+ * Log-mel features computed while encoding
+ */
+export interface LogMelOptions {
+  /**
+   * Path of the binary feature file (can be file:// URI); its directory must exist
+   */
+  path?: string;
+  /**
+   * Also return the features in the result, for decodeLogMel() (default: false)
+   */
+  returnData?: boolean;
+  /**
+   * Mel bands, 1 to 128 (default: 64)
+   */
+  bands?: number;
+}
+
+/**
+ * Log-mel spectrogram decoded by decodeLogMel()
+ */
+export interface LogMelFeatures {
+  bands: number;
+  frames: number;
+  /**
+   * Rate the features were computed at (16000)
+   */
+  sampleRate: number;
+  /**
+   * Samples between frames (160)
+   */
+  hopLength: number;
+  /**
+   * Samples per frame (400)
+   */
+  windowLength: number;
+  /**
+   * frames * bands natural-log mel energies, frame by frame
+   */
+  data: Float32Array;
+}
+
+/**
+ * Waveform peaks computed while encoding
+ */
+export interface PeakOptions {
+  /**
+   * Path of the binary sidecar (can be file:// URI); its directory must exist
+   */
+  path?: string;
+  /**
+   * Also return the peaks in the result, for decodePeaks() (default: false)
+   */
+  returnData?: boolean;
+  /**
+   * Frames per bin of the finest level, 16 to 65536 (default: 256)
+   */
+  samplesPerBin?: number;
+  /**
+   * Levels, 1 to 8, each four times coarser than the one before (default: 3)
+   */
+  levels?: number;
+}
+
+/**
+ * Loudness measurement and normalization
+ */
+export interface LoudnessOptions {
+  /**
+   * Normalize to this integrated loudness, -40 to -5 LUFS (e.g. -16 for podcasts);
+   * without it the loudness is only measured
+   */
+  target?: number;
+  /**
+   * Audio held back to steer the gain, 0 to 10000 ms (default: 3000)
+   */
+  lookaheadMs?: number;
+  /**
+   * Largest boost, 0 to 40 dB (default: 20); cuts are not limited
+   */
+  maxGainDb?: number;
+  /**
+   * Write the output's ReplayGain to the MP3's LAME tag (default: false)
+   */
+  replayGain?: boolean;
+}
+
+/**
+ * Filters run in this order: DC removal, high-pass, low-pass, gate, compressor, gain
+ */
+export interface FilterOptions {
+  /**
+   * Remove DC offset with a 10 Hz high-pass (default: false)
+   */
+  dcRemoval?: boolean;
+  /**
+   * 4th-order Butterworth high-pass, 10 to 20000 Hz
+   */
+  highpassHz?: number;
+  /**
+   * 4th-order Butterworth low-pass, 100 to 24000 Hz; ignored at or above half the sample rate
+   */
+  lowpassHz?: number;
+  /**
+   * Noise gate threshold, -100 to -1 dBFS; quieter passages are attenuated by 80 dB
+   */
+  gateDb?: number;
+  compressor?: CompressorOptions;
+  /**
+   * Gain, -40 to 40 dB
+   */
+  gainDb?: number;
+}
+
+/**
+ * The preview convertWithPreview() writes before the full-quality output
+ */
+export interface PreviewOptions {
+  /**
+   * Encode only the first seconds of the input, or 0 for all of it (default: 0)
+   */
+  seconds?: number;
+  /**
+   * Bitrate, 8 to 320 kbps for MP3 and 6 to 256 for Opus (default: 32, or the job's
+   * bitrate if lower)
    */
   bitrate?: number;
+}
+
+/**
+ * Cache of decoded AAC/M4A audio, stored losslessly compressed in the app's cache
+ * directory and keyed by the input's contents
+ */
+export interface PcmCacheOptions {
+  enabled?: boolean;
+  /**
+   * Size of the cache; the least recently used entries are removed beyond it
+   * (default: 256 MB)
+   */
+  maxBytes?: number;
+}
+
+/**
+ * Downward compressor with a hard knee, linked across channels
+ */
+export interface CompressorOptions {
+  /**
+   * Peak level above which the gain is reduced, -60 to -1 dBFS
+   */
+  thresholdDb: number;
+  /**
+   * 1 to 20 (default: 4)
+   */
+  ratio?: number;
+  /**
+   * 0 to 1000 ms (default: 10)
+   */
+  attackMs?: number;
+  /**
+   * 1 to 5000 ms (default: 100)
+   */
+  releaseMs?: number;
+  /**
+   * Gain after compression, 0 to 30 dB (default: 0)
+   */
+  makeupDb?: number;
+}
+
+/**
+ * One zoom level of a peak pyramid, every channel folded into the same bins
+ */
+export interface PeakLevel {
+  samplesPerBin: number;
+  /**
+   * Per bin, in [-1, 1]
+   */
+  min: Float32Array;
+  max: Float32Array;
+  rms: Float32Array;
+  /**
+   * Samples at full scale per bin, saturating at 65535
+   */
+  clipped: Uint16Array;
+}
+
+/**
+ * Peak pyramid decoded by decodePeaks()
+ */
+export interface Peaks {
+  sampleRate: number;
+  channels: number;
+  frames: number;
+  /**
+   * Finest level first
+   */
+  levels: PeakLevel[];
+}
+
+/**
+ * Statistics of a finished conversion
+ */
+export interface ConversionResult {
+  /**
+   * Path of the written file
+   */
+  outputPath: string;
+  /**
+   * Encoder backend that produced the output
+   */
+  encoder: string;
+  /**
+   * Input frames (samples per channel) read
+   */
+  inputFrames: number;
+  /**
+   * Bytes written
+   */
+  outputBytes: number;
+  /**
+   * Time spent decoding and encoding
+   */
+  elapsedMs: number;
+  /**
+   * Priority the job ran at
+   */
+  priority: JobPriority;
+  /**
+   * Cores the worker was pinned to: 'performance', 'efficiency', or 'any' when
+   * the device is not big.LITTLE or pinning is unavailable
+   */
+  placement: 'performance' | 'efficiency' | 'any';
+  /**
+   * Affinity mask as a CPU list, e.g. "4-7"; empty when not pinned
+   */
+  cpus: string;
+  /**
+   * Core the job finished on, -1 if unknown
+   */
+  cpu: number;
+  /**
+   * True when dual-mono stereo input was encoded as mono, see detectMono
+   */
+  monoDownmix: boolean;
+  /**
+   * Bitrate of the output in kbps
+   */
+  bitrate: number;
+  /**
+   * Sample rate of the output
+   */
+  sampleRate: number;
+  /**
+   * Channels of the output
+   */
+  channels: number;
+  /**
+   * Content detected by preset 'auto'; null otherwise
+   */
+  content: 'speech' | 'music' | 'silence' | null;
+  /**
+   * Quality level used, e.g. chosen for deadlineMs
+   */
+  quality: number;
+  /**
+   * Whether the conversion finished within deadlineMs; null without a deadline
+   */
+  deadlineMet: boolean | null;
+  /**
+   * Bytes of PCM written to speechOutput, including the WAV header; 0 without one
+   */
+  speechOutputBytes: number;
+  /**
+   * Log-mel frames computed; 0 without logMel
+   */
+  logMelFrames: number;
+  /**
+   * Features for decodeLogMel() when logMel.returnData is set; null otherwise
+   */
+  logMel: string | null;
+  /**
+   * Samples at full scale, every channel counted; 0 without peaks
+   */
+  clippedSamples: number;
+  /**
+   * Pyramid for decodePeaks() when peaks.returnData is set; null otherwise
+   */
+  peaks: string | null;
+  /**
+   * Perceptual fingerprint when the fingerprint option is set; null otherwise
+   */
+  fingerprint: string | null;
+  /**
+   * Integrated loudness of the input in LUFS, -70 for silence; null without loudness
+   */
+  loudness: number | null;
+  /**
+   * Integrated loudness of the output after normalization; null without loudness
+   */
+  outputLoudness: number | null;
+  /**
+   * Milliseconds spent in each filter, keyed by name (e.g. highpass); null without filters
+   */
+  filterMs: { [filter: string]: number } | null;
+}
+
+/**
+ * Encode speed of this device, measured by calibrate()
+ */
+export interface CalibrationResult {
+  /**
+   * Seconds of 44.1 kHz stereo audio encoded per second, for each quality level 0-9
+   */
+  realtimeFactors: number[];
+  /**
+   * Where the calibration is stored
+   */
+  file: string;
+}
+
+/**
+ * Format and duration of a file, read from its header by probe()
+ */
+export interface MediaInfo {
+  /**
+   * The path as given
+   */
+  path: string;
+  /**
+   * 'wav', 'rf64', 'mp4', 'adts' (raw AAC), 'mp3' or 'ogg'
+   */
+  container: string;
+  /**
+   * 'pcm', 'float', 'aac', 'mp3', 'opus', 'vorbis', 'alac', ...
+   */
+  codec: string;
+  sampleRate: number;
+  channels: number;
+  /**
+   * Bits per PCM sample; 0 for compressed audio
+   */
+  bitsPerSample: number;
+  /**
+   * Average bitrate in kbps
+   */
+  bitrate: number;
+  /**
+   * Length in sample frames, or null if the file does not say
+   */
+  frames: number | null;
+  /**
+   * Length in milliseconds, or null if the file does not say
+   */
+  durationMs: number | null;
+  /**
+   * True if the length was estimated from the file size (ADTS AAC, untagged CBR MP3)
+   * rather than counted
+   */
+  estimated: boolean;
+}
+
+/**
+ * A file probeMany() could not read
+ */
+export interface ProbeError {
+  path: string;
+  error: string;
+}
+
+/**
+ * What estimate() predicts for a conversion
+ */
+export interface ConversionEstimate {
+  /**
+   * The input as probe() reads it; container 'raw' for headerless PCM
+   */
+  input: MediaInfo;
+  /**
+   * Backend expected to encode: 'lame', 'fixed' or 'opus'
+   */
+  encoder: string;
+  /**
+   * Encoded stream. preset 'auto' may choose a lower bitrate or rate than estimated.
+   */
+  bitrate: number;
+  sampleRate: number;
+  channels: number;
+  quality: number;
+  /**
+   * Predicted size of the output file
+   */
+  outputBytes: number;
+  /**
+   * 16-bit PCM a compressed input (AAC on Android) is decoded to next to the output first
+   */
+  decodedBytes: number;
+  /**
+   * Free space where the output goes, or null if unknown
+   */
+  freeBytes: number | null;
+  /**
+   * Predicted conversion time, or null before the device has a calibration or a finished
+   * job with this encoder to go by
+   */
+  elapsedMs: number | null;
+  /**
+   * 'jobs' when the time is learned from finished conversions, 'calibration' when it
+   * comes from calibrate()
+   */
+  timeModel: 'jobs' | 'calibration' | null;
+  /**
+   * Finished conversions behind a 'jobs' prediction
+   */
+  modelJobs: number;
+}
+
+/**
+ * What trimMp3() and joinMp3() resolve with
+ */
+export interface Mp3EditResult {
+  outputPath: string;
+  sampleRate: number;
+  channels: number;
+  /**
+   * MP3 frames written
+   */
+  frames: number;
+  outputBytes: number;
+  /**
+   * Playing time of the output; gapless players skip the encoder delay and padding
+   */
+  durationMs: number;
   /**
-   * Encoding quality (0=best, 9=worst, default: 5)
+   * Frames moved to a higher bitrate because the data they borrowed from earlier
+   * frames was cut away
    */
-  quality?: number;
+  resizedFrames: number;
+  /**
+   * joinMp3(): near-silence kept where the inputs meet, from their encoder delay and padding
+   */
+  gapMs: number;
+  elapsedMs: number;
+}
+
+/**
+ * One output of convertMulti(). Its options override the ones shared by the job;
+ * priority only applies to the job as a whole.
+ */
+export interface OutputSpec extends WavToMp3Options {
+  /**
+   * Path where this output should be saved (can be file:// URI)
+   */
+  outputPath: string;
 }
 
 /**
@@ -24,6 +601,31 @@ export interface ConversionProgress {
   progress: number;
 }
 
+/**
+ * Sent when the full-quality output of convertWithPreview() has replaced the preview,
+ * or failed to
+ */
+export interface FinalOutputEvent {
+  jobId: string;
+  result?: ConversionResult;
+  errorCode?: string;
+  errorMessage?: string;
+}
+
+/**
+ * What convertWithPreview() resolves with
+ */
+export interface PreviewJob {
+  /**
+   * Statistics of the preview, already at outputPath
+   */
+  preview: ConversionResult;
+  /**
+   * Settles when the full-quality output has replaced the preview
+   */
+  final: Promise<ConversionResult>;
+}
+
 /**
  * Event types that can be emitted by the converter
  */
@@ -31,7 +633,11 @@ export enum WavToMp3Events {
   /**
    * Progress update event
    */
-  Progress = 'onProgress'
+  Progress = 'onProgress',
+  /**
+   * Background phase of convertWithPreview() finished
+   */
+  FinalOutput = 'onFinalOutput'
 }
 
 /**
@@ -40,6 +646,21 @@ export enum WavToMp3Events {
 interface WavToMp3NativeModule {
   convertWavToMp3(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<string>;
   convertAacToMp3?(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<string>;
+  convertWithResult?(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<ConversionResult>;
+  convertMulti?(inputPath: string, outputs: OutputSpec[], options?: WavToMp3Options): Promise<ConversionResult[]>;
+  calibrate?(): Promise<CalibrationResult>;
+  compareFingerprints?(a: string, b: string): Promise<number>;
+  probe?(path: string): Promise<MediaInfo>;
+  probeMany?(paths: string[]): Promise<(MediaInfo | ProbeError)[]>;
+  estimate?(inputPath: string, outputPath: string, options?: WavToMp3Options): Promise<ConversionEstimate>;
+  trimMp3?(inputPath: string, outputPath: string, startMs: number, endMs: number): Promise<Mp3EditResult>;
+  joinMp3?(inputPaths: string[], outputPath: string): Promise<Mp3EditResult>;
+  convertWithPreview?(
+    jobId: string,
+    inputPath: string,
+    outputPath: string,
+    options?: WavToMp3Options
+  ): Promise<ConversionResult>;
 }
 
 const LINKING_ERROR =
@@ -60,6 +681,464 @@ const NativeWavToMp3 = NativeModules.WavToMp3
       }
     );
 
+/**
+ * Validates conversion options and drops unknown keys before they reach native code
+ */
+function processOptions(options?: WavToMp3Options): WavToMp3Options | undefined {
+  if (!options) {
+    return options;
+  }
+  const processedOptions: WavToMp3Options = {};
+
+  // Handle format
+  if (options.format !== undefined) {
+    if (options.format !== 'mp3' && options.format !== 'opus') {
+      throw new Error("Format must be 'mp3' or 'opus'");
+    }
+    if (options.format === 'opus' && Platform.OS !== 'android') {
+      throw new Error('Opus output is only supported on Android');
+    }
+    processedOptions.format = options.format;
+  }
+
+  // Handle bitrate
+  if (options.bitrate !== undefined) {
+    const bitrate = Number(options.bitrate);
+    if (isNaN(bitrate)) {
+      throw new Error('Bitrate must be a valid number');
+    }
+    if (processedOptions.format === 'opus') {
+      if (bitrate < 6 || bitrate > 256) {
+        throw new Error('Bitrate must be between 6 and 256 kbps for Opus');
+      }
+    } else if (bitrate < 32 || bitrate > 320) {
+      throw new Error('Bitrate must be between 32 and 320 kbps');
+    }
+    processedOptions.bitrate = bitrate;
+  }
+
+  // Handle quality
+  if (options.quality !== undefined) {
+    const quality = Number(options.quality);
+    if (isNaN(quality)) {
+      throw new Error('Quality must be a valid number');
+    }
+    if (quality < 0 || quality > 9) {
+      throw new Error('Quality must be between 0 (best) and 9 (worst)');
+    }
+    processedOptions.quality = quality;
+  }
+
+  // Handle encoder
+  if (options.encoder !== undefined) {
+    if (options.encoder !== 'auto' && options.encoder !== 'lame' && options.encoder !== 'fixed') {
+      throw new Error("Encoder must be 'auto', 'lame' or 'fixed'");
+    }
+    processedOptions.encoder = options.encoder;
+  }
+
+  // Handle priority
+  if (options.priority !== undefined) {
+    if (options.priority !== 'interactive' && options.priority !== 'background') {
+      throw new Error("Priority must be 'interactive' or 'background'");
+    }
+    processedOptions.priority = options.priority;
+  }
+
+  // Handle preset
+  if (options.preset !== undefined) {
+    if (options.preset !== 'manual' && options.preset !== 'auto') {
+      throw new Error("Preset must be 'manual' or 'auto'");
+    }
+    processedOptions.preset = options.preset;
+  }
+
+  // Handle deadlineMs
+  if (options.deadlineMs !== undefined) {
+    const deadlineMs = Number(options.deadlineMs);
+    if (isNaN(deadlineMs) || deadlineMs <= 0) {
+      throw new Error('deadlineMs must be a positive number');
+    }
+    processedOptions.deadlineMs = deadlineMs;
+  }
+
+  // Handle maxBytes and targetBytes
+  if (options.maxBytes !== undefined) {
+    const maxBytes = Number(options.maxBytes);
+    if (!(maxBytes >= 1e3 && maxBytes <= 1e12)) {
+      throw new Error('maxBytes must be between 1e3 and 1e12');
+    }
+    processedOptions.maxBytes = maxBytes;
+  }
+  if (options.targetBytes !== undefined) {
+    const targetBytes = Number(options.targetBytes);
+    if (!(targetBytes >= 1e3 && targetBytes <= 1e12)) {
+      throw new Error('targetBytes must be between 1e3 and 1e12');
+    }
+    if (processedOptions.maxBytes !== undefined && targetBytes > processedOptions.maxBytes) {
+      throw new Error('targetBytes must not exceed maxBytes');
+    }
+    processedOptions.targetBytes = targetBytes;
+  }
+
+  // Handle speechOutput
+  if (options.speechOutput !== undefined) {
+    const { path, format, sampleRate } = options.speechOutput;
+    if (typeof path !== 'string' || path === '') {
+      throw new Error('speechOutput.path must be a non-empty string');
+    }
+    if (format !== undefined && format !== 'wav' && format !== 'raw') {
+      throw new Error("speechOutput.format must be 'wav' or 'raw'");
+    }
+    if (sampleRate !== undefined && !(Number(sampleRate) >= 8000 && Number(sampleRate) <= 48000)) {
+      throw new Error('speechOutput.sampleRate must be between 8000 and 48000');
+    }
+    const speechOutput: SpeechOutput = { path: path.replace(/^file:\/\//, '') };
+    if (format !== undefined) {
+      speechOutput.format = format;
+    }
+    if (sampleRate !== undefined) {
+      speechOutput.sampleRate = Number(sampleRate);
+    }
+    processedOptions.speechOutput = speechOutput;
+  }
+
+  // Handle logMel
+  if (options.logMel !== undefined) {
+    const { path, returnData, bands } = options.logMel;
+    if (path !== undefined && (typeof path !== 'string' || path === '')) {
+      throw new Error('logMel.path must be a non-empty string');
+    }
+    if (returnData !== undefined && typeof returnData !== 'boolean') {
+      throw new Error('logMel.returnData must be a boolean');
+    }
+    if (path === undefined && !returnData) {
+      throw new Error('logMel needs a path or returnData: true');
+    }
+    if (bands !== undefined && !(Number(bands) >= 1 && Number(bands) <= 128)) {
+      throw new Error('logMel.bands must be between 1 and 128');
+    }
+    const logMel: LogMelOptions = {};
+    if (path !== undefined) {
+      logMel.path = path.replace(/^file:\/\//, '');
+    }
+    if (returnData !== undefined) {
+      logMel.returnData = returnData;
+    }
+    if (bands !== undefined) {
+      logMel.bands = Number(bands);
+    }
+    processedOptions.logMel = logMel;
+  }
+
+  // Handle peaks
+  if (options.peaks !== undefined) {
+    const { path, returnData, samplesPerBin, levels } = options.peaks;
+    if (path !== undefined && (typeof path !== 'string' || path === '')) {
+      throw new Error('peaks.path must be a non-empty string');
+    }
+    if (returnData !== undefined && typeof returnData !== 'boolean') {
+      throw new Error('peaks.returnData must be a boolean');
+    }
+    if (path === undefined && !returnData) {
+      throw new Error('peaks needs a path or returnData: true');
+    }
+    if (samplesPerBin !== undefined && !(Number(samplesPerBin) >= 16 && Number(samplesPerBin) <= 65536)) {
+      throw new Error('peaks.samplesPerBin must be between 16 and 65536');
+    }
+    if (levels !== undefined && !(Number(levels) >= 1 && Number(levels) <= 8)) {
+      throw new Error('peaks.levels must be between 1 and 8');
+    }
+    const peaks: PeakOptions = {};
+    if (path !== undefined) {
+      peaks.path = path.replace(/^file:\/\//, '');
+    }
+    if (returnData !== undefined) {
+      peaks.returnData = returnData;
+    }
+    if (samplesPerBin !== undefined) {
+      peaks.samplesPerBin = Number(samplesPerBin);
+    }
+    if (levels !== undefined) {
+      peaks.levels = Number(levels);
+    }
+    processedOptions.peaks = peaks;
+  }
+
+  // Handle fingerprint
+  if (options.fingerprint !== undefined) {
+    if (typeof options.fingerprint !== 'boolean') {
+      throw new Error('fingerprint must be a boolean');
+    }
+    processedOptions.fingerprint = options.fingerprint;
+  }
+
+  // Handle loudness
+  if (options.loudness !== undefined) {
+    const { target, lookaheadMs, maxGainDb, replayGain } = options.loudness;
+    if (target !== undefined && !(Number(target) >= -40 && Number(target) <= -5)) {
+      throw new Error('loudness.target must be between -40 and -5 LUFS');
+    }
+    if (lookaheadMs !== undefined && !(Number(lookaheadMs) >= 0 && Number(lookaheadMs) <= 10000)) {
+      throw new Error('loudness.lookaheadMs must be between 0 and 10000');
+    }
+    if (maxGainDb !== undefined && !(Number(maxGainDb) >= 0 && Number(maxGainDb) <= 40)) {
+      throw new Error('loudness.maxGainDb must be between 0 and 40');
+    }
+    if (replayGain !== undefined && typeof replayGain !== 'boolean') {
+      throw new Error('loudness.replayGain must be a boolean');
+    }
+    const loudness: LoudnessOptions & { measure: boolean } = { measure: true };
+    if (target !== undefined) {
+      loudness.target = Number(target);
+    }
+    if (lookaheadMs !== undefined) {
+      loudness.lookaheadMs = Number(lookaheadMs);
+    }
+    if (maxGainDb !== undefined) {
+      loudness.maxGainDb = Number(maxGainDb);
+    }
+    if (replayGain !== undefined) {
+      loudness.replayGain = replayGain;
+    }
+    processedOptions.loudness = loudness;
+  }
+
+  // Handle filters
+  if (options.filters !== undefined) {
+    const { dcRemoval, highpassHz, lowpassHz, gateDb, compressor, gainDb } = options.filters;
+    const inRange = (value: unknown, min: number, max: number) =>
+      value === undefined || (Number(value) >= min && Number(value) <= max);
+    if (dcRemoval !== undefined && typeof dcRemoval !== 'boolean') {
+      throw new Error('filters.dcRemoval must be a boolean');
+    }
+    if (!inRange(highpassHz, 10, 20000)) {
+      throw new Error('filters.highpassHz must be between 10 and 20000');
+    }
+    if (!inRange(lowpassHz, 100, 24000)) {
+      throw new Error('filters.lowpassHz must be between 100 and 24000');
+    }
+    if (!inRange(gateDb, -100, -1)) {
+      throw new Error('filters.gateDb must be between -100 and -1');
+    }
+    if (!inRange(gainDb, -40, 40)) {
+      throw new Error('filters.gainDb must be between -40 and 40');
+    }
+    const filters: FilterOptions = {};
+    if (dcRemoval !== undefined) {
+      filters.dcRemoval = dcRemoval;
+    }
+    if (highpassHz !== undefined) {
+      filters.highpassHz = Number(highpassHz);
+    }
+    if (lowpassHz !== undefined) {
+      filters.lowpassHz = Number(lowpassHz);
+    }
+    if (gateDb !== undefined) {
+      filters.gateDb = Number(gateDb);
+    }
+    if (compressor !== undefined) {
+      const { thresholdDb, ratio, attackMs, releaseMs, makeupDb } = compressor;
+      if (thresholdDb === undefined || !inRange(thresholdDb, -60, -1)) {
+        throw new Error('filters.compressor.thresholdDb must be between -60 and -1');
+      }
+      if (!inRange(ratio, 1, 20)) {
+        throw new Error('filters.compressor.ratio must be between 1 and 20');
+      }
+      if (!inRange(attackMs, 0, 1000)) {
+        throw new Error('filters.compressor.attackMs must be between 0 and 1000');
+      }
+      if (!inRange(releaseMs, 1, 5000)) {
+        throw new Error('filters.compressor.releaseMs must be between 1 and 5000');
+      }
+      if (!inRange(makeupDb, 0, 30)) {
+        throw new Error('filters.compressor.makeupDb must be between 0 and 30');
+      }
+      filters.compressor = { thresholdDb: Number(thresholdDb) };
+      if (ratio !== undefined) {
+        filters.compressor.ratio = Number(ratio);
+      }
+      if (attackMs !== undefined) {
+        filters.compressor.attackMs = Number(attackMs);
+      }
+      if (releaseMs !== undefined) {
+        filters.compressor.releaseMs = Number(releaseMs);
+      }
+      if (makeupDb !== undefined) {
+        filters.compressor.makeupDb = Number(makeupDb);
+      }
+    }
+    if (gainDb !== undefined) {
+      filters.gainDb = Number(gainDb);
+    }
+    processedOptions.filters = filters;
+  }
+
+  // Handle detectMono
+  if (options.detectMono !== undefined) {
+    if (typeof options.detectMono !== 'boolean') {
+      throw new Error('detectMono must be a boolean');
+    }
+    processedOptions.detectMono = options.detectMono;
+  }
+
+  // Handle preview
+  if (options.preview !== undefined) {
+    const { seconds, bitrate } = options.preview;
+    if (seconds !== undefined && !(Number(seconds) >= 0 && Number(seconds) <= 86400)) {
+      throw new Error('preview.seconds must be between 0 and 86400');
+    }
+    if (bitrate !== undefined) {
+      // MP3 has no bitrate below 8 kbps
+      const opus = processedOptions.format === 'opus';
+      const min = opus ? 6 : 8;
+      const max = opus ? 256 : 320;
+      if (!(Number(bitrate) >= min && Number(bitrate) <= max)) {
+        throw new Error(`preview.bitrate must be between ${min} and ${max} kbps for ${opus ? 'Opus' : 'MP3'}`);
+      }
+    }
+    const preview: PreviewOptions = {};
+    if (seconds !== undefined) {
+      preview.seconds = Number(seconds);
+    }
+    if (bitrate !== undefined) {
+      preview.bitrate = Number(bitrate);
+    }
+    processedOptions.preview = preview;
+  }
+
+  // Handle pcmCache
+  if (options.pcmCache !== undefined) {
+    const { enabled, maxBytes } = options.pcmCache;
+    if (enabled !== undefined && typeof enabled !== 'boolean') {
+      throw new Error('pcmCache.enabled must be a boolean');
+    }
+    if (maxBytes !== undefined && !(Number(maxBytes) >= 1e6 && Number(maxBytes) <= 1e12)) {
+      throw new Error('pcmCache.maxBytes must be between 1e6 and 1e12');
+    }
+    const pcmCache: PcmCacheOptions = {};
+    if (enabled !== undefined) {
+      pcmCache.enabled = enabled;
+    }
+    if (maxBytes !== undefined) {
+      pcmCache.maxBytes = Number(maxBytes);
+    }
+    processedOptions.pcmCache = pcmCache;
+  }
+
+  return processedOptions;
+}
+
+const BASE64_ALPHABET = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/';
+
+function decodeBase64(text: string): Uint8Array {
+  const digits = new Int8Array(128).fill(-1);
+  for (let i = 0; i < BASE64_ALPHABET.length; i++) {
+    digits[BASE64_ALPHABET.charCodeAt(i)] = i;
+  }
+  const end = text.replace(/=+$/, '').length;
+  const bytes = new Uint8Array(Math.floor((end * 3) / 4));
+  let value = 0;
+  let bits = 0;
+  let length = 0;
+  for (let i = 0; i < end; i++) {
+    const code = text.charCodeAt(i);
+    const digit = code < 128 ? digits[code] : -1;
+    if (digit < 0) {
+      throw new Error('Invalid base64 data');
+    }
+    value = ((value << 6) | digit) & 0xffffff;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bytes[length++] = (value >> bits) & 0xff;
+    }
+  }
+  return bytes;
+}
+
+function halfToFloat(half: number): number {
+  const sign = half & 0x8000 ? -1 : 1;
+  const exponent = (half >> 10) & 0x1f;
+  const mantissa = half & 0x3ff;
+  if (exponent === 0) {
+    return sign * mantissa * Math.pow(2, -24);
+  }
+  if (exponent === 31) {
+    return mantissa ? NaN : sign * Infinity;
+  }
+  return sign * (1 + mantissa / 1024) * Math.pow(2, exponent - 15);
+}
+
+/**
+ * Decode ConversionResult.logMel, or a logMel.path file read as base64
+ * @param logMel Base64 features
+ * @returns The features as a typed array
+ */
+export function decodeLogMel(logMel: string): LogMelFeatures {
+  const bytes = decodeBase64(logMel);
+  const u16 = (offset: number) => bytes[offset] | (bytes[offset + 1] << 8);
+  const u32 = (offset: number) => u16(offset) + u16(offset + 2) * 65536;
+  if (bytes.length < 20 || String.fromCharCode(bytes[0], bytes[1], bytes[2], bytes[3]) !== 'LMEL') {
+    throw new Error('Not log-mel data');
+  }
+  if (u16(4) !== 1) {
+    throw new Error(`Unsupported log-mel version ${u16(4)}`);
+  }
+  const bands = u16(6);
+  const frames = u32(16);
+  if (bytes.length < 20 + frames * bands * 2) {
+    throw new Error('Truncated log-mel data');
+  }
+  const data = new Float32Array(frames * bands);
+  for (let i = 0; i < data.length; i++) {
+    data[i] = halfToFloat(u16(20 + 2 * i));
+  }
+  return { bands, frames, sampleRate: u32(8), hopLength: u16(12), windowLength: u16(14), data };
+}
+
+/**
+ * Decode ConversionResult.peaks, or a peaks.path sidecar read as base64
+ * @param peaks Base64 peak pyramid
+ * @returns Every level as typed arrays
+ */
+export function decodePeaks(peaks: string): Peaks {
+  const bytes = decodeBase64(peaks);
+  const u16 = (offset: number) => bytes[offset] | (bytes[offset + 1] << 8);
+  const u32 = (offset: number) => u16(offset) + u16(offset + 2) * 65536;
+  const i16 = (offset: number) => (u16(offset) << 16) >> 16;
+  if (bytes.length < 20 || String.fromCharCode(bytes[0], bytes[1], bytes[2], bytes[3]) !== 'PEAK') {
+    throw new Error('Not peak data');
+  }
+  if (u16(4) !== 1) {
+    throw new Error(`Unsupported peak version ${u16(4)}`);
+  }
+  const levelCount = u16(6);
+  let offset = 20 + levelCount * 8;
+  const levels: PeakLevel[] = [];
+  for (let level = 0; level < levelCount; level++) {
+    const bins = u32(24 + level * 8);
+    if (bytes.length < offset + bins * 8) {
+      throw new Error('Truncated peak data');
+    }
+    const min = new Float32Array(bins);
+    const max = new Float32Array(bins);
+    const rms = new Float32Array(bins);
+    const clipped = new Uint16Array(bins);
+    for (let i = 0; i < bins; i++, offset += 8) {
+      min[i] = i16(offset) / 32767;
+      max[i] = i16(offset + 2) / 32767;
+      rms[i] = u16(offset + 4) / 32767;
+      clipped[i] = u16(offset + 6);
+    }
+    levels.push({ samplesPerBin: u32(20 + level * 8), min, max, rms, clipped });
+  }
+  return { sampleRate: u32(8), channels: u16(12), frames: u32(16), levels };
+}
+
+// Ids that match convertWithPreview() calls to their onFinalOutput events
+let previewJobCount = 0;
+
 /**
  * Event emitter for conversion progress updates
  */
@@ -79,11 +1158,21 @@ class WavToMp3Emitter {
     return this.eventEmitter.addListener(WavToMp3Events.Progress, callback);
   }
 
+  /**
+   * Add a listener for the background phase of convertWithPreview() finishing
+   * @param callback Function to be called with the job's outcome
+   * @returns Subscription that should be removed when no longer needed
+   */
+  addFinalOutputListener(callback: (event: FinalOutputEvent) => void): EmitterSubscription {
+    return this.eventEmitter.addListener(WavToMp3Events.FinalOutput, callback);
+  }
+
   /**
    * Remove all event listeners
    */
   removeAllListeners(): void {
     this.eventEmitter.removeAllListeners(WavToMp3Events.Progress);
+    this.eventEmitter.removeAllListeners(WavToMp3Events.FinalOutput);
   }
 }
 
@@ -138,38 +1227,7 @@ class WavToMp3Converter {
     outputPath: string,
     options?: WavToMp3Options
   ): Promise<string> {
-    // Validate options
-    if (options) {
-      let processedOptions: WavToMp3Options = {};
-
-      // Handle bitrate
-      if (options.bitrate !== undefined) {
-        const bitrate = Number(options.bitrate);
-        if (isNaN(bitrate)) {
-          throw new Error('Bitrate must be a valid number');
-        }
-        if (bitrate < 32 || bitrate > 320) {
-          throw new Error('Bitrate must be between 32 and 320 kbps');
-        }
-        processedOptions.bitrate = bitrate;
-      }
-
-      // Handle quality
-      if (options.quality !== undefined) {
-        const quality = Number(options.quality);
-        if (isNaN(quality)) {
-          throw new Error('Quality must be a valid number');
-        }
-        if (quality < 0 || quality > 9) {
-          throw new Error('Quality must be between 0 (best) and 9 (worst)');
-        }
-        processedOptions.quality = quality;
-      }
-
-      return this.nativeModule.convertWavToMp3(inputPath, outputPath, processedOptions);
-    }
-
-    return this.nativeModule.convertWavToMp3(inputPath, outputPath, options);
+    return this.nativeModule.convertWavToMp3(inputPath, outputPath, processOptions(options));
   }
 
   /**
@@ -219,38 +1277,228 @@ class WavToMp3Converter {
       throw new Error('AAC to MP3 conversion is not available in this version');
     }
 
-    // Validate options
-    if (options) {
-      let processedOptions: WavToMp3Options = {};
+    return this.nativeModule.convertAacToMp3(inputPath, outputPath, processOptions(options));
+  }
 
-      // Handle bitrate
-      if (options.bitrate !== undefined) {
-        const bitrate = Number(options.bitrate);
-        if (isNaN(bitrate)) {
-          throw new Error('Bitrate must be a valid number');
-        }
-        if (bitrate < 32 || bitrate > 320) {
-          throw new Error('Bitrate must be between 32 and 320 kbps');
-        }
-        processedOptions.bitrate = bitrate;
+  /**
+   * Convert like convert(), resolving with the job statistics, including where
+   * the encode thread was placed
+   * @param inputPath Path to the input WAV file (can be file:// URI)
+   * @param outputPath Path where the output file should be saved (can be file:// URI)
+   * @param options Optional conversion settings
+   * @returns Promise that resolves with the conversion statistics
+   */
+  async convertWithResult(
+    inputPath: string,
+    outputPath: string,
+    options?: WavToMp3Options
+  ): Promise<ConversionResult> {
+    if (!this.nativeModule.convertWithResult) {
+      throw new Error('convertWithResult is not available in this version');
+    }
+    return this.nativeModule.convertWithResult(inputPath, outputPath, processOptions(options));
+  }
+
+  /**
+   * Encode one input into several outputs, e.g. 128 kbps for download and 32 kbps for
+   * streaming. The input is read, converted and resampled once and every output is
+   * encoded on its own thread. If any output fails, none is kept.
+   * @param inputPath Path to the input WAV file (can be file:// URI)
+   * @param outputs Up to 8 outputs, each with its path and its own options
+   * @param options Optional settings shared by every output
+   * @returns Promise that resolves with the statistics of each output, in order
+   */
+  async convertMulti(
+    inputPath: string,
+    outputs: OutputSpec[],
+    options?: WavToMp3Options
+  ): Promise<ConversionResult[]> {
+    if (!this.nativeModule.convertMulti) {
+      throw new Error('convertMulti is not available in this version');
+    }
+    if (!Array.isArray(outputs) || outputs.length === 0 || outputs.length > 8) {
+      throw new Error('outputs must be an array of 1 to 8 outputs');
+    }
+    const processedOutputs = outputs.map((output) => {
+      if (!output || typeof output.outputPath !== 'string' || output.outputPath === '') {
+        throw new Error('Each output needs an outputPath');
       }
+      return { ...processOptions(output), outputPath: output.outputPath };
+    });
+    return this.nativeModule.convertMulti(inputPath, processedOutputs, processOptions(options));
+  }
 
-      // Handle quality
-      if (options.quality !== undefined) {
-        const quality = Number(options.quality);
-        if (isNaN(quality)) {
-          throw new Error('Quality must be a valid number');
+  /**
+   * Measure how fast this device encodes at each quality level and store the result
+   * for the deadlineMs option. Takes about a second; run it once, e.g. after install.
+   * @returns Promise that resolves with the measured speeds
+   */
+  async calibrate(): Promise<CalibrationResult> {
+    if (!this.nativeModule.calibrate) {
+      throw new Error('calibrate is not available in this version');
+    }
+    return this.nativeModule.calibrate();
+  }
+  /**
+   * Compare two fingerprints from convertWithResult() with the fingerprint option, e.g.
+   * to find the same recording imported in another container or bitrate. The best
+   * alignment within 10 s is used.
+   * @param a Fingerprint of one conversion
+   * @param b Fingerprint of another conversion
+   * @returns Promise that resolves with the similarity, about 0 for unrelated audio and
+   * close to 1 for the same audio
+   */
+  async compareFingerprints(a: string, b: string): Promise<number> {
+    if (!this.nativeModule.compareFingerprints) {
+      throw new Error('compareFingerprints is not available in this version');
+    }
+    if (typeof a !== 'string' || typeof b !== 'string') {
+      throw new Error('Fingerprints must be strings');
+    }
+    return this.nativeModule.compareFingerprints(a, b);
+  }
+  /**
+   * Read format and duration of an audio file from its header, without decoding it,
+   * e.g. to show durations in a file list. Takes well under a millisecond per file.
+   * @param path Path to a WAV/RF64, MP4/M4A, AAC (ADTS), MP3 or Ogg Opus/Vorbis file
+   * (can be file:// URI)
+   * @returns Promise that resolves with the file's format and duration
+   */
+  async probe(path: string): Promise<MediaInfo> {
+    if (!this.nativeModule.probe) {
+      throw new Error('probe is not available in this version');
+    }
+    if (typeof path !== 'string' || path.length === 0) {
+      throw new Error('Path must be a non-empty string');
+    }
+    return this.nativeModule.probe(path);
+  }
+  /**
+   * probe() many files at once, reading them in parallel
+   * @param paths Paths to the files (can be file:// URIs)
+   * @returns Promise that resolves with one entry per path, in order: its MediaInfo, or
+   * a ProbeError if it could not be read
+   */
+  async probeMany(paths: string[]): Promise<(MediaInfo | ProbeError)[]> {
+    if (!this.nativeModule.probeMany) {
+      throw new Error('probeMany is not available in this version');
+    }
+    if (!Array.isArray(paths) || paths.some((path) => typeof path !== 'string')) {
+      throw new Error('Paths must be an array of strings');
+    }
+    return this.nativeModule.probeMany(paths);
+  }
+  /**
+   * Predict the output size and conversion time before starting, e.g. to warn about a
+   * large file or a long wait. The size follows from the input's duration and the
+   * bitrate; the time from how fast this device finished earlier conversions with the
+   * same encoder, or from calibrate() until it has. Rejects with SPACE_ERROR when the
+   * output's file system lacks the space.
+   * @param inputPath Path to the input file (can be file:// URI)
+   * @param outputPath Path the output would be saved to (can be file:// URI)
+   * @param options The conversion settings
+   * @returns Promise that resolves with the predicted size and time
+   */
+  async estimate(
+    inputPath: string,
+    outputPath: string,
+    options?: WavToMp3Options
+  ): Promise<ConversionEstimate> {
+    if (!this.nativeModule.estimate) {
+      throw new Error('estimate is not available in this version');
+    }
+    return this.nativeModule.estimate(inputPath, outputPath, processOptions(options));
+  }
+  /**
+   * Cut an MP3 to the part from startMs to endMs without re-encoding, so it takes about
+   * as long as copying the file. The cut falls on frame boundaries (26 ms at 44.1 kHz);
+   * the output's LAME tag tells gapless players to skip to the exact millisecond.
+   * Rejects with MP3_ERROR when the input is not an MP3 stream.
+   * @param inputPath Path to the input MP3 (can be file:// URI)
+   * @param outputPath Path where the output should be saved; may be inputPath (can be file:// URI)
+   * @param startMs Where the kept part starts
+   * @param endMs Where it ends (default: the end of the file)
+   * @returns Promise that resolves with the output's statistics
+   */
+  async trimMp3(
+    inputPath: string,
+    outputPath: string,
+    startMs: number,
+    endMs?: number
+  ): Promise<Mp3EditResult> {
+    if (!this.nativeModule.trimMp3) {
+      throw new Error('trimMp3 is not available in this version');
+    }
+    if (typeof startMs !== 'number' || !(startMs >= 0)) {
+      throw new Error('startMs must be a number of 0 or more');
+    }
+    if (endMs !== undefined && (typeof endMs !== 'number' || !(endMs > startMs))) {
+      throw new Error('endMs must be a number greater than startMs');
+    }
+    return this.nativeModule.trimMp3(inputPath, outputPath, startMs, endMs ?? -1);
+  }
+  /**
+   * Join MP3 files one after the other without re-encoding. All must share the sample
+   * rate and channel count; bitrates may differ. Each seam keeps the encoder delay and
+   * padding of the files it joins, about 25 to 50 ms of near-silence (gapMs in total).
+   * @param inputPaths Paths to the input MP3s, in order (can be file:// URIs)
+   * @param outputPath Path where the output should be saved (can be file:// URI)
+   * @returns Promise that resolves with the output's statistics
+   */
+  async joinMp3(inputPaths: string[], outputPath: string): Promise<Mp3EditResult> {
+    if (!this.nativeModule.joinMp3) {
+      throw new Error('joinMp3 is not available in this version');
+    }
+    if (!Array.isArray(inputPaths) || inputPaths.length === 0 ||
+        inputPaths.some((path) => typeof path !== 'string')) {
+      throw new Error('Input paths must be a non-empty array of strings');
+    }
+    return this.nativeModule.joinMp3(inputPaths, outputPath);
+  }
+  /**
+   * Convert in two phases: first a quick low-bitrate preview at outputPath, resolved as
+   * soon as it is written, then the full-quality output at background priority, which
+   * replaces the preview atomically. Both phases read the input once from storage; the
+   * second finds it in the page cache. WAV and raw PCM input only.
+   * @param inputPath Path to the input WAV file (can be file:// URI)
+   * @param outputPath Path where the output file should be saved (can be file:// URI)
+   * @param options Conversion settings of the final output; options.preview shapes the preview
+   * @returns Promise that resolves with the preview's statistics and a promise of the final ones
+   */
+  async convertWithPreview(
+    inputPath: string,
+    outputPath: string,
+    options?: WavToMp3Options
+  ): Promise<PreviewJob> {
+    const nativeModule = this.nativeModule;
+    if (!nativeModule.convertWithPreview) {
+      throw new Error('convertWithPreview is not available in this version');
+    }
+    const processed = processOptions(options);
+    const jobId = `preview-${++previewJobCount}`;
+    let subscription: EmitterSubscription | undefined;
+    const final = new Promise<ConversionResult>((resolve, reject) => {
+      subscription = this.events.addFinalOutputListener((event) => {
+        if (event.jobId !== jobId) {
+          return;
         }
-        if (quality < 0 || quality > 9) {
-          throw new Error('Quality must be between 0 (best) and 9 (worst)');
+        subscription?.remove();
+        if (event.result) {
+          resolve(event.result);
+        } else {
+          const error: Error & { code?: string } = new Error(event.errorMessage);
+          error.code = event.errorCode;
+          reject(error);
         }
-        processedOptions.quality = quality;
-      }
-
-      return this.nativeModule.convertAacToMp3(inputPath, outputPath, processedOptions);
+      });
+    });
+    try {
+      const preview = await nativeModule.convertWithPreview(jobId, inputPath, outputPath, processed);
+      return { preview, final };
+    } catch (error) {
+      subscription?.remove();
+      throw error;
     }
-
-    return this.nativeModule.convertAacToMp3(inputPath, outputPath, options);
   }
 }
 